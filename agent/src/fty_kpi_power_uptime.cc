@@ -74,8 +74,21 @@ int main(int argc, char* argv[])
     //    zstr_sendx (server, "CONSUMER", "METRICS", "^status.ups@.*", nullptr);
     //    zstr_sendx (server, "CONSUMER", "METRICS", "^status@.*", nullptr);
     zstr_sendx(server, "CONSUMER", "ASSETS", "^datacenter.unknown@.*", nullptr);
+    zsock_wait(server);
     zstr_sendx(server, "CONSUMER", "ASSETS", "^datacenter.N_A@.*", nullptr);
     zsock_wait(server);
+    // rooms, rows, racks and upses place the upses in the tree of rollups
+    zstr_sendx(server, "CONSUMER", "ASSETS", "^room\\..*@.*", nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONSUMER", "ASSETS", "^row\\..*@.*", nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONSUMER", "ASSETS", "^rack\\..*@.*", nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONSUMER", "ASSETS", "^device\\.ups@.*", nullptr);
+    zsock_wait(server);
+    // learn all datacenters now rather than waiting for them to appear on the stream
+    zstr_sendx(server, "BOOTSTRAP", "asset-agent", "5000", nullptr);
+    zsock_wait(server);
 
     //  Accept and print any message back from server
     //  copy from src/malamute.c under MPL license
@@ -1,5 +1,5 @@
 /*  =========================================================================
-    fty_kpi_power_uptime_convert - Converts old binary format state file into new zpl format state file
+    fty_kpi_power_uptime_convert - Inspects, repairs and converts state files
 
     Copyright (C) 2014 - 2020 Eaton
 
@@ -19,9 +19,16 @@
     =========================================================================
 */
 
-/// fty_kpi_power_uptime_convert - Converts old binary format state file into new zpl format state file
+/// fty_kpi_power_uptime_convert - Inspects, repairs and converts state files
+///
+/// Dumps, validates, compares, merges, compacts and exports state files of the agent and converts
+/// state files of the old binary format. State files are read one datacenter at a time (see
+/// upt_statefile.h), so memory does not grow with the number of UPSes; diff and merge keep a few
+/// numbers of every datacenter.
 
-#include "dc.h"
+#include "upt_export.h"
+#include "upt_statefile.h"
+#include <fty_log.h>
 
 static void s_dc_destructor(void** x)
 {
@@ -38,172 +45,605 @@ static void* s_str_duplicator(const void* x)
     return strdup(reinterpret_cast<const char*>(x));
 }
 
-static void s_load_binary(FILE* file, zhashx_t** ups2dc_p, zhashx_t* dc)
+static void s_usage(void)
 {
-    assert(file);
-    assert(ups2dc_p);
-    assert(dc);
+    puts("fty-kpi-power-uptime-convert command [options] file...");
+    puts("Inspects, repairs and converts state files of fty-kpi-power-uptime.");
+    puts("  dump FILE              print datacenters and their upses");
+    puts("  validate FILE...       check state files, exit status 1 if one is broken");
+    puts("  diff OLD NEW           print changes of datacenters, exit status 1 if there are some, 2 on error");
+    puts("  merge -o OUT FILE...   union of datacenters, of the same one the one with the most time is kept");
+    puts("  compact -o OUT FILE    drop values of upses which left their datacenter");
+    puts("  export FILE            print counters of datacenters and upses as JSON Lines or CSV");
+    puts("  convert -o OUT FILE    convert a state file of the old binary format");
+    puts("  FILE_NAME OLD_DIR NEW_DIR  convert OLD_DIR/FILE_NAME to NEW_DIR/FILE_NAME (older usage)");
+    puts("  --output / -o PATH     state file to write");
+    puts("  --format / -f FORMAT   json (default) or csv, for export");
+    puts("  --records / -r KIND    dc (default), window, ups or all (json only), for export");
+    puts("  --baselines / -b PATH  baselines file of the agent, for window records of export");
+    puts("  --drop-empty           compact drops datacenters without upses too");
+    puts("  --verbose / -v         verbose output");
+    puts("  --help / -h            this information");
+}
 
-    zmsg_t* msg = nullptr;
-#if CZMQ_VERSION_MAJOR == 3
-    msg = zmsg_load(nullptr, file);
-#else
-    msg = zmsg_load(file);
-#endif
-    assert(msg);
-    assert(zmsg_is(msg));
+static bool s_is_command(const char* command)
+{
+    static const char* commands[] = {"dump", "validate", "diff", "merge", "compact", "export", "convert"};
+    for (const char* known : commands) {
+        if (streq(command, known))
+            return true;
+    }
+    return false;
+}
 
-    char* magic = zmsg_popstr(msg);
-    assert(magic);
-    assert(streq(magic, "upt0x01"));
-    zstr_free(&magic);
+// open file, errors are printed
+static upt_statefile_t* s_open(const char* path)
+{
+    upt_statefile_t* file = upt_statefile_open(path);
+    if (!file)
+        fprintf(stderr, "%s: can't open\n", path);
+    return file;
+}
 
-    // ups2dc
-    zframe_t* frame = zmsg_pop(msg);
-    assert(frame);
-    *ups2dc_p = zhashx_unpack(frame);
-    assert(*ups2dc_p);
+// close file, return -1 if reading stopped on an error (printed)
+static int s_close(upt_statefile_t** file_p)
+{
+    int rv = 0;
+    if (upt_statefile_error(*file_p)) {
+        fprintf(stderr, "%s\n", upt_statefile_error(*file_p));
+        rv = -1;
+    }
+    upt_statefile_close(file_p);
+    return rv;
+}
 
-    zhashx_set_duplicator(*ups2dc_p, s_str_duplicator);
-    zhashx_set_destructor(*ups2dc_p, s_str_destructor);
-    zframe_destroy(&frame);
+//  --------------------------------------------------------------------------
+//  dump
 
-    // count
-    char* s_size = zmsg_popstr(msg);
-    assert(s_size);
+static int s_dump(const char* path)
+{
+    upt_statefile_t* file = s_open(path);
+    if (!file)
+        return -1;
+
+    printf("# checkpoint\t%" PRIi64 "\n", upt_statefile_checkpoint(file));
+    printf("# datacenter\ttotal\toffline\tunknown\tpolicy\tthreshold\tupses\toffline_upses\n");
+    printf("#\tups\tstate\ton_battery\ttransitions\tlast_change\n");
+    for (upt_statefile_dc_t* record = upt_statefile_next(file); record != nullptr;
+         record                     = upt_statefile_next(file)) {
+        dc_t* dc = record->dc;
+        printf("%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%s\t%" PRIu64 "\t%zu\t%zu\n", record->name, dc_total(dc),
+            dc_off_line(dc), dc_unknown(dc), dc_policy_name(dc->policy), dc->threshold, zlistx_size(record->upses),
+            zlistx_size(dc->ups));
+        for (char* ups = reinterpret_cast<char*>(zlistx_first(record->upses)); ups != nullptr;
+             ups       = reinterpret_cast<char*>(zlistx_next(record->upses))) {
+            dc_ups_counters_t counters = {0, 0, 0, -1};
+            dc_ups_counters(dc, ups, &counters);
+            printf("\t%s\t%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIi64 "\n", ups, dc_state_name(dc_ups_state(dc, ups)),
+                counters.on_battery, counters.transitions, counters.last_change);
+        }
+    }
+    return s_close(&file);
+}
 
-    size_t size;
-    sscanf(s_size, "%zu", &size);
-    zstr_free(&s_size);
+//  --------------------------------------------------------------------------
+//  validate
 
-    if (size == 0)
-        return;
+// names of values of upses which are not members, they are dropped by compact
+static zlistx_t* s_strangers(upt_statefile_dc_t* record)
+{
+    zhashx_t* members = zhashx_new();
+    for (char* ups = reinterpret_cast<char*>(zlistx_first(record->upses)); ups != nullptr;
+         ups       = reinterpret_cast<char*>(zlistx_next(record->upses))) {
+        zhashx_update(members, ups, ups);
+    }
 
-    size_t i = 0;
-    char*  key;
-    do {
-        key = zmsg_popstr(msg);
-        if (!key)
-            break;
-        frame = zmsg_pop(msg);
-        if (!frame) {
-            zstr_free(&key);
-            break;
+    zlistx_t* strangers = zlistx_new();
+    zlistx_set_duplicator(strangers, s_str_duplicator);
+    zlistx_set_destructor(strangers, s_str_destructor);
+    zlistx_set_comparator(strangers, reinterpret_cast<czmq_comparator*>(strcmp));
+    zhashx_t* hashes[] = {record->dc->states, record->dc->ratings, record->dc->counters};
+    for (zhashx_t* hash : hashes) {
+        if (!hash)
+            continue;
+        for (void* entry = zhashx_first(hash); entry != nullptr; entry = zhashx_next(hash)) {
+            const char* ups = reinterpret_cast<const char*>(zhashx_cursor(hash));
+            if (!zhashx_lookup(members, ups) && !zlistx_find(strangers, const_cast<char*>(ups)))
+                zlistx_add_end(strangers, const_cast<char*>(ups));
         }
-        dc_t* dc_item = dc_unpack(frame);
-        if (!dc_item) {
-            zframe_destroy(&frame);
-            zstr_free(&key);
-            break;
-        }
-        zhashx_insert(dc, key, dc_item);
-        zframe_destroy(&frame);
-        zstr_free(&key);
-        i++;
-    } while (i != size);
-
-    zmsg_destroy(&msg);
-    return;
+    }
+    zhashx_destroy(&members);
+    return strangers;
 }
 
-static void s_save_zpl(zhashx_t* ups2dc, zhashx_t* dc, const char* file_path)
+static int s_validate(const char* path, bool verbose)
 {
-    assert(ups2dc);
-    assert(dc);
-    assert(file_path);
+    upt_statefile_t* file = s_open(path);
+    if (!file)
+        return -1;
+
+    size_t count = 0, warnings = 0;
+    for (upt_statefile_dc_t* record = upt_statefile_next(file); record != nullptr;
+         record                     = upt_statefile_next(file), count++) {
+        dc_t* dc = record->dc;
+        if (dc_off_line(dc) > dc_total(dc)) {
+            printf("%s: %s: offline time is longer than total time\n", path, record->name);
+            warnings++;
+        }
+        zlistx_t* strangers = s_strangers(record);
+        for (char* ups = reinterpret_cast<char*>(zlistx_first(strangers)); ups != nullptr;
+             ups       = reinterpret_cast<char*>(zlistx_next(strangers))) {
+            printf("%s: %s: %s is not a member but has values\n", path, record->name, ups);
+            warnings++;
+        }
+        zlistx_destroy(&strangers);
+    }
+    if (upt_statefile_ignored(file) != 0) {
+        printf("%s: %zu values are not read by the agent (gap in their numbering)\n", path,
+            upt_statefile_ignored(file));
+        warnings++;
+    }
+    int rv = s_close(&file);
+    if (rv == 0 && verbose)
+        printf("%s: %zu datacenters, %zu warnings\n", path, count, warnings);
+    return rv;
+}
 
-    zconfig_t* config_file = zconfig_new("root", nullptr);
+//  --------------------------------------------------------------------------
+//  diff
 
-    int   j        = 1;
-    dc_t* dc_struc = nullptr;
+// what diff compares of a datacenter
+struct s_summary_t
+{
+    uint64_t    total, offline, unknown, threshold;
+    uint64_t    durations[DC_STATE_COUNT];
+    dc_policy_t policy;
+    size_t      upses, offline_upses;
+    bool        seen;
+};
+
+static void s_free_destructor(void** x)
+{
+    free(*x);
+    *x = nullptr;
+}
 
-    for (dc_struc = reinterpret_cast<dc_t*>(zhashx_first(dc)); dc_struc != nullptr;
-         dc_struc = reinterpret_cast<dc_t*>(zhashx_next(dc))) {
-        int i = 1;
+static void s_summarize(upt_statefile_dc_t* record, s_summary_t* summary)
+{
+    summary->total     = dc_total(record->dc);
+    summary->offline   = dc_off_line(record->dc);
+    summary->unknown   = dc_unknown(record->dc);
+    summary->threshold = record->dc->threshold;
+    memcpy(summary->durations, record->dc->durations, sizeof(summary->durations));
+    summary->policy        = record->dc->policy;
+    summary->upses         = zlistx_size(record->upses);
+    summary->offline_upses = zlistx_size(record->dc->ups);
+    summary->seen          = false;
+}
 
-        // list of datacenters
-        char* dc_name = const_cast<char*>(reinterpret_cast<const char*>(zhashx_cursor(dc)));
-        char* path    = zsys_sprintf("dc_list/dc.%d", j);
-        zconfig_putf(config_file, path, "%s", dc_name);
-        zstr_free(&path);
+static void s_print_summary(char sign, const char* name, s_summary_t* summary)
+{
+    printf("%c %s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%s\t%" PRIu64 "\t%zu\t%zu\n", sign, name, summary->total,
+        summary->offline, summary->unknown, dc_policy_name(summary->policy), summary->threshold, summary->upses,
+        summary->offline_upses);
+}
 
-        // self->ups2dc - list of upses for each dc
-        for (char* dc1 = reinterpret_cast<char*>(zhashx_first(ups2dc)); dc1 != nullptr;
-             dc1       = reinterpret_cast<char*>(zhashx_next(ups2dc))) {
-            if (streq(dc1, dc_name)) {
-                path = zsys_sprintf("dc_upses/%s/ups.%d", dc1, i);
-                zconfig_putf(config_file, path, "%s", reinterpret_cast<const char*>(zhashx_cursor(ups2dc)));
-                zstr_free(&path);
-                i++;
-            }
+// print fields which differ, return their number
+static size_t s_compare(const char* name, s_summary_t* old, s_summary_t* now)
+{
+    struct
+    {
+        const char* field;
+        uint64_t    old, now;
+    } fields[] = {
+        {"total", old->total, now->total},
+        {"offline", old->offline, now->offline},
+        {"unknown", old->unknown, now->unknown},
+        {"threshold", old->threshold, now->threshold},
+        {"upses", old->upses, now->upses},
+        {"offline_upses", old->offline_upses, now->offline_upses},
+    };
+    size_t changes = 0;
+    for (const auto& it : fields) {
+        if (it.old != it.now) {
+            printf("~ %s\t%s\t%" PRIu64 "\t%" PRIu64 "\n", name, it.field, it.old, it.now);
+            changes++;
+        }
+    }
+    if (old->policy != now->policy) {
+        printf("~ %s\tpolicy\t%s\t%s\n", name, dc_policy_name(old->policy), dc_policy_name(now->policy));
+        changes++;
+    }
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+        if (old->durations[state] != now->durations[state]) {
+            printf("~ %s\t%s\t%" PRIu64 "\t%" PRIu64 "\n", name, dc_state_name(dc_state_t(state)),
+                old->durations[state], now->durations[state]);
+            changes++;
         }
-        j++;
+    }
+    return changes;
+}
 
-    } // for
+// return 0 if the files hold the same, 1 if not, -1 on error
+static int s_diff(const char* old_path, const char* new_path)
+{
+    upt_statefile_t* file = s_open(old_path);
+    if (!file)
+        return -1;
+    zhashx_t* summaries = zhashx_new();
+    zhashx_set_destructor(summaries, s_free_destructor);
+    for (upt_statefile_dc_t* record = upt_statefile_next(file); record != nullptr;
+         record                     = upt_statefile_next(file)) {
+        s_summary_t* summary = reinterpret_cast<s_summary_t*>(zmalloc(sizeof(s_summary_t)));
+        s_summarize(record, summary);
+        zhashx_update(summaries, record->name, summary);
+    }
+    if (s_close(&file) != 0 || !(file = s_open(new_path))) {
+        zhashx_destroy(&summaries);
+        return -1;
+    }
 
-    // save the state file
-    int rv = zconfig_save(config_file, file_path);
-    assert(rv == 0);
-    zconfig_destroy(&config_file);
-    return;
+    printf("# datacenter\ttotal\toffline\tunknown\tpolicy\tthreshold\tupses\toffline_upses\n");
+    printf("# datacenter\tfield\told\tnew\n");
+    size_t changes = 0;
+    for (upt_statefile_dc_t* record = upt_statefile_next(file); record != nullptr;
+         record                     = upt_statefile_next(file)) {
+        s_summary_t  now;
+        s_summary_t* old = reinterpret_cast<s_summary_t*>(zhashx_lookup(summaries, record->name));
+        s_summarize(record, &now);
+        if (!old) {
+            s_print_summary('+', record->name, &now);
+            changes++;
+        } else {
+            changes += s_compare(record->name, old, &now);
+            old->seen = true;
+        }
+    }
+    int rv = s_close(&file);
+    for (s_summary_t* old = reinterpret_cast<s_summary_t*>(zhashx_first(summaries)); old != nullptr;
+         old              = reinterpret_cast<s_summary_t*>(zhashx_next(summaries))) {
+        if (!old->seen) {
+            s_print_summary('-', reinterpret_cast<const char*>(zhashx_cursor(summaries)), old);
+            changes++;
+        }
+    }
+    zhashx_destroy(&summaries);
+    return rv != 0 ? -1 : changes != 0 ? 1 : 0;
 }
 
-int main(int argc, char* argv[])
+//  --------------------------------------------------------------------------
+//  merge
+
+// input holding the datacenter with the most total time
+struct s_owner_t
 {
-    bool verbose = false;
-    int  argn;
-    for (argn = 1; argn < argc; argn++) {
-        if (streq(argv[argn], "--help") || streq(argv[argn], "-h")) {
-            puts("fty-kpi-power-uptime-convert [options] [file_name] [old_path] [new_path]");
-            puts("Converts bios_proto state file to fty_proto state file.");
-            puts("  --verbose / -v         verbose test output");
-            puts("  --help / -h            this information");
-            return EXIT_SUCCESS;
-        } else if (streq(argv[argn], "--verbose") || streq(argv[argn], "-v"))
-            verbose = true;
+    size_t   input;
+    uint64_t total;
+};
+
+static int s_merge(zlistx_t* inputs, const char* output, bool verbose)
+{
+    // first pass picks the owner of every datacenter, the second one copies them
+    zhashx_t* owners = zhashx_new();
+    zhashx_set_destructor(owners, s_free_destructor);
+    int64_t checkpoint = -1;
+    int     rv         = 0;
+    size_t  input      = 0;
+    for (char* path = reinterpret_cast<char*>(zlistx_first(inputs)); path != nullptr && rv == 0;
+         path       = reinterpret_cast<char*>(zlistx_next(inputs)), input++) {
+        upt_statefile_t* file = s_open(path);
+        if (!file) {
+            rv = -1;
+            break;
+        }
+        if (upt_statefile_checkpoint(file) > checkpoint)
+            checkpoint = upt_statefile_checkpoint(file);
+        for (upt_statefile_dc_t* record = upt_statefile_next(file); record != nullptr;
+             record                     = upt_statefile_next(file)) {
+            s_owner_t* owner = reinterpret_cast<s_owner_t*>(zhashx_lookup(owners, record->name));
+            if (!owner) {
+                owner = reinterpret_cast<s_owner_t*>(zmalloc(sizeof(s_owner_t)));
+                zhashx_insert(owners, record->name, owner);
+            } else if (owner->total >= dc_total(record->dc))
+                continue;
+            owner->input = input;
+            owner->total = dc_total(record->dc);
+        }
+        rv = s_close(&file);
     }
-    char *file_name = nullptr, *old_path = nullptr, *new_path = nullptr;
-    if (verbose) {
-        file_name = argv[2];
-        old_path  = argv[3];
-        new_path  = argv[4];
-    } else {
-        file_name = argv[1];
-        old_path  = argv[2];
-        new_path  = argv[3];
+
+    upt_statefile_writer_t* writer = rv == 0 ? upt_statefile_create(output, checkpoint) : nullptr;
+    if (rv == 0 && !writer)
+        rv = -1;
+    input = 0;
+    for (char* path = reinterpret_cast<char*>(zlistx_first(inputs)); path != nullptr && rv == 0;
+         path       = reinterpret_cast<char*>(zlistx_next(inputs)), input++) {
+        upt_statefile_t* file = s_open(path);
+        if (!file) {
+            rv = -1;
+            break;
+        }
+        size_t taken = 0;
+        for (upt_statefile_dc_t* record = upt_statefile_next(file); record != nullptr && rv == 0;
+             record                     = upt_statefile_next(file)) {
+            s_owner_t* owner = reinterpret_cast<s_owner_t*>(zhashx_lookup(owners, record->name));
+            if (owner->input != input)
+                continue;
+            rv           = upt_statefile_write(writer, record->name, record->dc, record->upses);
+            owner->input = SIZE_MAX; // written
+            taken++;
+        }
+        if (s_close(&file) != 0)
+            rv = -1;
+        if (verbose)
+            printf("%s: %zu datacenters taken\n", path, taken);
     }
+    if (writer && rv == 0)
+        rv = upt_statefile_commit(&writer);
+    upt_statefile_abort(&writer);
+    if (rv == 0 && verbose)
+        printf("%s: %zu datacenters\n", output, zhashx_size(owners));
+    zhashx_destroy(&owners);
+    return rv;
+}
 
-    printf("file_name = '%s'\n", file_name);
-    printf("old_path = '%s'\n", old_path);
-    printf("new_path = '%s'\n", new_path);
+//  --------------------------------------------------------------------------
+//  compact
 
-    zhashx_t* ups2dc = nullptr;
+static int s_compact(const char* path, const char* output, bool drop_empty, bool verbose)
+{
+    upt_statefile_t* file = s_open(path);
+    if (!file)
+        return -1;
+    upt_statefile_writer_t* writer = upt_statefile_create(output, upt_statefile_checkpoint(file));
+    if (!writer) {
+        upt_statefile_close(&file);
+        return -1;
+    }
 
-    zhashx_t* dc = zhashx_new();
-    assert(dc);
-    zhashx_set_destructor(dc, s_dc_destructor);
+    int    rv      = 0;
+    size_t dropped = 0, removed = 0;
+    for (upt_statefile_dc_t* record = upt_statefile_next(file); record != nullptr && rv == 0;
+         record                     = upt_statefile_next(file)) {
+        if (drop_empty && zlistx_size(record->upses) == 0) {
+            dropped++;
+            continue;
+        }
+        zlistx_t* strangers = s_strangers(record);
+        for (char* ups = reinterpret_cast<char*>(zlistx_first(strangers)); ups != nullptr;
+             ups       = reinterpret_cast<char*>(zlistx_next(strangers))) {
+            dc_remove_ups(record->dc, ups);
+        }
+        removed += zlistx_size(strangers);
+        zlistx_destroy(&strangers);
+        rv = upt_statefile_write(writer, record->name, record->dc, record->upses);
+    }
+    size_t ignored = upt_statefile_ignored(file);
+    if (s_close(&file) != 0)
+        rv = -1;
+    if (rv == 0)
+        rv = upt_statefile_commit(&writer);
+    upt_statefile_abort(&writer);
+    if (rv == 0 && verbose)
+        printf("%s: %zu datacenters dropped, %zu upses removed, %zu unread values dropped\n", output, dropped,
+            removed, ignored);
+    return rv;
+}
 
-    zfile_t* file = zfile_new(old_path, file_name);
-    assert(file);
+//  --------------------------------------------------------------------------
+//  export
 
-    assert(zfile_is_regular(file));
-    assert(zfile_is_readable(file));
-    assert(zfile_input(file) == 0);
+static int s_export(
+    const char* path, upt_export_format_t format, upt_export_records_t records, const char* baselines_path)
+{
+    upt_baseline_t* baselines = nullptr;
+    if (baselines_path) {
+        baselines = upt_baseline_load(baselines_path);
+        if (!baselines) {
+            fprintf(stderr, "%s: can't load baselines\n", baselines_path);
+            return -1;
+        }
+    }
+    upt_statefile_t* file = s_open(path);
+    if (!file) {
+        upt_baseline_destroy(&baselines);
+        return -1;
+    }
 
-    FILE* fp = zfile_handle(file);
-    assert(fp);
+    upt_export_header(stdout, format, records);
+    for (upt_statefile_dc_t* record = upt_statefile_next(file); record != nullptr;
+         record                     = upt_statefile_next(file)) {
+        upt_export_write(stdout, format, records, record->name, record->dc, zlistx_size(record->upses), baselines);
+    }
+    upt_baseline_destroy(&baselines);
+    return s_close(&file);
+}
 
-    s_load_binary(fp, &ups2dc, dc);
+//  --------------------------------------------------------------------------
+//  convert
 
-    zfile_close(file);
-    zfile_destroy(&file);
+// load the old binary format (upt0x01): ups2dc maps ups name to dc name, dc maps name to dc_t
+static int s_load_binary(const char* path, zhashx_t** ups2dc_p, zhashx_t* dc)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "%s: can't open\n", path);
+        return -1;
+    }
+#if CZMQ_VERSION_MAJOR == 3
+    zmsg_t* msg = zmsg_load(nullptr, file);
+#else
+    zmsg_t* msg = zmsg_load(file);
+#endif
+    fclose(file);
+
+    char* magic = msg ? zmsg_popstr(msg) : nullptr;
+    if (!magic || !streq(magic, "upt0x01")) {
+        fprintf(stderr, "%s: not a state file of the binary format\n", path);
+        zstr_free(&magic);
+        zmsg_destroy(&msg);
+        return -1;
+    }
+    zstr_free(&magic);
 
-    char* tmp = zsys_sprintf("%s/%s", new_path, file_name);
-    s_save_zpl(ups2dc, dc, tmp);
-    zstr_free(&tmp);
+    zframe_t* frame = zmsg_pop(msg);
+    *ups2dc_p       = frame ? zhashx_unpack(frame) : nullptr;
+    zframe_destroy(&frame);
+    char* s_size = zmsg_popstr(msg);
+    if (!*ups2dc_p || !s_size) {
+        fprintf(stderr, "%s: truncated state file\n", path);
+        zstr_free(&s_size);
+        zmsg_destroy(&msg);
+        return -1;
+    }
+    zhashx_set_duplicator(*ups2dc_p, s_str_duplicator);
+    zhashx_set_destructor(*ups2dc_p, s_str_destructor);
+
+    size_t size = size_t(atol(s_size));
+    zstr_free(&s_size);
+    int rv = 0;
+    for (size_t i = 0; i != size; i++) {
+        char* key = zmsg_popstr(msg);
+        frame     = zmsg_pop(msg);
+        dc_t* item = frame ? dc_unpack(frame) : nullptr;
+        zframe_destroy(&frame);
+        if (!key || !item) {
+            fprintf(stderr, "%s: datacenter %zu of %zu is missing or broken\n", path, i + 1, size);
+            zstr_free(&key);
+            rv = -1;
+            break;
+        }
+        zhashx_insert(dc, key, item);
+        zstr_free(&key);
+    }
+    zmsg_destroy(&msg);
+    return rv;
+}
 
+static int s_convert(const char* path, const char* output)
+{
+    zhashx_t* ups2dc = nullptr;
+    zhashx_t* dcs    = zhashx_new();
+    zhashx_set_destructor(dcs, s_dc_destructor);
+
+    int rv = s_load_binary(path, &ups2dc, dcs);
+    upt_statefile_writer_t* writer = rv == 0 ? upt_statefile_create(output, -1) : nullptr;
+    if (rv == 0 && !writer)
+        rv = -1;
+    zlistx_t* upses = zlistx_new();
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(dcs)); dc != nullptr && rv == 0;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(dcs))) {
+        const char* dc_name = reinterpret_cast<const char*>(zhashx_cursor(dcs));
+        zlistx_purge(upses);
+        for (char* name = reinterpret_cast<char*>(zhashx_first(ups2dc)); name != nullptr;
+             name       = reinterpret_cast<char*>(zhashx_next(ups2dc))) {
+            if (streq(name, dc_name))
+                zlistx_add_end(upses, const_cast<void*>(zhashx_cursor(ups2dc)));
+        }
+        rv = upt_statefile_write(writer, dc_name, dc, upses);
+    }
+    if (rv == 0)
+        rv = upt_statefile_commit(&writer);
+    upt_statefile_abort(&writer);
+    zlistx_destroy(&upses);
     zhashx_destroy(&ups2dc);
-    zhashx_destroy(&dc);
+    zhashx_destroy(&dcs);
+    return rv;
+}
 
-    return 0;
+int main(int argc, char* argv[])
+{
+    const char*          command    = nullptr;
+    const char*          output     = nullptr;
+    upt_export_format_t  format     = UPT_EXPORT_JSON;
+    upt_export_records_t records    = UPT_EXPORT_DCS;
+    const char*          baselines  = nullptr;
+    bool                 drop_empty = false;
+    bool                 verbose    = false;
+    zlistx_t*            files      = zlistx_new();
+
+    for (int argn = 1; argn < argc; argn++) {
+        const char* arg = argv[argn];
+        if (streq(arg, "--help") || streq(arg, "-h")) {
+            s_usage();
+            zlistx_destroy(&files);
+            return EXIT_SUCCESS;
+        } else if (streq(arg, "--verbose") || streq(arg, "-v"))
+            verbose = true;
+        else if ((streq(arg, "--output") || streq(arg, "-o")) && argn + 1 < argc)
+            output = argv[++argn];
+        else if ((streq(arg, "--format") || streq(arg, "-f")) && argn + 1 < argc) {
+            if (upt_export_format_parse(argv[++argn], &format) == -1) {
+                printf("Unknown format: %s\n", argv[argn]);
+                zlistx_destroy(&files);
+                return EXIT_FAILURE;
+            }
+        } else if ((streq(arg, "--records") || streq(arg, "-r")) && argn + 1 < argc) {
+            if (upt_export_records_parse(argv[++argn], &records) == -1) {
+                printf("Unknown records: %s\n", argv[argn]);
+                zlistx_destroy(&files);
+                return EXIT_FAILURE;
+            }
+        } else if ((streq(arg, "--baselines") || streq(arg, "-b")) && argn + 1 < argc)
+            baselines = argv[++argn];
+        else if (streq(arg, "--drop-empty"))
+            drop_empty = true;
+        else if (arg[0] != '-' && !command)
+            command = arg;
+        else if (arg[0] != '-')
+            zlistx_add_end(files, const_cast<char*>(arg));
+        else {
+            printf("Unknown option: %s\n", arg);
+            zlistx_destroy(&files);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ftylog_setInstance("fty-kpi-power-uptime-convert", FTY_COMMON_LOGGING_DEFAULT_CFG);
+    if (verbose)
+        ftylog_setVeboseMode(ftylog_getInstance());
+
+    const char* first  = reinterpret_cast<const char*>(zlistx_first(files));
+    const char* second = reinterpret_cast<const char*>(zlistx_next(files));
+    size_t      count  = zlistx_size(files);
+    int         rv     = -1;
+    if (!command) {
+        s_usage();
+    } else if (streq(command, "dump") && count == 1)
+        rv = s_dump(first);
+    else if (streq(command, "validate") && count != 0) {
+        rv = 0;
+        for (char* path = reinterpret_cast<char*>(zlistx_first(files)); path != nullptr;
+             path       = reinterpret_cast<char*>(zlistx_next(files))) {
+            if (s_validate(path, verbose) != 0)
+                rv = -1;
+        }
+    } else if (streq(command, "diff") && count == 2)
+        rv = s_diff(first, second);
+    else if (streq(command, "merge") && count != 0 && output)
+        rv = s_merge(files, output, verbose);
+    else if (streq(command, "compact") && count == 1 && output)
+        rv = s_compact(first, output, drop_empty, verbose);
+    else if (streq(command, "export") && count == 1 && format == UPT_EXPORT_CSV && records == UPT_EXPORT_ALL)
+        printf("CSV holds one kind of records, choose dc, window or ups\n");
+    else if (streq(command, "export") && count == 1)
+        rv = s_export(first, format, records, baselines);
+    else if (streq(command, "convert") && count == 1 && output)
+        rv = s_convert(first, output);
+    else if (!s_is_command(command) && count == 2) {
+        // older usage: file_name old_path new_path
+        char* old_file = zsys_sprintf("%s/%s", first, command);
+        char* new_file = zsys_sprintf("%s/%s", second, command);
+        rv             = s_convert(old_file, new_file);
+        zstr_free(&old_file);
+        zstr_free(&new_file);
+    } else
+        printf("Wrong arguments of %s, see --help\n", command);
+
+    // diff exits as diff(1) does: 0 same, 1 different, 2 trouble
+    bool diff = command && streq(command, "diff");
+    zlistx_destroy(&files);
+    if (diff)
+        return rv == -1 ? 2 : rv;
+    return rv == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
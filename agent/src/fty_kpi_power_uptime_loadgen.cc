@@ -0,0 +1,373 @@
+/*  =========================================================================
+    fty_kpi_power_uptime_loadgen - Synthetic end-to-end load generator and soak harness
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// fty_kpi_power_uptime_loadgen - Synthetic end-to-end load generator and soak harness
+///
+/// Starts an in-process malamute broker, a private fty-shm directory and the uptime
+/// server, publishes datacenter assets and drives UPS status in shm following a
+/// scenario. Every report interval it prints one JSON object with detection latency
+/// (status written to shm -> transition applied by the server), UPTIME query latency,
+/// CPU and memory of the process.
+
+#include "fty_kpi_power_uptime_server.h"
+#include <fty_log.h>
+#include <fty_shm.h>
+#include <malamute.h>
+#include <sys/resource.h>
+#include <vector>
+
+#define ACTOR_NAME "uptime"
+#define ENDPOINT   "inproc://fty-kpi-power-uptime-loadgen"
+
+// main loop period, msec
+#define TICK_MS 10
+
+struct s_options_t
+{
+    size_t      dcs;
+    size_t      upses;      // upses in each datacenter
+    const char* scenario;   // outage, flap or steady
+    double      rate;       // shm writes per second for flap and steady
+    int64_t     duration;   // sec
+    int64_t     hold;       // sec an outage (or flap phase) lasts
+    int         poll;       // shm polling interval of the server, sec
+    double      query_rate; // UPTIME requests per second
+    int64_t     report;     // sec between two reports
+    char*       dir;        // private fty-shm and state directory
+};
+
+struct s_run_t
+{
+    std::vector<char*> ups;          // ups names, ups i belongs to dc i / upses
+    std::vector<bool>  written;      // last status written to shm, true is on battery
+    uint64_t           expected;     // transitions the server should have applied by now
+    uint64_t           applied;      // transitions the server reports
+    std::vector<std::pair<uint64_t, int64_t>> waiting; // (expected count, usecs written) not applied yet
+
+    upt_stats_histogram_t detection;
+    upt_stats_histogram_t query;
+    uint64_t              queries_failed;
+};
+
+static uint64_t s_server_counter(zactor_t* server, const char* counter)
+{
+    zstr_sendx(server, "STATS", nullptr);
+    zmsg_t*  reply = zmsg_recv(server);
+    uint64_t value = 0;
+    for (char* name = zmsg_popstr(reply); name != nullptr; name = zmsg_popstr(reply)) {
+        char* s_value = zmsg_popstr(reply);
+        if (s_value && streq(name, counter))
+            value = uint64_t(atoll(s_value));
+        zstr_free(&name);
+        zstr_free(&s_value);
+    }
+    zmsg_destroy(&reply);
+    return value;
+}
+
+static void s_publish_assets(mlm_client_t* producer, s_options_t* options, s_run_t* run)
+{
+    for (size_t d = 0; d != options->dcs; d++) {
+        zhash_t* aux = zhash_new();
+        zhash_autofree(aux);
+        zhash_insert(aux, "type", const_cast<char*>("datacenter"));
+        for (size_t u = 0; u != options->upses; u++) {
+            char* key = zsys_sprintf("ups%zu", u);
+            zhash_insert(aux, key, run->ups[d * options->upses + u]);
+            zstr_free(&key);
+        }
+        char*   dc_name = zsys_sprintf("loadgen-dc%zu", d);
+        char*   subject = zsys_sprintf("datacenter.unknown@%s", dc_name);
+        zmsg_t* msg     = fty_proto_encode_asset(aux, dc_name, "inventory", nullptr);
+        mlm_client_send(producer, subject, &msg);
+        zstr_free(&subject);
+        zstr_free(&dc_name);
+        zhash_destroy(&aux);
+    }
+}
+
+static void s_write(s_options_t* options, s_run_t* run, size_t i, bool onbattery)
+{
+    int ttl = options->poll * 3 > 60 ? options->poll * 3 : 60;
+    fty::shm::write_metric(run->ups[i], "status.ups", onbattery ? "16" : "8", "", ttl);
+    if (run->written[i] != onbattery) {
+        run->written[i] = onbattery;
+        run->expected++;
+        run->waiting.emplace_back(run->expected, zclock_usecs());
+    }
+}
+
+// desired status of ups i at time t (sec since start)
+static bool s_desired(s_options_t* options, size_t count, size_t i, double t)
+{
+    if (streq(options->scenario, "outage"))
+        return (int64_t(t) / options->hold) % 2 == 1;
+    if (streq(options->scenario, "flap")) {
+        // phases of upses are spread evenly over the flap period
+        double shifted = t + double(options->hold) * double(i) / double(count);
+        return (int64_t(shifted) / options->hold) % 2 == 1;
+    }
+    return false;
+}
+
+static void s_query(mlm_client_t* ui, s_options_t* options, s_run_t* run, size_t q)
+{
+    zmsg_t* req = zmsg_new();
+    zmsg_addstr(req, "UPTIME");
+    zmsg_addstrf(req, "loadgen-dc%zu", q % options->dcs);
+
+    int64_t start = zclock_usecs();
+    mlm_client_sendto(ui, ACTOR_NAME, "UPTIME", nullptr, 1000, &req);
+
+    zpoller_t* poller = zpoller_new(mlm_client_msgpipe(ui), nullptr);
+    if (zpoller_wait(poller, 5000)) {
+        zmsg_t* reply = mlm_client_recv(ui);
+        upt_stats_histogram_add(&run->query, uint64_t(zclock_usecs() - start));
+        zmsg_destroy(&reply);
+    } else
+        run->queries_failed++;
+    zpoller_destroy(&poller);
+}
+
+static double s_cpu_seconds(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+           + double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static long s_rss_kb(void)
+{
+    long  pages = 0, resident = 0;
+    FILE* file  = fopen("/proc/self/statm", "r");
+    if (file) {
+        if (fscanf(file, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(file);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void s_report(s_options_t* options, s_run_t* run, double elapsed, double cpu, double interval, bool final)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("{\"report\": \"%s\", \"scenario\": \"%s\", \"elapsed_s\": %.1f, \"upses\": %zu, "
+           "\"transitions_written\": %" PRIu64 ", \"transitions_applied\": %" PRIu64 ", "
+           "\"detection_p50_ms\": %.1f, \"detection_p99_ms\": %.1f, \"detection_max_ms\": %.1f, "
+           "\"query_count\": %" PRIu64 ", \"query_failed\": %" PRIu64 ", "
+           "\"query_p50_us\": %" PRIu64 ", \"query_p99_us\": %" PRIu64 ", \"query_max_us\": %" PRIu64 ", "
+           "\"cpu_pct\": %.1f, \"rss_kb\": %ld, \"peak_rss_kb\": %ld}\n",
+        final ? "final" : "interval", options->scenario, elapsed, run->ups.size(), run->expected, run->applied,
+        double(upt_stats_histogram_percentile(&run->detection, 50)) / 1000.0,
+        double(upt_stats_histogram_percentile(&run->detection, 99)) / 1000.0, double(run->detection.max_us) / 1000.0,
+        run->query.count, run->queries_failed, upt_stats_histogram_percentile(&run->query, 50),
+        upt_stats_histogram_percentile(&run->query, 99), run->query.max_us, interval > 0 ? cpu / interval * 100.0 : 0.0,
+        s_rss_kb(), usage.ru_maxrss);
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    s_options_t options = {100, 10, "outage", 1000.0, 60, 10, 1, 10.0, 10, nullptr};
+    bool        verbose = false;
+
+    for (int argn = 1; argn < argc; argn++) {
+        const char* arg   = argv[argn];
+        const char* value = argn + 1 < argc ? argv[argn + 1] : nullptr;
+        if (streq(arg, "--help") || streq(arg, "-h")) {
+            puts("fty-kpi-power-uptime-loadgen [options] ...");
+            puts("  --dcs N                number of datacenters (100)");
+            puts("  --ups N                upses in each datacenter (10)");
+            puts("  --scenario NAME        outage (all upses at once), flap (spread), steady (no transitions)");
+            puts("  --rate N               shm writes per second for flap and steady (1000)");
+            puts("  --hold SEC             length of an outage or of one flap phase (10)");
+            puts("  --duration SEC         length of the run (60)");
+            puts("  --poll SEC             shm polling interval of the server (1)");
+            puts("  --query-rate N         UPTIME requests per second (10)");
+            puts("  --report SEC           seconds between two reports (10)");
+            puts("  --dir PATH             private fty-shm and state directory (temporary)");
+            puts("  --verbose / -v         verbose output of the server");
+            puts("  --help / -h            this information");
+            return 0;
+        } else if (streq(arg, "--verbose") || streq(arg, "-v")) {
+            verbose = true;
+            continue;
+        } else if (!value) {
+            printf("Unknown option: %s\n", arg);
+            return 1;
+        }
+        argn++;
+        if (streq(arg, "--dcs"))
+            options.dcs = size_t(atol(value));
+        else if (streq(arg, "--ups"))
+            options.upses = size_t(atol(value));
+        else if (streq(arg, "--scenario"))
+            options.scenario = value;
+        else if (streq(arg, "--rate"))
+            options.rate = atof(value);
+        else if (streq(arg, "--hold"))
+            options.hold = atoll(value);
+        else if (streq(arg, "--duration"))
+            options.duration = atoll(value);
+        else if (streq(arg, "--poll"))
+            options.poll = atoi(value);
+        else if (streq(arg, "--query-rate"))
+            options.query_rate = atof(value);
+        else if (streq(arg, "--report"))
+            options.report = atoll(value);
+        else if (streq(arg, "--dir"))
+            options.dir = strdup(value);
+        else {
+            printf("Unknown option: %s\n", arg);
+            return 1;
+        }
+    }
+    if (!streq(options.scenario, "outage") && !streq(options.scenario, "flap") && !streq(options.scenario, "steady")) {
+        printf("Unknown scenario: %s\n", options.scenario);
+        return 1;
+    }
+    if (options.dcs == 0 || options.upses == 0 || options.hold <= 0 || options.poll <= 0 || options.report <= 0) {
+        puts("dcs, ups, hold, poll and report must be positive");
+        return 1;
+    }
+
+    ftylog_setInstance("uptime-loadgen", FTY_COMMON_LOGGING_DEFAULT_CFG);
+    if (verbose)
+        ftylog_setVeboseMode(ftylog_getInstance());
+
+    if (!options.dir) {
+        char tmp[] = "/tmp/fty-kpi-power-uptime-loadgen-XXXXXX";
+        if (!mkdtemp(tmp)) {
+            puts("can't create temporary directory");
+            return 1;
+        }
+        options.dir = strdup(tmp);
+    }
+    fty_shm_set_test_dir(options.dir);
+    fty_shm_set_default_polling_interval(options.poll);
+
+    s_run_t run;
+    memset(&run.detection, 0, sizeof(run.detection));
+    memset(&run.query, 0, sizeof(run.query));
+    run.expected       = 0;
+    run.applied        = 0;
+    run.queries_failed = 0;
+    for (size_t d = 0; d != options.dcs; d++) {
+        for (size_t u = 0; u != options.upses; u++) {
+            run.ups.push_back(zsys_sprintf("loadgen-ups%zu-%zu", d, u));
+        }
+    }
+    run.written.assign(run.ups.size(), false);
+
+    zactor_t* broker = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    zstr_sendx(broker, "BIND", ENDPOINT, nullptr);
+
+    zactor_t* server = zactor_new(fty_kpi_power_uptime_server, const_cast<char*>(ACTOR_NAME));
+    zstr_sendx(server, "CONFIG", options.dir, nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONNECT", ENDPOINT, nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONSUMER", "ASSETS", "datacenter.unknown@.*", nullptr);
+    zsock_wait(server);
+
+    mlm_client_t* producer = mlm_client_new();
+    mlm_client_connect(producer, ENDPOINT, 1000, "loadgen-assets");
+    mlm_client_set_producer(producer, "ASSETS");
+    mlm_client_t* ui = mlm_client_new();
+    mlm_client_connect(ui, ENDPOINT, 1000, "loadgen-ui");
+
+    // every ups starts online and known to the server
+    for (size_t i = 0; i != run.ups.size(); i++) {
+        fty::shm::write_metric(run.ups[i], "status.ups", "8", "", 60);
+    }
+    s_publish_assets(producer, &options, &run);
+    while (!zsys_interrupted && s_server_counter(server, "upses") < run.ups.size()) {
+        zclock_sleep(TICK_MS);
+    }
+
+    int64_t start       = zclock_mono();
+    int64_t last_report = start;
+    double  start_cpu   = s_cpu_seconds();
+    double  last_cpu    = start_cpu;
+    double  budget      = 0.0;
+    size_t  cursor      = 0;
+    size_t  queries     = 0;
+
+    while (!zsys_interrupted) {
+        int64_t now = zclock_mono();
+        double  t   = double(now - start) / 1000.0;
+        if (t >= double(options.duration))
+            break;
+
+        // drive shm
+        if (streq(options.scenario, "outage")) {
+            bool desired = s_desired(&options, run.ups.size(), 0, t);
+            if (run.written[0] != desired) {
+                for (size_t i = 0; i != run.ups.size(); i++)
+                    s_write(&options, &run, i, desired);
+            }
+        } else {
+            budget += options.rate * TICK_MS / 1000.0;
+            for (; budget >= 1.0; budget -= 1.0) {
+                s_write(&options, &run, cursor, s_desired(&options, run.ups.size(), cursor, t));
+                cursor = (cursor + 1) % run.ups.size();
+            }
+        }
+
+        // detection latency, transitions are applied in the order they were written
+        run.applied = s_server_counter(server, "transitions");
+        size_t done = 0;
+        while (done != run.waiting.size() && run.waiting[done].first <= run.applied) {
+            upt_stats_histogram_add(&run.detection, uint64_t(zclock_usecs() - run.waiting[done].second));
+            done++;
+        }
+        run.waiting.erase(run.waiting.begin(), run.waiting.begin() + long(done));
+
+        // queries
+        while (options.query_rate > 0 && double(queries) < t * options.query_rate) {
+            s_query(ui, &options, &run, queries++);
+        }
+
+        if (now - last_report >= options.report * 1000) {
+            double cpu = s_cpu_seconds();
+            s_report(&options, &run, t, cpu - last_cpu, double(now - last_report) / 1000.0, false);
+            last_cpu    = cpu;
+            last_report = now;
+        }
+        zclock_sleep(TICK_MS);
+    }
+
+    double elapsed = double(zclock_mono() - start) / 1000.0;
+    s_report(&options, &run, elapsed, s_cpu_seconds() - start_cpu, elapsed, true);
+
+    mlm_client_destroy(&ui);
+    mlm_client_destroy(&producer);
+    zactor_destroy(&server);
+    zactor_destroy(&broker);
+    fty_shm_delete_test_dir();
+    for (char*& name : run.ups) {
+        zstr_free(&name);
+    }
+    zstr_free(&options.dir);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*  =========================================================================
+    fty_kpi_power_uptime_merge - Merge federation snapshots of several appliances
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// fty_kpi_power_uptime_merge - Merge federation snapshots of several appliances
+///
+/// Combines federation snapshots (see upt_federation.h) written by appliances watching parts
+/// of the same sites into one snapshot, and prints uptime of every datacenter of the result.
+/// Order of the inputs does not matter and an input given twice is counted once.
+
+#include "upt_federation.h"
+#include <fty_log.h>
+
+int main(int argc, char* argv[])
+{
+    const char* output  = nullptr;
+    bool        verbose = false;
+    zlistx_t*   inputs  = zlistx_new();
+
+    for (int argn = 1; argn < argc; argn++) {
+        const char* arg = argv[argn];
+        if (streq(arg, "--help") || streq(arg, "-h")) {
+            puts("fty-kpi-power-uptime-merge [options] snapshot...");
+            puts("Merges federation snapshots of several appliances and prints uptime of every datacenter.");
+            puts("  --output / -o PATH     write the merged snapshot to this file");
+            puts("  --verbose / -v         verbose output");
+            puts("  --help / -h            this information");
+            zlistx_destroy(&inputs);
+            return EXIT_SUCCESS;
+        } else if (streq(arg, "--verbose") || streq(arg, "-v"))
+            verbose = true;
+        else if ((streq(arg, "--output") || streq(arg, "-o")) && argn + 1 < argc)
+            output = argv[++argn];
+        else if (arg[0] != '-')
+            zlistx_add_end(inputs, const_cast<char*>(arg));
+        else {
+            printf("Unknown option: %s\n", arg);
+            zlistx_destroy(&inputs);
+            return EXIT_FAILURE;
+        }
+    }
+    if (zlistx_size(inputs) == 0) {
+        puts("missing snapshot files, see --help");
+        zlistx_destroy(&inputs);
+        return EXIT_FAILURE;
+    }
+
+    ftylog_setInstance("fty-kpi-power-uptime-merge", FTY_COMMON_LOGGING_DEFAULT_CFG);
+    if (verbose)
+        ftylog_setVeboseMode(ftylog_getInstance());
+
+    upt_federation_t* merged = upt_federation_new("merge");
+    int               rv     = 0;
+    int64_t           start  = zclock_usecs();
+    for (char* input = reinterpret_cast<char*>(zlistx_first(inputs)); input != nullptr;
+         input       = reinterpret_cast<char*>(zlistx_next(inputs))) {
+        upt_federation_t* snapshot = upt_federation_load(input, "merge");
+        if (!snapshot) {
+            rv = -1;
+            break;
+        }
+        upt_federation_merge(merged, snapshot);
+        log_debug("%s: %zu datacenters", input, upt_federation_size(snapshot));
+        upt_federation_destroy(&snapshot);
+    }
+    int64_t stop = zclock_usecs();
+
+    if (rv == 0 && output) {
+        rv = upt_federation_save(merged, output);
+        if (rv != 0)
+            log_error("can't save merged snapshot to %s", output);
+    }
+    if (rv == 0) {
+        printf("# datacenter\ttotal\toffline\tsources\n");
+        for (const char* dc_name = upt_federation_first(merged); dc_name != nullptr;
+             dc_name             = upt_federation_next(merged)) {
+            uint64_t total, offline;
+            size_t   sources;
+            upt_federation_uptime(merged, dc_name, &total, &offline, &sources);
+            printf("%s\t%" PRIu64 "\t%" PRIu64 "\t%zu\n", dc_name, total, offline, sources);
+        }
+        if (verbose)
+            printf("# snapshots: %zu, datacenters: %zu, merge: %.3f s\n", zlistx_size(inputs),
+                upt_federation_size(merged), double(stop - start) / 1e6);
+    }
+
+    upt_federation_destroy(&merged);
+    zlistx_destroy(&inputs);
+    return rv == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
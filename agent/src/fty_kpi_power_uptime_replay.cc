@@ -0,0 +1,109 @@
+/*  =========================================================================
+    fty_kpi_power_uptime_replay - Rebuild uptime state from recorded events
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// fty_kpi_power_uptime_replay - Rebuild uptime state from recorded events
+///
+/// Replays a CSV log of UPS status and topology changes (see upt_replay.h) and writes
+/// a state file the agent loads on start. With --topology the topology events of the
+/// log are ignored and the ones from the given file are used instead, to recompute
+/// history after a UPS was assigned to the wrong datacenter.
+
+#include "upt_replay.h"
+#include <fty_log.h>
+
+int main(int argc, char* argv[])
+{
+    const char* events   = nullptr;
+    const char* topology = nullptr;
+    const char* output   = "./state";
+    int64_t     until    = -1;
+    size_t      threads  = 1;
+    bool        verbose  = false;
+
+    for (int argn = 1; argn < argc; argn++) {
+        const char* arg = argv[argn];
+        if (streq(arg, "--help") || streq(arg, "-h")) {
+            puts("fty-kpi-power-uptime-replay [options] events.csv");
+            puts("Rebuilds uptime state file from a log of UPS status and topology changes ('-' reads stdin).");
+            puts("  --topology / -t PATH   take topology from this file, ignore topology events of the log");
+            puts("  --output / -o PATH     state file to write (./state)");
+            puts("  --until / -u MSEC      account datacenters up to this time (time of the last event)");
+            puts("  --threads / -j N       replay datacenters on N threads (1)");
+            puts("  --verbose / -v         verbose output");
+            puts("  --help / -h            this information");
+            return EXIT_SUCCESS;
+        } else if (streq(arg, "--verbose") || streq(arg, "-v"))
+            verbose = true;
+        else if ((streq(arg, "--topology") || streq(arg, "-t")) && argn + 1 < argc)
+            topology = argv[++argn];
+        else if ((streq(arg, "--output") || streq(arg, "-o")) && argn + 1 < argc)
+            output = argv[++argn];
+        else if ((streq(arg, "--until") || streq(arg, "-u")) && argn + 1 < argc)
+            until = atoll(argv[++argn]);
+        else if ((streq(arg, "--threads") || streq(arg, "-j")) && argn + 1 < argc)
+            threads = size_t(atol(argv[++argn]));
+        else if (!events && (arg[0] != '-' || streq(arg, "-")))
+            events = arg;
+        else {
+            printf("Unknown option: %s\n", arg);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!events) {
+        puts("missing events file, see --help");
+        return EXIT_FAILURE;
+    }
+
+    ftylog_setInstance("fty-kpi-power-uptime-replay", FTY_COMMON_LOGGING_DEFAULT_CFG);
+    if (verbose)
+        ftylog_setVeboseMode(ftylog_getInstance());
+
+    upt_replay_t* replay = upt_replay_new();
+    int64_t       start  = zclock_usecs();
+
+    if (topology && upt_replay_load(replay, topology, 0) == -1) {
+        upt_replay_destroy(&replay);
+        return EXIT_FAILURE;
+    }
+    if (upt_replay_load(replay, events, topology ? UPT_REPLAY_STATUS_ONLY : 0) == -1) {
+        upt_replay_destroy(&replay);
+        return EXIT_FAILURE;
+    }
+    int64_t loaded = zclock_usecs();
+
+    upt_t*  upt      = upt_replay_run(replay, until, threads);
+    int64_t replayed = zclock_usecs();
+
+    int rv = upt_save(upt, output);
+    if (rv != 0)
+        log_error("can't save state to %s", output);
+
+    size_t count = upt_replay_size(replay);
+    printf("events: %zu, datacenters: %zu, upses: %zu\n", count, zhashx_size(upt->dc), zhashx_size(upt->ups2dc));
+    printf("load: %.3f s, replay: %.3f s (%.0f events/s)\n", double(loaded - start) / 1e6,
+        double(replayed - loaded) / 1e6, replayed > loaded ? double(count) * 1e6 / double(replayed - loaded) : 0.0);
+    if (verbose)
+        upt_print(upt);
+
+    upt_destroy(&upt);
+    upt_replay_destroy(&replay);
+    return rv == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
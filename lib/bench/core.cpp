@@ -0,0 +1,301 @@
+/*  =========================================================================
+    core - microbenchmarks of the dc/upt core
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// Runs dc/upt operations on synthetic topologies of growing size and prints one
+/// JSON object per operation and size: ns/op, allocations/op and peak RSS so far.
+/// Output of an older build can be passed to --compare to print relative changes.
+
+#include "dc.h"
+#include "upt.h"
+#include <atomic>
+#include <chrono>
+#include <sys/resource.h>
+#include <vector>
+
+//  Allocation counting - glibc allows malloc to be interposed by the executable
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t nmemb, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static std::atomic<uint64_t> s_allocs(0);
+
+extern "C" void* malloc(size_t size)
+{
+    s_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t nmemb, size_t size)
+{
+    s_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(nmemb, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    s_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+//  Measurement
+
+// dc_set_offline scans the list of offline upses, larger dcs are skipped to keep runtime sane
+#define DC_MAX_UPS 10000
+
+// refreshing a dc scans all upses, so only this many dcs are refreshed
+#define REFRESH_MAX 100
+
+struct s_result_t
+{
+    char     op[32];
+    size_t   size;
+    uint64_t ops;
+    double   ns_per_op;
+    double   allocs_per_op;
+};
+
+struct s_measure_t
+{
+    std::chrono::steady_clock::time_point start;
+    uint64_t                              allocs;
+};
+
+static std::vector<s_result_t> s_baseline;
+
+static s_measure_t s_start()
+{
+    s_measure_t measure;
+    measure.allocs = s_allocs.load();
+    measure.start  = std::chrono::steady_clock::now();
+    return measure;
+}
+
+static void s_stop(s_measure_t& measure, const char* op, size_t size, uint64_t ops)
+{
+    auto     stop   = std::chrono::steady_clock::now();
+    uint64_t allocs = s_allocs.load() - measure.allocs;
+    int64_t  ns     = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - measure.start).count();
+    if (ops == 0)
+        ops = 1;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double ns_per_op     = double(ns) / double(ops);
+    double allocs_per_op = double(allocs) / double(ops);
+    printf("{\"op\": \"%s\", \"ups\": %zu, \"ops\": %" PRIu64 ", \"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, "
+           "\"peak_rss_kb\": %ld",
+        op, size, ops, ns_per_op, allocs_per_op, usage.ru_maxrss);
+    for (const s_result_t& base : s_baseline) {
+        if (streq(base.op, op) && base.size == size && base.ns_per_op > 0) {
+            printf(", \"ns_change_pct\": %.1f, \"allocs_change\": %.2f", (ns_per_op / base.ns_per_op - 1.0) * 100.0,
+                allocs_per_op - base.allocs_per_op);
+            break;
+        }
+    }
+    puts("}");
+    fflush(stdout);
+}
+
+static void s_load_baseline(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "can't open baseline %s\n", path);
+        return;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        s_result_t result;
+        if (sscanf(line,
+                "{\"op\": \"%31[^\"]\", \"ups\": %zu, \"ops\": %" SCNu64 ", \"ns_per_op\": %lf, \"allocs_per_op\": %lf",
+                result.op, &result.size, &result.ops, &result.ns_per_op, &result.allocs_per_op)
+            == 5)
+            s_baseline.push_back(result);
+    }
+    fclose(file);
+}
+
+//  Synthetic topology
+
+static std::vector<char*> s_names(const char* prefix, size_t count)
+{
+    std::vector<char*> names;
+    names.reserve(count);
+    for (size_t i = 0; i != count; i++) {
+        names.push_back(zsys_sprintf("%s-%zu", prefix, i));
+    }
+    return names;
+}
+
+static void s_free_names(std::vector<char*>& names)
+{
+    for (char*& name : names) {
+        zstr_free(&name);
+    }
+    names.clear();
+}
+
+static void s_bench_dc(size_t size)
+{
+    if (size > DC_MAX_UPS)
+        return;
+
+    std::vector<char*> ups = s_names("ups", size);
+    dc_t*              dc  = dc_new();
+
+    s_measure_t measure = s_start();
+    for (char* name : ups) {
+        dc_set_offline(dc, name);
+    }
+    s_stop(measure, "dc_set_offline", size, size);
+
+    measure = s_start();
+    for (char* name : ups) {
+        dc_set_online(dc, name);
+    }
+    s_stop(measure, "dc_set_online", size, size);
+
+    for (char* name : ups) {
+        dc_set_offline(dc, name);
+    }
+    zframe_t* frame = nullptr;
+    measure         = s_start();
+    frame           = dc_pack(dc);
+    s_stop(measure, "dc_pack", size, 1);
+
+    measure   = s_start();
+    dc_t* dc2 = dc_unpack(frame);
+    s_stop(measure, "dc_unpack", size, 1);
+
+    zframe_destroy(&frame);
+    dc_destroy(&dc2);
+    dc_destroy(&dc);
+    s_free_names(ups);
+}
+
+static void s_bench_upt(size_t size, size_t per_dc, const char* dir)
+{
+    size_t             dcs      = (size + per_dc - 1) / per_dc;
+    std::vector<char*> dc_names = s_names("dc", dcs);
+    std::vector<char*> ups      = s_names("ups", size);
+
+    std::vector<zlistx_t*> lists(dcs);
+    for (size_t d = 0; d != dcs; d++) {
+        lists[d] = zlistx_new();
+        for (size_t u = d * per_dc; u < size && u < (d + 1) * per_dc; u++) {
+            zlistx_add_end(lists[d], ups[u]);
+        }
+    }
+
+    upt_t*      upt     = upt_new();
+    s_measure_t measure = s_start();
+    for (size_t d = 0; d != dcs; d++) {
+        upt_add(upt, dc_names[d], lists[d]);
+    }
+    s_stop(measure, "upt_add", size, dcs);
+
+    size_t refresh = dcs < REFRESH_MAX ? dcs : REFRESH_MAX;
+    measure        = s_start();
+    for (size_t d = 0; d != refresh; d++) {
+        upt_add(upt, dc_names[d], lists[d]);
+    }
+    s_stop(measure, "upt_add_refresh", size, refresh);
+
+    measure = s_start();
+    for (char* name : ups) {
+        upt_set_offline(upt, name);
+    }
+    s_stop(measure, "upt_set_offline", size, size);
+
+    uint64_t total, offline;
+    measure = s_start();
+    for (char* name : dc_names) {
+        upt_uptime(upt, name, &total, &offline);
+    }
+    s_stop(measure, "upt_uptime", size, dcs);
+
+    char* state_file = zsys_sprintf("%s/bench-core-state", dir);
+    measure          = s_start();
+    upt_save(upt, state_file);
+    s_stop(measure, "upt_save", size, 1);
+
+    measure       = s_start();
+    upt_t* loaded = upt_load(state_file);
+    s_stop(measure, "upt_load", size, 1);
+
+    zsys_file_delete(state_file);
+    zstr_free(&state_file);
+    upt_destroy(&loaded);
+    upt_destroy(&upt);
+    for (zlistx_t*& list : lists) {
+        zlistx_destroy(&list);
+    }
+    s_free_names(ups);
+    s_free_names(dc_names);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t      min_size = 10;
+    size_t      max_size = 100000;
+    size_t      per_dc   = 10;
+    const char* dir      = ".";
+
+    for (int argn = 1; argn < argc; argn++) {
+        if (streq(argv[argn], "--help") || streq(argv[argn], "-h")) {
+            puts("fty-kpi-power-uptime-bench [options] ...");
+            puts("  --min / -n             smallest topology, in upses (10)");
+            puts("  --max / -m             largest topology, in upses (100000)");
+            puts("  --ups / -u             number of upses in each datacenter (10)");
+            puts("  --dir / -d             directory for state files (.)");
+            puts("  --compare / -c         output of a previous run to compare with");
+            puts("  --help / -h            this information");
+            puts("Topology grows 10 times each step. dc_* operations run on one datacenter");
+            puts("holding the whole topology and are skipped above 10000 upses.");
+            return 0;
+        } else if ((streq(argv[argn], "--min") || streq(argv[argn], "-n")) && argn + 1 < argc)
+            min_size = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--max") || streq(argv[argn], "-m")) && argn + 1 < argc)
+            max_size = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--ups") || streq(argv[argn], "-u")) && argn + 1 < argc)
+            per_dc = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--dir") || streq(argv[argn], "-d")) && argn + 1 < argc)
+            dir = argv[++argn];
+        else if ((streq(argv[argn], "--compare") || streq(argv[argn], "-c")) && argn + 1 < argc)
+            s_load_baseline(argv[++argn]);
+        else {
+            printf("Unknown option: %s\n", argv[argn]);
+            return 1;
+        }
+    }
+    if (min_size == 0 || per_dc == 0) {
+        puts("topology and ups per datacenter must be positive");
+        return 1;
+    }
+
+    for (size_t size = min_size; size <= max_size; size *= 10) {
+        s_bench_dc(size);
+        s_bench_upt(size, per_dc, dir);
+    }
+    return 0;
+}
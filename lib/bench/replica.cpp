@@ -0,0 +1,194 @@
+/*  =========================================================================
+    replica - replication lag between two processes
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// Measures the replication stream between two processes of one host. The parent is the
+/// leader: it sends a snapshot as soon as the follower subscribes, then deltas of UPS
+/// transitions. The forked child is the follower, it applies the stream the way the server
+/// does in FOLLOW mode and reports catch-up time and lag. One JSON object per line.
+
+#include "upt.h"
+#include "upt_replica.h"
+#include <chrono>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+static upt_t* s_topology(size_t dcs, size_t upses)
+{
+    upt_t* upt = upt_new();
+    for (size_t d = 0; d != dcs; d++) {
+        char*     dc_name = zsys_sprintf("dc-%zu", d);
+        zlistx_t* ups     = zlistx_new();
+        zlistx_set_destructor(ups, s_str_destructor);
+        for (size_t u = 0; u != upses; u++) {
+            zlistx_add_end(ups, zsys_sprintf("ups-%zu-%zu", d, u));
+        }
+        upt_add(upt, dc_name, ups);
+        zlistx_destroy(&ups);
+        zstr_free(&dc_name);
+    }
+    return upt;
+}
+
+// follower, return 0 if the whole stream was applied
+static int s_follower(const char* endpoint, uint64_t last_seq)
+{
+    zsock_t* sub = zsock_new_sub(endpoint, UPT_REPLICA_TOPIC);
+    if (!sub)
+        return 1;
+    zsock_set_rcvtimeo(sub, 5000);
+
+    upt_t*         upt     = upt_new();
+    upt_replica_t* replica = upt_replica_new();
+    while (replica->seq < last_seq) {
+        zmsg_t* msg = zmsg_recv(sub);
+        if (!msg)
+            break;
+        upt_replica_apply(replica, &upt, &msg);
+    }
+
+    printf("{\"bench\": \"replica\", \"messages\": %" PRIu64 ", \"applied_seq\": %" PRIu64
+           ", \"gaps\": %" PRIu64 ", \"catchup_ms\": %" PRIi64 ", \"lag_p50_us\": %" PRIu64
+           ", \"lag_p99_us\": %" PRIu64 ", \"lag_max_us\": %" PRIu64 "}\n",
+        replica->received, replica->seq, replica->gaps, replica->catchup_ms,
+        upt_stats_histogram_percentile(&replica->lag, 50), upt_stats_histogram_percentile(&replica->lag, 99),
+        replica->lag.max_us);
+    fflush(stdout);
+
+    int rv = replica->seq == last_seq ? 0 : 1;
+    upt_replica_destroy(&replica);
+    upt_destroy(&upt);
+    zsock_destroy(&sub);
+    return rv;
+}
+
+// leader, send one snapshot on subscription and then deltas deltas of batch transitions each
+static int s_leader(const char* endpoint, size_t dcs, size_t upses, size_t deltas, size_t batch, int64_t interval_us)
+{
+    zsock_t* pub = zsock_new_xpub(endpoint);
+    if (!pub)
+        return 1;
+    zsock_set_xpub_verbose(pub, 1);
+    zsock_set_sndhwm(pub, 0);
+
+    upt_t*         upt     = s_topology(dcs, upses);
+    upt_replica_t* replica = upt_replica_new();
+    zhashx_t*      dirty   = zhashx_new();
+
+    zframe_t* subscription = zframe_recv(pub);
+    zframe_destroy(&subscription);
+    zmsg_t* msg = upt_replica_snapshot(replica, upt);
+    zmsg_send(&msg, pub);
+
+    size_t e = 0;
+    for (size_t d = 0; d != deltas; d++) {
+        for (size_t b = 0; b != batch; b++, e++) {
+            char* dc_name = zsys_sprintf("dc-%zu", e % dcs);
+            char* name    = zsys_sprintf("ups-%zu-%zu", e % dcs, (e / dcs) % upses);
+            uint64_t total, offline;
+            upt_uptime(upt, dc_name, &total, &offline);
+            if (((e / (dcs * upses)) % 2) == 0)
+                upt_set_offline(upt, name);
+            else
+                upt_set_online(upt, name);
+            zhashx_update(dirty, dc_name, upt);
+            zstr_free(&name);
+            zstr_free(&dc_name);
+        }
+        msg = upt_replica_delta(replica, upt, dirty);
+        zmsg_send(&msg, pub);
+        zhashx_purge(dirty);
+        if (interval_us > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(interval_us));
+    }
+
+    zhashx_destroy(&dirty);
+    upt_replica_destroy(&replica);
+    upt_destroy(&upt);
+    // let the follower drain before the socket goes away
+    zsock_set_linger(pub, 5000);
+    zsock_destroy(&pub);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t      dcs         = 1000;
+    size_t      upses       = 10;
+    size_t      deltas      = 10000;
+    size_t      batch       = 10;
+    int64_t     interval_us = 100;
+    const char* endpoint    = "ipc://@/fty-kpi-power-uptime-bench-replica";
+
+    for (int argn = 1; argn < argc; argn++) {
+        if (streq(argv[argn], "--help") || streq(argv[argn], "-h")) {
+            puts("fty-kpi-power-uptime-bench-replica [options] ...");
+            puts("  --dcs / -d             number of datacenters (1000)");
+            puts("  --ups / -u             number of upses in each datacenter (10)");
+            puts("  --deltas / -n          number of delta messages (10000)");
+            puts("  --batch / -b           UPS transitions in one delta (10)");
+            puts("  --interval / -i        usec between two deltas (100)");
+            puts("  --endpoint / -e        replication endpoint (ipc://@/fty-kpi-power-uptime-bench-replica)");
+            puts("  --help / -h            this information");
+            return 0;
+        } else if ((streq(argv[argn], "--dcs") || streq(argv[argn], "-d")) && argn + 1 < argc)
+            dcs = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--ups") || streq(argv[argn], "-u")) && argn + 1 < argc)
+            upses = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--deltas") || streq(argv[argn], "-n")) && argn + 1 < argc)
+            deltas = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--batch") || streq(argv[argn], "-b")) && argn + 1 < argc)
+            batch = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--interval") || streq(argv[argn], "-i")) && argn + 1 < argc)
+            interval_us = atoll(argv[++argn]);
+        else if ((streq(argv[argn], "--endpoint") || streq(argv[argn], "-e")) && argn + 1 < argc)
+            endpoint = argv[++argn];
+        else {
+            printf("Unknown option: %s\n", argv[argn]);
+            return 1;
+        }
+    }
+    if (dcs == 0 || upses == 0 || batch == 0) {
+        puts("dcs, ups and batch must be positive");
+        return 1;
+    }
+
+    // fork before any zmq context exists, each process gets its own
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0)
+        return s_follower(endpoint, uint64_t(deltas) + 1);
+
+    int rv     = s_leader(endpoint, dcs, upses, deltas, batch, interval_us);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (rv == 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+        rv = 1;
+    return rv;
+}
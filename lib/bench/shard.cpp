@@ -0,0 +1,149 @@
+/*  =========================================================================
+    shard - throughput of the sharded accounting engine
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// Applies the same stream of UPS status transitions to 1..N shards and reports
+/// transitions per second, one JSON object per line.
+
+#include "upt.h"
+#include "upt_shard.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#define BATCH_SIZE 1000
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+static upt_t* s_topology(size_t dcs, size_t upses)
+{
+    upt_t* upt = upt_new();
+    for (size_t d = 0; d != dcs; d++) {
+        char*     dc_name = zsys_sprintf("dc-%zu", d);
+        zlistx_t* ups     = zlistx_new();
+        zlistx_set_destructor(ups, s_str_destructor);
+        for (size_t u = 0; u != upses; u++) {
+            zlistx_add_end(ups, zsys_sprintf("ups-%zu-%zu", d, u));
+        }
+        upt_add(upt, dc_name, ups);
+        zlistx_destroy(&ups);
+        zstr_free(&dc_name);
+    }
+    return upt;
+}
+
+static void s_run(upt_t* upt, size_t dcs, size_t upses, size_t events, size_t count)
+{
+    std::vector<zactor_t*> shards(count);
+    for (size_t i = 0; i != count; i++) {
+        shards[i] = zactor_new(upt_shard, upt_partition(upt, i, count));
+    }
+
+    // batches are prepared up front, so only the shards are measured
+    std::vector<std::vector<zmsg_t*>> batches(count);
+    std::vector<zmsg_t*>              pending(count, nullptr);
+    std::vector<size_t>               sizes(count, 0);
+    for (size_t e = 0; e != events; e++) {
+        size_t d       = e % dcs;
+        size_t u       = (e / dcs) % upses;
+        bool   offline = ((e / (dcs * upses)) % 2) == 0;
+        char*  dc_name = zsys_sprintf("dc-%zu", d);
+        char*  name    = zsys_sprintf("ups-%zu-%zu", d, u);
+        size_t i       = upt_shard_of(dc_name, count);
+        upt_shard_status_add(&pending[i], name, offline ? DC_STATE_ON_BATTERY : DC_STATE_ONLINE);
+        if (++sizes[i] == BATCH_SIZE) {
+            batches[i].push_back(pending[i]);
+            pending[i] = nullptr;
+            sizes[i]   = 0;
+        }
+        zstr_free(&dc_name);
+        zstr_free(&name);
+    }
+    for (size_t i = 0; i != count; i++) {
+        if (pending[i])
+            batches[i].push_back(pending[i]);
+    }
+
+    int64_t start = zclock_usecs();
+    for (size_t i = 0; i != count; i++) {
+        for (zmsg_t* batch : batches[i]) {
+            upt_shard_status(shards[i], &batch);
+        }
+    }
+    // shards process commands in order, so an answered query means all batches were applied
+    uint64_t total, offline;
+    for (size_t i = 0; i != count; i++) {
+        upt_shard_uptime(shards[i], "dc-0", &total, &offline);
+    }
+    int64_t elapsed = zclock_usecs() - start;
+
+    printf("{\"bench\": \"shard\", \"shards\": %zu, \"dcs\": %zu, \"ups_per_dc\": %zu, \"events\": %zu, "
+           "\"usecs\": %" PRIi64 ", \"events_per_sec\": %.0f}\n",
+        count, dcs, upses, events, elapsed, elapsed > 0 ? double(events) * 1e6 / double(elapsed) : 0.0);
+
+    for (size_t i = 0; i != count; i++) {
+        zactor_destroy(&shards[i]);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t dcs        = 1000;
+    size_t upses      = 10;
+    size_t events     = 1000000;
+    size_t max_shards = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int argn = 1; argn < argc; argn++) {
+        if (streq(argv[argn], "--help") || streq(argv[argn], "-h")) {
+            puts("fty-kpi-power-uptime-bench-shard [options] ...");
+            puts("  --dcs / -d             number of datacenters (1000)");
+            puts("  --ups / -u             number of upses in each datacenter (10)");
+            puts("  --events / -e          number of status transitions (1000000)");
+            puts("  --shards / -s          maximal number of shards (number of cores)");
+            puts("  --help / -h            this information");
+            return 0;
+        } else if ((streq(argv[argn], "--dcs") || streq(argv[argn], "-d")) && argn + 1 < argc)
+            dcs = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--ups") || streq(argv[argn], "-u")) && argn + 1 < argc)
+            upses = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--events") || streq(argv[argn], "-e")) && argn + 1 < argc)
+            events = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--shards") || streq(argv[argn], "-s")) && argn + 1 < argc)
+            max_shards = size_t(atol(argv[++argn]));
+        else {
+            printf("Unknown option: %s\n", argv[argn]);
+            return 1;
+        }
+    }
+    if (dcs == 0 || upses == 0 || max_shards == 0) {
+        puts("dcs, ups and shards must be positive");
+        return 1;
+    }
+
+    upt_t* upt = s_topology(dcs, upses);
+    for (size_t count = 1; count <= max_shards; count++) {
+        s_run(upt, dcs, upses, events, count);
+    }
+    upt_destroy(&upt);
+    return 0;
+}
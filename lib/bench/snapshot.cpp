@@ -0,0 +1,155 @@
+/*  =========================================================================
+    snapshot - UPTIME query latency under concurrent ingestion
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// Measures query latency while a writer thread applies UPS transitions and
+/// periodically saves the state. Mode "locked" serializes queries with ingestion
+/// behind one mutex (what a shared loop does), mode "snapshot" answers them from
+/// upt_snapshot. One JSON object per line.
+
+#include "upt.h"
+#include "upt_snapshot.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+static upt_t* s_topology(size_t dcs, size_t upses)
+{
+    upt_t* upt = upt_new();
+    for (size_t d = 0; d != dcs; d++) {
+        char*     dc_name = zsys_sprintf("dc-%zu", d);
+        zlistx_t* ups     = zlistx_new();
+        zlistx_set_destructor(ups, s_str_destructor);
+        for (size_t u = 0; u != upses; u++) {
+            zlistx_add_end(ups, zsys_sprintf("ups-%zu-%zu", d, u));
+        }
+        upt_add(upt, dc_name, ups);
+        zlistx_destroy(&ups);
+        zstr_free(&dc_name);
+    }
+    return upt;
+}
+
+static void s_run(const char* mode, size_t dcs, size_t upses, size_t queries, const char* state_file)
+{
+    bool              locked   = streq(mode, "locked");
+    upt_t*            upt      = s_topology(dcs, upses);
+    upt_snapshot_t*   snapshot = upt_snapshot_new(1);
+    std::mutex        mutex;
+    std::atomic<bool> done(false);
+
+    upt_snapshot_publish(snapshot, upt);
+
+    std::thread writer([&]() {
+        size_t e = 0;
+        while (!done.load()) {
+            char* name = zsys_sprintf("ups-%zu-%zu", e % dcs, (e / dcs) % upses);
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (((e / (dcs * upses)) % 2) == 0)
+                    upt_set_offline(upt, name);
+                else
+                    upt_set_online(upt, name);
+                // a state save every 10000 transitions, as the server does on its loop
+                if (e % 10000 == 0)
+                    upt_save(upt, state_file);
+            }
+            if (!locked)
+                upt_snapshot_publish(snapshot, upt);
+            zstr_free(&name);
+            e++;
+        }
+    });
+
+    std::vector<int64_t> latency;
+    latency.reserve(queries);
+    for (size_t q = 0; q != queries; q++) {
+        char*    dc_name = zsys_sprintf("dc-%zu", q % dcs);
+        uint64_t total, offline;
+        auto     start = std::chrono::steady_clock::now();
+        if (locked) {
+            std::lock_guard<std::mutex> guard(mutex);
+            upt_uptime(upt, dc_name, &total, &offline);
+        } else
+            upt_snapshot_uptime(snapshot, 0, dc_name, &total, &offline, nullptr);
+        auto stop = std::chrono::steady_clock::now();
+        latency.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+        zstr_free(&dc_name);
+    }
+    done.store(true);
+    writer.join();
+
+    std::sort(latency.begin(), latency.end());
+    printf("{\"bench\": \"snapshot\", \"mode\": \"%s\", \"dcs\": %zu, \"queries\": %zu, \"p50_ns\": %" PRIi64
+           ", \"p99_ns\": %" PRIi64 ", \"p999_ns\": %" PRIi64 ", \"max_ns\": %" PRIi64 "}\n",
+        mode, dcs, queries, latency[latency.size() / 2], latency[latency.size() * 99 / 100],
+        latency[latency.size() * 999 / 1000], latency.back());
+
+    upt_snapshot_destroy(&snapshot);
+    upt_destroy(&upt);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t      dcs        = 1000;
+    size_t      upses      = 10;
+    size_t      queries    = 1000000;
+    const char* state_file = "./bench-snapshot-state";
+
+    for (int argn = 1; argn < argc; argn++) {
+        if (streq(argv[argn], "--help") || streq(argv[argn], "-h")) {
+            puts("fty-kpi-power-uptime-bench-snapshot [options] ...");
+            puts("  --dcs / -d             number of datacenters (1000)");
+            puts("  --ups / -u             number of upses in each datacenter (10)");
+            puts("  --queries / -q         number of UPTIME queries (1000000)");
+            puts("  --state / -s           state file written by the ingesting thread");
+            puts("  --help / -h            this information");
+            return 0;
+        } else if ((streq(argv[argn], "--dcs") || streq(argv[argn], "-d")) && argn + 1 < argc)
+            dcs = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--ups") || streq(argv[argn], "-u")) && argn + 1 < argc)
+            upses = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--queries") || streq(argv[argn], "-q")) && argn + 1 < argc)
+            queries = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--state") || streq(argv[argn], "-s")) && argn + 1 < argc)
+            state_file = argv[++argn];
+        else {
+            printf("Unknown option: %s\n", argv[argn]);
+            return 1;
+        }
+    }
+    if (dcs == 0 || upses == 0 || queries == 0) {
+        puts("dcs, ups and queries must be positive");
+        return 1;
+    }
+
+    s_run("locked", dcs, upses, queries, state_file);
+    s_run("snapshot", dcs, upses, queries, state_file);
+    zsys_file_delete(state_file);
+    return 0;
+}
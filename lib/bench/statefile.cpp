@@ -0,0 +1,174 @@
+/*  =========================================================================
+    statefile - reading and writing large state files
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// Writes a synthetic state file with the streaming writer, then reads it with the streaming
+/// reader and with upt_load. Every step runs in its own process so that its peak RSS is its own.
+/// One JSON object per line.
+
+#include "upt.h"
+#include "upt_statefile.h"
+#include <chrono>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+// every datacenter has upses members, a tenth of them in other states than online, all rated
+static int s_write(const char* path, size_t dcs, size_t upses)
+{
+    upt_clock_t*            clock  = upt_clock_sim_new(0);
+    upt_statefile_writer_t* writer = upt_statefile_create(path, 1600000000);
+    if (!writer)
+        return -1;
+    zlistx_t* members = zlistx_new();
+    zlistx_set_destructor(members, s_str_destructor);
+    int rv = 0;
+    for (size_t d = 0; d != dcs && rv == 0; d++) {
+        char* dc_name = zsys_sprintf("dc-%zu", d);
+        dc_t* dc      = dc_new_clock(clock);
+        zlistx_purge(members);
+        for (size_t u = 0; u != upses; u++) {
+            char* ups = zsys_sprintf("ups-%zu-%zu", d, u);
+            dc_set_rating(dc, ups, 1000 + u);
+            if (u % 10 == 0)
+                dc_set_state(dc, ups, u % 20 == 0 ? DC_STATE_ON_BATTERY : DC_STATE_BYPASS);
+            zlistx_add_end(members, ups);
+        }
+        dc_set_members(dc, upses);
+        upt_clock_advance(clock, 1000);
+        rv = upt_statefile_write(writer, dc_name, dc, members);
+        dc_destroy(&dc);
+        zstr_free(&dc_name);
+    }
+    if (rv == 0)
+        rv = upt_statefile_commit(&writer);
+    upt_statefile_abort(&writer);
+    zlistx_destroy(&members);
+    upt_clock_destroy(&clock);
+    return rv;
+}
+
+static int s_stream(const char* path)
+{
+    upt_statefile_t* file = upt_statefile_open(path);
+    if (!file)
+        return -1;
+    size_t count = 0;
+    while (upt_statefile_next(file))
+        count++;
+    int rv = upt_statefile_error(file) ? -1 : 0;
+    upt_statefile_close(&file);
+    return rv;
+}
+
+static int s_load(const char* path)
+{
+    upt_t* upt = upt_load(path);
+    int    rv  = zhashx_size(upt->dc) != 0 ? 0 : -1;
+    upt_destroy(&upt);
+    return rv;
+}
+
+// run op in a child process and print its time and peak RSS
+static void s_run(const char* op, int (*fn)(const char*, size_t, size_t), const char* path, size_t dcs, size_t upses)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        auto start = std::chrono::steady_clock::now();
+        int  rv    = fn(path, dcs, upses);
+        auto stop  = std::chrono::steady_clock::now();
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        int64_t ns    = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+        double  bytes = double(zsys_file_size(path));
+        printf("{\"bench\": \"statefile\", \"op\": \"%s\", \"dcs\": %zu, \"upses\": %zu, \"bytes\": %.0f, \"ms\": %.1f, "
+               "\"mb_per_s\": %.1f, \"peak_rss_kb\": %ld, \"ok\": %s}\n",
+            op, dcs, upses, bytes, double(ns) / 1e6, bytes / 1048576.0 / (double(ns) / 1e9), usage.ru_maxrss,
+            rv == 0 ? "true" : "false");
+        fflush(stdout);
+        _exit(rv == 0 ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+
+static int s_write_op(const char* path, size_t dcs, size_t upses)
+{
+    return s_write(path, dcs, upses);
+}
+
+static int s_stream_op(const char* path, size_t, size_t)
+{
+    return s_stream(path);
+}
+
+static int s_load_op(const char* path, size_t, size_t)
+{
+    return s_load(path);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t      dcs        = 10000;
+    size_t      upses      = 10;
+    const char* state_file = "./bench-state";
+    bool        load       = true;
+
+    for (int argn = 1; argn < argc; argn++) {
+        if (streq(argv[argn], "--help") || streq(argv[argn], "-h")) {
+            puts("fty-kpi-power-uptime-bench-statefile [options] ...");
+            puts("  --dcs / -d             number of datacenters (10000)");
+            puts("  --ups / -u             number of upses in each datacenter (10)");
+            puts("  --state / -s           state file, put it on the disk to measure (./bench-state)");
+            puts("  --no-load              skip upt_load, which needs memory for the whole file");
+            puts("  --help / -h            this information");
+            return 0;
+        } else if ((streq(argv[argn], "--dcs") || streq(argv[argn], "-d")) && argn + 1 < argc)
+            dcs = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--ups") || streq(argv[argn], "-u")) && argn + 1 < argc)
+            upses = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--state") || streq(argv[argn], "-s")) && argn + 1 < argc)
+            state_file = argv[++argn];
+        else if (streq(argv[argn], "--no-load"))
+            load = false;
+        else {
+            printf("Unknown option: %s\n", argv[argn]);
+            return 1;
+        }
+    }
+    if (dcs == 0 || upses == 0) {
+        puts("all counts must be positive");
+        return 1;
+    }
+
+    s_run("write", s_write_op, state_file, dcs, upses);
+    s_run("stream", s_stream_op, state_file, dcs, upses);
+    if (load)
+        s_run("upt_load", s_load_op, state_file, dcs, upses);
+    zsys_file_delete(state_file);
+    return 0;
+}
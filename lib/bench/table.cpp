@@ -0,0 +1,164 @@
+/*  =========================================================================
+    table - cost of memory mapped counters and msync policies
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// Measures the cost of one UPS transition (status change and accounting of its datacenter)
+/// with counters on the heap only and written through to a memory mapped table, flushed
+/// to disk by the kernel, asynchronously after every update, synchronously after every
+/// update or synchronously after every batch of updates. One JSON object per line.
+
+#include "upt.h"
+#include <chrono>
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+static upt_t* s_topology(size_t dcs, size_t upses)
+{
+    upt_t* upt = upt_new();
+    for (size_t d = 0; d != dcs; d++) {
+        char*     dc_name = zsys_sprintf("dc-%zu", d);
+        zlistx_t* ups     = zlistx_new();
+        zlistx_set_destructor(ups, s_str_destructor);
+        for (size_t u = 0; u != upses; u++) {
+            zlistx_add_end(ups, zsys_sprintf("ups-%zu-%zu", d, u));
+        }
+        upt_add(upt, dc_name, ups);
+        zlistx_destroy(&ups);
+        zstr_free(&dc_name);
+    }
+    return upt;
+}
+
+// sync every n updates, 0 never; sync false is MS_ASYNC
+static void s_run(const char* mode, bool mapped, size_t every, bool sync, size_t dcs, size_t upses,
+    size_t updates, const char* table_file)
+{
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    upt_t*       upt   = s_topology(dcs, upses);
+    upt_set_clock(upt, clock);
+    upt_table_t* table = nullptr;
+    if (mapped) {
+        zsys_file_delete(table_file);
+        table = upt_table_open(table_file, dcs);
+        if (!table) {
+            printf("can't open %s\n", table_file);
+            exit(1);
+        }
+        upt_set_table(upt, table);
+    }
+
+    // names are prepared up front, only the accounting is measured
+    char** ups_names = reinterpret_cast<char**>(zmalloc(dcs * upses * sizeof(char*)));
+    char** dc_names  = reinterpret_cast<char**>(zmalloc(dcs * sizeof(char*)));
+    for (size_t d = 0; d != dcs; d++) {
+        dc_names[d] = zsys_sprintf("dc-%zu", d);
+        for (size_t u = 0; u != upses; u++) {
+            ups_names[d * upses + u] = zsys_sprintf("ups-%zu-%zu", d, u);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t e = 0; e != updates; e++) {
+        size_t   d = e % dcs;
+        size_t   u = (e / dcs) % upses;
+        uint64_t total, offline;
+        upt_clock_advance(clock, 1000);
+        upt_uptime(upt, dc_names[d], &total, &offline);
+        if (((e / (dcs * upses)) % 2) == 0)
+            upt_set_offline(upt, ups_names[d * upses + u]);
+        else
+            upt_set_online(upt, ups_names[d * upses + u]);
+        if (table && every != 0 && (e + 1) % every == 0)
+            upt_table_sync(table, sync);
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    printf("{\"bench\": \"table\", \"mode\": \"%s\", \"dcs\": %zu, \"updates\": %zu, \"ns_per_update\": %.1f}\n", mode,
+        dcs, updates, double(ns) / double(updates));
+    fflush(stdout);
+
+    for (size_t i = 0; i != dcs * upses; i++) {
+        zstr_free(&ups_names[i]);
+    }
+    for (size_t d = 0; d != dcs; d++) {
+        zstr_free(&dc_names[d]);
+    }
+    free(ups_names);
+    free(dc_names);
+    upt_destroy(&upt);
+    upt_table_destroy(&table);
+    upt_clock_destroy(&clock);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t      dcs          = 1000;
+    size_t      upses        = 10;
+    size_t      updates      = 1000000;
+    size_t      sync_updates = 1000;
+    size_t      batch        = 1000;
+    const char* table_file   = "./bench-table";
+
+    for (int argn = 1; argn < argc; argn++) {
+        if (streq(argv[argn], "--help") || streq(argv[argn], "-h")) {
+            puts("fty-kpi-power-uptime-bench-table [options] ...");
+            puts("  --dcs / -d             number of datacenters (1000)");
+            puts("  --ups / -u             number of upses in each datacenter (10)");
+            puts("  --updates / -n         number of UPS transitions (1000000)");
+            puts("  --sync-updates / -s    transitions with a synchronous flush after each one (1000)");
+            puts("  --batch / -b           transitions between two synchronous flushes in batch mode (1000)");
+            puts("  --table / -t           table file, put it on the disk to measure (./bench-table)");
+            puts("  --help / -h            this information");
+            return 0;
+        } else if ((streq(argv[argn], "--dcs") || streq(argv[argn], "-d")) && argn + 1 < argc)
+            dcs = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--ups") || streq(argv[argn], "-u")) && argn + 1 < argc)
+            upses = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--updates") || streq(argv[argn], "-n")) && argn + 1 < argc)
+            updates = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--sync-updates") || streq(argv[argn], "-s")) && argn + 1 < argc)
+            sync_updates = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--batch") || streq(argv[argn], "-b")) && argn + 1 < argc)
+            batch = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--table") || streq(argv[argn], "-t")) && argn + 1 < argc)
+            table_file = argv[++argn];
+        else {
+            printf("Unknown option: %s\n", argv[argn]);
+            return 1;
+        }
+    }
+    if (dcs == 0 || upses == 0 || updates == 0 || sync_updates == 0 || batch == 0) {
+        puts("all counts must be positive");
+        return 1;
+    }
+
+    s_run("heap", false, 0, false, dcs, upses, updates, table_file);
+    s_run("mapped", true, 0, false, dcs, upses, updates, table_file);
+    s_run("msync-batch", true, batch, true, dcs, upses, updates, table_file);
+    s_run("msync-async", true, 1, false, dcs, upses, updates, table_file);
+    // every synchronous flush waits for the disk, fewer updates
+    s_run("msync-sync", true, 1, true, dcs, upses, sync_updates, table_file);
+    zsys_file_delete(table_file);
+    return 0;
+}
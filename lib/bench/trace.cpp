@@ -0,0 +1,141 @@
+/*  =========================================================================
+    trace - Per-message overhead of trace points
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// Measures what the trace points of the per-message path cost. Each message hits
+/// the same trace points as a status metric received from the stream: malamute.recv,
+/// metric.status and dc.offline. Modes:
+///  baseline  - no trace statement at all
+///  log_debug - the log_debug calls the hot path used to have, debug level disabled
+///  off, sample, full - upt_trace in that runtime mode
+/// Without ENABLE_TRACE the upt_trace modes must match the baseline. Full mode writes
+/// every record to the log, redirect it. One JSON object per line.
+
+#include "upt_trace.h"
+#include <chrono>
+#include <vector>
+
+struct s_message_t
+{
+    char* sender;
+    char* subject;
+    char* ups;
+    char* dc;
+};
+
+static volatile size_t s_sink;
+
+// stand-in for the work done on every message, keeps the loop from being optimized out
+static void s_work(const s_message_t& msg)
+{
+    s_sink = s_sink + strlen(msg.subject) + strlen(msg.ups);
+}
+
+static void s_run(const char* mode, std::vector<s_message_t>& messages, size_t count)
+{
+    if (streq(mode, "off"))
+        upt_trace_set_mode(UPT_TRACE_OFF, 0);
+    else if (streq(mode, "sample"))
+        upt_trace_set_mode(UPT_TRACE_SAMPLE, 10);
+    else if (streq(mode, "full"))
+        upt_trace_set_mode(UPT_TRACE_FULL, 0);
+
+    bool baseline  = streq(mode, "baseline");
+    bool debug     = streq(mode, "log_debug");
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i != count; i++) {
+        const s_message_t& msg = messages[i % messages.size()];
+        if (debug) {
+            log_debug("%s:\tcommand=%s", "uptime", "STREAM DELIVER");
+            log_debug("%s:\tsender=%s", "uptime", msg.sender);
+            log_debug("%s:\tsubject=%s", "uptime", msg.subject);
+            log_debug("uptime: ups %s set offline", msg.ups);
+        } else if (!baseline) {
+            upt_trace("malamute.recv", "%s: command=%s sender=%s subject=%s", "uptime", "STREAM DELIVER", msg.sender,
+                msg.subject);
+            upt_trace("metric.status", "%s: ups=%s dc=%s value=%s", "uptime", msg.ups, msg.dc, "16");
+            upt_trace("dc.offline", "ups=%s", msg.ups);
+        }
+        s_work(msg);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    upt_trace_set_mode(UPT_TRACE_OFF, 0);
+
+    double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    printf("{\"bench\": \"trace\", \"mode\": \"%s\", \"compiled\": %s, \"messages\": %zu, \"ns_per_msg\": %.1f}\n",
+        mode,
+#ifdef UPT_TRACE
+        "true",
+#else
+        "false",
+#endif
+        count, ns / double(count));
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t count      = 10000000;
+    size_t full_count = 10000;
+
+    for (int argn = 1; argn < argc; argn++) {
+        if (streq(argv[argn], "--help") || streq(argv[argn], "-h")) {
+            puts("fty-kpi-power-uptime-bench-trace [options] ...");
+            puts("  --messages / -m        number of messages (10000000)");
+            puts("  --full / -f            number of messages in full mode, each one is logged (10000)");
+            puts("  --help / -h            this information");
+            return 0;
+        } else if ((streq(argv[argn], "--messages") || streq(argv[argn], "-m")) && argn + 1 < argc)
+            count = size_t(atol(argv[++argn]));
+        else if ((streq(argv[argn], "--full") || streq(argv[argn], "-f")) && argn + 1 < argc)
+            full_count = size_t(atol(argv[++argn]));
+        else {
+            printf("Unknown option: %s\n", argv[argn]);
+            return 1;
+        }
+    }
+    if (count == 0 || full_count == 0) {
+        puts("messages must be positive");
+        return 1;
+    }
+
+    ftylog_setInstance("fty-kpi-power-uptime-bench-trace", FTY_COMMON_LOGGING_DEFAULT_CFG);
+
+    std::vector<s_message_t> messages;
+    for (size_t i = 0; i != 1000; i++) {
+        messages.push_back({zsys_sprintf("agent-nut-%zu", i % 4), zsys_sprintf("status.ups@ups-%zu", i),
+            zsys_sprintf("ups-%zu", i), zsys_sprintf("dc-%zu", i / 10)});
+    }
+
+    s_run("baseline", messages, count);
+    s_run("log_debug", messages, count);
+    s_run("off", messages, count);
+    s_run("sample", messages, count);
+    s_run("full", messages, full_count);
+
+    for (s_message_t& msg : messages) {
+        zstr_free(&msg.sender);
+        zstr_free(&msg.subject);
+        zstr_free(&msg.ups);
+        zstr_free(&msg.dc);
+    }
+    return 0;
+}
@@ -20,7 +20,17 @@
 */
 
 #include "dc.h"
+#include "upt_trace.h"
+#include <algorithm>
 #include <fty_log.h>
+#include <vector>
+
+// copy counters to the table slot, if mapped
+static void s_sync(dc_t* self)
+{
+    if (self->slot)
+        upt_table_write(self->slot, self->last_update, self->total, self->offline, zlistx_size(self->ups));
+}
 
 uint64_t dc_total(dc_t* self)
 {
@@ -41,6 +51,7 @@ void set_dc_total(dc_t* self, uint64_t total)
     assert(self);
 
     self->total = total;
+    s_sync(self);
 }
 
 void set_dc_off_line(dc_t* self, uint64_t offline)
@@ -48,6 +59,21 @@ void set_dc_off_line(dc_t* self, uint64_t offline)
     assert(self);
 
     self->offline = offline;
+    s_sync(self);
+}
+
+uint64_t dc_unknown(dc_t* self)
+{
+    assert(self);
+
+    return self->unknown;
+}
+
+void set_dc_unknown(dc_t* self, uint64_t unknown)
+{
+    assert(self);
+
+    self->unknown = unknown;
 }
 
 static void s_str_destructor(void** x)
@@ -65,14 +91,204 @@ static int s_str_comparator(const void* a, const void* b)
     return strcmp(reinterpret_cast<const char*>(a), reinterpret_cast<const char*>(b));
 }
 
+static void s_rating_destructor(void** x)
+{
+    free(*x);
+    *x = nullptr;
+}
+
+static void* s_rating_duplicator(const void* x)
+{
+    uint64_t* copy = reinterpret_cast<uint64_t*>(zmalloc(sizeof(uint64_t)));
+    *copy          = *reinterpret_cast<const uint64_t*>(x);
+    return copy;
+}
+
+// state of a ups which is not online
+struct s_ups_t
+{
+    dc_state_t state;
+    void*      handle; // in the list of offline upses, nullptr if the ups is not offline
+};
+
+static void s_ups_destructor(void** x)
+{
+    free(*x);
+    *x = nullptr;
+}
+
+bool dc_state_is_offline(dc_state_t state)
+{
+    return state == DC_STATE_ON_BATTERY || state == DC_STATE_LOW_BATTERY;
+}
+
+// move ups to state, counters of states and the list of offline upses follow in constant time
+static bool s_set_state(dc_t* self, const char* ups, dc_state_t state)
+{
+    s_ups_t*   entry = self->states ? reinterpret_cast<s_ups_t*>(zhashx_lookup(self->states, ups)) : nullptr;
+    dc_state_t old   = entry ? entry->state : DC_STATE_ONLINE;
+    if (old == state)
+        return false;
+
+    void* handle = entry ? entry->handle : nullptr;
+    if (dc_state_is_offline(state) && !dc_state_is_offline(old)) {
+        handle = zlistx_add_end(self->ups, const_cast<char*>(ups));
+        self->offline_capacity += dc_rating(self, ups);
+        upt_trace("dc.offline", "ups=%s", ups);
+    } else if (!dc_state_is_offline(state) && dc_state_is_offline(old)) {
+        zlistx_delete(self->ups, handle);
+        handle = nullptr;
+        self->offline_capacity -= dc_rating(self, ups);
+    }
+
+    if (old != DC_STATE_ONLINE)
+        self->in_state[old]--;
+    if (state == DC_STATE_ONLINE)
+        zhashx_delete(self->states, ups);
+    else {
+        self->in_state[state]++;
+        if (!entry) {
+            if (!self->states) {
+                self->states = zhashx_new();
+                zhashx_set_destructor(self->states, s_ups_destructor);
+            }
+            entry = reinterpret_cast<s_ups_t*>(zmalloc(sizeof(s_ups_t)));
+            zhashx_insert(self->states, ups, entry);
+        }
+        entry->state  = state;
+        entry->handle = handle;
+    }
+    s_sync(self);
+    return true;
+}
+
+static void* s_counters_duplicator(const void* x)
+{
+    dc_ups_counters_t* copy = reinterpret_cast<dc_ups_counters_t*>(zmalloc(sizeof(dc_ups_counters_t)));
+    *copy                   = *reinterpret_cast<const dc_ups_counters_t*>(x);
+    return copy;
+}
+
+// counters of ups, created if needed
+static dc_ups_counters_t* s_counters_get(dc_t* self, const char* ups)
+{
+    if (!self->counters) {
+        self->counters = zhashx_new();
+        zhashx_set_destructor(self->counters, s_ups_destructor);
+        zhashx_set_duplicator(self->counters, s_counters_duplicator);
+    }
+    dc_ups_counters_t* counters = reinterpret_cast<dc_ups_counters_t*>(zhashx_lookup(self->counters, ups));
+    if (!counters) {
+        // the hash keeps a copy made by its duplicator
+        dc_ups_counters_t fresh = {0, 0, 0, -1};
+        zhashx_insert(self->counters, ups, &fresh);
+        counters = reinterpret_cast<dc_ups_counters_t*>(zhashx_lookup(self->counters, ups));
+    }
+    return counters;
+}
+
+// on battery seconds of counters including the current period
+static uint64_t s_on_battery(dc_t* self, const dc_ups_counters_t* counters)
+{
+    int64_t current = counters->since != -1 ? upt_clock_now(self->clock) / 1000LL - counters->since : 0;
+    return counters->on_battery + (current > 0 ? uint64_t(current) : 0);
+}
+
+// state change reported for ups, counted in its counters (restoring a state is not a change)
+static bool s_change(dc_t* self, const char* ups, dc_state_t state)
+{
+    dc_state_t old = dc_ups_state(self, ups);
+    if (!s_set_state(self, ups, state))
+        return false;
+
+    dc_ups_counters_t* counters = s_counters_get(self, ups);
+    if (dc_state_is_offline(state) && !dc_state_is_offline(old))
+        counters->since = upt_clock_now(self->clock) / 1000LL;
+    else if (!dc_state_is_offline(state) && dc_state_is_offline(old)) {
+        counters->on_battery = s_on_battery(self, counters);
+        counters->since      = -1;
+    }
+    counters->transitions++;
+    counters->last_change = upt_clock_wall(self->clock) / 1000LL;
+    return true;
+}
+
+// account seconds spent in the current state
+static void s_account(dc_t* self, uint64_t seconds)
+{
+    self->total += seconds;
+    if (dc_is_offline(self))
+        self->offline += seconds;
+
+    bool online = true;
+    for (int state = DC_STATE_ONLINE + 1; state != DC_STATE_COUNT; state++) {
+        if (self->in_state[state] != 0) {
+            self->durations[state] += seconds;
+            online = false;
+        }
+    }
+    if (online)
+        self->durations[DC_STATE_ONLINE] += seconds;
+}
+
+// account time elapsed since the last update
+static void s_fold(dc_t* self)
+{
+    int64_t now       = (upt_clock_now(self->clock) / 1000LL);
+    int64_t time_diff = (now - self->last_update);
+
+    // XXX: this should not happen due mono clock used, but we already got
+    // weird total time, so newer add negative number typecasted to unsigned
+    if (time_diff > 0LL) {
+        s_account(self, uint64_t(time_diff));
+        self->last_update = now;
+        s_sync(self);
+    }
+}
+
+// replace rating of ups, capacities follow without looking at other upses
+static void s_set_rating(dc_t* self, const char* ups, uint64_t rating)
+{
+    uint64_t old = dc_rating(self, ups);
+    if (rating == 0) {
+        if (self->ratings)
+            zhashx_delete(self->ratings, ups);
+    } else {
+        if (!self->ratings) {
+            self->ratings = zhashx_new();
+            zhashx_set_destructor(self->ratings, s_rating_destructor);
+            zhashx_set_duplicator(self->ratings, s_rating_duplicator);
+        }
+        zhashx_update(self->ratings, ups, &rating);
+    }
+    self->capacity = self->capacity - old + rating;
+    if (dc_state_is_offline(dc_ups_state(self, ups)))
+        self->offline_capacity = self->offline_capacity - old + rating;
+}
+
 dc_t* dc_new(void)
+{
+    return dc_new_clock(nullptr);
+}
+
+dc_t* dc_new_clock(upt_clock_t* clock)
 {
     dc_t* self = reinterpret_cast<dc_t*>(zmalloc(sizeof(dc_t)));
     if (!self)
         return nullptr;
-    self->last_update = zclock_mono() / 1000LL;
+    self->clock       = clock ? clock : upt_clock_system();
+    self->last_update = upt_clock_now(self->clock) / 1000LL;
     self->total       = 0LL;
     self->offline     = 0LL;
+    self->unknown     = 0LL;
+    self->checkpoint  = -1;
+    self->policy      = DC_POLICY_ANY;
+    self->threshold   = 0;
+    self->members     = 0;
+    self->ratings     = nullptr;
+    self->capacity    = 0;
+    self->offline_capacity = 0;
+    self->counters    = nullptr;
     self->ups         = zlistx_new();
     zlistx_set_duplicator(self->ups, s_str_duplicator);
     zlistx_set_destructor(self->ups, s_str_destructor);
@@ -88,70 +304,380 @@ void dc_destroy(dc_t** self_p)
     dc_t* self = *self_p;
 
     zlistx_destroy(&self->ups);
+    zhashx_destroy(&self->states);
+    zhashx_destroy(&self->ratings);
+    zhashx_destroy(&self->counters);
     free(self);
     *self_p = nullptr;
 }
 
+dc_t* dc_dup(dc_t* self)
+{
+    assert(self);
+
+    dc_t* copy = dc_new_clock(self->clock);
+    if (!copy)
+        return nullptr;
+    copy->last_update = self->last_update;
+    copy->total       = self->total;
+    copy->offline     = self->offline;
+    copy->unknown     = self->unknown;
+    copy->checkpoint  = self->checkpoint;
+    copy->policy      = self->policy;
+    copy->threshold   = self->threshold;
+    copy->members     = self->members;
+    copy->ratings     = self->ratings ? zhashx_dup(self->ratings) : nullptr;
+    copy->capacity    = self->capacity;
+    copy->counters    = self->counters ? zhashx_dup(self->counters) : nullptr;
+    memcpy(copy->durations, self->durations, sizeof(self->durations));
+    // offline upses first to keep their order, state counters and offline capacity are rebuilt
+    for (char* ups = reinterpret_cast<char*>(zlistx_first(self->ups)); ups != nullptr;
+         ups       = reinterpret_cast<char*>(zlistx_next(self->ups))) {
+        s_set_state(copy, ups, dc_ups_state(self, ups));
+    }
+    if (self->states) {
+        for (s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_first(self->states)); entry != nullptr;
+             entry          = reinterpret_cast<s_ups_t*>(zhashx_next(self->states))) {
+            if (!dc_state_is_offline(entry->state))
+                s_set_state(copy, reinterpret_cast<const char*>(zhashx_cursor(self->states)), entry->state);
+        }
+    }
+    return copy;
+}
+
+void dc_set_clock(dc_t* self, upt_clock_t* clock)
+{
+    assert(self);
+
+    uint64_t total, offline;
+    dc_uptime(self, &total, &offline);
+    self->clock       = clock ? clock : upt_clock_system();
+    self->last_update = upt_clock_now(self->clock) / 1000LL;
+    s_sync(self);
+}
+
+void dc_freeze(dc_t* self, upt_clock_t* clock)
+{
+    assert(self);
+    assert(clock);
+
+    // like s_fold, but up to the time of clock and not of the current one
+    int64_t until     = upt_clock_now(clock) / 1000LL;
+    int64_t time_diff = until - self->last_update;
+    if (time_diff > 0LL) {
+        s_account(self, uint64_t(time_diff));
+        self->last_update = until;
+    }
+    self->clock = clock;
+    s_sync(self);
+}
+
+void dc_set_slot(dc_t* self, upt_table_slot_t* slot)
+{
+    assert(self);
+
+    self->slot = slot;
+    s_sync(self);
+}
+
+void dc_set_policy(dc_t* self, dc_policy_t policy, uint64_t threshold)
+{
+    assert(self);
+
+    s_fold(self);
+    self->policy    = policy;
+    self->threshold = threshold;
+}
+
+void dc_set_members(dc_t* self, size_t members)
+{
+    assert(self);
+
+    s_fold(self);
+    self->members = members;
+}
+
+void dc_set_rating(dc_t* self, const char* ups, uint64_t rating)
+{
+    assert(self);
+    assert(ups);
+
+    s_fold(self);
+    s_set_rating(self, ups, rating);
+}
+
+uint64_t dc_rating(dc_t* self, const char* ups)
+{
+    assert(self);
+    assert(ups);
+
+    uint64_t* rating = self->ratings ? reinterpret_cast<uint64_t*>(zhashx_lookup(self->ratings, ups)) : nullptr;
+    return rating ? *rating : 0;
+}
+
+static const char* s_policy_names[] = {"any", "all", "k-of-n", "capacity"};
+
+const char* dc_policy_name(dc_policy_t policy)
+{
+    return s_policy_names[policy];
+}
+
+int dc_policy_parse(const char* name, dc_policy_t* policy)
+{
+    assert(policy);
+
+    for (int i = DC_POLICY_ANY; name && i <= DC_POLICY_CAPACITY; i++) {
+        if (streq(name, s_policy_names[i])) {
+            *policy = dc_policy_t(i);
+            return 0;
+        }
+    }
+    return -1;
+}
+
 bool dc_is_offline(dc_t* self)
 {
     assert(self);
 
-    return zlistx_size(self->ups) > 0;
+    size_t offline = zlistx_size(self->ups);
+    if (offline == 0)
+        return false;
+
+    // policies fall back to any ups until they know the upses of the datacenter
+    switch (self->policy) {
+        case DC_POLICY_ALL:
+            return self->members == 0 || offline >= self->members;
+        case DC_POLICY_K_OF_N:
+            if (self->members == 0)
+                return true;
+            return offline >= self->members || self->members - offline < self->threshold;
+        case DC_POLICY_CAPACITY:
+            if (self->capacity == 0)
+                return true;
+            return (self->capacity - self->offline_capacity) * 100 < self->threshold * self->capacity;
+        default:
+            return true;
+    }
 }
 
-void dc_set_offline(dc_t* self, char* ups)
+bool dc_set_offline(dc_t* self, char* ups)
 {
     assert(self);
 
-    void* foo = zlistx_find(self->ups, ups);
-    if (!foo) {
-        zlistx_add_end(self->ups, ups);
-        log_debug("uptime: ups %s set offline", ups);
+    if (dc_state_is_offline(dc_ups_state(self, ups)))
+        return false;
+    return s_change(self, ups, DC_STATE_ON_BATTERY);
+}
+
+bool dc_set_online(dc_t* self, char* ups)
+{
+    assert(self);
+
+    if (!dc_state_is_offline(dc_ups_state(self, ups)))
+        return false;
+    return s_change(self, ups, DC_STATE_ONLINE);
+}
+
+bool dc_set_state(dc_t* self, const char* ups, dc_state_t state)
+{
+    assert(self);
+    assert(ups);
+
+    return s_change(self, ups, state);
+}
+
+dc_state_t dc_ups_state(dc_t* self, const char* ups)
+{
+    assert(self);
+    assert(ups);
+
+    s_ups_t* entry = self->states ? reinterpret_cast<s_ups_t*>(zhashx_lookup(self->states, ups)) : nullptr;
+    return entry ? entry->state : DC_STATE_ONLINE;
+}
+
+void dc_durations(dc_t* self, uint64_t* durations)
+{
+    assert(self);
+    assert(durations);
+
+    s_fold(self);
+    memcpy(durations, self->durations, sizeof(self->durations));
+}
+
+dc_state_t dc_state_of_status(const char* status)
+{
+    if (!status || !*status)
+        return DC_STATE_UNKNOWN;
+
+    if (isdigit(status[0])) {
+        // see core.git/src/shared/upsstatus.h OL 1 << 3, OB 1 << 4, OVER 1 << 5, LB 1 << 6, BYPASS 1 << 8
+        int flags = atoi(status);
+        if (flags & 0x10)
+            return (flags & 0x40) ? DC_STATE_LOW_BATTERY : DC_STATE_ON_BATTERY;
+        if (flags & 0x100)
+            return DC_STATE_BYPASS;
+        if (flags & 0x20)
+            return DC_STATE_OVERLOAD;
+        return (flags & 0x08) ? DC_STATE_ONLINE : DC_STATE_UNKNOWN;
+    }
+
+    // NUT status flags, e.g. "OB LB"
+    if (strstr(status, "OB"))
+        return strstr(status, "LB") ? DC_STATE_LOW_BATTERY : DC_STATE_ON_BATTERY;
+    if (strstr(status, "BYPASS"))
+        return DC_STATE_BYPASS;
+    if (strstr(status, "OVER"))
+        return DC_STATE_OVERLOAD;
+    return strstr(status, "OL") ? DC_STATE_ONLINE : DC_STATE_UNKNOWN;
+}
+
+static const char* s_state_names[] = {
+    "online", "on-battery", "low-battery", "bypass", "overload", "unknown", "stale"};
+
+const char* dc_state_name(dc_state_t state)
+{
+    return s_state_names[state];
+}
+
+int dc_state_parse(const char* name, dc_state_t* state)
+{
+    assert(state);
+
+    for (int i = DC_STATE_ONLINE; name && i != DC_STATE_COUNT; i++) {
+        if (streq(name, s_state_names[i])) {
+            *state = dc_state_t(i);
+            return 0;
+        }
     }
+    return -1;
 }
 
-void dc_set_online(dc_t* self, char* ups)
+void dc_remove_ups(dc_t* self, const char* ups)
 {
     assert(self);
+    assert(ups);
 
-    void* foo = zlistx_find(self->ups, ups);
-    if (!foo)
-        return;
-    zlistx_delete(self->ups, foo);
+    s_fold(self);
+    s_set_state(self, ups, DC_STATE_ONLINE);
+    s_set_rating(self, ups, 0);
+    if (self->counters)
+        zhashx_delete(self->counters, ups);
 }
 
-void dc_uptime(dc_t* self, uint64_t* total, uint64_t* offline)
+int dc_ups_counters(dc_t* self, const char* ups, dc_ups_counters_t* counters)
 {
     assert(self);
+    assert(ups);
+    assert(counters);
+
+    dc_ups_counters_t* entry =
+        self->counters ? reinterpret_cast<dc_ups_counters_t*>(zhashx_lookup(self->counters, ups)) : nullptr;
+    if (!entry)
+        return -1;
+    *counters            = *entry;
+    counters->on_battery = s_on_battery(self, entry);
+    return 0;
+}
 
-    int64_t now       = (zclock_mono() / 1000LL);
-    int64_t time_diff = (now - self->last_update);
+void dc_set_ups_counters(dc_t* self, const char* ups, uint64_t on_battery, uint64_t transitions, int64_t last_change)
+{
+    assert(self);
+    assert(ups);
 
-    // XXX: this should not happen due mono clock used, but we already got
-    // weird total time, so newer add negative number typecasted to unsigned
-    if (time_diff > 0LL) {
+    dc_ups_counters_t* counters = s_counters_get(self, ups);
+    counters->on_battery        = on_battery;
+    counters->transitions       = transitions;
+    counters->last_change       = last_change;
+    counters->since = dc_state_is_offline(dc_ups_state(self, ups)) ? upt_clock_now(self->clock) / 1000LL : -1;
+}
 
-        self->total += uint64_t(time_diff);
-        if (dc_is_offline(self))
-            self->offline += uint64_t(time_diff);
+size_t dc_top(dc_t* self, size_t n, const char** upses, dc_ups_counters_t* counters)
+{
+    assert(self);
+    assert(upses || n == 0);
+    assert(counters || n == 0);
+
+    if (!self->counters || n == 0)
+        return 0;
+
+    struct s_rank_t
+    {
+        const char*       ups;
+        dc_ups_counters_t counters;
+    };
+    std::vector<s_rank_t> ranks;
+    ranks.reserve(zhashx_size(self->counters));
+    for (dc_ups_counters_t* entry = reinterpret_cast<dc_ups_counters_t*>(zhashx_first(self->counters));
+         entry != nullptr; entry = reinterpret_cast<dc_ups_counters_t*>(zhashx_next(self->counters))) {
+        s_rank_t rank{reinterpret_cast<const char*>(zhashx_cursor(self->counters)), *entry};
+        rank.counters.on_battery = s_on_battery(self, entry);
+        ranks.push_back(rank);
+    }
 
-        self->last_update = now;
+    // only the first n are ordered, O(upses * log n)
+    n = std::min(n, ranks.size());
+    std::partial_sort(ranks.begin(), ranks.begin() + long(n), ranks.end(), [](const s_rank_t& a, const s_rank_t& b) {
+        if (a.counters.on_battery != b.counters.on_battery)
+            return a.counters.on_battery > b.counters.on_battery;
+        if (a.counters.transitions != b.counters.transitions)
+            return a.counters.transitions > b.counters.transitions;
+        return strcmp(a.ups, b.ups) < 0;
+    });
+    for (size_t i = 0; i != n; i++) {
+        upses[i]    = ranks[i].ups;
+        counters[i] = ranks[i].counters;
     }
+    return n;
+}
+
+void dc_uptime(dc_t* self, uint64_t* total, uint64_t* offline)
+{
+    assert(self);
+
+    s_fold(self);
 
     *total   = self->total;
     *offline = self->offline;
 }
 
+void dc_reconcile(dc_t* self, int64_t now, dc_gap_policy_t policy, int64_t clamp)
+{
+    assert(self);
+
+    int64_t gap      = now - self->checkpoint;
+    bool    recorded = self->checkpoint != -1;
+    self->checkpoint = -1;
+    if (!recorded || gap <= 0)
+        return;
+
+    int64_t assumed = 0;
+    if (policy == DC_GAP_ASSUME)
+        assumed = gap;
+    else if (policy == DC_GAP_CLAMP)
+        assumed = gap < clamp ? gap : (clamp > 0 ? clamp : 0);
+
+    s_account(self, uint64_t(assumed));
+    self->unknown += uint64_t(gap - assumed);
+    s_sync(self);
+}
+
 zframe_t* dc_pack(dc_t* self)
 {
 
     assert(self);
 
     zmsg_t* msg = zmsg_new();
-    zmsg_addstr(msg, "dc0x01");
+    zmsg_addstr(msg, "dc0x05");
     zmsg_addstrf(msg, "%" PRIi64, self->last_update);
     zmsg_addstrf(msg, "%" PRIu64, self->total);
     zmsg_addstrf(msg, "%" PRIu64, self->offline);
+    zmsg_addstrf(msg, "%" PRIu64, self->unknown);
+    zmsg_addstr(msg, dc_policy_name(self->policy));
+    zmsg_addstrf(msg, "%" PRIu64, self->threshold);
+    zmsg_addstrf(msg, "%zu", self->members);
+    zmsg_addstrf(msg, "%d", int(DC_STATE_COUNT));
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++)
+        zmsg_addstrf(msg, "%" PRIu64, self->durations[state]);
     zmsg_addstrf(msg, "%zu", zlistx_size(self->ups));
 
     char* ups = reinterpret_cast<char*>(zlistx_first(self->ups));
@@ -160,6 +686,40 @@ zframe_t* dc_pack(dc_t* self)
         ups = reinterpret_cast<char*>(zlistx_next(self->ups));
     }
 
+    // ups name/state pairs of upses in other states than online or on battery
+    size_t other = self->states ? zhashx_size(self->states) - self->in_state[DC_STATE_ON_BATTERY] : 0;
+    zmsg_addstrf(msg, "%zu", other);
+    if (self->states) {
+        for (s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_first(self->states)); entry != nullptr;
+             entry          = reinterpret_cast<s_ups_t*>(zhashx_next(self->states))) {
+            if (entry->state == DC_STATE_ON_BATTERY)
+                continue;
+            zmsg_addstr(msg, reinterpret_cast<const char*>(zhashx_cursor(self->states)));
+            zmsg_addstr(msg, dc_state_name(entry->state));
+        }
+    }
+
+    // ups name/on battery/transitions/last change of upses with counters
+    zmsg_addstrf(msg, "%zu", self->counters ? zhashx_size(self->counters) : 0);
+    if (self->counters) {
+        for (dc_ups_counters_t* counters = reinterpret_cast<dc_ups_counters_t*>(zhashx_first(self->counters));
+             counters != nullptr; counters = reinterpret_cast<dc_ups_counters_t*>(zhashx_next(self->counters))) {
+            zmsg_addstr(msg, reinterpret_cast<const char*>(zhashx_cursor(self->counters)));
+            zmsg_addstrf(msg, "%" PRIu64, s_on_battery(self, counters));
+            zmsg_addstrf(msg, "%" PRIu64, counters->transitions);
+            zmsg_addstrf(msg, "%" PRIi64, counters->last_change);
+        }
+    }
+
+    // ups name/rating pairs
+    if (self->ratings) {
+        for (uint64_t* rating = reinterpret_cast<uint64_t*>(zhashx_first(self->ratings)); rating != nullptr;
+             rating           = reinterpret_cast<uint64_t*>(zhashx_next(self->ratings))) {
+            zmsg_addstr(msg, reinterpret_cast<const char*>(zhashx_cursor(self->ratings)));
+            zmsg_addstrf(msg, "%" PRIu64, *rating);
+        }
+    }
+
     /* Note: the CZMQ_VERSION_MAJOR comparisons below actually assume versions
      * we know and care about - v3.0.2 (our legacy default, already obsoleted
      * by upstream), and v4.x that is in current upstream master. If the API
@@ -217,12 +777,21 @@ dc_t* dc_unpack(zframe_t* frame)
     }
 
     char* magic = zmsg_popstr(msg);
-    if (!magic || !streq(magic, "dc0x01")) {
+    if (!magic ||
+        !(streq(magic, "dc0x01") || streq(magic, "dc0x02") || streq(magic, "dc0x03") || streq(magic, "dc0x04") ||
+            streq(magic, "dc0x05"))) {
         log_error("unknown magic %s", magic);
+        zstr_free(&magic);
         zmsg_destroy(&msg);
         return nullptr;
     }
-
+    // version 2 has unknown time after offline, version 3 the policy after it and ratings at the end,
+    // version 4 durations of states after the policy and states of upses before ratings, version 5
+    // counters of upses after their states
+    bool has_counters = streq(magic, "dc0x05");
+    bool has_states   = has_counters || streq(magic, "dc0x04");
+    bool has_policy   = has_states || streq(magic, "dc0x03");
+    bool has_unknown  = has_policy || streq(magic, "dc0x02");
     zstr_free(&magic);
 
     int64_t  last_update;
@@ -232,24 +801,59 @@ dc_t* dc_unpack(zframe_t* frame)
     char* s_last_update = zmsg_popstr(msg);
     char* s_total       = zmsg_popstr(msg);
     char* s_offline     = zmsg_popstr(msg);
-    char* s_size        = zmsg_popstr(msg);
+    char* s_unknown     = has_unknown ? zmsg_popstr(msg) : nullptr;
+    char* s_policy      = has_policy ? zmsg_popstr(msg) : nullptr;
+    char* s_threshold   = has_policy ? zmsg_popstr(msg) : nullptr;
+    char* s_members     = has_policy ? zmsg_popstr(msg) : nullptr;
+
+    uint64_t durations[DC_STATE_COUNT] = {};
+    if (has_states) {
+        char* s_count = zmsg_popstr(msg);
+        int   count   = s_count ? atoi(s_count) : 0;
+        zstr_free(&s_count);
+        for (int state = 0; state < count; state++) {
+            char* s_duration = zmsg_popstr(msg);
+            if (s_duration && state < DC_STATE_COUNT)
+                sscanf(s_duration, "%" SCNu64, &durations[state]);
+            zstr_free(&s_duration);
+        }
+    }
+    char* s_size = zmsg_popstr(msg);
 
-    if (!s_last_update || !s_total || !s_offline || !s_size) {
-        log_error("missing last_update, total, offline or size fields");
+    dc_policy_t policy = DC_POLICY_ANY;
+    if (!s_last_update || !s_total || !s_offline || (has_unknown && !s_unknown) ||
+        (has_policy && (!s_threshold || !s_members || dc_policy_parse(s_policy, &policy) == -1)) || !s_size) {
+        log_error("missing last_update, total, offline, unknown, policy or size fields");
         zstr_free(&s_last_update);
         zstr_free(&s_total);
         zstr_free(&s_offline);
+        zstr_free(&s_unknown);
+        zstr_free(&s_policy);
+        zstr_free(&s_threshold);
+        zstr_free(&s_members);
         zstr_free(&s_size);
         zmsg_destroy(&msg);
         return nullptr;
     }
 
+    uint64_t unknown = 0, threshold = 0;
+    size_t   members = 0;
     sscanf(s_last_update, "%" SCNi64, &last_update);
     sscanf(s_total, "%" SCNu64, &total);
     sscanf(s_offline, "%" SCNu64, &offline);
+    if (s_unknown)
+        sscanf(s_unknown, "%" SCNu64, &unknown);
+    if (s_threshold)
+        sscanf(s_threshold, "%" SCNu64, &threshold);
+    if (s_members)
+        sscanf(s_members, "%zu", &members);
     sscanf(s_size, "%zu", &size);
 
     zstr_free(&s_offline);
+    zstr_free(&s_unknown);
+    zstr_free(&s_policy);
+    zstr_free(&s_threshold);
+    zstr_free(&s_members);
     zstr_free(&s_total);
     zstr_free(&s_last_update);
     zstr_free(&s_size);
@@ -264,17 +868,67 @@ dc_t* dc_unpack(zframe_t* frame)
     dc->last_update = last_update;
     dc->total       = total;
     dc->offline     = offline;
+    dc->unknown     = unknown;
+    dc->policy      = policy;
+    dc->threshold   = threshold;
+    dc->members     = members;
+    memcpy(dc->durations, durations, sizeof(durations));
+
+    for (size_t i = 0; i != size; i++) {
+        char* ups = zmsg_popstr(msg);
+        if (!ups)
+            break;
+        s_set_state(dc, ups, DC_STATE_ON_BATTERY);
+        zstr_free(&ups);
+    }
 
-    if (size != 0) {
-        char*  ups = zmsg_popstr(msg);
-        size_t i   = 0;
-        while (ups && i != size) {
-            dc_set_offline(dc, ups);
+    if (has_states) {
+        char*  s_other = zmsg_popstr(msg);
+        size_t other   = s_other ? size_t(atol(s_other)) : 0;
+        zstr_free(&s_other);
+        for (size_t i = 0; i != other; i++) {
+            char*      ups     = zmsg_popstr(msg);
+            char*      s_state = zmsg_popstr(msg);
+            dc_state_t state;
+            if (ups && dc_state_parse(s_state, &state) == 0)
+                s_set_state(dc, ups, state);
             zstr_free(&ups);
-            ups = zmsg_popstr(msg);
-            i += 1;
+            zstr_free(&s_state);
         }
+    }
+
+    if (has_counters) {
+        char*  s_count = zmsg_popstr(msg);
+        size_t count   = s_count ? size_t(atol(s_count)) : 0;
+        zstr_free(&s_count);
+        for (size_t i = 0; i != count; i++) {
+            char*    ups           = zmsg_popstr(msg);
+            char*    s_on_battery  = zmsg_popstr(msg);
+            char*    s_transitions = zmsg_popstr(msg);
+            char*    s_last_change = zmsg_popstr(msg);
+            uint64_t on_battery = 0, transitions = 0;
+            int64_t  last_change = 0;
+            if (ups && s_on_battery && s_transitions && s_last_change) {
+                sscanf(s_on_battery, "%" SCNu64, &on_battery);
+                sscanf(s_transitions, "%" SCNu64, &transitions);
+                sscanf(s_last_change, "%" SCNi64, &last_change);
+                dc_set_ups_counters(dc, ups, on_battery, transitions, last_change);
+            }
+            zstr_free(&ups);
+            zstr_free(&s_on_battery);
+            zstr_free(&s_transitions);
+            zstr_free(&s_last_change);
+        }
+    }
+
+    for (char* ups = zmsg_popstr(msg); ups != nullptr; ups = zmsg_popstr(msg)) {
+        char*    s_rating = zmsg_popstr(msg);
+        uint64_t rating   = 0;
+        if (s_rating)
+            sscanf(s_rating, "%" SCNu64, &rating);
+        s_set_rating(dc, ups, rating);
         zstr_free(&ups);
+        zstr_free(&s_rating);
     }
 
     zmsg_destroy(&msg);
@@ -286,6 +940,14 @@ void dc_print(dc_t* self)
     log_debug("last_update: %" PRIi64 "\n", self->last_update);
     log_debug("total: %" PRIu64 "\n", self->total);
     log_debug("offline: %" PRIu64 "\n", self->offline);
+    log_debug("unknown: %" PRIu64 "\n", self->unknown);
+    log_debug("policy: %s threshold: %" PRIu64 " members: %zu\n", dc_policy_name(self->policy), self->threshold,
+        self->members);
+    log_debug("capacity: %" PRIu64 " offline: %" PRIu64 "\n", self->capacity, self->offline_capacity);
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++)
+        log_debug("%s: %" PRIu64 " (%zu upses)\n", dc_state_name(dc_state_t(state)), self->durations[state],
+            self->in_state[state]);
+    log_debug("ups with counters: %zu\n", self->counters ? zhashx_size(self->counters) : 0);
     log_debug("ups (%zu):\n", zlistx_size(self->ups));
 
     for (char* i = reinterpret_cast<char*>(zlistx_first(self->ups)); i != nullptr;
@@ -20,22 +20,94 @@
 */
 
 #pragma once
+#include "upt_clock.h"
+#include "upt_table.h"
 #include <czmq.h>
 
+///  When a datacenter is offline, evaluated from counters kept up to date by every status change
+enum dc_policy_t
+{
+    DC_POLICY_ANY,     // any ups is offline (default)
+    DC_POLICY_ALL,     // all upses are offline
+    DC_POLICY_K_OF_N,  // less than threshold upses are online
+    DC_POLICY_CAPACITY // rated capacity of online upses is below threshold percent of the total
+};
+
+///  Status of a ups (from ups.status) and the states datacenters account time in
+enum dc_state_t
+{
+    DC_STATE_ONLINE,      // on line without any other condition
+    DC_STATE_ON_BATTERY,  // on battery, ups is offline
+    DC_STATE_LOW_BATTERY, // on battery with low battery, ups is offline
+    DC_STATE_BYPASS,      // on bypass
+    DC_STATE_OVERLOAD,    // overloaded
+    DC_STATE_UNKNOWN,     // status is not understood
+    DC_STATE_STALE,       // status was not refreshed in time
+    DC_STATE_COUNT
+};
+
+///  Counters of one ups, kept from its first status change while it is part of the datacenter
+struct dc_ups_counters_t
+{
+    uint64_t on_battery;  // seconds the ups was offline, up to since while it is offline
+    uint64_t transitions; // number of state changes
+    int64_t  last_change; // wall clock (s) of the last state change, 0 if not known
+    int64_t  since;       // clock (s) the ups went offline, -1 if it is not offline
+};
+
 struct dc_t
 {
     int64_t last_update;
     uint64_t total;
     uint64_t offline;
+    uint64_t unknown; // seconds the agent was not running and did not account as total
+    int64_t checkpoint; // wall clock (s) counters were accounted up to before a restart, -1 if none
     zlistx_t *ups; // list of offline upses
+    zhashx_t *states; // ups name -> state of upses which are not online, with their handle in ups
+    size_t in_state[DC_STATE_COUNT]; // number of upses per state, online upses are not counted
+    uint64_t durations[DC_STATE_COUNT]; // seconds some ups was in the state, online: all upses were
+    upt_clock_t *clock; // time source, not owned
+    upt_table_slot_t *slot; // counters are written through to it, nullptr if not mapped
+    dc_policy_t policy; // how offline upses make the datacenter offline
+    uint64_t threshold; // upses of DC_POLICY_K_OF_N, percent of DC_POLICY_CAPACITY
+    size_t members; // number of upses of the datacenter
+    zhashx_t *ratings; // ups name -> rated capacity (uint64_t *), nullptr if none was set
+    uint64_t capacity; // sum of ratings
+    uint64_t offline_capacity; // sum of ratings of offline upses
+    zhashx_t *counters; // ups name -> dc_ups_counters_t, nullptr if no ups changed state yet
 };
 
-///  Create a new dc
+///  How dc_reconcile accounts time the agent was not running
+enum dc_gap_policy_t
+{
+    DC_GAP_UNKNOWN, // all of it is unknown
+    DC_GAP_ASSUME,  // status at the checkpoint lasted all the time
+    DC_GAP_CLAMP    // status at the checkpoint lasted up to a limit, the rest is unknown
+};
+
+///  Create a new dc counting time on the system clock
 dc_t *dc_new (void);
 
+///  Create a new dc counting time on clock, nullptr is the system clock
+dc_t *dc_new_clock (upt_clock_t *clock);
+
+///  Account time elapsed on the current clock and continue on clock
+void dc_set_clock (dc_t *self, upt_clock_t *clock);
+
+///  Account time elapsed up to the time of clock and continue on it, which must count on the same
+///  time base as the current clock. Meant for a copy on a stopped clock: its counters do not move
+///  anymore and time already accounted past the clock is kept.
+void dc_freeze (dc_t *self, upt_clock_t *clock);
+
 ///  Destroy the dc
 void dc_destroy (dc_t **self_p);
 
+///  Create a deep copy of the dc, the copy is not mapped to a table slot
+dc_t *dc_dup (dc_t *self);
+
+///  Write counters through to slot of a counter table from now on, nullptr stops it
+void dc_set_slot (dc_t *self, upt_table_slot_t *slot);
+
 /// Get total value
 uint64_t dc_total (dc_t *self);
 
@@ -48,14 +120,78 @@ void set_dc_total (dc_t *self, uint64_t total);
 /// Set off line value
 void set_dc_off_line (dc_t *self, uint64_t offline);
 
-///  Return if dc is offline
+/// Get unknown value
+uint64_t dc_unknown (dc_t *self);
+
+/// Set unknown value
+void set_dc_unknown (dc_t *self, uint64_t unknown);
+
+///  Account time from the checkpoint to now (wall clock, s) under policy, clamp is the limit (s) of
+///  DC_GAP_CLAMP. Checkpoint is cleared, nothing happens without one.
+void dc_reconcile (dc_t *self, int64_t now, dc_gap_policy_t policy, int64_t clamp);
+
+///  Set how offline upses make the datacenter offline, time is accounted up to now under the old policy
+void dc_set_policy (dc_t *self, dc_policy_t policy, uint64_t threshold);
+
+///  Set number of upses of the datacenter (N of the policies)
+void dc_set_members (dc_t *self, size_t members);
+
+///  Set rated capacity of ups, 0 removes the rating
+void dc_set_rating (dc_t *self, const char *ups, uint64_t rating);
+
+///  Return rated capacity of ups, 0 if not rated
+uint64_t dc_rating (dc_t *self, const char *ups);
+
+///  Return name of policy
+const char *dc_policy_name (dc_policy_t policy);
+
+///  Parse name of policy, return -1 if it is not known
+int dc_policy_parse (const char *name, dc_policy_t *policy);
+
+///  Return if dc is offline under its policy, in constant time
 bool dc_is_offline (dc_t *self);
 
-///  Set UPS as as offline
-void dc_set_offline (dc_t *self, char *ups);
+///  Set UPS as as offline (on battery), return true if UPS was not offline yet
+bool dc_set_offline (dc_t *self, char *ups);
+
+/// Set UPS as online, return true if UPS was offline
+bool dc_set_online (dc_t *self, char *ups);
+
+///  Set state of UPS, time since the last accounting is charged to the new state, call dc_uptime
+///  first to charge it to the old one. Return true if state changed.
+///  Offline upses are the ones on battery (DC_STATE_ON_BATTERY or DC_STATE_LOW_BATTERY).
+bool dc_set_state (dc_t *self, const char *ups, dc_state_t state);
+
+///  Return state of UPS, DC_STATE_ONLINE if it is not known
+dc_state_t dc_ups_state (dc_t *self, const char *ups);
+
+///  Compute time spent in every state, durations must hold DC_STATE_COUNT values
+void dc_durations (dc_t *self, uint64_t *durations);
+
+///  Return state of a ups.status value, numeric (core upsstatus.h bits) or a string of NUT flags
+dc_state_t dc_state_of_status (const char *status);
+
+///  Return name of state
+const char *dc_state_name (dc_state_t state);
+
+///  Return true if state makes an ups offline (on battery or low battery)
+bool dc_state_is_offline (dc_state_t state);
+
+///  Parse name of state, return -1 if it is not known
+int dc_state_parse (const char *name, dc_state_t *state);
+
+///  Forget ups leaving the datacenter: its state (without counting a change), rating and counters
+void dc_remove_ups (dc_t *self, const char *ups);
+
+///  Get counters of ups, on battery seconds include the current period. Return -1 if ups has none.
+int dc_ups_counters (dc_t *self, const char *ups, dc_ups_counters_t *counters);
+
+///  Replace counters of ups (restored from a saved state), the current period starts now if it is offline
+void dc_set_ups_counters (dc_t *self, const char *ups, uint64_t on_battery, uint64_t transitions, int64_t last_change);
 
-/// Set UPS as online
-void dc_set_online (dc_t *self, char *ups);
+///  Fill upses and counters with up to n upses having the most on battery seconds (ties by
+///  transitions), worst first. Names are valid until the next change of dc. Return their number.
+size_t dc_top (dc_t *self, size_t n, const char **upses, dc_ups_counters_t *counters);
 
 /// Compute uptime, return result in total/offline pointers
 void dc_uptime (dc_t *self, uint64_t *total, uint64_t *offline);
@@ -22,6 +22,9 @@
 /// fty_kpi_power_uptime_server - Actor computing uptime
 
 #include "fty_kpi_power_uptime_server.h"
+#include "upt_export.h"
+#include "upt_shard.h"
+#include "upt_trace.h"
 #include <regex>
 #include <fty_log.h>
 #include <fty_proto.h>
@@ -30,10 +33,110 @@
 
 //  Structure of our class
 
+// bootstrap window is closed when no datacenter arrived for this long (msec)
+#define BOOTSTRAP_QUIET_MS 250
+
+// when the counter table is flushed to disk
+#define TABLE_SYNC_NONE   0 // by the kernel, survives a crash of the agent but not of the system
+#define TABLE_SYNC_SAVE   1 // with every state save
+#define TABLE_SYNC_ALWAYS 2 // after every batch of metrics
+
+// at most this many messages are taken from malamute at once
+#define DRAIN_MAX 1000
+
+// at most this many stream messages are processed before looking for queries again
+#define STREAM_BATCH 100
+
+// datacenters in one message of an export, one such message is sent per pass of the loop
+#define EXPORT_BATCH 200
+
+// exports in progress at once, each one holds the names of all datacenters
+#define EXPORT_MAX 4
+
+// upses in a TOP reply, by default and at most
+#define TOP_DEFAULT 10
+#define TOP_MAX     100
+
+// malamute message waiting in one of the queues of the server
+struct s_pending_t
+{
+    char*   sender;
+    char*   subject;
+    zmsg_t* msg;
+    int64_t enqueued; // zclock_usecs()
+};
+
+static void s_pending_destructor(void** x)
+{
+    s_pending_t** self_p = reinterpret_cast<s_pending_t**>(x);
+    if (!*self_p)
+        return;
+    zstr_free(&(*self_p)->sender);
+    zstr_free(&(*self_p)->subject);
+    zmsg_destroy(&(*self_p)->msg);
+    free(*self_p);
+    *self_p = nullptr;
+}
+
+// EXPORT in progress, records are sent EXPORT_BATCH datacenters at a time
+struct s_export_t
+{
+    mlm_client_t*        client; // client the request came through, not owned
+    char*                sender;
+    upt_export_format_t  format;
+    upt_export_records_t records;
+    zlistx_t*            names;   // datacenters known at the request
+    upt_clock_t*         clock;   // stopped at the request, counters are accounted up to it
+    char*                next;    // next datacenter to export (cursor of names), nullptr at the end
+    uint64_t             seq;     // number of messages sent
+    uint64_t             count;   // number of records sent
+};
+
+static void s_export_destructor(void** x)
+{
+    s_export_t** self_p = reinterpret_cast<s_export_t**>(x);
+    if (!*self_p)
+        return;
+    zstr_free(&(*self_p)->sender);
+    zlistx_destroy(&(*self_p)->names);
+    upt_clock_destroy(&(*self_p)->clock);
+    free(*self_p);
+    *self_p = nullptr;
+}
+
+static void s_queue_init(fty_kpi_power_uptime_queue_t* queue)
+{
+    memset(queue, 0, sizeof(*queue));
+    queue->pending = zlistx_new();
+    zlistx_set_destructor(queue->pending, s_pending_destructor);
+}
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+static void* s_str_duplicator(const void* x)
+{
+    return strdup(reinterpret_cast<const char*>(x));
+}
+
+static void s_list_destructor(void** x)
+{
+    zlistx_destroy(reinterpret_cast<zlistx_t**>(x));
+}
 
 //  --------------------------------------------------------------------------
 //  Create a new fty_kpi_power_uptime_server
 
+// work of the scheduled tasks of the server loop
+static void s_poll_timer(void* arg);
+static void s_expire_timer(void* arg);
+static void s_bootstrap_timer(void* arg);
+static void s_stats_timer(void* arg);
+static void s_export_timer(void* arg);
+static void s_replica_timer(void* arg);
+
 fty_kpi_power_uptime_server_t* fty_kpi_power_uptime_server_new(void)
 {
     fty_kpi_power_uptime_server_t* self =
@@ -43,6 +146,44 @@ fty_kpi_power_uptime_server_t* fty_kpi_power_uptime_server_new(void)
     self->request_counter = 0;
     self->upt             = upt_new();
     self->name            = strdup("uptime");
+    self->bootstrap       = nullptr;
+    self->started         = zclock_mono();
+    self->bootstrap_ms    = -1;
+    self->shards          = nullptr;
+    self->shard_count     = 0;
+    self->shard_batch     = nullptr;
+    self->snapshots       = nullptr;
+    self->snapshot_count  = 0;
+    self->reader          = nullptr;
+    self->dirty           = false;
+    s_queue_init(&self->queries);
+    s_queue_init(&self->stream);
+    self->stats           = upt_stats_new();
+    self->stats_file      = nullptr;
+    self->replica         = nullptr;
+    self->replica_pub     = nullptr;
+    self->replica_sub     = nullptr;
+    self->replica_dirty   = nullptr;
+    self->federation      = nullptr;
+    self->table           = nullptr;
+    self->table_sync      = TABLE_SYNC_SAVE;
+    self->table_dirty     = false;
+    self->table_syncs     = 0;
+    self->gap_policy      = DC_GAP_UNKNOWN;
+    self->gap_clamp       = 0;
+    self->debounce        = nullptr;
+    self->stale           = nullptr;
+    self->tree            = upt_tree_new(self->upt->clock);
+    self->baselines       = upt_baseline_new();
+    self->sched           = upt_sched_new(nullptr);
+    self->poll_task       = upt_sched_add(self->sched, "poll", s_poll_timer, self);
+    self->expire_task     = upt_sched_add(self->sched, "expire", s_expire_timer, self);
+    self->bootstrap_task  = upt_sched_add(self->sched, "bootstrap", s_bootstrap_timer, self);
+    self->stats_task      = upt_sched_add(self->sched, "stats", s_stats_timer, self);
+    self->replica_task    = upt_sched_add(self->sched, "replica", s_replica_timer, self);
+    self->exports         = zlistx_new();
+    zlistx_set_destructor(self->exports, s_export_destructor);
+    self->export_task     = upt_sched_add(self->sched, "export", s_export_timer, self);
 
     return self;
 }
@@ -57,7 +198,30 @@ void fty_kpi_power_uptime_server_destroy(fty_kpi_power_uptime_server_t** self_p)
         return;
 
     fty_kpi_power_uptime_server_t* self = *self_p;
+    zactor_destroy(&self->reader);
+    zlistx_destroy(&self->exports);
+    fty_kpi_power_uptime_server_set_shards(self, 0);
+    for (size_t i = 0; i != self->snapshot_count; i++) {
+        upt_snapshot_destroy(&self->snapshots[i]);
+    }
+    free(self->snapshots);
     upt_destroy(&self->upt);
+    upt_table_destroy(&self->table);
+    upt_stats_destroy(&self->stats);
+    zstr_free(&self->stats_file);
+    zlistx_destroy(&self->queries.pending);
+    zlistx_destroy(&self->stream.pending);
+    zhashx_destroy(&self->bootstrap);
+    zsock_destroy(&self->replica_pub);
+    zsock_destroy(&self->replica_sub);
+    zhashx_destroy(&self->replica_dirty);
+    upt_replica_destroy(&self->replica);
+    upt_federation_destroy(&self->federation);
+    upt_debounce_destroy(&self->debounce);
+    upt_stale_destroy(&self->stale);
+    upt_tree_destroy(&self->tree);
+    upt_baseline_destroy(&self->baselines);
+    upt_sched_destroy(&self->sched);
     zstr_free(&self->dir);
     zstr_free(&self->name);
     free(self);
@@ -74,6 +238,156 @@ void fty_kpi_power_uptime_server_set_dir(fty_kpi_power_uptime_server_t* self, co
     self->dir = strdup(dir);
 }
 
+// stop all shards, when collect is true their state is merged back into self->upt
+static void s_shards_stop(fty_kpi_power_uptime_server_t* self, bool collect)
+{
+    for (size_t i = 0; i != self->shard_count; i++) {
+        if (collect) {
+            upt_t* part = upt_shard_snapshot(self->shards[i]);
+            if (part)
+                upt_merge(self->upt, &part);
+        }
+        zmsg_destroy(&self->shard_batch[i]);
+        zactor_destroy(&self->shards[i]);
+    }
+    free(self->shards);
+    free(self->shard_batch);
+    self->shards      = nullptr;
+    self->shard_batch = nullptr;
+    self->shard_count = 0;
+    if (collect)
+        upt_set_table(self->upt, self->table);
+}
+
+static void s_shards_start(fty_kpi_power_uptime_server_t* self, size_t count)
+{
+    // shards own the counters and write them through to their slots of the table, the routing copy
+    // is not mapped; partitions are mapped before any shard runs
+    upt_set_table(self->upt, nullptr);
+    upt_t** parts = reinterpret_cast<upt_t**>(zmalloc(count * sizeof(upt_t*)));
+    for (size_t i = 0; i != count; i++) {
+        parts[i] = upt_partition(self->upt, i, count);
+        upt_set_table(parts[i], self->table);
+    }
+    self->shards      = reinterpret_cast<zactor_t**>(zmalloc(count * sizeof(zactor_t*)));
+    self->shard_batch = reinterpret_cast<zmsg_t**>(zmalloc(count * sizeof(zmsg_t*)));
+    self->shard_count = count;
+    for (size_t i = 0; i != count; i++) {
+        self->shards[i] = zactor_new(upt_shard, parts[i]);
+        if (self->snapshots)
+            upt_shard_publish(self->shards[i], self->snapshots[i]);
+    }
+    free(parts);
+}
+
+// copy of the accounting state owned by the shards
+static upt_t* s_shards_collect(fty_kpi_power_uptime_server_t* self)
+{
+    upt_t* state = upt_new();
+    for (size_t i = 0; i != self->shard_count; i++) {
+        upt_t* part = upt_shard_snapshot(self->shards[i]);
+        if (part)
+            upt_merge(state, &part);
+    }
+    return state;
+}
+
+// send ups statuses collected for the shards
+static void s_shards_flush(fty_kpi_power_uptime_server_t* self)
+{
+    for (size_t i = 0; i != self->shard_count; i++) {
+        upt_shard_status(self->shards[i], &self->shard_batch[i]);
+    }
+}
+
+void fty_kpi_power_uptime_server_set_shards(fty_kpi_power_uptime_server_t* self, size_t count)
+{
+    assert(self);
+
+    if (self->snapshots) {
+        log_error("%s: can't change number of shards while reader is running", self->name);
+        return;
+    }
+    if (self->shard_count != 0)
+        s_shards_stop(self, true);
+    if (count > 1) {
+        s_shards_start(self, count);
+        log_info("%s: accounting split over %zu shards", self->name, count);
+    }
+}
+
+// stop debouncing, its counters are kept in the statistics and pending changes are dropped
+static void s_debounce_stop(fty_kpi_power_uptime_server_t* self)
+{
+    if (!self->debounce)
+        return;
+    self->stats->flaps += self->debounce->flaps;
+    self->stats->debounced += self->debounce->delayed;
+    upt_debounce_destroy(&self->debounce);
+}
+
+void fty_kpi_power_uptime_server_set_debounce(fty_kpi_power_uptime_server_t* self, int64_t offline_ms, int64_t online_ms)
+{
+    assert(self);
+
+    if (offline_ms <= 0 && online_ms <= 0) {
+        s_debounce_stop(self);
+        return;
+    }
+    if (!self->debounce)
+        self->debounce = upt_debounce_new(self->upt->clock);
+    upt_debounce_set_dwell(self->debounce, offline_ms, online_ms);
+}
+
+void fty_kpi_power_uptime_server_set_stale(fty_kpi_power_uptime_server_t* self, int64_t ttl_ms)
+{
+    assert(self);
+
+    if (ttl_ms <= 0) {
+        if (self->stale)
+            self->stats->stale += self->stale->expired;
+        upt_stale_destroy(&self->stale);
+        return;
+    }
+    if (self->stale) {
+        upt_stale_set_ttl(self->stale, ttl_ms);
+        return;
+    }
+
+    // known upses get ttl from now to report
+    self->stale = upt_stale_new(self->upt->clock, ttl_ms);
+    for (void* dc = zhashx_first(self->upt->ups2dc); dc != nullptr; dc = zhashx_next(self->upt->ups2dc))
+        upt_stale_seen(self->stale, reinterpret_cast<const char*>(zhashx_cursor(self->upt->ups2dc)));
+}
+
+void fty_kpi_power_uptime_server_set_clock(fty_kpi_power_uptime_server_t* self, upt_clock_t* clock)
+{
+    assert(self);
+
+    // shards own the datacenters, bring them home and split again on the new clock
+    size_t shard_count = self->shard_count;
+    if (shard_count != 0)
+        s_shards_stop(self, true);
+    upt_set_clock(self->upt, clock);
+    if (shard_count != 0)
+        s_shards_start(self, shard_count);
+    self->dirty = true;
+
+    // dwell is measured on the clock of the state
+    if (self->debounce) {
+        int64_t offline_ms = self->debounce->offline_ms;
+        int64_t online_ms  = self->debounce->online_ms;
+        s_debounce_stop(self);
+        fty_kpi_power_uptime_server_set_debounce(self, offline_ms, online_ms);
+    }
+    if (self->stale) {
+        int64_t ttl_ms = self->stale->ttl_ms;
+        fty_kpi_power_uptime_server_set_stale(self, 0);
+        fty_kpi_power_uptime_server_set_stale(self, ttl_ms);
+    }
+    upt_tree_set_clock(self->tree, self->upt->clock);
+}
+
 int fty_kpi_power_uptime_server_load_state(fty_kpi_power_uptime_server_t* self)
 {
     assert(self);
@@ -86,32 +400,282 @@ int fty_kpi_power_uptime_server_load_state(fty_kpi_power_uptime_server_t* self)
         log_error("error loading state\n");
 
     zstr_free(&state_file);
+
+    char* baselines_file = zsys_sprintf("%s/baselines", self->dir);
+    if (zsys_file_exists(baselines_file)) {
+        upt_baseline_t* baselines = upt_baseline_load(baselines_file);
+        if (baselines) {
+            upt_baseline_destroy(&self->baselines);
+            self->baselines = baselines;
+        } else
+            log_error("error loading baselines");
+    }
+    zstr_free(&baselines_file);
+
+    // loaded state replaces whatever the shards own, they stop writing the table before it is mapped
+    size_t shard_count = self->shard_count;
+    if (shard_count != 0)
+        s_shards_stop(self, false);
+    upt_set_clock(upt, self->upt->clock);
+    upt_set_table(upt, self->table);
+    upt_reconcile(upt, self->gap_policy, self->gap_clamp);
     upt_destroy(&self->upt);
     self->upt = upt;
+    if (shard_count != 0)
+        s_shards_start(self, shard_count);
+    self->dirty = true;
+
+    return 0;
+}
+
+static void s_table_sync(fty_kpi_power_uptime_server_t* self)
+{
+    upt_table_sync(self->table, true);
+    self->table_syncs++;
+    self->table_dirty = false;
+}
+
+static void s_table_start(fty_kpi_power_uptime_server_t* self, const char* path, size_t capacity, int sync)
+{
+    upt_table_t* table = upt_table_open(path, capacity);
+    if (!table) {
+        log_error("%s: TABLE: can't open counter table %s", self->name, path);
+        return;
+    }
+
+    // shards are brought home, so their counters are mapped (and taken from the table if ahead)
+    size_t shard_count = self->shard_count;
+    if (shard_count != 0)
+        s_shards_stop(self, true);
+    upt_set_table(self->upt, nullptr);
+    upt_table_destroy(&self->table);
+    self->table      = table;
+    self->table_sync = sync;
+    upt_set_table(self->upt, table);
+    if (shard_count != 0)
+        s_shards_start(self, shard_count);
+    self->dirty = true;
+    log_info("%s: counters mapped to %s (%zu of %zu slots used)", self->name, path, upt_table_size(table),
+        upt_table_capacity(table));
+}
+
+// wall clock time of the federation record, msec
+static int64_t s_federation_now(fty_kpi_power_uptime_server_t* self)
+{
+    return self->federation_offset + upt_clock_now(self->upt->clock);
+}
+
+// record current status of datacenter dc_name of state, union of snapshots is exact for 'any' only
+static void s_federation_observe(fty_kpi_power_uptime_server_t* self, upt_t* state, const char* dc_name, int64_t now)
+{
+    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(state->dc, dc_name));
+    if (dc && dc->policy == DC_POLICY_ANY)
+        upt_federation_observe(self->federation, dc_name, now, dc_is_offline(dc));
+    else
+        upt_federation_leave(self->federation, dc_name, now);
+}
+
+// record current status of every datacenter of state, time since the previous record is watched
+static void s_federation_observe_all(fty_kpi_power_uptime_server_t* self, upt_t* state)
+{
+    int64_t now = s_federation_now(self);
+    for (void* dc = zhashx_first(state->dc); dc != nullptr; dc = zhashx_next(state->dc)) {
+        s_federation_observe(self, state, reinterpret_cast<const char*>(zhashx_cursor(state->dc)), now);
+    }
+}
+
+static int s_federation_start(fty_kpi_power_uptime_server_t* self, const char* source)
+{
+    if (!self->dir) {
+        log_error("%s: FEDERATION: state directory not configured yet", self->name);
+        return -1;
+    }
 
+    char* federation_file = zsys_sprintf("%s/federation", self->dir);
+    upt_federation_destroy(&self->federation);
+    // time while the agent was not running is not watched
+    if (zsys_file_exists(federation_file))
+        self->federation = upt_federation_load(federation_file, source);
+    if (!self->federation)
+        self->federation = upt_federation_new(source);
+    zstr_free(&federation_file);
+
+    self->federation_offset = zclock_time() - upt_clock_now(self->upt->clock);
+    if (self->shard_count != 0) {
+        upt_t* state = s_shards_collect(self);
+        s_federation_observe_all(self, state);
+        upt_destroy(&state);
+    } else
+        s_federation_observe_all(self, self->upt);
+    log_info("%s: recording federation snapshot as '%s'", self->name, source);
     return 0;
 }
 
+// write baselines next to the state, the file is removed with the last baseline
+static int s_baselines_save(fty_kpi_power_uptime_server_t* self)
+{
+    char* baselines_file = zsys_sprintf("%s/baselines", self->dir);
+    int   rv             = 0;
+    if (upt_baseline_size(self->baselines) != 0)
+        rv = upt_baseline_save(self->baselines, baselines_file);
+    else if (zsys_file_exists(baselines_file))
+        zsys_file_delete(baselines_file);
+    zstr_free(&baselines_file);
+    return rv;
+}
+
 int fty_kpi_power_uptime_server_save_state(fty_kpi_power_uptime_server_t* self)
 {
     assert(self);
 
+    if (self->replica_sub) {
+        // the leader owns the state file
+        log_debug("%s: following, state is not saved", self->name);
+        return 0;
+    }
     if (!self->dir) {
         log_error("Saving state directory not configured yet. Probably got some messages before CONFIG.");
         return -1;
     }
 
-    char* state_file = zsys_sprintf("%s/state", self->dir);
-    int   rv         = upt_save(self->upt, state_file);
+    char*   state_file = zsys_sprintf("%s/state", self->dir);
+    int     rv         = 0;
+    int64_t start      = zclock_usecs();
+    // upt of the server only routes upses when sharded, counters are collected from the shards
+    upt_t* state = self->shard_count != 0 ? s_shards_collect(self) : self->upt;
+    rv           = upt_save(state, state_file);
+    if (self->table && self->table_sync == TABLE_SYNC_SAVE)
+        s_table_sync(self);
+    if (self->federation) {
+        char* federation_file = zsys_sprintf("%s/federation", self->dir);
+        s_federation_observe_all(self, state);
+        if (upt_federation_save(self->federation, federation_file) != 0)
+            rv = -1;
+        zstr_free(&federation_file);
+    }
+    if (s_baselines_save(self) != 0)
+        rv = -1;
+    if (state != self->upt)
+        upt_destroy(&state);
+    upt_stats_histogram_add(&self->stats->save, uint64_t(zclock_usecs() - start));
     if (rv != 0) {
         log_error("fty_kpi_power_uptime_server_save_state: error while saving state file");
+        self->stats->save_errors++;
         zstr_free(&state_file);
         return -1;
     }
+    self->stats->saves++;
+    self->stats->save_bytes = uint64_t(zsys_file_size(state_file));
     zstr_free(&state_file);
     return 0;
 }
 
+// stream the whole state to followers
+static void s_replica_snapshot(fty_kpi_power_uptime_server_t* server)
+{
+    if (!server->replica_pub)
+        return;
+
+    zmsg_t* msg = nullptr;
+    if (server->shard_count != 0) {
+        upt_t* state = s_shards_collect(server);
+        msg          = upt_replica_snapshot(server->replica, state);
+        upt_destroy(&state);
+    } else
+        msg = upt_replica_snapshot(server->replica, server->upt);
+    zmsg_send(&msg, server->replica_pub);
+    zhashx_purge(server->replica_dirty);
+    upt_sched_arm_in(server->sched, server->replica_task, server->replica_interval);
+}
+
+static void s_replica_timer(void* arg)
+{
+    s_replica_snapshot(reinterpret_cast<fty_kpi_power_uptime_server_t*>(arg));
+}
+
+// stream counters of datacenters changed since the last delta
+static void s_replica_flush(fty_kpi_power_uptime_server_t* server)
+{
+    if (!server->replica_pub || zhashx_size(server->replica_dirty) == 0)
+        return;
+
+    zmsg_t* msg = upt_replica_delta(server->replica, server->upt, server->replica_dirty);
+    zmsg_send(&msg, server->replica_pub);
+    zhashx_purge(server->replica_dirty);
+}
+
+static void s_replica_changed(fty_kpi_power_uptime_server_t* server, const char* dc_name)
+{
+    // set of names, value is not used
+    if (server->replica_pub)
+        zhashx_update(server->replica_dirty, dc_name, server);
+}
+
+static void s_replica_topology(fty_kpi_power_uptime_server_t* server, const char* dc_name, zlistx_t* ups)
+{
+    if (!server->replica_pub || server->shard_count != 0)
+        return;
+
+    zmsg_t* msg = upt_replica_topology(server->replica, server->upt, dc_name, ups);
+    if (msg)
+        zmsg_send(&msg, server->replica_pub);
+    zhashx_delete(server->replica_dirty, dc_name);
+}
+
+// redundancy of the datacenter from attributes of its asset: uptime.policy (any, all, k-of-n or
+// capacity), uptime.threshold and uptime.rating.<ups> (rated capacity of member upses)
+static void s_set_dc_policy(fty_kpi_power_uptime_server_t* self, const char* dc_name, zhash_t* ext, zlistx_t* ups)
+{
+    dc_policy_t policy      = DC_POLICY_ANY;
+    const char* s_policy    = ext ? reinterpret_cast<const char*>(zhash_lookup(ext, "uptime.policy")) : nullptr;
+    const char* s_threshold = ext ? reinterpret_cast<const char*>(zhash_lookup(ext, "uptime.threshold")) : nullptr;
+    if (s_policy && dc_policy_parse(s_policy, &policy) == -1)
+        log_warning("%s: unknown uptime.policy '%s' of %s, using 'any'", self->name, s_policy, dc_name);
+    uint64_t threshold = s_threshold ? strtoull(s_threshold, nullptr, 10) : 0;
+
+    // when sharded the routing copy keeps membership only, the shard does the accounting
+    zactor_t* shard = self->shard_count != 0 ? self->shards[upt_shard_of(dc_name, self->shard_count)] : nullptr;
+    if (shard)
+        upt_shard_policy(shard, dc_name, policy, threshold);
+    else
+        upt_set_policy(self->upt, dc_name, policy, threshold);
+
+    for (char* ups_name = reinterpret_cast<char*>(zlistx_first(ups)); ups_name != nullptr;
+         ups_name       = reinterpret_cast<char*>(zlistx_next(ups))) {
+        char*       key      = zsys_sprintf("uptime.rating.%s", ups_name);
+        const char* s_rating = ext ? reinterpret_cast<const char*>(zhash_lookup(ext, key)) : nullptr;
+        uint64_t    rating   = s_rating ? strtoull(s_rating, nullptr, 10) : 0;
+        if (shard)
+            upt_shard_rating(shard, dc_name, ups_name, rating);
+        else
+            upt_set_rating(self->upt, dc_name, ups_name, rating);
+        zstr_free(&key);
+    }
+    upt_trace("asset.policy", "%s: dc_name=%s policy=%s threshold=%" PRIu64, self->name, dc_name,
+        dc_policy_name(policy), threshold);
+}
+
+// upses which left every datacenter and are not in the tree report no more, drop their timers
+static void s_forget_left(fty_kpi_power_uptime_server_t* self)
+{
+    if (!self->stale)
+        return;
+
+    zlistx_t* left = zlistx_new();
+    for (void* entry = zhashx_first(self->stale->upses); entry != nullptr; entry = zhashx_next(self->stale->upses)) {
+        const char* ups_name = reinterpret_cast<const char*>(zhashx_cursor(self->stale->upses));
+        if (!upt_dc_names(self->upt, ups_name) && !upt_tree_is_placed(self->tree, ups_name))
+            zlistx_add_end(left, const_cast<char*>(ups_name));
+    }
+    for (char* ups_name = reinterpret_cast<char*>(zlistx_first(left)); ups_name != nullptr;
+         ups_name       = reinterpret_cast<char*>(zlistx_next(left))) {
+        if (self->debounce)
+            upt_debounce_forget(self->debounce, ups_name);
+        upt_stale_forget(self->stale, ups_name);
+    }
+    zlistx_destroy(&left);
+}
+
 void s_set_dc_upses(fty_kpi_power_uptime_server_t* self, fty_proto_t* fmsg)
 {
     assert(fmsg);
@@ -130,9 +694,11 @@ void s_set_dc_upses(fty_kpi_power_uptime_server_t* self, fty_proto_t* fmsg)
         return;
     }
 
-    log_debug("%s:\ts_set_dc_upses \t dc_name: %s", self->name, dc_name);
+    upt_trace("asset.dc", "%s: dc_name=%s", self->name, dc_name);
 
     zlistx_t* ups = zlistx_new();
+    zlistx_set_duplicator(ups, s_str_duplicator);
+    zlistx_set_destructor(ups, s_str_destructor);
 
     for (uint i = 0; i < zhash_size(aux); ++i) {
         char* key  = zsys_sprintf("ups%d", i);
@@ -140,69 +706,442 @@ void s_set_dc_upses(fty_kpi_power_uptime_server_t* self, fty_proto_t* fmsg)
 
         if (item) {
             zlistx_add_end(ups, item);
-            log_debug("%s:\ts_set_dc_upses : %s", self->name, reinterpret_cast<char*>(item));
+            upt_trace("asset.ups", "%s: ups=%s", self->name, reinterpret_cast<char*>(item));
         } else {
             log_info("s_set_dc_upses: not relevant item");
         }
         zstr_free(&key);
     }
 
-    if (zlistx_size(ups) != 0)
+    if (self->bootstrap) {
+        // bootstrap in progress, the whole batch is applied once the window closes, policy
+        // creates the datacenter right away and is kept by the batch
+        if (zlistx_size(ups) != 0) {
+            s_set_dc_policy(self, dc_name, fty_proto_ext(fmsg), ups);
+            zhashx_update(self->bootstrap, dc_name, ups);
+            self->bootstrap_last = zclock_mono();
+            int64_t close        = self->bootstrap_deadline - self->bootstrap_last;
+            upt_sched_arm_in(self->sched, self->bootstrap_task, close < BOOTSTRAP_QUIET_MS ? close : BOOTSTRAP_QUIET_MS);
+        } else
+            zlistx_destroy(&ups);
+        zhash_destroy(&aux);
+        return;
+    }
+
+    if (zlistx_size(ups) != 0) {
         upt_add(self->upt, dc_name, ups);
+        s_forget_left(self);
+        self->dirty = true;
+        if (self->shard_count != 0)
+            upt_shard_topology(self->shards[upt_shard_of(dc_name, self->shard_count)], dc_name, ups);
+        s_set_dc_policy(self, dc_name, fty_proto_ext(fmsg), ups);
+        s_replica_topology(self, dc_name, ups);
+        if (self->federation && self->shard_count == 0)
+            s_federation_observe(self, self->upt, dc_name, s_federation_now(self));
+    }
 
     // recalculate uptime - some modification might have had an impact on a state of DC
     uint64_t total, offline;
-    upt_uptime(self->upt, dc_name, &total, &offline);
+    if (self->shard_count == 0)
+        upt_uptime(self->upt, dc_name, &total, &offline);
     zlistx_destroy(&ups);
     zhash_destroy(&aux);
 }
 
-static void s_handle_uptime(fty_kpi_power_uptime_server_t* server, mlm_client_t* client, zmsg_t* msg)
+// UPTIME/total/offline/unknown followed by state/seconds pairs of every state
+static void s_send_uptime(mlm_client_t* client, const char* sender, uint64_t total, uint64_t offline,
+    uint64_t unknown, const uint64_t* durations)
 {
-    int   r;
-    char* dc_name = zmsg_popstr(msg);
+    zmsg_t* reply = zmsg_new();
+    zmsg_addstr(reply, "UPTIME");
+    zmsg_addstrf(reply, "%" PRIu64, total);
+    zmsg_addstrf(reply, "%" PRIu64, offline);
+    zmsg_addstrf(reply, "%" PRIu64, unknown);
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+        zmsg_addstr(reply, dc_state_name(dc_state_t(state)));
+        zmsg_addstrf(reply, "%" PRIu64, durations[state]);
+    }
+    mlm_client_sendto(client, sender, "UPTIME", nullptr, 5000, &reply);
+}
+
+// counters of datacenter dc_name, from its shard when sharded, return -1 if unknown dc
+static int s_counters(fty_kpi_power_uptime_server_t* server, const char* dc_name, upt_baseline_counters_t* counters)
+{
+    int r;
+    memset(counters, 0, sizeof(*counters));
+    if (server->shard_count != 0) {
+        zactor_t* shard = server->shards[upt_shard_of(dc_name, server->shard_count)];
+        r               = upt_shard_uptime(shard, dc_name, &counters->total, &counters->offline);
+        if (r == 0)
+            upt_shard_durations(shard, dc_name, counters->durations);
+    } else {
+        r = upt_uptime(server->upt, dc_name, &counters->total, &counters->offline);
+        if (r == 0)
+            upt_durations(server->upt, dc_name, counters->durations);
+    }
+    // unknown time changes at load only, routing copy of sharded state has it too
+    if (r == 0)
+        upt_unknown(server->upt, dc_name, &counters->unknown);
+    return r;
+}
+
+// UPTIME/dc[/baseline], counters since baseline when it is given
+static void s_handle_uptime(
+    fty_kpi_power_uptime_server_t* server, mlm_client_t* client, const char* sender, zmsg_t* msg)
+{
+    char* dc_name  = zmsg_popstr(msg);
+    char* baseline = zmsg_popstr(msg);
     if (!dc_name) {
         log_error("no DC name in message, ignoring");
 
-        mlm_client_sendtox(client, mlm_client_sender(client), "UPTIME", "UPTIME", "ERROR",
-            "Invalid request: missing DC name", nullptr);
+        mlm_client_sendtox(client, sender, "UPTIME", "UPTIME", "ERROR", "Invalid request: missing DC name", nullptr);
+        zstr_free(&baseline);
+        return;
     }
-    log_debug("%s:\tdc_name: '%s'", server->name, dc_name);
+    upt_trace("uptime.request", "%s: dc_name=%s", server->name, dc_name);
 
-    uint64_t total, offline;
-    r = upt_uptime(server->upt, dc_name, &total, &offline);
+    upt_baseline_counters_t counters;
+    int                     r = s_counters(server, dc_name, &counters);
 
-    log_debug("%s:\tr: %d, total: %" PRIu64 ", offline: %" PRIu64 "\n", server->name, r, total, offline);
+    upt_trace("uptime.reply", "%s: r=%d total=%" PRIu64 " offline=%" PRIu64, server->name, r, counters.total,
+        counters.offline);
 
     if (r == -1) {
         log_error("Can't compute uptime, most likely unknown DC: %s", dc_name);
-        mlm_client_sendtox(client, mlm_client_sender(client), "UPTIME", "UPTIME", "ERROR",
-            "Invalid request: DC name is not known", nullptr);
+        mlm_client_sendtox(
+            client, sender, "UPTIME", "UPTIME", "ERROR", "Invalid request: DC name is not known", nullptr);
+    } else if (baseline && upt_baseline_since(server->baselines, baseline, dc_name, &counters) == -1) {
+        mlm_client_sendtox(
+            client, sender, "UPTIME", "UPTIME", "ERROR", "Invalid request: baseline is not known", nullptr);
+    } else
+        s_send_uptime(client, sender, counters.total, counters.offline, counters.unknown, counters.durations);
+
+    zstr_free(&dc_name);
+    zstr_free(&baseline);
+}
+
+// baselines are taken on request and would not come back after a crash, they are saved at once
+static void s_baselines_changed(fty_kpi_power_uptime_server_t* server)
+{
+    if (server->dir && !server->replica_sub && s_baselines_save(server) != 0)
+        log_error("%s: error while saving baselines", server->name);
+}
+
+// BASELINE/TAKE/name, BASELINE/DROP/name or BASELINE/LIST
+static void s_handle_baseline(
+    fty_kpi_power_uptime_server_t* server, mlm_client_t* client, const char* sender, zmsg_t* msg)
+{
+    char* op   = zmsg_popstr(msg);
+    char* name = zmsg_popstr(msg);
+    if (op && streq(op, "LIST")) {
+        zmsg_t* reply = zmsg_new();
+        zmsg_addstr(reply, "BASELINE");
+        for (const char* it = upt_baseline_first(server->baselines); it != nullptr;
+             it             = upt_baseline_next(server->baselines)) {
+            zmsg_addstr(reply, it);
+            zmsg_addstrf(reply, "%" PRIi64, upt_baseline_taken(server->baselines, it));
+        }
+        mlm_client_sendto(client, sender, "BASELINE", nullptr, 5000, &reply);
+    } else if (!op || !name || !*name) {
+        mlm_client_sendtox(
+            client, sender, "BASELINE", "BASELINE", "ERROR", "Invalid request: missing baseline name", nullptr);
+    } else if (streq(op, "TAKE")) {
+        int64_t taken = upt_clock_wall(server->upt->clock) / 1000;
+        // live counters are in the shards, the routing copy has datacenters only
+        if (server->shard_count != 0) {
+            upt_t* state = s_shards_collect(server);
+            upt_baseline_take(server->baselines, name, taken, state);
+            upt_destroy(&state);
+        } else
+            upt_baseline_take(server->baselines, name, taken, server->upt);
+        s_baselines_changed(server);
+        log_info("%s: baseline '%s' taken", server->name, name);
+        zmsg_t* reply = zmsg_new();
+        zmsg_addstr(reply, "BASELINE");
+        zmsg_addstr(reply, "OK");
+        zmsg_addstrf(reply, "%" PRIi64, taken);
+        mlm_client_sendto(client, sender, "BASELINE", nullptr, 5000, &reply);
+    } else if (streq(op, "DROP")) {
+        if (upt_baseline_drop(server->baselines, name) == -1)
+            mlm_client_sendtox(
+                client, sender, "BASELINE", "BASELINE", "ERROR", "Invalid request: baseline is not known", nullptr);
+        else {
+            s_baselines_changed(server);
+            mlm_client_sendtox(client, sender, "BASELINE", "BASELINE", "OK", nullptr);
+        }
+    } else
+        mlm_client_sendtox(client, sender, "BASELINE", "BASELINE", "ERROR", "Unknown operation", nullptr);
+    zstr_free(&op);
+    zstr_free(&name);
+}
+
+// TOP/dc/n, reply TOP followed by ups/on_battery/transitions/last_change of up to n worst upses
+static void s_handle_top(fty_kpi_power_uptime_server_t* server, mlm_client_t* client, const char* sender, zmsg_t* msg)
+{
+    char* dc_name = zmsg_popstr(msg);
+    char* s_n     = zmsg_popstr(msg);
+    if (!dc_name) {
+        mlm_client_sendtox(client, sender, "TOP", "TOP", "ERROR", "Invalid request: missing DC name", nullptr);
+        zstr_free(&s_n);
+        return;
     }
 
-    char *s_total, *s_offline;
-    r = asprintf(&s_total, "%" PRIu64, total);
-    assert(r > 0);
-    r = asprintf(&s_offline, "%" PRIu64, offline);
-    assert(r > 0);
+    char*         end = nullptr;
+    unsigned long n   = s_n && *s_n ? strtoul(s_n, &end, 10) : TOP_DEFAULT;
+    if ((end && *end) || n == 0 || (s_n && *s_n == '-')) {
+        mlm_client_sendtox(
+            client, sender, "TOP", "TOP", "ERROR", "Invalid request: n is not a positive number", nullptr);
+        zstr_free(&dc_name);
+        zstr_free(&s_n);
+        return;
+    }
+    if (n > TOP_MAX)
+        n = TOP_MAX;
 
-    mlm_client_sendtox(client, mlm_client_sender(client), "UPTIME", "UPTIME", s_total, s_offline, nullptr);
+    zmsg_t* reply = nullptr;
+    if (server->shard_count != 0)
+        reply = upt_shard_top(server->shards[upt_shard_of(dc_name, server->shard_count)], dc_name, n);
+    else
+        reply = upt_top(server->upt, dc_name, n);
 
+    if (!reply)
+        mlm_client_sendtox(client, sender, "TOP", "TOP", "ERROR", "Invalid request: DC name is not known", nullptr);
+    else {
+        zmsg_pushstr(reply, "TOP");
+        mlm_client_sendto(client, sender, "TOP", nullptr, 5000, &reply);
+    }
     zstr_free(&dc_name);
-    zstr_free(&s_total);
-    zstr_free(&s_offline);
+    zstr_free(&s_n);
 }
 
-static bool s_ups_is_onbattery(fty_proto_t* msg)
+// ROLLUP/node, reply ROLLUP/type/parent/total/offline/children/offline_children/outages
+static void s_handle_rollup(fty_kpi_power_uptime_server_t* server, mlm_client_t* client, const char* sender, zmsg_t* msg)
 {
-    const char* state = fty_proto_value(msg);
-    if (isdigit(state[0])) {
-        // see core.git/src/shared/upsstatus.h STATUS_OB == 1 << 4 == 16
-        int istate = atoi(state);
-        return (istate & 0x10) != 0;
-    } else
-        // this is forward compatible - new protocol allows strings to be passed
-        return strstr(state, "OB") != nullptr;
+    char* name = zmsg_popstr(msg);
+
+    upt_tree_rollup_t rollup;
+    if (upt_tree_rollup(server->tree, name && *name ? name : UPT_TREE_ROOT, &rollup) == -1)
+        mlm_client_sendtox(client, sender, "ROLLUP", "ROLLUP", "ERROR", "Invalid request: node is not known", nullptr);
+    else {
+        zmsg_t* reply = zmsg_new();
+        zmsg_addstr(reply, "ROLLUP");
+        zmsg_addstr(reply, rollup.type);
+        zmsg_addstr(reply, rollup.parent ? rollup.parent : "");
+        zmsg_addstrf(reply, "%" PRIu64, rollup.total);
+        zmsg_addstrf(reply, "%" PRIu64, rollup.offline);
+        zmsg_addstrf(reply, "%zu", rollup.children);
+        zmsg_addstrf(reply, "%zu", rollup.offline_children);
+        zmsg_addstrf(reply, "%" PRIu64, rollup.outages);
+        mlm_client_sendto(client, sender, "ROLLUP", nullptr, 5000, &reply);
+    }
+    zstr_free(&name);
+}
+
+// EXPORT/format/records, records of all datacenters are streamed back as EXPORT/DATA/seq/text
+// messages of EXPORT_BATCH datacenters ended by EXPORT/END/count, counters as of the request
+static void s_handle_export(fty_kpi_power_uptime_server_t* server, mlm_client_t* client, const char* sender, zmsg_t* msg)
+{
+    char*                s_format  = zmsg_popstr(msg);
+    char*                s_records = zmsg_popstr(msg);
+    upt_export_format_t  format    = UPT_EXPORT_JSON;
+    upt_export_records_t records   = UPT_EXPORT_DCS;
+    const char*          error     = nullptr;
+    if (s_format && *s_format && upt_export_format_parse(s_format, &format) == -1)
+        error = "Invalid request: unknown format";
+    else if (s_records && *s_records && upt_export_records_parse(s_records, &records) == -1)
+        error = "Invalid request: unknown records";
+    else if (format == UPT_EXPORT_CSV && records == UPT_EXPORT_ALL)
+        error = "Invalid request: CSV holds one kind of records";
+    else if (zlistx_size(server->exports) >= EXPORT_MAX)
+        error = "Too many exports in progress";
+    zstr_free(&s_format);
+    zstr_free(&s_records);
+    if (error) {
+        mlm_client_sendtox(client, sender, "EXPORT", "EXPORT", "ERROR", error, nullptr);
+        return;
+    }
+
+    s_export_t* job = reinterpret_cast<s_export_t*>(zmalloc(sizeof(s_export_t)));
+    job->client     = client;
+    job->sender     = strdup(sender);
+    job->format     = format;
+    job->records    = records;
+    // only names are taken now, each batch copies its datacenters from the live state
+    job->names = zlistx_new();
+    zlistx_set_duplicator(job->names, s_str_duplicator);
+    zlistx_set_destructor(job->names, s_str_destructor);
+    for (void* dc = zhashx_first(server->upt->dc); dc != nullptr; dc = zhashx_next(server->upt->dc))
+        zlistx_add_end(job->names, const_cast<void*>(zhashx_cursor(server->upt->dc)));
+    job->clock = upt_clock_sim_new(upt_clock_now(server->upt->clock));
+    job->next  = reinterpret_cast<char*>(zlistx_first(job->names));
+    zlistx_add_end(server->exports, job);
+    upt_sched_arm_in(server->sched, server->export_task, 0);
+    log_info("%s: exporting %zu datacenters to %s", server->name, zlistx_size(job->names), sender);
+}
+
+// copy of datacenters batch from the live state, live counters are in the shards when sharded
+static upt_t* s_export_copy(fty_kpi_power_uptime_server_t* server, zlistx_t* batch)
+{
+    if (server->shard_count == 0)
+        return upt_dup_dcs(server->upt, batch);
+
+    upt_t*    state = upt_new();
+    zlistx_t* owned = zlistx_new();
+    for (size_t i = 0; i != server->shard_count; i++) {
+        for (char* dc_name = reinterpret_cast<char*>(zlistx_first(batch)); dc_name != nullptr;
+             dc_name       = reinterpret_cast<char*>(zlistx_next(batch))) {
+            if (upt_shard_of(dc_name, server->shard_count) == i)
+                zlistx_add_end(owned, dc_name);
+        }
+        if (zlistx_size(owned) != 0) {
+            upt_t* part = upt_shard_copy(server->shards[i], owned);
+            upt_merge(state, &part);
+        }
+        zlistx_purge(owned);
+    }
+    zlistx_destroy(&owned);
+    return state;
+}
+
+// send the next message of the oldest export, exports take turns so that each pass of the loop
+// sends one message and queries and metrics are served in between
+static void s_export_timer(void* arg)
+{
+    fty_kpi_power_uptime_server_t* server = reinterpret_cast<fty_kpi_power_uptime_server_t*>(arg);
+    s_export_t*                    job    = reinterpret_cast<s_export_t*>(zlistx_detach(server->exports, nullptr));
+    if (!job)
+        return;
+
+    // datacenters removed since the request are skipped
+    zlistx_t* batch = zlistx_new();
+    for (size_t i = 0; i != EXPORT_BATCH && job->next != nullptr; i++) {
+        zlistx_add_end(batch, job->next);
+        job->next = reinterpret_cast<char*>(zlistx_next(job->names));
+    }
+    upt_t* state = s_export_copy(server, batch);
+    upt_freeze(state, job->clock);
+
+    char*  text = nullptr;
+    size_t size = 0;
+    FILE*  file = open_memstream(&text, &size);
+    if (job->seq == 0)
+        upt_export_header(file, job->format, job->records);
+    for (char* dc_name = reinterpret_cast<char*>(zlistx_first(batch)); dc_name != nullptr;
+         dc_name       = reinterpret_cast<char*>(zlistx_next(batch))) {
+        dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(state->dc, dc_name));
+        if (dc)
+            job->count +=
+                upt_export_write(file, job->format, job->records, dc_name, dc, dc->members, server->baselines);
+    }
+    fclose(file);
+    upt_destroy(&state);
+    zlistx_destroy(&batch);
+
+    zmsg_t* reply = zmsg_new();
+    zmsg_addstr(reply, "EXPORT");
+    zmsg_addstr(reply, "DATA");
+    zmsg_addstrf(reply, "%" PRIu64, job->seq++);
+    zmsg_addmem(reply, text, size);
+    free(text);
+    mlm_client_sendto(job->client, job->sender, "EXPORT", nullptr, 5000, &reply);
+
+    if (job->next) {
+        zlistx_add_end(server->exports, job);
+    } else {
+        char* count = zsys_sprintf("%" PRIu64, job->count);
+        mlm_client_sendtox(job->client, job->sender, "EXPORT", "EXPORT", "END", count, nullptr);
+        log_info("%s: export to %s done, %s records", server->name, job->sender, count);
+        zstr_free(&count);
+        s_export_destructor(reinterpret_cast<void**>(&job));
+    }
+    if (zlistx_size(server->exports) != 0)
+        upt_sched_arm_in(server->sched, server->export_task, 0);
+}
+
+static void s_handle_mailbox(
+    fty_kpi_power_uptime_server_t* server, mlm_client_t* client, const char* sender, zmsg_t* msg)
+{
+    server->stats->msg_mailbox++;
+    char* command = zmsg_popstr(msg);
+    upt_trace("mailbox.command", "%s: command=%s", server->name, command);
+    if (!command) {
+        mlm_client_sendtox(client, sender, "UPTIME", "ERROR", "Unknown command", nullptr);
+    } else if (streq(command, "UPTIME")) {
+        s_handle_uptime(server, client, sender, msg);
+    } else if (streq(command, "TOP")) {
+        s_handle_top(server, client, sender, msg);
+    } else if (streq(command, "ROLLUP")) {
+        s_handle_rollup(server, client, sender, msg);
+    } else if (streq(command, "BASELINE")) {
+        s_handle_baseline(server, client, sender, msg);
+    } else if (streq(command, "EXPORT")) {
+        s_handle_export(server, client, sender, msg);
+    } else if (streq(command, "STATS")) {
+        zmsg_t* reply = fty_kpi_power_uptime_server_stats(server);
+        zmsg_pushstr(reply, "STATS");
+        mlm_client_sendto(client, sender, "STATS", nullptr, 5000, &reply);
+    } else if (streq(command, "TRACE")) {
+        char* s_mode = zmsg_popstr(msg);
+        char* s_rate = zmsg_popstr(msg);
+        int   mode   = upt_trace_parse(s_mode);
+        if (mode == -1)
+            mlm_client_sendtox(client, sender, "TRACE", "TRACE", "ERROR", "Unknown trace mode", nullptr);
+        else {
+            upt_trace_set_mode(upt_trace_mode_t(mode), s_rate ? uint32_t(atoi(s_rate)) : 10);
+            log_info("%s: trace mode set to %s", server->name, s_mode);
+            mlm_client_sendtox(client, sender, "TRACE", "TRACE", "OK", nullptr);
+        }
+        zstr_free(&s_mode);
+        zstr_free(&s_rate);
+    } else {
+        mlm_client_sendtox(client, sender, "UPTIME", "ERROR", "Unknown command", nullptr);
+    }
+    zstr_free(&command);
+}
+
+// apply accepted state of ups to every datacenter it belongs to and to the tree
+static void s_apply_state(fty_kpi_power_uptime_server_t* server, const char* ups_name, dc_state_t state)
+{
+    upt_tree_set_offline(server->tree, ups_name, dc_state_is_offline(state));
+
+    zlistx_t* dcs = upt_dc_names(server->upt, ups_name);
+    if (!dcs)
+        return;
+
+    if (server->shard_count != 0) {
+        // owning shards do the accounting, statuses are sent in batches by s_shards_flush, once per shard
+        bool* sent = reinterpret_cast<bool*>(zmalloc(server->shard_count * sizeof(bool)));
+        for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dcs)); dc_name != nullptr;
+             dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+            size_t i = upt_shard_of(dc_name, server->shard_count);
+            if (!sent[i])
+                upt_shard_status_add(&server->shard_batch[i], ups_name, state);
+            sent[i] = true;
+        }
+        free(sent);
+        return;
+    }
+
+    // time up to now belongs to the old state, account it before the change
+    uint64_t total, offline;
+    for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dcs)); dc_name != nullptr;
+         dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+        upt_uptime(server->upt, dc_name, &total, &offline);
+    }
+
+    bool changed = upt_set_state(server->upt, ups_name, state);
+    if (changed) {
+        server->stats->transitions++;
+        server->dirty = true;
+    }
+
+    for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dcs)); changed && dc_name != nullptr;
+         dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+        s_replica_changed(server, dc_name);
+        if (server->federation)
+            s_federation_observe(server, server->upt, dc_name, s_federation_now(server));
+    }
+    server->table_dirty = server->table != nullptr;
 }
 
 static void s_handle_metric(fty_kpi_power_uptime_server_t* server, mlm_client_t* /*client*/, fty_proto_t* msg)
@@ -210,60 +1149,495 @@ static void s_handle_metric(fty_kpi_power_uptime_server_t* server, mlm_client_t*
     const char* ups_name = fty_proto_name(msg);
     const char* dc_name  = upt_dc_name(server->upt, ups_name);
 
-    if (!dc_name)
+    if (!dc_name && !upt_tree_is_placed(server->tree, ups_name))
+        return;
+    server->stats->metrics_matched++;
+    if (server->stale)
+        upt_stale_seen(server->stale, ups_name);
+    upt_trace("metric.status", "%s: ups=%s dc=%s value=%s", server->name, ups_name, dc_name, fty_proto_value(msg));
+
+    // numeric values are bits of core.git/src/shared/upsstatus.h, the new protocol allows NUT strings
+    dc_state_t state = dc_state_of_status(fty_proto_value(msg));
+    if (server->debounce && !upt_debounce_observe(server->debounce, ups_name, state))
         return;
+    s_apply_state(server, ups_name, state);
+}
 
-    if (s_ups_is_onbattery(msg))
-        upt_set_offline(server->upt, ups_name);
+// pending state of ups lasted for its dwell
+static void s_debounced(const char* ups_name, dc_state_t state, void* arg)
+{
+    fty_kpi_power_uptime_server_t* server = reinterpret_cast<fty_kpi_power_uptime_server_t*>(arg);
+    s_apply_state(server, ups_name, state);
+}
+
+// ups did not report for ttl, its last status is not trusted any more
+static void s_stale(const char* ups_name, void* arg)
+{
+    fty_kpi_power_uptime_server_t* server  = reinterpret_cast<fty_kpi_power_uptime_server_t*>(arg);
+    const char*                    dc_name = upt_dc_name(server->upt, ups_name);
+    // the next status is applied at once when it reports again
+    if (server->debounce)
+        upt_debounce_forget(server->debounce, ups_name);
+    // upses placed only in the tree go stale there too
+    log_info("%s: ups %s of %s stopped reporting, it is stale", server->name, ups_name,
+        dc_name ? dc_name : "the tree");
+    s_apply_state(server, ups_name, DC_STATE_STALE);
+}
+
+// the shorter of two timeouts, -1 is infinity
+static int64_t s_timeout_min(int64_t a, int64_t b)
+{
+    if (a < 0)
+        return b;
+    if (b < 0)
+        return a;
+    return a < b ? a : b;
+}
+
+// wake up when the first debounce or stale timer is due, they run on the clock of the state
+static void s_expire_arm(fty_kpi_power_uptime_server_t* server)
+{
+    int64_t next = -1;
+    if (server->debounce)
+        next = upt_debounce_next(server->debounce);
+    if (server->stale)
+        next = s_timeout_min(next, upt_stale_next(server->stale));
+    if (next == -1)
+        upt_sched_disarm(server->sched, server->expire_task);
     else
-        upt_set_online(server->upt, ups_name);
+        upt_sched_arm_in(server->sched, server->expire_task, next - upt_clock_now(server->upt->clock));
+}
+
+static void s_expire_timer(void* arg)
+{
+    fty_kpi_power_uptime_server_t* server = reinterpret_cast<fty_kpi_power_uptime_server_t*>(arg);
+    if (server->debounce)
+        upt_debounce_expire(server->debounce, s_debounced, server);
+    if (server->stale)
+        upt_stale_expire(server->stale, s_stale, server);
+    s_shards_flush(server);
+    s_expire_arm(server);
+}
+
+void fty_kpi_power_uptime_server_poll_metrics(fty_kpi_power_uptime_server_t* self)
+{
+    assert(self);
+
+    int64_t              start = zclock_usecs();
+    fty::shm::shmMetrics result;
+    fty::shm::read_metrics(".*", "^status\\.ups|^status", result);
+    upt_trace("shm.poll", "%s: metrics=%zu", self->name, result.size());
+
+    for (auto& element : result) {
+        s_handle_metric(self, nullptr, element);
+    }
+    s_shards_flush(self);
+    s_expire_arm(self);
+
+    self->stats->polls++;
+    self->stats->metrics_read += result.size();
+    upt_stats_histogram_add(&self->stats->poll, uint64_t(zclock_usecs() - start));
+}
+
+// shm is read every polling interval by the server thread itself, so that the state is never
+// touched by two threads
+static void s_poll_timer(void* arg)
+{
+    fty_kpi_power_uptime_server_t* server = reinterpret_cast<fty_kpi_power_uptime_server_t*>(arg);
+    if (!server->replica_sub)
+        fty_kpi_power_uptime_server_poll_metrics(server);
+    upt_sched_arm_in(server->sched, server->poll_task, int64_t(fty_get_polling_interval()) * 1000);
+}
+
+static void s_bootstrap_start(
+    fty_kpi_power_uptime_server_t* server, mlm_client_t* client, const char* agent, int64_t timeout)
+{
+    zhashx_destroy(&server->bootstrap);
+    server->bootstrap = zhashx_new();
+    zhashx_set_key_duplicator(server->bootstrap, s_str_duplicator);
+    zhashx_set_key_destructor(server->bootstrap, s_str_destructor);
+    zhashx_set_destructor(server->bootstrap, s_list_destructor);
+    server->bootstrap_deadline = zclock_mono() + timeout;
+    server->bootstrap_last     = 0;
+    upt_sched_arm_in(server->sched, server->bootstrap_task, timeout);
+
+    // asset agent republishes assets on ASSETS stream, we get datacenters thanks to our consumer patterns
+    zmsg_t* msg = zmsg_new();
+    zmsg_addstr(msg, "$all");
+    int rv = mlm_client_sendto(client, agent, "REPUBLISH", nullptr, 5000, &msg);
+    if (rv == -1)
+        log_error("%s: can't request REPUBLISH from '%s', waiting for the stream", server->name, agent);
+    else
+        log_info("%s: bootstrap requested from '%s'", server->name, agent);
+}
+
+// return msec until bootstrap window closes, -1 if there is no bootstrap in progress
+static int64_t s_bootstrap_timeout(fty_kpi_power_uptime_server_t* server)
+{
+    if (!server->bootstrap)
+        return -1;
+
+    int64_t close = server->bootstrap_deadline;
+    if (server->bootstrap_last != 0 && server->bootstrap_last + BOOTSTRAP_QUIET_MS < close)
+        close = server->bootstrap_last + BOOTSTRAP_QUIET_MS;
+
+    int64_t timeout = close - zclock_mono();
+    return timeout > 0 ? timeout : 0;
+}
+
+static void s_bootstrap_finish(fty_kpi_power_uptime_server_t* server)
+{
+    size_t dcs = zhashx_size(server->bootstrap);
+    upt_add_bulk(server->upt, server->bootstrap);
+    s_forget_left(server);
 
     uint64_t total, offline;
-    // recalculate total/offline when we get the metric
-    upt_uptime(server->upt, dc_name, &total, &offline);
+    for (zlistx_t* ups = reinterpret_cast<zlistx_t*>(zhashx_first(server->bootstrap)); ups != nullptr;
+         ups           = reinterpret_cast<zlistx_t*>(zhashx_next(server->bootstrap))) {
+        const char* dc_name = reinterpret_cast<const char*>(zhashx_cursor(server->bootstrap));
+        if (server->shard_count != 0)
+            upt_shard_topology(server->shards[upt_shard_of(dc_name, server->shard_count)], dc_name, ups);
+        else
+            upt_uptime(server->upt, dc_name, &total, &offline);
+    }
+    zhashx_destroy(&server->bootstrap);
+    server->dirty = true;
+
+    // seed UPS status now instead of waiting for the first polling interval
+    fty_kpi_power_uptime_server_poll_metrics(server);
+    s_replica_snapshot(server);
+
+    server->bootstrap_ms = zclock_mono() - server->started;
+    log_info("%s: bootstrap applied %zu datacenters, accurate state after %" PRIi64 " ms", server->name, dcs,
+        server->bootstrap_ms);
 }
 
+// the window may close later than planned when datacenters keep coming
+static void s_bootstrap_timer(void* arg)
+{
+    fty_kpi_power_uptime_server_t* server = reinterpret_cast<fty_kpi_power_uptime_server_t*>(arg);
+    if (!server->bootstrap)
+        return;
+    int64_t timeout = s_bootstrap_timeout(server);
+    if (timeout > 0)
+        upt_sched_arm_in(server->sched, server->bootstrap_task, timeout);
+    else
+        s_bootstrap_finish(server);
+}
+
+struct s_reader_args_t
+{
+    upt_snapshot_t** snapshots;
+    size_t           count;
+};
+
+static void s_reader_uptime(s_reader_args_t* args, mlm_client_t* client, const char* sender, zmsg_t* msg)
+{
+    char* dc_name = zmsg_popstr(msg);
+    if (!dc_name) {
+        mlm_client_sendtox(client, sender, "UPTIME", "UPTIME", "ERROR", "Invalid request: missing DC name", nullptr);
+        return;
+    }
+
+    upt_snapshot_t* snapshot = args->snapshots[upt_shard_of(dc_name, args->count)];
+    uint64_t        total, offline, unknown, durations[DC_STATE_COUNT] = {};
+    int             r = upt_snapshot_uptime(snapshot, 0, dc_name, &total, &offline, &unknown);
+    if (r == -1) {
+        mlm_client_sendtox(
+            client, sender, "UPTIME", "UPTIME", "ERROR", "Invalid request: DC name is not known", nullptr);
+    } else {
+        upt_snapshot_durations(snapshot, 0, dc_name, durations);
+        s_send_uptime(client, sender, total, offline, unknown, durations);
+    }
+    zstr_free(&dc_name);
+}
 
-void fty_kpi_power_metric_pull(zsock_t* pipe, void* args)
+// owns the mailbox of the agent, UPTIME requests without a baseline are answered from snapshots, everything
+// else is forwarded to the server as MAILBOX/sender/subject/frames...
+static void s_reader(zsock_t* pipe, void* args)
 {
-    zpoller_t* poller = zpoller_new(pipe, nullptr);
+    s_reader_args_t* reader = reinterpret_cast<s_reader_args_t*>(args);
+    mlm_client_t*    client = mlm_client_new();
+    zpoller_t*       poller = zpoller_new(pipe, mlm_client_msgpipe(client), nullptr);
     zsock_signal(pipe, 0);
 
-    fty_kpi_power_uptime_server_t* server  = reinterpret_cast<fty_kpi_power_uptime_server_t*>(args);
-    uint64_t                       timeout = uint64_t(fty_get_polling_interval() * 1000);
     while (!zsys_interrupted) {
-        void* which = zpoller_wait(poller, int(timeout));
-        if (which == nullptr) {
-            if (zpoller_terminated(poller) || zsys_interrupted) {
+        void* which = zpoller_wait(poller, -1);
+        if (which == nullptr)
+            break;
+
+        if (which == pipe) {
+            zmsg_t* msg = zmsg_recv(pipe);
+            char*   cmd = zmsg_popstr(msg);
+            if (cmd && streq(cmd, "$TERM")) {
+                zstr_free(&cmd);
+                zmsg_destroy(&msg);
                 break;
+            } else if (cmd && streq(cmd, "CONNECT")) {
+                char* endpoint = zmsg_popstr(msg);
+                char* address  = zmsg_popstr(msg);
+                if (mlm_client_connect(client, endpoint, 1000, address) == -1)
+                    log_error("reader: can't connect to malamute endpoint '%s'", endpoint);
+                zstr_free(&endpoint);
+                zstr_free(&address);
+                zsock_signal(pipe, 0);
             }
-            if (zpoller_expired(poller)) {
-                fty::shm::shmMetrics result;
-                fty::shm::read_metrics(".*", "^status\\.ups|^status", result);
-                log_debug("metric reads : %d", result.size());
+            zstr_free(&cmd);
+            zmsg_destroy(&msg);
+            continue;
+        }
 
-                for (auto& element : result) {
-                    s_handle_metric(server, nullptr, element);
-                }
-            }
-        } else if (which == pipe) {
-            zmsg_t* message = zmsg_recv(pipe);
-            if (message) {
-                char* cmd = zmsg_popstr(message);
-                if (cmd) {
-                    if (streq(cmd, "$TERM")) {
-                        zstr_free(&cmd);
-                        zmsg_destroy(&message);
-                        break;
-                    }
-                    zstr_free(&cmd);
-                }
-                zmsg_destroy(&message);
-            }
+        zmsg_t* msg = mlm_client_recv(client);
+        if (!msg)
+            continue;
+        if (!streq(mlm_client_command(client), "MAILBOX DELIVER")) {
+            zmsg_destroy(&msg);
+            continue;
+        }
+
+        // counters since a baseline are known to the server only
+        char* command = zmsg_popstr(msg);
+        if (command && streq(command, "UPTIME") && zmsg_size(msg) < 2) {
+            s_reader_uptime(reader, client, mlm_client_sender(client), msg);
+            zmsg_destroy(&msg);
+        } else {
+            if (command)
+                zmsg_pushstr(msg, command);
+            zmsg_pushstr(msg, mlm_client_subject(client));
+            zmsg_pushstr(msg, mlm_client_sender(client));
+            zmsg_pushstr(msg, "MAILBOX");
+            zmsg_send(&msg, pipe);
         }
-        timeout = uint64_t(fty_get_polling_interval() * 1000);
+        zstr_free(&command);
     }
+
     zpoller_destroy(&poller);
+    mlm_client_destroy(&client);
+    free(reader);
+}
+
+static void s_reader_start(fty_kpi_power_uptime_server_t* server)
+{
+    server->snapshot_count = server->shard_count != 0 ? server->shard_count : 1;
+    server->snapshots =
+        reinterpret_cast<upt_snapshot_t**>(zmalloc(server->snapshot_count * sizeof(upt_snapshot_t*)));
+    for (size_t i = 0; i != server->snapshot_count; i++) {
+        server->snapshots[i] = upt_snapshot_new(1);
+        if (server->shard_count != 0)
+            upt_shard_publish(server->shards[i], server->snapshots[i]);
+    }
+    if (server->shard_count == 0)
+        upt_snapshot_publish(server->snapshots[0], server->upt);
+
+    s_reader_args_t* args = reinterpret_cast<s_reader_args_t*>(zmalloc(sizeof(s_reader_args_t)));
+    args->snapshots       = server->snapshots;
+    args->count           = server->snapshot_count;
+    server->reader        = zactor_new(s_reader, args);
+}
+
+// make changes visible to the reader, shards publish on their own
+static void s_publish(fty_kpi_power_uptime_server_t* server)
+{
+    if (server->snapshots && server->shard_count == 0 && server->dirty)
+        upt_snapshot_publish(server->snapshots[0], server->upt);
+    server->dirty = false;
+}
+
+// take everything malamute has for us (up to DRAIN_MAX) and sort it by traffic class
+static void s_drain(fty_kpi_power_uptime_server_t* server, mlm_client_t* client)
+{
+    size_t count = 0;
+    do {
+        zmsg_t* msg = mlm_client_recv(client);
+        if (!msg)
+            break;
+
+        upt_trace("malamute.recv", "%s: command=%s sender=%s subject=%s", server->name, mlm_client_command(client),
+            mlm_client_sender(client), mlm_client_subject(client));
+
+        fty_kpi_power_uptime_queue_t* queue = nullptr;
+        if (streq(mlm_client_command(client), "MAILBOX DELIVER"))
+            queue = &server->queries;
+        else if (streq(mlm_client_command(client), "STREAM DELIVER"))
+            queue = &server->stream;
+        else {
+            zmsg_destroy(&msg);
+            continue;
+        }
+
+        s_pending_t* pending = reinterpret_cast<s_pending_t*>(zmalloc(sizeof(s_pending_t)));
+        pending->sender      = strdup(mlm_client_sender(client));
+        pending->subject     = strdup(mlm_client_subject(client));
+        pending->msg         = msg;
+        pending->enqueued    = zclock_usecs();
+        zlistx_add_end(queue->pending, pending);
+        if (zlistx_size(queue->pending) > queue->max_depth)
+            queue->max_depth = zlistx_size(queue->pending);
+    } while (++count < DRAIN_MAX && (zsock_events(mlm_client_msgpipe(client)) & ZMQ_POLLIN));
+}
+
+// remove the oldest message from the queue and account the time it waited
+static s_pending_t* s_queue_pop(fty_kpi_power_uptime_queue_t* queue)
+{
+    s_pending_t* pending = reinterpret_cast<s_pending_t*>(zlistx_detach(queue->pending, nullptr));
+    if (!pending)
+        return nullptr;
+
+    uint64_t latency = uint64_t(zclock_usecs() - pending->enqueued);
+    queue->served++;
+    queue->latency_sum_us += latency;
+    if (latency > queue->latency_max_us)
+        queue->latency_max_us = latency;
+    return pending;
+}
+
+// locations and upses are placed in the tree under the closest parent of their asset, return
+// false for other assets
+static bool s_set_tree(fty_kpi_power_uptime_server_t* server, fty_proto_t* fmsg)
+{
+    const char* name    = fty_proto_name(fmsg);
+    const char* type    = fty_proto_aux_string(fmsg, "type", "null");
+    const char* subtype = fty_proto_aux_string(fmsg, "subtype", "null");
+    const char* parent  = fty_proto_aux_string(fmsg, "parent_name.1", nullptr);
+    bool        ups     = streq(type, "device") && streq(subtype, "ups");
+    if (!name || !(ups || streq(type, "datacenter") || streq(type, "room") || streq(type, "row") || streq(type, "rack")))
+        return false;
+
+    if (streq(fty_proto_operation(fmsg), FTY_PROTO_ASSET_OP_DELETE))
+        upt_tree_remove(server->tree, name);
+    else if (ups)
+        upt_tree_set_ups(server->tree, name, parent);
+    else if (upt_tree_set_node(server->tree, name, type, parent) == -1)
+        log_warning("%s: %s can't be placed under %s", server->name, name, parent ? parent : UPT_TREE_ROOT);
+    upt_trace("asset.tree", "%s: name=%s type=%s parent=%s", server->name, name, type, parent ? parent : "");
+    return true;
+}
+
+static void s_handle_stream(fty_kpi_power_uptime_server_t* server, mlm_client_t* client, zmsg_t** msg_p)
+{
+    if (server->replica_sub) {
+        // state of a follower comes from the leader only
+        zmsg_destroy(msg_p);
+        return;
+    }
+    fty_proto_t* bmsg = fty_proto_decode(msg_p);
+    if (!bmsg) {
+        log_warning("Not fty proto, skipping");
+        server->stats->msg_invalid++;
+    } else if (fty_proto_id(bmsg) == FTY_PROTO_METRIC) {
+        server->stats->msg_metric++;
+        server->stats->metrics_read++;
+        s_handle_metric(server, client, bmsg);
+    } else if (fty_proto_id(bmsg) == FTY_PROTO_ASSET) {
+        server->stats->msg_asset++;
+        bool placed = s_set_tree(server, bmsg);
+        if (streq(fty_proto_aux_string(bmsg, "type", "null"), "datacenter")) {
+            s_set_dc_upses(server, bmsg);
+        } else if (!placed)
+            upt_trace("asset.ignored", "%s: type=%s", server->name, fty_proto_aux_string(bmsg, "type", "null"));
+    } else {
+        log_warning("%s: recieved invalid message", server->name);
+        server->stats->msg_invalid++;
+    }
+    fty_proto_destroy(&bmsg);
+}
+
+static void s_count_request(fty_kpi_power_uptime_server_t* server)
+{
+    if ((server->request_counter++) % 100 == 0) {
+        log_debug("%s: saving the state", server->name);
+        fty_kpi_power_uptime_server_save_state(server);
+    }
+}
+
+// serve all waiting queries, then at most STREAM_BATCH stream messages
+static void s_serve(fty_kpi_power_uptime_server_t* server, mlm_client_t* client)
+{
+    for (s_pending_t* pending = s_queue_pop(&server->queries); pending != nullptr;
+         pending              = s_queue_pop(&server->queries)) {
+        s_count_request(server);
+        s_handle_mailbox(server, client, pending->sender, pending->msg);
+        upt_stats_histogram_add(&server->stats->query, uint64_t(zclock_usecs() - pending->enqueued));
+        s_pending_destructor(reinterpret_cast<void**>(&pending));
+    }
+
+    size_t batch = 0;
+    for (s_pending_t* pending = s_queue_pop(&server->stream); pending != nullptr;
+         pending              = s_queue_pop(&server->stream)) {
+        s_count_request(server);
+        s_handle_stream(server, client, &pending->msg);
+        s_pending_destructor(reinterpret_cast<void**>(&pending));
+        if (++batch == STREAM_BATCH)
+            break;
+    }
+    s_shards_flush(server);
+    s_expire_arm(server);
+}
+
+static void s_queue_report(zmsg_t* reply, const char* name, fty_kpi_power_uptime_queue_t* queue)
+{
+    zmsg_addstrf(reply, "%s.depth", name);
+    zmsg_addstrf(reply, "%zu", zlistx_size(queue->pending));
+    zmsg_addstrf(reply, "%s.max_depth", name);
+    zmsg_addstrf(reply, "%" PRIu64, queue->max_depth);
+    zmsg_addstrf(reply, "%s.served", name);
+    zmsg_addstrf(reply, "%" PRIu64, queue->served);
+    zmsg_addstrf(reply, "%s.latency_avg_us", name);
+    zmsg_addstrf(reply, "%" PRIu64, queue->served ? queue->latency_sum_us / queue->served : 0);
+    zmsg_addstrf(reply, "%s.latency_max_us", name);
+    zmsg_addstrf(reply, "%" PRIu64, queue->latency_max_us);
+}
+
+zmsg_t* fty_kpi_power_uptime_server_stats(fty_kpi_power_uptime_server_t* self)
+{
+    assert(self);
+
+    // transitions of sharded state are counted by the shards
+    upt_stats_t stats = *self->stats;
+    for (size_t i = 0; i != self->shard_count; i++) {
+        stats.transitions += upt_shard_transitions(self->shards[i]);
+    }
+    if (self->debounce) {
+        stats.flaps += self->debounce->flaps;
+        stats.debounced += self->debounce->delayed;
+    }
+    if (self->stale)
+        stats.stale += self->stale->expired;
+
+    zmsg_t* reply = zmsg_new();
+    upt_stats_report(&stats, reply);
+    s_queue_report(reply, "queries", &self->queries);
+    s_queue_report(reply, "stream", &self->stream);
+    zmsg_addstr(reply, "datacenters");
+    zmsg_addstrf(reply, "%zu", zhashx_size(self->upt->dc));
+    zmsg_addstr(reply, "upses");
+    zmsg_addstrf(reply, "%zu", zhashx_size(self->upt->ups2dc));
+    zmsg_addstr(reply, "bootstrap_ms");
+    zmsg_addstrf(reply, "%" PRIi64, self->bootstrap_ms);
+    upt_sched_report(self->sched, reply);
+    if (self->replica)
+        upt_replica_report(self->replica, reply);
+    if (self->table) {
+        zmsg_addstr(reply, "table.slots");
+        zmsg_addstrf(reply, "%zu", upt_table_size(self->table));
+        zmsg_addstr(reply, "table.syncs");
+        zmsg_addstrf(reply, "%" PRIu64, self->table_syncs);
+    }
+    return reply;
+}
+
+static void s_stats_dump(fty_kpi_power_uptime_server_t* server)
+{
+    zmsg_t* report = fty_kpi_power_uptime_server_stats(server);
+    upt_stats_dump(report, server->stats_file);
+    zmsg_destroy(&report);
+}
+
+static void s_stats_timer(void* arg)
+{
+    fty_kpi_power_uptime_server_t* server = reinterpret_cast<fty_kpi_power_uptime_server_t*>(arg);
+    if (server->stats_file)
+        s_stats_dump(server);
 }
 
 //  Server as an actor
@@ -279,9 +1653,59 @@ void fty_kpi_power_uptime_server(zsock_t* pipe, void* args)
 
     zpoller_t* poller = zpoller_new(pipe, mlm_client_msgpipe(client), nullptr);
     zsock_signal(pipe, 0);
-    zactor_t* kpi_power_metric_pull = zactor_new(fty_kpi_power_metric_pull, server);
+    upt_sched_arm_in(server->sched, server->poll_task, int64_t(fty_get_polling_interval()) * 1000);
     while (!zsys_interrupted) {
-        void* which = zpoller_wait(poller, -1);
+        upt_sched_run(server->sched);
+        s_serve(server, client);
+        s_publish(server);
+        s_replica_flush(server);
+        if (server->table_dirty && server->table_sync == TABLE_SYNC_ALWAYS)
+            s_table_sync(server);
+
+        // sleep until the next deadline, with stream messages still waiting only look whether
+        // something more urgent came
+        int64_t timeout = upt_sched_timeout(server->sched);
+        if (zlistx_size(server->stream.pending) != 0)
+            timeout = 0;
+        void* which = zpoller_wait(poller, int(timeout));
+        server->stats->wakeups++;
+        if (which == nullptr) {
+            if (zpoller_terminated(poller) || zsys_interrupted)
+                break;
+            continue;
+        }
+
+        if (server->replica_sub && which == server->replica_sub) {
+            zmsg_t* msg = zmsg_recv(server->replica_sub);
+            if (upt_replica_apply(server->replica, &server->upt, &msg) == 0)
+                server->dirty = true;
+            continue;
+        }
+
+        if (server->replica_pub && which == server->replica_pub) {
+            // a follower subscribed, give it something to start from
+            zframe_t* frame = zframe_recv(server->replica_pub);
+            if (frame && zframe_size(frame) > 0 && zframe_data(frame)[0] == 1)
+                s_replica_snapshot(server);
+            zframe_destroy(&frame);
+            continue;
+        }
+
+        if (server->reader && which == server->reader) {
+            // mailbox request the reader does not answer itself
+            zmsg_t* msg     = zmsg_recv(server->reader);
+            char*   cmd     = zmsg_popstr(msg);
+            char*   sender  = zmsg_popstr(msg);
+            char*   subject = zmsg_popstr(msg);
+            if (cmd && streq(cmd, "MAILBOX") && sender)
+                s_handle_mailbox(server, client, sender, msg);
+            zstr_free(&cmd);
+            zstr_free(&sender);
+            zstr_free(&subject);
+            zmsg_destroy(&msg);
+            continue;
+        }
+
         if (which == pipe) {
             zmsg_t* msg = zmsg_recv(pipe);
             char*   cmd = zmsg_popstr(msg);
@@ -300,11 +1724,26 @@ void fty_kpi_power_uptime_server(zsock_t* pipe, void* args)
                 goto exit;
             } else if (streq(cmd, "CONNECT")) {
                 char* endpoint = zmsg_popstr(msg);
-                int   rv       = mlm_client_connect(client, endpoint, 1000, name);
+                int   rv       = 0;
+                if (server->reader) {
+                    // reader owns the mailbox address
+                    char* address = zsys_sprintf("%s-stream", name);
+                    rv            = mlm_client_connect(client, endpoint, 1000, address);
+                    zstr_free(&address);
+                    zstr_sendx(server->reader, "CONNECT", endpoint, name, nullptr);
+                    zsock_wait(server->reader);
+                } else
+                    rv = mlm_client_connect(client, endpoint, 1000, name);
                 if (rv == -1)
                     log_error("%s: can't connect to malamute endpoint '%s'", name, endpoint);
                 zstr_free(&endpoint);
                 zsock_signal(pipe, 0);
+            } else if (streq(cmd, "READER")) {
+                if (!server->reader) {
+                    s_reader_start(server);
+                    zpoller_add(poller, server->reader);
+                }
+                zsock_signal(pipe, 0);
             } else if (streq(cmd, "CONSUMER")) {
                 char* stream  = zmsg_popstr(msg);
                 char* pattern = zmsg_popstr(msg);
@@ -327,65 +1766,219 @@ void fty_kpi_power_uptime_server(zsock_t* pipe, void* args)
                 }
                 zstr_free(&dir);
                 zsock_signal(pipe, 0);
+            } else if (streq(cmd, "SHARDS")) {
+                char* count = zmsg_popstr(msg);
+                fty_kpi_power_uptime_server_set_shards(server, count ? size_t(atoi(count)) : 0);
+                zstr_free(&count);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "CLOCK")) {
+                zframe_t* frame = zmsg_pop(msg);
+                if (frame && zframe_size(frame) == sizeof(void*)) {
+                    upt_clock_t* clock = nullptr;
+                    memcpy(&clock, zframe_data(frame), sizeof(void*));
+                    fty_kpi_power_uptime_server_set_clock(server, clock);
+                } else
+                    log_error("%s: CLOCK: missing clock", name);
+                zframe_destroy(&frame);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "POLL")) {
+                if (!server->replica_sub)
+                    fty_kpi_power_uptime_server_poll_metrics(server);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "UPTIME")) {
+                char*    dc_name = zmsg_popstr(msg);
+                uint64_t total = 0, offline = 0, unknown = 0;
+                int      r     = -1;
+                if (dc_name && server->shard_count != 0)
+                    r = upt_shard_uptime(
+                        server->shards[upt_shard_of(dc_name, server->shard_count)], dc_name, &total, &offline);
+                else if (dc_name)
+                    r = upt_uptime(server->upt, dc_name, &total, &offline);
+                if (r == 0)
+                    upt_unknown(server->upt, dc_name, &unknown);
+                zsock_send(pipe, "i888", r, total, offline, unknown);
+                zstr_free(&dc_name);
+            } else if (streq(cmd, "DURATIONS")) {
+                char*    dc_name                   = zmsg_popstr(msg);
+                uint64_t durations[DC_STATE_COUNT] = {};
+                int      r                         = -1;
+                if (dc_name && server->shard_count != 0)
+                    r = upt_shard_durations(
+                        server->shards[upt_shard_of(dc_name, server->shard_count)], dc_name, durations);
+                else if (dc_name)
+                    r = upt_durations(server->upt, dc_name, durations);
+                zsock_send(pipe, "ib", r, durations, sizeof(durations));
+                zstr_free(&dc_name);
+            } else if (streq(cmd, "TABLE")) {
+                char* path       = zmsg_popstr(msg);
+                char* s_capacity = zmsg_popstr(msg);
+                char* s_sync     = zmsg_popstr(msg);
+                int   sync       = TABLE_SYNC_SAVE;
+                if (s_sync && streq(s_sync, "none"))
+                    sync = TABLE_SYNC_NONE;
+                else if (s_sync && streq(s_sync, "always"))
+                    sync = TABLE_SYNC_ALWAYS;
+                else if (s_sync && !streq(s_sync, "save"))
+                    log_warning("%s: TABLE: unknown sync policy '%s', using 'save'", name, s_sync);
+                if (!path)
+                    log_error("%s: TABLE: missing path", name);
+                else
+                    s_table_start(server, path, s_capacity ? size_t(atol(s_capacity)) : 4096, sync);
+                zstr_free(&path);
+                zstr_free(&s_capacity);
+                zstr_free(&s_sync);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "DOWNTIME")) {
+                char* policy  = zmsg_popstr(msg);
+                char* s_clamp = zmsg_popstr(msg);
+                if (policy && streq(policy, "unknown"))
+                    server->gap_policy = DC_GAP_UNKNOWN;
+                else if (policy && streq(policy, "assume"))
+                    server->gap_policy = DC_GAP_ASSUME;
+                else if (policy && streq(policy, "clamp") && s_clamp) {
+                    server->gap_policy = DC_GAP_CLAMP;
+                    server->gap_clamp  = atoll(s_clamp);
+                } else
+                    log_error("%s: DOWNTIME: expected unknown, assume or clamp seconds", name);
+                zstr_free(&policy);
+                zstr_free(&s_clamp);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "DEBOUNCE")) {
+                char* s_offline = zmsg_popstr(msg);
+                char* s_online  = zmsg_popstr(msg);
+                if (!s_offline || !s_online)
+                    log_error("%s: DEBOUNCE: expected offline and online dwell (msec)", name);
+                else
+                    fty_kpi_power_uptime_server_set_debounce(server, atoll(s_offline), atoll(s_online));
+                zstr_free(&s_offline);
+                zstr_free(&s_online);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "STALE")) {
+                char* s_ttl = zmsg_popstr(msg);
+                if (!s_ttl)
+                    log_error("%s: STALE: expected ttl (msec)", name);
+                else
+                    fty_kpi_power_uptime_server_set_stale(server, atoll(s_ttl));
+                zstr_free(&s_ttl);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "FEDERATION")) {
+                char* source = zmsg_popstr(msg);
+                if (!source)
+                    log_error("%s: FEDERATION: missing source name", name);
+                else
+                    s_federation_start(server, source);
+                zstr_free(&source);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "REPLICATE")) {
+                char* endpoint   = zmsg_popstr(msg);
+                char* s_interval = zmsg_popstr(msg);
+                if (!endpoint || server->replica_pub || server->replica_sub)
+                    log_error("%s: REPLICATE: missing endpoint, or already replicating or following", name);
+                else {
+                    server->replica_pub = zsock_new_xpub(endpoint);
+                    if (!server->replica_pub)
+                        log_error("%s: REPLICATE: can't bind %s", name, endpoint);
+                    else {
+                        // every subscription is reported, so every new follower gets a snapshot
+                        zsock_set_xpub_verbose(server->replica_pub, 1);
+                        upt_replica_destroy(&server->replica);
+                        server->replica          = upt_replica_new();
+                        server->replica_dirty    = zhashx_new();
+                        server->replica_interval = s_interval ? atoll(s_interval) : 10000;
+                        if (server->replica_interval <= 0)
+                            server->replica_interval = 10000;
+                        upt_sched_arm_in(server->sched, server->replica_task, 0);
+                        zpoller_add(poller, server->replica_pub);
+                        log_info("%s: replicating state to %s", name, endpoint);
+                    }
+                }
+                zstr_free(&endpoint);
+                zstr_free(&s_interval);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "FOLLOW")) {
+                char* endpoint = zmsg_popstr(msg);
+                if (!endpoint || server->replica_pub || server->replica_sub)
+                    log_error("%s: FOLLOW: missing endpoint, or already replicating or following", name);
+                else {
+                    // replicated state is one upt, shards would only get stale
+                    fty_kpi_power_uptime_server_set_shards(server, 0);
+                    server->replica_sub = zsock_new_sub(endpoint, UPT_REPLICA_TOPIC);
+                    if (!server->replica_sub)
+                        log_error("%s: FOLLOW: can't connect %s", name, endpoint);
+                    else {
+                        upt_replica_destroy(&server->replica);
+                        server->replica = upt_replica_new();
+                        zpoller_add(poller, server->replica_sub);
+                        log_info("%s: following %s", name, endpoint);
+                    }
+                }
+                zstr_free(&endpoint);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "PROMOTE")) {
+                if (server->replica_sub) {
+                    zpoller_remove(poller, server->replica_sub);
+                    zsock_destroy(&server->replica_sub);
+                    log_info("%s: promoted, last replicated message %" PRIu64 "%s", name, server->replica->seq,
+                        server->replica->synced ? "" : " (out of sync)");
+                    fty_kpi_power_uptime_server_poll_metrics(server);
+                    fty_kpi_power_uptime_server_save_state(server);
+                }
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "STATS")) {
+                zmsg_t* reply = fty_kpi_power_uptime_server_stats(server);
+                zmsg_send(&reply, pipe);
+            } else if (streq(cmd, "STATS-FILE")) {
+                char* file       = zmsg_popstr(msg);
+                char* s_interval = zmsg_popstr(msg);
+                zstr_free(&server->stats_file);
+                server->stats_file     = file;
+                server->stats_interval = s_interval ? atoll(s_interval) : 60000;
+                if (server->stats_interval <= 0)
+                    server->stats_interval = 60000;
+                upt_sched_every(server->sched, server->stats_task, server->stats_interval);
+                zstr_free(&s_interval);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "TRACE")) {
+                char* s_mode = zmsg_popstr(msg);
+                char* s_rate = zmsg_popstr(msg);
+                int   mode   = upt_trace_parse(s_mode);
+                if (mode == -1)
+                    log_error("%s: TRACE: unknown mode %s", name, s_mode ? s_mode : "(null)");
+                else
+                    upt_trace_set_mode(upt_trace_mode_t(mode), s_rate ? uint32_t(atoi(s_rate)) : 10);
+                zstr_free(&s_mode);
+                zstr_free(&s_rate);
+                zsock_signal(pipe, 0);
+            } else if (streq(cmd, "QUEUES")) {
+                zmsg_t* reply = zmsg_new();
+                s_queue_report(reply, "queries", &server->queries);
+                s_queue_report(reply, "stream", &server->stream);
+                zmsg_send(&reply, pipe);
+            } else if (streq(cmd, "BOOTSTRAP")) {
+                char*   agent     = zmsg_popstr(msg);
+                char*   s_timeout = zmsg_popstr(msg);
+                int64_t timeout   = s_timeout ? atoll(s_timeout) : 5000;
+                if (!agent)
+                    log_error("%s: BOOTSTRAP: asset agent address is null", name);
+                else
+                    s_bootstrap_start(server, client, agent, timeout);
+                zstr_free(&agent);
+                zstr_free(&s_timeout);
+                zsock_signal(pipe, 0);
             }
             zstr_free(&cmd);
             zmsg_destroy(&msg);
             continue;
         } // which == pipe
 
-        log_debug("%s: handling the protocol", name);
-        zmsg_t* msg = mlm_client_recv(client);
-        if (!msg)
-            continue;
-
-
-        log_debug("%s:\tcommand=%s", name, mlm_client_command(client));
-        log_debug("%s:\tsender=%s", name, mlm_client_sender(client));
-        log_debug("%s:\tsubject=%s", name, mlm_client_subject(client));
-
-
-        if ((server->request_counter++) % 100 == 0) {
-
-            log_debug("%s: saving the state", name);
-            fty_kpi_power_uptime_server_save_state(server);
-        }
-
-        if (streq(mlm_client_command(client), "MAILBOX DELIVER")) {
-            char* command = zmsg_popstr(msg);
-            log_debug("%s:\tproto-command=%s", name, command);
-            if (!command) {
-                zmsg_destroy(&msg);
-                mlm_client_sendtox(client, mlm_client_sender(client), "UPTIME", "ERROR", "Unknown command", nullptr);
-            } else if (streq(command, "UPTIME")) {
-                s_handle_uptime(server, client, msg);
-            } else {
-                mlm_client_sendtox(client, mlm_client_sender(client), "UPTIME", "ERROR", "Unknown command", nullptr);
-            }
-            zstr_free(&command);
-        } else if (streq(mlm_client_command(client), "STREAM DELIVER")) {
-            fty_proto_t* bmsg = fty_proto_decode(&msg);
-            if (!bmsg) {
-                log_warning("Not fty proto, skipping");
-            } else if (fty_proto_id(bmsg) == FTY_PROTO_METRIC) {
-                s_handle_metric(server, client, bmsg);
-            } else if (fty_proto_id(bmsg) == FTY_PROTO_ASSET) {
-                if (streq(fty_proto_aux_string(bmsg, "type", "null"), "datacenter")) {
-                    s_set_dc_upses(server, bmsg);
-                } else
-                    log_debug("%s: invalid asset type: %s", server->name, fty_proto_aux_string(bmsg, "type", "null"));
-            } else {
-                log_warning("%s: recieved invalid message", server->name);
-            }
-            fty_proto_destroy(&bmsg);
-        }
-
-        zmsg_destroy(&msg);
+        upt_trace("loop.drain", "%s", name);
+        s_drain(server, client);
     }
 exit:
     ret = fty_kpi_power_uptime_server_save_state(server);
     if (ret != 0)
         log_error("failed to save state to %s", server->dir);
-    zactor_destroy(&kpi_power_metric_pull);
+    zactor_destroy(&server->reader);
     zpoller_destroy(&poller);
     mlm_client_destroy(&client);
     fty_kpi_power_uptime_server_destroy(&server);
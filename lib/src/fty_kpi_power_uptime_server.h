@@ -21,15 +21,76 @@
 
 #pragma once
 #include "upt.h"
+#include "upt_baseline.h"
+#include "upt_debounce.h"
+#include "upt_federation.h"
+#include "upt_stale.h"
+#include "upt_replica.h"
+#include "upt_sched.h"
+#include "upt_snapshot.h"
+#include "upt_stats.h"
+#include "upt_tree.h"
 #include <czmq.h>
 #include <fty_proto.h>
 
+// traffic class of malamute messages waiting in the server
+struct fty_kpi_power_uptime_queue_t
+{
+    zlistx_t* pending;        // messages waiting to be served, oldest first
+    uint64_t  served;         // messages served so far
+    uint64_t  max_depth;      // the longest the queue has been
+    uint64_t  latency_sum_us; // sum of time spent in the queue
+    uint64_t  latency_max_us; // the longest time spent in the queue
+};
+
 struct fty_kpi_power_uptime_server_t
 {
-    int    request_counter;
-    upt_t* upt;
-    char*  dir;
-    char*  name;
+    int       request_counter;
+    upt_t*    upt;
+    char*     dir;
+    char*     name;
+    zhashx_t* bootstrap;          // dc name -> zlistx_t of upses staged during bootstrap, nullptr otherwise
+    int64_t   bootstrap_deadline; // zclock_mono() when the bootstrap window closes at the latest
+    int64_t   bootstrap_last;     // zclock_mono() of the last staged datacenter, 0 if none yet
+    int64_t   started;            // zclock_mono() when the server was created
+    int64_t   bootstrap_ms;       // time to accurate state measured at startup, -1 until bootstrapped
+    zactor_t** shards;            // upt_shard actors owning slices of state, nullptr when not sharded
+    size_t     shard_count;       // number of shards, 0 when not sharded
+    zmsg_t**   shard_batch;       // pending ups statuses for each shard
+    upt_snapshot_t** snapshots;   // counters published for the reader, one per shard (or one), nullptr if no reader
+    size_t           snapshot_count;
+    zactor_t*        reader;      // thread answering UPTIME requests from snapshots, nullptr if disabled
+    bool             dirty;       // state changed since the last publication
+    fty_kpi_power_uptime_queue_t queries; // MAILBOX DELIVER, always served first
+    fty_kpi_power_uptime_queue_t stream;  // STREAM DELIVER, processed in bounded batches
+    upt_stats_t* stats;          // runtime statistics
+    char*        stats_file;     // file statistics are periodically dumped to, nullptr if disabled
+    int64_t      stats_interval; // msec between two dumps
+    upt_replica_t* replica;          // replication state, nullptr unless leader or follower
+    zsock_t*       replica_pub;      // XPUB the state is streamed to, leader only
+    zsock_t*       replica_sub;      // SUB the state is received from, follower only
+    zhashx_t*      replica_dirty;    // names of datacenters changed since the last delta
+    int64_t        replica_interval; // msec between two snapshots
+    upt_federation_t* federation;        // mergeable availability record, nullptr if disabled
+    int64_t           federation_offset; // msec from the clock of the state to the wall clock
+    upt_table_t*      table;             // memory mapped counters, nullptr if disabled
+    int               table_sync;        // when the table is flushed to disk, TABLE_SYNC_*
+    bool              table_dirty;       // counters changed since the last flush
+    uint64_t          table_syncs;       // number of flushes
+    dc_gap_policy_t   gap_policy;        // how time the agent was not running is accounted at load
+    int64_t           gap_clamp;         // seconds assumed by DC_GAP_CLAMP
+    upt_debounce_t*   debounce;          // dwell of ups status changes, nullptr if disabled
+    upt_stale_t*      stale;             // expiry of upses which stopped reporting, nullptr if disabled
+    upt_tree_t*       tree;              // rollups of rooms, rows, racks and the estate
+    upt_baseline_t*   baselines;         // named baselines of counters of datacenters
+    upt_sched_t*      sched;             // deadlines of the periodic work of the server loop
+    upt_sched_task_t* poll_task;         // read of shm every polling interval
+    upt_sched_task_t* expire_task;       // debounce and stale timers
+    upt_sched_task_t* bootstrap_task;    // close of the bootstrap window
+    upt_sched_task_t* stats_task;        // dump of statistics to stats_file
+    upt_sched_task_t* replica_task;      // snapshot of the state for followers
+    zlistx_t*         exports;           // EXPORT requests in progress, oldest first
+    upt_sched_task_t* export_task;       // next batch of every export
 };
 
 //  Create new fty-kpi-power-uptime instance.
@@ -53,6 +114,104 @@ struct fty_kpi_power_uptime_server_t
 //      zsock_sendx (server, "CONFIG", "src/", NULL);
 //      zsock_wait (server);
 //
+//  Partition datacenters over N worker threads (N < 2 disables sharding), upt of the server then
+//  only routes upses to shards, the accounting itself is owned by the shards
+//      zsock_sendx (server, "SHARDS", "4", NULL);
+//      zsock_wait (server);
+//
+//  Answer UPTIME requests from a dedicated reader thread, reading immutable snapshots of the
+//  counters, so queries never wait behind ingestion or state saves. Must be sent before CONNECT,
+//  reader then owns the malamute address and the server connects as '<address>-stream'.
+//      zsock_sendx (server, "READER", NULL);
+//      zsock_wait (server);
+//
+//  Get depth and latency of query and stream queues, reply is a list of name/value pairs
+//      zstr_sendx (server, "QUEUES", NULL);
+//      zmsg_t *reply = zmsg_recv (server);
+//
+//  Get runtime statistics (counters and latency histograms), reply is a list of name/value pairs
+//      zstr_sendx (server, "STATS", NULL);
+//      zmsg_t *reply = zmsg_recv (server);
+//
+//  Dump runtime statistics to a file every interval msec
+//      zstr_sendx (server, "STATS-FILE", "/run/fty-kpi-power-uptime.stats", "60000", NULL);
+//      zsock_wait (server);
+//
+//  Count uptime on another clock (upt_clock_t*), e.g. a simulated one in tests
+//      zsock_send (server, "sp", "CLOCK", clock);
+//      zsock_wait (server);
+//
+//  Read UPS status from shm right now instead of waiting for the polling interval
+//      zstr_sendx (server, "POLL", NULL);
+//      zsock_wait (server);
+//
+//  Stream state to hot-standby followers: changes as they are applied, the whole state every
+//  interval msec and whenever a follower subscribes. Deltas need the unsharded mode, sharded
+//  state is replicated by snapshots only.
+//      zstr_sendx (server, "REPLICATE", "ipc://@/fty-kpi-power-uptime-replica", "10000", NULL);
+//      zsock_wait (server);
+//
+//  Follow a leader: state comes from the replication stream only, shm and stream metrics are
+//  ignored and the state file is not written
+//      zstr_sendx (server, "FOLLOW", "ipc://@/fty-kpi-power-uptime-replica", NULL);
+//      zsock_wait (server);
+//
+//  Stop following and take over, with the replicated state
+//      zstr_sendx (server, "PROMOTE", NULL);
+//      zsock_wait (server);
+//
+//  Record availability of datacenters as a federation snapshot, saved to <dir>/federation with
+//  the state and mergeable with snapshots of other appliances (fty-kpi-power-uptime-merge).
+//  Source names this appliance. Sharded state is recorded at the resolution of state saves.
+//      zstr_sendx (server, "FEDERATION", "appliance-1", NULL);
+//      zsock_wait (server);
+//
+//  Keep counters of datacenters in a memory mapped file updated in place (capacity datacenters,
+//  4096 by default), counters survive a crash without any save and other processes can read
+//  them (upt_table_open_readonly). Counters found in the table are taken when they are ahead of
+//  the state file. Table is flushed to disk by the kernel only ("none"), with every state save
+//  ("save", default) or after every batch of metrics ("always"). Sharded counters are written
+//  at state saves.
+//      zstr_sendx (server, "TABLE", "/var/lib/fty/fty-kpi-power-uptime/counters", "4096", "save", NULL);
+//      zsock_wait (server);
+//
+//  Account time the agent was not running when the state is loaded, from the wall clock
+//  checkpoint of the state file: as "unknown" (default), "assume" the last known state of
+//  datacenters, or assume it for at most "clamp" seconds and the rest as unknown. Must be sent
+//  before CONFIG.
+//      zstr_sendx (server, "DOWNTIME", "clamp", "300", NULL);
+//      zsock_wait (server);
+//
+//  Debounce flapping UPS status: a change is applied only once the new status lasted offline_ms
+//  (going on battery) or online_ms (anything else) msec, shorter excursions are counted as flaps
+//  in STATS. Pending changes are applied as soon as their dwell passed. 0 0 disables it.
+//      zstr_sendx (server, "DEBOUNCE", "5000", "30000", NULL);
+//      zsock_wait (server);
+//
+//  Move upses which did not report their status for ttl msec to the "stale" state until they
+//  report again, so datacenters stop accruing time on old data. Upses known at the time are
+//  taken as seen now. 0 disables it.
+//      zstr_sendx (server, "STALE", "300000", NULL);
+//      zsock_wait (server);
+//
+//  Get uptime of a datacenter, reply is result (-1 if unknown), total, offline and unknown
+//      zstr_sendx (server, "UPTIME", "datacenter-3", NULL);
+//      zsock_recv (server, "i888", &r, &total, &offline, &unknown);
+//
+//  Get seconds a datacenter spent in every state (dc_state_t order), reply is result (-1 if unknown)
+//  and DC_STATE_COUNT uint64_t values
+//      zstr_sendx (server, "DURATIONS", "datacenter-3", NULL);
+//      zsock_recv (server, "ib", &r, &durations, &size);
+//
+//  Enable compiled in trace points (off, sample or full), sample mode emits rate records per second and point
+//      zstr_sendx (server, "TRACE", "sample", "10", NULL);
+//      zsock_wait (server);
+//
+//  Ask asset agent to republish all datacenters and apply them in one batch, then seed UPS status
+//  from shm. Bootstrap window is closed after timeout (msec) or once datacenters stop arriving.
+//      zsock_sendx (server, "BOOTSTRAP", "asset-agent", "5000", NULL);
+//      zsock_wait (server);
+//
 void fty_kpi_power_uptime_server(zsock_t* pipe, void* args);
 
 fty_kpi_power_uptime_server_t* fty_kpi_power_uptime_server_new(void);
@@ -61,3 +220,9 @@ int                            fty_kpi_power_uptime_server_load_state(fty_kpi_po
 void                           fty_kpi_power_uptime_server_destroy(fty_kpi_power_uptime_server_t** self_p);
 void                           s_set_dc_upses(fty_kpi_power_uptime_server_t* self, fty_proto_t* fmsg);
 void fty_kpi_power_uptime_server_set_dir(fty_kpi_power_uptime_server_t* self, const char* dir);
+void fty_kpi_power_uptime_server_poll_metrics(fty_kpi_power_uptime_server_t* self);
+void fty_kpi_power_uptime_server_set_shards(fty_kpi_power_uptime_server_t* self, size_t count);
+void fty_kpi_power_uptime_server_set_clock(fty_kpi_power_uptime_server_t* self, upt_clock_t* clock);
+void fty_kpi_power_uptime_server_set_debounce(fty_kpi_power_uptime_server_t* self, int64_t offline_ms, int64_t online_ms);
+void fty_kpi_power_uptime_server_set_stale(fty_kpi_power_uptime_server_t* self, int64_t ttl_ms);
+zmsg_t* fty_kpi_power_uptime_server_stats(fty_kpi_power_uptime_server_t* self);
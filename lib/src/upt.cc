@@ -40,6 +40,52 @@ static void* s_str_duplicator(const void* x)
     return strdup(reinterpret_cast<const char*>(x));
 }
 
+static int s_str_comparator(const void* a, const void* b)
+{
+    return strcmp(reinterpret_cast<const char*>(a), reinterpret_cast<const char*>(b));
+}
+
+static void s_list_destructor(void** x)
+{
+    zlistx_destroy(reinterpret_cast<zlistx_t**>(x));
+}
+
+// true if list of strings holds name
+static bool s_list_has(zlistx_t* list, const char* name)
+{
+    for (char* item = reinterpret_cast<char*>(zlistx_first(list)); item != nullptr;
+         item       = reinterpret_cast<char*>(zlistx_next(list))) {
+        if (streq(item, name))
+            return true;
+    }
+    return false;
+}
+
+// add dc_name to the datacenters of ups_name, return false if it is there already
+static bool s_join(upt_t* self, const char* ups_name, const char* dc_name)
+{
+    zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_lookup(self->ups2dc, ups_name));
+    if (!dcs) {
+        dcs = zlistx_new();
+        zlistx_set_duplicator(dcs, s_str_duplicator);
+        zlistx_set_destructor(dcs, s_str_destructor);
+        zlistx_set_comparator(dcs, s_str_comparator);
+        zhashx_insert(self->ups2dc, ups_name, dcs);
+    } else if (zlistx_find(dcs, const_cast<char*>(dc_name)))
+        return false;
+    zlistx_add_end(dcs, const_cast<char*>(dc_name));
+    return true;
+}
+
+// remove dc_name from datacenters dcs of an ups, return true if it was the last one
+static bool s_leave(zlistx_t* dcs, const char* dc_name)
+{
+    void* handle = zlistx_find(dcs, const_cast<char*>(dc_name));
+    if (handle)
+        zlistx_delete(dcs, handle);
+    return zlistx_size(dcs) == 0;
+}
+
 upt_t* upt_new()
 {
     upt_t* self = reinterpret_cast<upt_t*>(zmalloc(sizeof(upt_t)));
@@ -53,11 +99,78 @@ upt_t* upt_new()
     self->ups2dc = zhashx_new();
     zhashx_set_key_duplicator(self->ups2dc, s_str_duplicator);
     zhashx_set_key_destructor(self->ups2dc, s_str_destructor);
-    zhashx_set_duplicator(self->ups2dc, s_str_duplicator);
-    zhashx_set_destructor(self->ups2dc, s_str_destructor);
+    zhashx_set_destructor(self->ups2dc, s_list_destructor);
+    self->clock = upt_clock_system();
+    self->table = nullptr;
     return self;
 }
 
+// table readers get wall clock time from last_update of the slots
+static void s_table_offset(upt_t* self)
+{
+    if (self->table)
+        upt_table_set_offset(self->table, upt_clock_wall(self->clock) / 1000LL - upt_clock_now(self->clock) / 1000LL);
+}
+
+// map counters of dc to the table, counters found there are taken when they are ahead:
+// the table is updated in place, so it outlives a crash better than any state file
+static void s_table_attach(upt_t* self, const char* dc_name, dc_t* dc)
+{
+    if (!self->table) {
+        dc_set_slot(dc, nullptr);
+        return;
+    }
+
+    upt_table_slot_t* slot = upt_table_lookup(self->table, dc_name);
+    if (slot) {
+        upt_table_entry_t entry;
+        upt_table_read(self->table, slot, &entry);
+        if (entry.total > dc->total) {
+            dc->total      = entry.total;
+            dc->offline    = entry.offline;
+            dc->checkpoint = entry.last_update;
+        }
+    } else
+        slot = upt_table_slot(self->table, dc_name);
+    dc_set_slot(dc, slot);
+}
+
+void upt_set_table(upt_t* self, upt_table_t* table)
+{
+    assert(self);
+
+    self->table = table;
+    s_table_offset(self);
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(self->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(self->dc))) {
+        s_table_attach(self, reinterpret_cast<const char*>(zhashx_cursor(self->dc)), dc);
+    }
+}
+
+void upt_set_clock(upt_t* self, upt_clock_t* clock)
+{
+    assert(self);
+
+    self->clock = clock ? clock : upt_clock_system();
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(self->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(self->dc))) {
+        dc_set_clock(dc, self->clock);
+    }
+    s_table_offset(self);
+}
+
+void upt_freeze(upt_t* self, upt_clock_t* clock)
+{
+    assert(self);
+    assert(clock);
+
+    self->clock = clock;
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(self->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(self->dc))) {
+        dc_freeze(dc, clock);
+    }
+}
+
 void upt_destroy(upt_t** self_p)
 {
     if (!self_p || !*self_p)
@@ -72,40 +185,248 @@ void upt_destroy(upt_t** self_p)
     *self_p = nullptr;
 }
 
-int upt_add(upt_t* self, const char* dc_name, zlistx_t* ups)
+upt_t* upt_dup(upt_t* self)
 {
     assert(self);
+
+    return upt_partition(self, 0, 1);
+}
+
+size_t upt_shard_of(const char* dc_name, size_t count)
+{
     assert(dc_name);
 
+    if (count <= 1)
+        return 0;
+
+    // FNV-1a, stable across restarts so state splits the same way every time
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char* c = dc_name; *c; c++) {
+        hash ^= uint64_t(uint8_t(*c));
+        hash *= 1099511628211ULL;
+    }
+    return size_t(hash % count);
+}
+
+upt_t* upt_partition(upt_t* self, size_t index, size_t count)
+{
+    assert(self);
+
+    upt_t* part = upt_new();
+    if (!part)
+        return nullptr;
+    part->clock = self->clock;
+
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(self->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(self->dc))) {
+        const char* dc_name = reinterpret_cast<const char*>(zhashx_cursor(self->dc));
+        if (upt_shard_of(dc_name, count) == index)
+            zhashx_insert(part->dc, dc_name, dc_dup(dc));
+    }
+    for (zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_first(self->ups2dc)); dcs != nullptr;
+         dcs           = reinterpret_cast<zlistx_t*>(zhashx_next(self->ups2dc))) {
+        const char* ups_name = reinterpret_cast<const char*>(zhashx_cursor(self->ups2dc));
+        for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dcs)); dc_name != nullptr;
+             dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+            if (upt_shard_of(dc_name, count) == index)
+                s_join(part, ups_name, dc_name);
+        }
+    }
+    return part;
+}
+
+upt_t* upt_dup_dcs(upt_t* self, zlistx_t* dc_names)
+{
+    assert(self);
+    assert(dc_names);
+
+    upt_t* copy = upt_new();
+    if (!copy)
+        return nullptr;
+    copy->clock = self->clock;
+
+    for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dc_names)); dc_name != nullptr;
+         dc_name       = reinterpret_cast<char*>(zlistx_next(dc_names))) {
+        dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
+        if (dc)
+            zhashx_update(copy->dc, dc_name, dc_dup(dc));
+    }
+    return copy;
+}
+
+void upt_merge(upt_t* self, upt_t** other_p)
+{
+    assert(self);
+    assert(other_p);
+
+    upt_t* other = *other_p;
+    if (!other)
+        return;
+
+    // dc_t structures are moved, not copied
+    zhashx_set_destructor(other->dc, nullptr);
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(other->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(other->dc))) {
+        zhashx_update(self->dc, zhashx_cursor(other->dc), dc);
+        s_table_attach(self, reinterpret_cast<const char*>(zhashx_cursor(other->dc)), dc);
+    }
+    for (zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_first(other->ups2dc)); dcs != nullptr;
+         dcs           = reinterpret_cast<zlistx_t*>(zhashx_next(other->ups2dc))) {
+        const char* ups_name = reinterpret_cast<const char*>(zhashx_cursor(other->ups2dc));
+        for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dcs)); dc_name != nullptr;
+             dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+            s_join(self, ups_name, dc_name);
+        }
+    }
+    upt_destroy(other_p);
+}
+
+// return datacenter dc_name, a new one is created if it does not exist yet
+static dc_t* s_dc_get(upt_t* self, const char* dc_name)
+{
     dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
     if (!dc) {
-        dc = dc_new();
+        dc = dc_new_clock(self->clock);
         zhashx_insert(self->dc, dc_name, dc);
-    } else {
-        // dc exists, so
-        //  1.) remove all entries from ups2dc, which are not in ups
-        //  2.) setup them as online
-        zlistx_t* keys = zhashx_keys(self->ups2dc);
-        for (char* ups_name = reinterpret_cast<char*>(zlistx_first(keys)); ups_name != nullptr;
-             ups_name       = reinterpret_cast<char*>(zlistx_next(keys))) {
-            char* sdc = reinterpret_cast<char*>(zhashx_lookup(self->ups2dc, ups_name));
-            if (sdc && streq(sdc, dc_name) && !zlistx_find(ups, ups_name)) {
-                zhashx_delete(self->ups2dc, ups_name);
-                dc_set_online(dc, ups_name);
+        s_table_attach(self, dc_name, dc);
+    }
+    return dc;
+}
+
+int upt_add(upt_t* self, const char* dc_name, zlistx_t* ups)
+{
+    assert(self);
+    assert(dc_name);
+
+    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
+    if (!dc)
+        dc = s_dc_get(self, dc_name);
+    else {
+        // dc exists, upses no longer listed leave it and forget their state there, their other
+        // datacenters are kept
+        zlistx_t* removed = zlistx_new();
+        for (zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_first(self->ups2dc)); dcs != nullptr;
+             dcs           = reinterpret_cast<zlistx_t*>(zhashx_next(self->ups2dc))) {
+            const char* ups_name = reinterpret_cast<const char*>(zhashx_cursor(self->ups2dc));
+            if (zlistx_find(dcs, const_cast<char*>(dc_name)) && !(ups && s_list_has(ups, ups_name))) {
+                dc_remove_ups(dc, ups_name);
+                if (s_leave(dcs, dc_name))
+                    zlistx_add_end(removed, const_cast<char*>(ups_name));
             }
         }
-        zlistx_destroy(&keys);
+        for (char* ups_name = reinterpret_cast<char*>(zlistx_first(removed)); ups_name != nullptr;
+             ups_name       = reinterpret_cast<char*>(zlistx_next(removed))) {
+            zhashx_delete(self->ups2dc, ups_name);
+        }
+        zlistx_destroy(&removed);
     }
+    dc_set_members(dc, ups ? zlistx_size(ups) : 0);
 
+    // an ups claimed by several datacenters belongs to all of them
     if (ups) {
         for (char* ups_name = reinterpret_cast<char*>(zlistx_first(ups)); ups_name != nullptr;
              ups_name       = reinterpret_cast<char*>(zlistx_next(ups))) {
-            zhashx_update(self->ups2dc, ups_name, const_cast<char*>(dc_name));
+            s_join(self, ups_name, dc_name);
         }
     }
     return 0;
 }
 
+int upt_add_bulk(upt_t* self, zhashx_t* topology)
+{
+    assert(self);
+    assert(topology);
+
+    // new membership in refreshed datacenters, ups name -> zlistx_t of dc names (borrowed from topology keys)
+    zhashx_t* index = zhashx_new();
+    zhashx_set_key_duplicator(index, s_str_duplicator);
+    zhashx_set_key_destructor(index, s_str_destructor);
+    zhashx_set_destructor(index, s_list_destructor);
+
+    for (zlistx_t* ups = reinterpret_cast<zlistx_t*>(zhashx_first(topology)); ups != nullptr;
+         ups           = reinterpret_cast<zlistx_t*>(zhashx_next(topology))) {
+        const char* dc_name = reinterpret_cast<const char*>(zhashx_cursor(topology));
+        dc_set_members(s_dc_get(self, dc_name), zlistx_size(ups));
+
+        for (char* ups_name = reinterpret_cast<char*>(zlistx_first(ups)); ups_name != nullptr;
+             ups_name       = reinterpret_cast<char*>(zlistx_next(ups))) {
+            zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_lookup(index, ups_name));
+            if (!dcs) {
+                dcs = zlistx_new();
+                zhashx_insert(index, ups_name, dcs);
+            }
+            zlistx_add_end(dcs, const_cast<char*>(dc_name));
+        }
+    }
+
+    // upses which are no longer part of a refreshed dc leave it and are set online there, upses
+    // left without any datacenter are removed
+    zlistx_t* removed = zlistx_new();
+    zlistx_t* left    = zlistx_new();
+    for (zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_first(self->ups2dc)); dcs != nullptr;
+         dcs           = reinterpret_cast<zlistx_t*>(zhashx_next(self->ups2dc))) {
+        const char* ups_name = reinterpret_cast<const char*>(zhashx_cursor(self->ups2dc));
+        zlistx_t*   ndcs     = reinterpret_cast<zlistx_t*>(zhashx_lookup(index, ups_name));
+        for (char* sdc = reinterpret_cast<char*>(zlistx_first(dcs)); sdc != nullptr;
+             sdc       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+            if (zhashx_lookup(topology, sdc) && !(ndcs && s_list_has(ndcs, sdc)))
+                zlistx_add_end(left, sdc);
+        }
+        for (char* sdc = reinterpret_cast<char*>(zlistx_first(left)); sdc != nullptr;
+             sdc       = reinterpret_cast<char*>(zlistx_next(left))) {
+            dc_remove_ups(reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, sdc)), ups_name);
+            if (s_leave(dcs, sdc))
+                zlistx_add_end(removed, const_cast<char*>(ups_name));
+        }
+        zlistx_purge(left);
+    }
+    zlistx_destroy(&left);
+    for (char* ups_name = reinterpret_cast<char*>(zlistx_first(removed)); ups_name != nullptr;
+         ups_name       = reinterpret_cast<char*>(zlistx_next(removed))) {
+        zhashx_delete(self->ups2dc, ups_name);
+    }
+    zlistx_destroy(&removed);
+
+    for (zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_first(index)); dcs != nullptr;
+         dcs           = reinterpret_cast<zlistx_t*>(zhashx_next(index))) {
+        const char* ups_name = reinterpret_cast<const char*>(zhashx_cursor(index));
+        for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dcs)); dc_name != nullptr;
+             dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+            s_join(self, ups_name, dc_name);
+        }
+    }
+    zhashx_destroy(&index);
+    return 0;
+}
+
+void upt_add_member(upt_t* self, const char* dc_name, const char* ups_name)
+{
+    assert(self);
+    assert(dc_name);
+    assert(ups_name);
+
+    s_join(self, ups_name, dc_name);
+}
+
+int upt_set_policy(upt_t* self, const char* dc_name, dc_policy_t policy, uint64_t threshold)
+{
+    assert(self);
+    assert(dc_name);
+
+    dc_set_policy(s_dc_get(self, dc_name), policy, threshold);
+    return 0;
+}
+
+int upt_set_rating(upt_t* self, const char* dc_name, const char* ups_name, uint64_t rating)
+{
+    assert(self);
+    assert(dc_name);
+    assert(ups_name);
+
+    dc_set_rating(s_dc_get(self, dc_name), ups_name, rating);
+    return 0;
+}
+
 bool upt_is_offline(upt_t* self, const char* dc_name)
 {
     assert(self);
@@ -118,36 +439,53 @@ bool upt_is_offline(upt_t* self, const char* dc_name)
     return dc_is_offline(dc);
 }
 
-void upt_set_offline(upt_t* self, const char* ups_name)
+// a status of ups fans out to all its datacenters, return true if it changed in any of them
+bool upt_set_offline(upt_t* self, const char* ups_name)
 {
     assert(self);
     assert(ups_name);
 
-    const char* dc_name = upt_dc_name(self, ups_name);
-    if (!dc_name)
-        return;
-
-    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
-    if (!dc)
-        return;
-
-    dc_set_offline(dc, const_cast<char*>(ups_name));
+    zlistx_t* dcs     = upt_dc_names(self, ups_name);
+    bool      changed = false;
+    for (char* dc_name = dcs ? reinterpret_cast<char*>(zlistx_first(dcs)) : nullptr; dc_name != nullptr;
+         dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+        dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
+        if (dc && dc_set_offline(dc, const_cast<char*>(ups_name)))
+            changed = true;
+    }
+    return changed;
 }
 
-void upt_set_online(upt_t* self, const char* ups_name)
+bool upt_set_online(upt_t* self, const char* ups_name)
 {
     assert(self);
     assert(ups_name);
 
-    const char* dc_name = upt_dc_name(self, ups_name);
-    if (!dc_name)
-        return;
+    zlistx_t* dcs     = upt_dc_names(self, ups_name);
+    bool      changed = false;
+    for (char* dc_name = dcs ? reinterpret_cast<char*>(zlistx_first(dcs)) : nullptr; dc_name != nullptr;
+         dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+        dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
+        if (dc && dc_set_online(dc, const_cast<char*>(ups_name)))
+            changed = true;
+    }
+    return changed;
+}
 
-    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
-    if (!dc)
-        return;
+bool upt_set_state(upt_t* self, const char* ups_name, dc_state_t state)
+{
+    assert(self);
+    assert(ups_name);
 
-    dc_set_online(dc, const_cast<char*>(ups_name));
+    zlistx_t* dcs     = upt_dc_names(self, ups_name);
+    bool      changed = false;
+    for (char* dc_name = dcs ? reinterpret_cast<char*>(zlistx_first(dcs)) : nullptr; dc_name != nullptr;
+         dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+        dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
+        if (dc && dc_set_state(dc, ups_name, state))
+            changed = true;
+    }
+    return changed;
 }
 
 const char* upt_dc_name(upt_t* self, const char* ups_name)
@@ -155,11 +493,19 @@ const char* upt_dc_name(upt_t* self, const char* ups_name)
     assert(self);
     assert(ups_name);
 
-    char* dc = reinterpret_cast<char*>(zhashx_lookup(self->ups2dc, ups_name));
-    if (!dc)
+    zlistx_t* dcs = upt_dc_names(self, ups_name);
+    if (!dcs)
         return nullptr;
 
-    return dc;
+    return reinterpret_cast<const char*>(zlistx_head(dcs));
+}
+
+zlistx_t* upt_dc_names(upt_t* self, const char* ups_name)
+{
+    assert(self);
+    assert(ups_name);
+
+    return reinterpret_cast<zlistx_t*>(zhashx_lookup(self->ups2dc, ups_name));
 }
 
 int upt_uptime(upt_t* self, const char* dc_name, uint64_t* total, uint64_t* offline)
@@ -179,13 +525,81 @@ int upt_uptime(upt_t* self, const char* dc_name, uint64_t* total, uint64_t* offl
     return 0;
 }
 
+int upt_durations(upt_t* self, const char* dc_name, uint64_t* durations)
+{
+    assert(self);
+    assert(dc_name);
+    assert(durations);
+
+    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
+    if (!dc)
+        return -1;
+    dc_durations(dc, durations);
+    return 0;
+}
+
+zmsg_t* upt_top(upt_t* self, const char* dc_name, size_t n)
+{
+    assert(self);
+    assert(dc_name);
+
+    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
+    if (!dc)
+        return nullptr;
+
+    size_t size = dc->counters ? zhashx_size(dc->counters) : 0;
+    if (n > size)
+        n = size;
+    const char**       upses    = reinterpret_cast<const char**>(zmalloc((n + 1) * sizeof(char*)));
+    dc_ups_counters_t* counters = reinterpret_cast<dc_ups_counters_t*>(zmalloc((n + 1) * sizeof(dc_ups_counters_t)));
+    size_t             count    = dc_top(dc, n, upses, counters);
+
+    zmsg_t* msg = zmsg_new();
+    for (size_t i = 0; i != count; i++) {
+        zmsg_addstr(msg, upses[i]);
+        zmsg_addstrf(msg, "%" PRIu64, counters[i].on_battery);
+        zmsg_addstrf(msg, "%" PRIu64, counters[i].transitions);
+        zmsg_addstrf(msg, "%" PRIi64, counters[i].last_change);
+    }
+    free(upses);
+    free(counters);
+    return msg;
+}
+
+int upt_unknown(upt_t* self, const char* dc_name, uint64_t* unknown)
+{
+    assert(self);
+    assert(dc_name);
+    assert(unknown);
+
+    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(self->dc, dc_name));
+    if (!dc)
+        return -1;
+    *unknown = dc_unknown(dc);
+    return 0;
+}
+
+void upt_reconcile(upt_t* self, dc_gap_policy_t policy, int64_t clamp)
+{
+    assert(self);
+
+    int64_t now = upt_clock_wall(self->clock) / 1000LL;
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(self->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(self->dc))) {
+        dc_reconcile(dc, now, policy, clamp);
+    }
+}
+
 void upt_print(upt_t* self)
 {
     log_debug("self: <%p>\n", self);
     log_debug("self->ups2dc: \n");
-    for (char* dc_name = reinterpret_cast<char*>(zhashx_first(self->ups2dc)); dc_name != nullptr;
-         dc_name       = reinterpret_cast<char*>(zhashx_next(self->ups2dc))) {
-        log_debug("\t'%s' : '%s'\n", reinterpret_cast<const char*>(zhashx_cursor(self->ups2dc)), dc_name);
+    for (zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_first(self->ups2dc)); dcs != nullptr;
+         dcs           = reinterpret_cast<zlistx_t*>(zhashx_next(self->ups2dc))) {
+        for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dcs)); dc_name != nullptr;
+             dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+            log_debug("\t'%s' : '%s'\n", reinterpret_cast<const char*>(zhashx_cursor(self->ups2dc)), dc_name);
+        }
     }
     log_debug("self->dc: \n");
     for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(self->dc)); dc != nullptr;
@@ -203,6 +617,9 @@ int upt_save(upt_t* self, const char* file_path)
 
     zconfig_t* config_file = zconfig_new("root", nullptr);
 
+    // wall clock the counters below are accounted up to, gap until the next start is reconciled from it
+    zconfig_putf(config_file, "checkpoint", "%" PRIi64, upt_clock_wall(self->clock) / 1000LL);
+
     int j = 1;
 
     // self->dc
@@ -217,6 +634,9 @@ int upt_save(upt_t* self, const char* file_path)
         zconfig_putf(config_file, path, "%s", dc_name);
         zstr_free(&path);
 
+        uint64_t total, offline;
+        dc_uptime(dc_struc, &total, &offline);
+
         path = zsys_sprintf("dc_data/%s/total", dc_name);
         zconfig_putf(config_file, path, "%" SCNu64, dc_total(dc_struc));
         zstr_free(&path);
@@ -225,10 +645,89 @@ int upt_save(upt_t* self, const char* file_path)
         zconfig_putf(config_file, path, "%" SCNu64, dc_off_line(dc_struc));
         zstr_free(&path);
 
-        // self->ups2dc - list of upses for each dc
-        for (char* dc = reinterpret_cast<char*>(zhashx_first(self->ups2dc)); dc != nullptr; dc = reinterpret_cast<char*>(zhashx_next(self->ups2dc))) {
-            if (streq(dc, dc_name)) {
-                path      = zsys_sprintf("dc_upses/%s/ups.%d", dc, i);
+        path = zsys_sprintf("dc_data/%s/unknown", dc_name);
+        zconfig_putf(config_file, path, "%" SCNu64, dc_unknown(dc_struc));
+        zstr_free(&path);
+
+        path = zsys_sprintf("dc_data/%s/policy", dc_name);
+        zconfig_put(config_file, path, dc_policy_name(dc_struc->policy));
+        zstr_free(&path);
+
+        path = zsys_sprintf("dc_data/%s/threshold", dc_name);
+        zconfig_putf(config_file, path, "%" PRIu64, dc_struc->threshold);
+        zstr_free(&path);
+
+        // rated capacity of upses
+        if (dc_struc->ratings) {
+            int k = 1;
+            for (uint64_t* rating = reinterpret_cast<uint64_t*>(zhashx_first(dc_struc->ratings)); rating != nullptr;
+                 rating           = reinterpret_cast<uint64_t*>(zhashx_next(dc_struc->ratings)), k++) {
+                path = zsys_sprintf("dc_ratings/%s/ups.%d", dc_name, k);
+                zconfig_put(config_file, path, reinterpret_cast<const char*>(zhashx_cursor(dc_struc->ratings)));
+                zstr_free(&path);
+                path = zsys_sprintf("dc_ratings/%s/rating.%d", dc_name, k);
+                zconfig_putf(config_file, path, "%" PRIu64, *rating);
+                zstr_free(&path);
+            }
+        }
+
+        for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+            path = zsys_sprintf("dc_durations/%s/%s", dc_name, dc_state_name(dc_state_t(state)));
+            zconfig_putf(config_file, path, "%" PRIu64, dc_struc->durations[state]);
+            zstr_free(&path);
+        }
+
+        // upses in other states than online at the checkpoint, offline ones are listed for older versions too
+        int k = 1;
+        if (dc_struc->states) {
+            for (void* entry = zhashx_first(dc_struc->states); entry != nullptr;
+                 entry       = zhashx_next(dc_struc->states)) {
+                const char* ups = reinterpret_cast<const char*>(zhashx_cursor(dc_struc->states));
+                path            = zsys_sprintf("dc_states/%s/ups.%d", dc_name, k);
+                zconfig_put(config_file, path, ups);
+                zstr_free(&path);
+                path = zsys_sprintf("dc_states/%s/state.%d", dc_name, k++);
+                zconfig_put(config_file, path, dc_state_name(dc_ups_state(dc_struc, ups)));
+                zstr_free(&path);
+            }
+        }
+
+        // counters of upses, on battery seconds up to the checkpoint
+        k = 1;
+        if (dc_struc->counters) {
+            for (void* entry = zhashx_first(dc_struc->counters); entry != nullptr;
+                 entry       = zhashx_next(dc_struc->counters), k++) {
+                const char*       ups = reinterpret_cast<const char*>(zhashx_cursor(dc_struc->counters));
+                dc_ups_counters_t counters;
+                dc_ups_counters(dc_struc, ups, &counters);
+                path = zsys_sprintf("dc_counters/%s/ups.%d", dc_name, k);
+                zconfig_put(config_file, path, ups);
+                zstr_free(&path);
+                path = zsys_sprintf("dc_counters/%s/on_battery.%d", dc_name, k);
+                zconfig_putf(config_file, path, "%" PRIu64, counters.on_battery);
+                zstr_free(&path);
+                path = zsys_sprintf("dc_counters/%s/transitions.%d", dc_name, k);
+                zconfig_putf(config_file, path, "%" PRIu64, counters.transitions);
+                zstr_free(&path);
+                path = zsys_sprintf("dc_counters/%s/last_change.%d", dc_name, k);
+                zconfig_putf(config_file, path, "%" PRIi64, counters.last_change);
+                zstr_free(&path);
+            }
+        }
+
+        // upses offline at the checkpoint
+        k = 1;
+        for (char* ups = reinterpret_cast<char*>(zlistx_first(dc_struc->ups)); ups != nullptr;
+             ups       = reinterpret_cast<char*>(zlistx_next(dc_struc->ups))) {
+            path = zsys_sprintf("dc_offline/%s/ups.%d", dc_name, k++);
+            zconfig_put(config_file, path, ups);
+            zstr_free(&path);
+        }
+
+        // self->ups2dc - list of upses for each dc, a shared ups is listed in each of its datacenters
+        for (zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_first(self->ups2dc)); dcs != nullptr; dcs = reinterpret_cast<zlistx_t*>(zhashx_next(self->ups2dc))) {
+            if (zlistx_find(dcs, dc_name)) {
+                path      = zsys_sprintf("dc_upses/%s/ups.%d", dc_name, i);
                 char* ups = const_cast<char*>(reinterpret_cast<const char*>(zhashx_cursor(self->ups2dc)));
 
                 zconfig_put(config_file, path, ups);
@@ -260,6 +759,12 @@ upt_t* upt_load(const char* file_path)
     char* dc_name = nullptr;
     char* ups     = nullptr;
 
+    // files of older versions have no checkpoint, their gap can't be reconciled
+    int64_t checkpoint   = -1;
+    char*   s_checkpoint = zconfig_get(config_file, "checkpoint", nullptr);
+    if (s_checkpoint)
+        sscanf(s_checkpoint, "%" SCNi64, &checkpoint);
+
     for (int i = 1;; i++) {
         char* path = zsys_sprintf("dc_list/dc.%d", i);
         dc_name    = zconfig_get(config_file, path, nullptr);
@@ -269,6 +774,32 @@ upt_t* upt_load(const char* file_path)
 
         dc_t* dc = dc_new();
 
+        // set policy, files of older versions have none
+        dc_policy_t policy = DC_POLICY_ANY;
+        uint64_t    threshold = 0;
+        path = zsys_sprintf("dc_data/%s/policy", dc_name);
+        dc_policy_parse(zconfig_get(config_file, path, nullptr), &policy);
+        zstr_free(&path);
+        path = zsys_sprintf("dc_data/%s/threshold", dc_name);
+        char* s_threshold = zconfig_get(config_file, path, nullptr);
+        zstr_free(&path);
+        if (s_threshold)
+            sscanf(s_threshold, "%" SCNu64, &threshold);
+        dc_set_policy(dc, policy, threshold);
+        for (int k = 1;; k++) {
+            path = zsys_sprintf("dc_ratings/%s/ups.%d", dc_name, k);
+            ups  = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            path           = zsys_sprintf("dc_ratings/%s/rating.%d", dc_name, k);
+            char* s_rating = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            if (!ups || !s_rating)
+                break;
+            uint64_t rating = 0;
+            sscanf(s_rating, "%" SCNu64, &rating);
+            dc_set_rating(dc, ups, rating);
+        }
+
         // set total
         uint64_t total;
         path          = zsys_sprintf("dc_data/%s/total", dc_name);
@@ -287,6 +818,68 @@ upt_t* upt_load(const char* file_path)
             sscanf(s_off_line, "%" SCNu64, &offline);
             set_dc_off_line(dc, offline);
         }
+        // set unknown
+        uint64_t unknown;
+        path            = zsys_sprintf("dc_data/%s/unknown", dc_name);
+        char* s_unknown = zconfig_get(config_file, path, nullptr);
+        zstr_free(&path);
+        if (s_unknown) {
+            sscanf(s_unknown, "%" SCNu64, &unknown);
+            set_dc_unknown(dc, unknown);
+        }
+        for (int k = 1;; k++) {
+            path = zsys_sprintf("dc_offline/%s/ups.%d", dc_name, k);
+            ups  = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            if (!ups)
+                break;
+            dc_set_offline(dc, ups);
+        }
+        for (int k = 1;; k++) {
+            path = zsys_sprintf("dc_states/%s/ups.%d", dc_name, k);
+            ups  = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            path          = zsys_sprintf("dc_states/%s/state.%d", dc_name, k);
+            char* s_state = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            dc_state_t state;
+            if (!ups || dc_state_parse(s_state, &state) == -1)
+                break;
+            dc_set_state(dc, ups, state);
+        }
+        // restoring states above is no change of upses, counters are the saved ones
+        if (dc->counters)
+            zhashx_purge(dc->counters);
+        for (int k = 1;; k++) {
+            path = zsys_sprintf("dc_counters/%s/ups.%d", dc_name, k);
+            ups  = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            path               = zsys_sprintf("dc_counters/%s/on_battery.%d", dc_name, k);
+            char* s_on_battery = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            path                = zsys_sprintf("dc_counters/%s/transitions.%d", dc_name, k);
+            char* s_transitions = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            path                = zsys_sprintf("dc_counters/%s/last_change.%d", dc_name, k);
+            char* s_last_change = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            if (!ups || !s_on_battery || !s_transitions || !s_last_change)
+                break;
+            uint64_t on_battery = 0, transitions = 0;
+            int64_t  last_change = 0;
+            sscanf(s_on_battery, "%" SCNu64, &on_battery);
+            sscanf(s_transitions, "%" SCNu64, &transitions);
+            sscanf(s_last_change, "%" SCNi64, &last_change);
+            dc_set_ups_counters(dc, ups, on_battery, transitions, last_change);
+        }
+        for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+            path             = zsys_sprintf("dc_durations/%s/%s", dc_name, dc_state_name(dc_state_t(state)));
+            char* s_duration = zconfig_get(config_file, path, nullptr);
+            zstr_free(&path);
+            if (s_duration)
+                sscanf(s_duration, "%" SCNu64, &dc->durations[state]);
+        }
+        dc->checkpoint = checkpoint;
         zhashx_insert(upt->dc, dc_name, dc);
 
         for (int j = 1;; j++) {
@@ -296,7 +889,8 @@ upt_t* upt_load(const char* file_path)
 
             if (!ups)
                 break;
-            zhashx_insert(upt->ups2dc, ups, dc_name);
+            upt_add_member(upt, dc_name, ups);
+            dc->members = size_t(j);
         }
     }
 
@@ -27,39 +27,111 @@
 #include <zhashx.h>
 */
 
+#include "dc.h"
+#include "upt_clock.h"
+#include "upt_table.h"
 #include <czmq.h>
 
 struct upt_t
 {
-    zhashx_t* ups2dc; // map ups name to dc name
-    zhashx_t* dc;     // map dc name to dc_t struct
+    zhashx_t*    ups2dc; // map ups name to zlistx_t of names of the datacenters it belongs to
+    zhashx_t*    dc;     // map dc name to dc_t struct
+    upt_clock_t* clock;  // time source of datacenters, not owned
+    upt_table_t* table;  // counters of datacenters are written through to it, not owned, nullptr if none
 };
 
-///  Create a new upt
+///  Create a new upt counting time on the system clock
 upt_t* upt_new(void);
 
+///  Count time of all datacenters, present and future, on clock; nullptr is the system clock
+void upt_set_clock(upt_t* self, upt_clock_t* clock);
+
+///  Move all datacenters to clock without accounting time past it, see dc_freeze
+void upt_freeze(upt_t* self, upt_clock_t* clock);
+
+///  Write counters of all datacenters, present and future, through to table; nullptr stops it.
+///  Counters found in the table are taken when they are ahead (table outlived a crash), also for
+///  datacenters added later.
+void upt_set_table(upt_t* self, upt_table_t* table);
+
 ///  Destroy the upt
 void upt_destroy(upt_t** self_p);
 
 ///  Print properties of object
 void upt_print(upt_t* self);
 
+///  Create a deep copy of the upt
+upt_t* upt_dup(upt_t* self);
+
+///  Return index of the shard owning datacenter dc_name, when state is split to count shards
+size_t upt_shard_of(const char* dc_name, size_t count);
+
+///  Create a copy of datacenters (and their upses) owned by shard index out of count shards
+upt_t* upt_partition(upt_t* self, size_t index, size_t count);
+
+///  Create a copy of datacenters dc_names, without the membership of upses. Unknown names are skipped.
+upt_t* upt_dup_dcs(upt_t* self, zlistx_t* dc_names);
+
+///  Move all datacenters and upses from other into self, other is destroyed
+void upt_merge(upt_t* self, upt_t** other_p);
+
+/// replace the UPS list of datacenter dc_name, an ups may belong to several datacenters: listed upses
+/// are shared with their other datacenters and unlisted ones only leave dc_name
 int upt_add(upt_t* self, const char* dc_name, zlistx_t* ups_p);
 
+/// replace the UPS lists of several datacenters at once, topology maps dc name to zlistx_t of ups names
+/// the whole batch is applied in one pass over ups2dc instead of one pass per datacenter
+int upt_add_bulk(upt_t* self, zhashx_t* topology);
+
+/// add ups to the members of datacenter dc_name, other datacenters of the ups are kept and counters
+/// of the datacenter are not touched (state restore)
+void upt_add_member(upt_t* self, const char* dc_name, const char* ups_name);
+
+/// set when datacenter dc_name is offline (see dc_policy_t), the datacenter is created if it is not known yet
+int upt_set_policy(upt_t* self, const char* dc_name, dc_policy_t policy, uint64_t threshold);
+
+/// set rated capacity of ups of datacenter dc_name for DC_POLICY_CAPACITY, 0 removes the rating
+int upt_set_rating(upt_t* self, const char* dc_name, const char* ups_name, uint64_t rating);
+
 bool upt_is_offline(upt_t* self, const char* dc_name);
 
-void upt_set_offline(upt_t* self, const char* dc_name);
+/// set ups offline, return true if the status of ups changed
+bool upt_set_offline(upt_t* self, const char* ups_name);
 
-void upt_set_online(upt_t* self, const char* dc_name);
+/// set ups online, return true if the status of ups changed
+bool upt_set_online(upt_t* self, const char* ups_name);
 
+/// set state of ups (see dc_set_state), return true if the state of ups changed
+bool upt_set_state(upt_t* self, const char* ups_name, dc_state_t state);
+
+/// return the first datacenter ups belongs to, nullptr if none
 const char* upt_dc_name(upt_t* self, const char* ups_name);
 
+/// return names of all datacenters ups belongs to, nullptr if none. The list is owned by upt, its
+/// cursor is used by upt_set_offline, upt_set_online and upt_set_state.
+zlistx_t* upt_dc_names(upt_t* self, const char* ups_name);
+
 int upt_uptime(upt_t* self, const char* ups_name, uint64_t* total, uint64_t* offline);
 
-/// save upt_t to file
+/// get seconds datacenter dc_name spent in every state, durations must hold DC_STATE_COUNT values,
+/// -1 if unknown dc
+int upt_durations(upt_t* self, const char* dc_name, uint64_t* durations);
+
+/// get up to n upses of datacenter dc_name with the most on battery seconds (see dc_top) as
+/// ups/on_battery/transitions/last_change frames, worst first; nullptr if unknown dc
+zmsg_t* upt_top(upt_t* self, const char* dc_name, size_t n);
+
+/// get seconds datacenter dc_name was not accounted while the agent was not running, -1 if unknown dc
+int upt_unknown(upt_t* self, const char* dc_name, uint64_t* unknown);
+
+/// account time since the checkpoint of a loaded state (see dc_reconcile), once
+void upt_reconcile(upt_t* self, dc_gap_policy_t policy, int64_t clamp);
+
+/// save upt_t to file, counters are accounted up to now, which is saved as wall clock checkpoint
+/// together with offline upses
 int upt_save(upt_t* self, const char* file_path);
 
 void upt_print(upt_t* self);
 
-/// load upt_t from file
+/// load upt_t from file, datacenters get the checkpoint of the file to be reconciled
 upt_t* upt_load(const char* file_path);
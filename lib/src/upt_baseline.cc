@@ -0,0 +1,364 @@
+/*  =========================================================================
+    upt_baseline - Named baselines of datacenter counters
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_baseline - Named baselines of datacenter counters
+
+#include "upt_baseline.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <fty_log.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct s_baseline_t
+{
+    uint64_t                                                 seq;   // order baselines were taken in
+    int64_t                                                  taken; // wall clock (s)
+    std::unordered_map<std::string, upt_baseline_counters_t> dcs;
+};
+
+struct upt_baseline_t
+{
+    std::map<std::string, s_baseline_t>           baselines;
+    std::map<std::string, s_baseline_t>::iterator cursor;
+    uint64_t                                      seq = 0;
+};
+
+upt_baseline_t* upt_baseline_new(void)
+{
+    upt_baseline_t* self = new upt_baseline_t;
+    self->cursor         = self->baselines.end();
+    return self;
+}
+
+void upt_baseline_destroy(upt_baseline_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    delete *self_p;
+    *self_p = nullptr;
+}
+
+void upt_baseline_take(upt_baseline_t* self, const char* name, int64_t taken, upt_t* upt)
+{
+    assert(self);
+    assert(name);
+    assert(upt);
+
+    s_baseline_t& baseline = self->baselines[name];
+    baseline.seq           = ++self->seq;
+    baseline.taken         = taken;
+    baseline.dcs.clear();
+    baseline.dcs.reserve(zhashx_size(upt->dc));
+    for (void* dc = zhashx_first(upt->dc); dc != nullptr; dc = zhashx_next(upt->dc)) {
+        const char*             dc_name  = reinterpret_cast<const char*>(zhashx_cursor(upt->dc));
+        upt_baseline_counters_t counters = {};
+        upt_uptime(upt, dc_name, &counters.total, &counters.offline);
+        upt_unknown(upt, dc_name, &counters.unknown);
+        upt_durations(upt, dc_name, counters.durations);
+        baseline.dcs[dc_name] = counters;
+    }
+}
+
+int upt_baseline_drop(upt_baseline_t* self, const char* name)
+{
+    assert(self);
+    assert(name);
+
+    auto it = self->baselines.find(name);
+    if (it == self->baselines.end())
+        return -1;
+    if (self->cursor == it)
+        self->cursor = self->baselines.end();
+    self->baselines.erase(it);
+    return 0;
+}
+
+// a - b, counters which went backwards (e.g. lost state) count from zero
+static uint64_t s_since(uint64_t a, uint64_t b)
+{
+    return a > b ? a - b : 0;
+}
+
+int upt_baseline_since(upt_baseline_t* self, const char* name, const char* dc_name, upt_baseline_counters_t* counters)
+{
+    assert(self);
+    assert(name);
+    assert(dc_name);
+    assert(counters);
+
+    auto it = self->baselines.find(name);
+    if (it == self->baselines.end())
+        return -1;
+    auto dc = it->second.dcs.find(dc_name);
+    if (dc == it->second.dcs.end())
+        return 0;
+
+    const upt_baseline_counters_t& base = dc->second;
+    counters->total                     = s_since(counters->total, base.total);
+    counters->offline                   = s_since(counters->offline, base.offline);
+    counters->unknown                   = s_since(counters->unknown, base.unknown);
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+        counters->durations[state] = s_since(counters->durations[state], base.durations[state]);
+    }
+    return 0;
+}
+
+int64_t upt_baseline_taken(upt_baseline_t* self, const char* name)
+{
+    assert(self);
+    assert(name);
+
+    auto it = self->baselines.find(name);
+    return it == self->baselines.end() ? -1 : it->second.taken;
+}
+
+size_t upt_baseline_size(upt_baseline_t* self)
+{
+    assert(self);
+
+    return self->baselines.size();
+}
+
+const char* upt_baseline_first(upt_baseline_t* self)
+{
+    assert(self);
+
+    self->cursor = self->baselines.begin();
+    return self->cursor == self->baselines.end() ? nullptr : self->cursor->first.c_str();
+}
+
+const char* upt_baseline_next(upt_baseline_t* self)
+{
+    assert(self);
+
+    if (self->cursor == self->baselines.end())
+        return nullptr;
+    ++self->cursor;
+    return self->cursor == self->baselines.end() ? nullptr : self->cursor->first.c_str();
+}
+
+// names may hold anything, the characters separating fields and records are escaped
+static std::string s_escape(const std::string& name)
+{
+    std::string escaped;
+    escaped.reserve(name.size());
+    for (char c : name) {
+        switch (c) {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\r':
+                escaped += "\\r";
+                break;
+            default:
+                escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string s_unescape(const char* escaped)
+{
+    std::string name;
+    for (; *escaped; escaped++) {
+        if (*escaped != '\\' || escaped[1] == '\0') {
+            name += *escaped;
+            continue;
+        }
+        switch (*++escaped) {
+            case 't':
+                name += '\t';
+                break;
+            case 'n':
+                name += '\n';
+                break;
+            case 'r':
+                name += '\r';
+                break;
+            default:
+                name += *escaped;
+        }
+    }
+    return name;
+}
+
+int upt_baseline_save(upt_baseline_t* self, const char* file_path)
+{
+    assert(self);
+    assert(file_path);
+
+    FILE* file = fopen(file_path, "w");
+    if (!file) {
+        log_error("upt_baseline_save: can't open %s", file_path);
+        return -1;
+    }
+
+    std::vector<const std::pair<const std::string, s_baseline_t>*> order;
+    for (const auto& it : self->baselines) {
+        order.push_back(&it);
+    }
+    std::sort(order.begin(), order.end(), [](const std::pair<const std::string, s_baseline_t>* a,
+                                              const std::pair<const std::string, s_baseline_t>* b) {
+        return a->second.seq < b->second.seq;
+    });
+
+    fprintf(file, "# fty-kpi-power-uptime baselines\n");
+    const s_baseline_t* previous = nullptr;
+    for (const auto* it : order) {
+        fprintf(file, "baseline\t%s\t%" PRIi64 "\n", s_escape(it->first).c_str(), it->second.taken);
+        for (const auto& dc : it->second.dcs) {
+            // a datacenter new to this baseline is written even when its counters are all zero
+            upt_baseline_counters_t base  = {};
+            bool                    known = false;
+            if (previous) {
+                auto prev = previous->dcs.find(dc.first);
+                if (prev != previous->dcs.end()) {
+                    base  = prev->second;
+                    known = true;
+                }
+            }
+            if (known && memcmp(&base, &dc.second, sizeof(base)) == 0)
+                continue;
+            fprintf(file, "dc\t%s\t%" PRIi64 "\t%" PRIi64 "\t%" PRIi64, s_escape(dc.first).c_str(),
+                int64_t(dc.second.total - base.total), int64_t(dc.second.offline - base.offline),
+                int64_t(dc.second.unknown - base.unknown));
+            for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+                fprintf(file, "\t%" PRIi64, int64_t(dc.second.durations[state] - base.durations[state]));
+            }
+            fprintf(file, "\n");
+        }
+        if (previous) {
+            for (const auto& dc : previous->dcs) {
+                if (it->second.dcs.find(dc.first) == it->second.dcs.end())
+                    fprintf(file, "gone\t%s\n", s_escape(dc.first).c_str());
+            }
+        }
+        previous = &it->second;
+    }
+    int rv = ferror(file) ? -1 : 0;
+    if (fclose(file) != 0)
+        rv = -1;
+    if (rv != 0)
+        log_error("upt_baseline_save: can't write %s", file_path);
+    return rv;
+}
+
+// parse "total\toffline\tunknown\tdurations..." and add it to counters, durations of states not
+// known to the writer stay as they are; return false if malformed
+static bool s_parse_counters(const char* value, upt_baseline_counters_t& counters)
+{
+    uint64_t* fields[3 + DC_STATE_COUNT] = {&counters.total, &counters.offline, &counters.unknown};
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+        fields[3 + state] = &counters.durations[state];
+    }
+    size_t count = 0;
+    while (count != 3 + DC_STATE_COUNT) {
+        char*   stop  = nullptr;
+        int64_t delta = strtoll(value, &stop, 10);
+        if (stop == value)
+            return false;
+        *fields[count++] += uint64_t(delta);
+        if (*stop == '\0')
+            break;
+        if (*stop != '\t')
+            return false;
+        value = stop + 1;
+    }
+    return count >= 3;
+}
+
+upt_baseline_t* upt_baseline_load(const char* file_path)
+{
+    assert(file_path);
+
+    FILE* file = fopen(file_path, "r");
+    if (!file) {
+        log_error("upt_baseline_load: can't open %s", file_path);
+        return nullptr;
+    }
+
+    upt_baseline_t* self     = upt_baseline_new();
+    s_baseline_t*   baseline = nullptr;
+    size_t          lineno   = 0;
+    char*           line     = nullptr;
+    size_t          size     = 0;
+    ssize_t         len;
+    while (self && (len = getline(&line, &size, file)) != -1) {
+        lineno++;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        if (len == 0 || line[0] == '#')
+            continue;
+
+        char* tab = strchr(line, '\t');
+        bool  ok  = tab != nullptr && tab[1] != '\0';
+        if (ok) {
+            *tab        = '\0';
+            char* value = tab + 1;
+            if (streq(line, "baseline")) {
+                // counters not listed are the ones of the previous baseline
+                char* stop  = nullptr;
+                char* taken = strchr(value, '\t');
+                ok          = taken != nullptr && taken != value;
+                if (ok) {
+                    *taken++           = '\0';
+                    s_baseline_t* next = &self->baselines[s_unescape(value)];
+                    next->seq          = ++self->seq;
+                    next->taken        = strtoll(taken, &stop, 10);
+                    ok                 = stop != taken && *stop == '\0';
+                    if (baseline)
+                        next->dcs = baseline->dcs;
+                    baseline = next;
+                }
+            } else if (streq(line, "dc") && baseline) {
+                // deltas are added to the counters of the previous baseline
+                char* counters = strchr(value, '\t');
+                ok             = counters != nullptr && counters != value;
+                if (ok) {
+                    *counters++                 = '\0';
+                    upt_baseline_counters_t& dc = baseline->dcs[s_unescape(value)];
+                    ok                          = s_parse_counters(counters, dc);
+                }
+            } else if (streq(line, "gone") && baseline) {
+                baseline->dcs.erase(s_unescape(value));
+            } else
+                ok = false;
+        }
+        if (!ok) {
+            log_error("upt_baseline_load: %s:%zu: malformed record", file_path, lineno);
+            upt_baseline_destroy(&self);
+        }
+    }
+    free(line);
+    fclose(file);
+    return self;
+}
@@ -0,0 +1,84 @@
+/*  =========================================================================
+    upt_baseline - Named baselines of datacenter counters
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "upt.h"
+#include <czmq.h>
+
+// Named snapshots of the counters of all datacenters, so that reports can ask for time since the
+// last audit or the start of a quarter without resetting anything. Counters only grow, a baseline
+// just remembers where they were, so a value since a baseline is a subtraction: O(1) per
+// datacenter whatever the number of baselines.
+//
+// Baselines file is a text file, one record per line, fields separated by tabs. Baselines are
+// written in the order they were taken and their counters are deltas against the previous one,
+// datacenters which did not change in between are left out and the ones which are gone since are
+// listed. Backslash, tab, newline and carriage return in names are escaped as \\, \t, \n and \r.
+//
+//  baseline    name    taken                               following records belong to this baseline
+//  dc          name    total   offline unknown durations...  deltas of counters of a datacenter
+//  gone        name                                        datacenter is not in this baseline
+
+struct upt_baseline_t;
+
+///  Counters of a datacenter (seconds)
+struct upt_baseline_counters_t
+{
+    uint64_t total;
+    uint64_t offline;
+    uint64_t unknown;
+    uint64_t durations[DC_STATE_COUNT];
+};
+
+///  Create an empty set of baselines
+upt_baseline_t* upt_baseline_new(void);
+
+///  Destroy the baselines
+void upt_baseline_destroy(upt_baseline_t** self_p);
+
+///  Take baseline name of all datacenters of upt at wall clock time taken (s), a baseline of the
+///  same name is replaced
+void upt_baseline_take(upt_baseline_t* self, const char* name, int64_t taken, upt_t* upt);
+
+///  Drop baseline name, return -1 if it is not known
+int upt_baseline_drop(upt_baseline_t* self, const char* name);
+
+///  Turn current counters of datacenter dc_name into counters since baseline name. A datacenter
+///  created after the baseline keeps all of them. Return -1 if the baseline is not known.
+int upt_baseline_since(upt_baseline_t* self, const char* name, const char* dc_name, upt_baseline_counters_t* counters);
+
+///  Return wall clock time (s) baseline name was taken, -1 if it is not known
+int64_t upt_baseline_taken(upt_baseline_t* self, const char* name);
+
+///  Number of baselines
+size_t upt_baseline_size(upt_baseline_t* self);
+
+///  Return the first baseline name (in alphabetical order) or nullptr
+const char* upt_baseline_first(upt_baseline_t* self);
+
+///  Return the next baseline name or nullptr
+const char* upt_baseline_next(upt_baseline_t* self);
+
+///  Save the baselines to file, return 0 on success
+int upt_baseline_save(upt_baseline_t* self, const char* file_path);
+
+///  Load baselines from file, return nullptr on error
+upt_baseline_t* upt_baseline_load(const char* file_path);
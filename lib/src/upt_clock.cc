@@ -0,0 +1,102 @@
+/*  =========================================================================
+    upt_clock - Time source of uptime accounting
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_clock - Time source of uptime accounting
+
+#include "upt_clock.h"
+
+static int64_t s_system_now(upt_clock_t* /* self */)
+{
+    return zclock_mono();
+}
+
+static int64_t s_sim_now(upt_clock_t* self)
+{
+    return self->sim.load();
+}
+
+static upt_clock_t s_system = {s_system_now, nullptr, {0}};
+
+upt_clock_t* upt_clock_system(void)
+{
+    return &s_system;
+}
+
+upt_clock_t* upt_clock_new(upt_clock_fn* now, void* arg)
+{
+    assert(now);
+
+    upt_clock_t* self = new upt_clock_t();
+    self->now         = now;
+    self->arg         = arg;
+    self->sim.store(0);
+    return self;
+}
+
+upt_clock_t* upt_clock_sim_new(int64_t start)
+{
+    upt_clock_t* self = upt_clock_new(s_sim_now, nullptr);
+    self->sim.store(start);
+    return self;
+}
+
+void upt_clock_destroy(upt_clock_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    if (*self_p != &s_system)
+        delete *self_p;
+    *self_p = nullptr;
+}
+
+int64_t upt_clock_now(upt_clock_t* self)
+{
+    if (!self)
+        return zclock_mono();
+    return self->now(self);
+}
+
+int64_t upt_clock_wall(upt_clock_t* self)
+{
+    if (!self || self == &s_system)
+        return zclock_time();
+    return self->now(self);
+}
+
+void upt_clock_advance(upt_clock_t* self, int64_t msec)
+{
+    assert(self);
+    assert(self->now == s_sim_now);
+
+    if (msec > 0)
+        self->sim.fetch_add(msec);
+}
+
+void upt_clock_set(upt_clock_t* self, int64_t msec)
+{
+    assert(self);
+    assert(self->now == s_sim_now);
+
+    int64_t current = self->sim.load();
+    while (msec > current && !self->sim.compare_exchange_weak(current, msec)) {
+    }
+}
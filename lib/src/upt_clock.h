@@ -0,0 +1,61 @@
+/*  =========================================================================
+    upt_clock - Time source of uptime accounting
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <atomic>
+#include <czmq.h>
+
+struct upt_clock_t;
+
+/// returns current time in msec, on a scale that never goes backwards
+typedef int64_t(upt_clock_fn)(upt_clock_t* self);
+
+struct upt_clock_t
+{
+    upt_clock_fn*        now;
+    void*                arg; // argument of a custom time source
+    std::atomic<int64_t> sim; // current time of a simulated clock, msec
+};
+
+///  Return the system clock (zclock_mono), shared and never destroyed
+upt_clock_t* upt_clock_system(void);
+
+///  Create a clock reading time from a custom function, arg is available as self->arg
+upt_clock_t* upt_clock_new(upt_clock_fn* now, void* arg);
+
+///  Create a simulated clock starting at start msec, it moves only by upt_clock_advance/upt_clock_set
+upt_clock_t* upt_clock_sim_new(int64_t start);
+
+///  Destroy the clock, the system clock is left alone
+void upt_clock_destroy(upt_clock_t** self_p);
+
+///  Return current time in msec, nullptr is the system clock
+int64_t upt_clock_now(upt_clock_t* self);
+
+///  Return wall clock time in msec (zclock_time) for the system clock, other clocks are their own
+///  wall clock and return upt_clock_now
+int64_t upt_clock_wall(upt_clock_t* self);
+
+///  Move a simulated clock forward by msec, can be called from any thread
+void upt_clock_advance(upt_clock_t* self, int64_t msec);
+
+///  Set a simulated clock to msec, it is not moved backwards
+void upt_clock_set(upt_clock_t* self, int64_t msec);
@@ -0,0 +1,185 @@
+/*  =========================================================================
+    upt_debounce - Debounce of flapping ups status
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_debounce - Debounce of flapping ups status
+
+#include "upt_debounce.h"
+
+// wheel of 100 msec ticks, one turn is a bit less than a minute
+#define WHEEL_TICK  100
+#define WHEEL_SLOTS 512
+
+struct s_ups_t
+{
+    dc_state_t accepted;
+    dc_state_t pending;
+    int64_t    since;    // msec pending state was first seen, -1 if none is pending
+    int64_t    deadline; // of the timer of the pending state on the wheel
+};
+
+struct s_expire_t
+{
+    upt_debounce_t*  self;
+    upt_debounce_fn* fn;
+    void*            arg;
+    int64_t          now;
+    size_t           count;
+};
+
+static void s_ups_destructor(void** x)
+{
+    free(*x);
+    *x = nullptr;
+}
+
+static int64_t s_dwell(upt_debounce_t* self, dc_state_t state)
+{
+    bool offline = state == DC_STATE_ON_BATTERY || state == DC_STATE_LOW_BATTERY;
+    return offline ? self->offline_ms : self->online_ms;
+}
+
+upt_debounce_t* upt_debounce_new(upt_clock_t* clock)
+{
+    upt_debounce_t* self = reinterpret_cast<upt_debounce_t*>(zmalloc(sizeof(upt_debounce_t)));
+    self->clock          = clock ? clock : upt_clock_system();
+    self->upses          = zhashx_new();
+    zhashx_set_destructor(self->upses, s_ups_destructor);
+    self->wheel = upt_wheel_new(WHEEL_TICK, WHEEL_SLOTS, upt_clock_now(self->clock));
+    return self;
+}
+
+void upt_debounce_destroy(upt_debounce_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    upt_debounce_t* self = *self_p;
+    zhashx_destroy(&self->upses);
+    upt_wheel_destroy(&self->wheel);
+    free(self);
+    *self_p = nullptr;
+}
+
+void upt_debounce_set_dwell(upt_debounce_t* self, int64_t offline_ms, int64_t online_ms)
+{
+    assert(self);
+
+    self->offline_ms = offline_ms > 0 ? offline_ms : 0;
+    self->online_ms  = online_ms > 0 ? online_ms : 0;
+}
+
+bool upt_debounce_observe(upt_debounce_t* self, const char* ups, dc_state_t state)
+{
+    assert(self);
+    assert(ups);
+
+    s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_lookup(self->upses, ups));
+    if (!entry) {
+        entry           = reinterpret_cast<s_ups_t*>(zmalloc(sizeof(s_ups_t)));
+        entry->accepted = state;
+        entry->since    = -1;
+        zhashx_insert(self->upses, ups, entry);
+        return true;
+    }
+
+    bool pending = entry->since != -1;
+    if (pending && entry->pending == state)
+        return false;
+    // pending state went away before its dwell, its timer is ignored on expiry
+    if (pending) {
+        self->flaps++;
+        entry->since = -1;
+    }
+    if (state == entry->accepted)
+        return false;
+
+    int64_t dwell = s_dwell(self, state);
+    if (dwell == 0) {
+        entry->accepted = state;
+        return true;
+    }
+    entry->pending  = state;
+    entry->since    = upt_clock_now(self->clock);
+    entry->deadline = entry->since + dwell;
+    upt_wheel_add(self->wheel, ups, entry->deadline);
+    return false;
+}
+
+void upt_debounce_forget(upt_debounce_t* self, const char* ups)
+{
+    assert(self);
+    assert(ups);
+
+    zhashx_delete(self->upses, ups);
+}
+
+static void s_expired(const char* ups, int64_t deadline, void* arg)
+{
+    s_expire_t* expire = reinterpret_cast<s_expire_t*>(arg);
+    s_ups_t*    entry  = reinterpret_cast<s_ups_t*>(zhashx_lookup(expire->self->upses, ups));
+
+    // timers of states given up meanwhile are stale, the pending state has its own timer
+    if (!entry || entry->since == -1 || entry->deadline != deadline)
+        return;
+    // a longer dwell set meanwhile needs a new one
+    int64_t due = entry->since + s_dwell(expire->self, entry->pending);
+    if (due > expire->now) {
+        entry->deadline = due;
+        upt_wheel_add(expire->self->wheel, ups, due);
+        return;
+    }
+
+    entry->accepted = entry->pending;
+    entry->since    = -1;
+    expire->self->delayed++;
+    expire->count++;
+    if (expire->fn)
+        expire->fn(ups, entry->accepted, expire->arg);
+}
+
+size_t upt_debounce_expire(upt_debounce_t* self, upt_debounce_fn* fn, void* arg)
+{
+    assert(self);
+
+    s_expire_t expire{self, fn, arg, upt_clock_now(self->clock), 0};
+    upt_wheel_advance(self->wheel, expire.now, s_expired, &expire);
+    return expire.count;
+}
+
+int64_t upt_debounce_next(upt_debounce_t* self)
+{
+    assert(self);
+
+    return upt_wheel_next(self->wheel);
+}
+
+size_t upt_debounce_pending(upt_debounce_t* self)
+{
+    assert(self);
+
+    size_t pending = 0;
+    for (s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_first(self->upses)); entry != nullptr;
+         entry          = reinterpret_cast<s_ups_t*>(zhashx_next(self->upses))) {
+        if (entry->since != -1)
+            pending++;
+    }
+    return pending;
+}
@@ -0,0 +1,70 @@
+/*  =========================================================================
+    upt_debounce - Debounce of flapping ups status
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "dc.h"
+#include "upt_clock.h"
+#include "upt_wheel.h"
+#include <czmq.h>
+
+// A new state of an ups is accepted only after it lasted for a dwell time, shorter excursions
+// are flaps which never reach the datacenters. Dwell differs by direction (hysteresis): one for
+// going offline (on battery) and one for any other state. Pending states wait on a timer wheel,
+// there are no timers or threads per ups.
+
+struct upt_debounce_t
+{
+    upt_clock_t* clock;      // time source, not owned
+    int64_t      offline_ms; // dwell before accepting an offline state
+    int64_t      online_ms;  // dwell before accepting any other state
+    zhashx_t*    upses;      // ups name -> accepted and pending state
+    upt_wheel_t* wheel;      // expiry of pending states
+    uint64_t     flaps;      // pending states given up before their dwell passed
+    uint64_t     delayed;    // states accepted after their dwell
+};
+
+///  Called for every pending state accepted by upt_debounce_expire
+typedef void(upt_debounce_fn)(const char* ups, dc_state_t state, void* arg);
+
+///  Create a new debounce on clock, nullptr is the system clock
+upt_debounce_t* upt_debounce_new(upt_clock_t* clock);
+
+///  Destroy the debounce, pending states are dropped
+void upt_debounce_destroy(upt_debounce_t** self_p);
+
+///  Set dwell (msec) before accepting an offline state and any other state, 0 accepts at once
+void upt_debounce_set_dwell(upt_debounce_t* self, int64_t offline_ms, int64_t online_ms);
+
+///  Observe state of ups, return true if it is accepted now and has to be applied. The first state
+///  of an ups is accepted at once, a different one waits for its dwell (see upt_debounce_expire).
+bool upt_debounce_observe(upt_debounce_t* self, const char* ups, dc_state_t state);
+
+///  Forget ups, its pending state is dropped and its next state is taken as the first one
+void upt_debounce_forget(upt_debounce_t* self, const char* ups);
+
+///  Accept pending states which lasted for their dwell, fn is called for each. Return their number.
+size_t upt_debounce_expire(upt_debounce_t* self, upt_debounce_fn* fn, void* arg);
+
+///  Return time (msec on the clock) of the next upt_debounce_expire with something to do, -1 if none
+int64_t upt_debounce_next(upt_debounce_t* self);
+
+///  Return number of upses with a pending state
+size_t upt_debounce_pending(upt_debounce_t* self);
@@ -0,0 +1,257 @@
+/*  =========================================================================
+    upt_export - Datacenter records as JSON Lines or CSV
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_export - Datacenter records as JSON Lines or CSV
+
+#include "upt_export.h"
+#include <cinttypes>
+
+int upt_export_format_parse(const char* name, upt_export_format_t* format)
+{
+    assert(format);
+
+    if (name && streq(name, "json"))
+        *format = UPT_EXPORT_JSON;
+    else if (name && streq(name, "csv"))
+        *format = UPT_EXPORT_CSV;
+    else
+        return -1;
+    return 0;
+}
+
+int upt_export_records_parse(const char* name, upt_export_records_t* records)
+{
+    assert(records);
+
+    if (name && streq(name, "dc"))
+        *records = UPT_EXPORT_DCS;
+    else if (name && streq(name, "window"))
+        *records = UPT_EXPORT_WINDOWS;
+    else if (name && streq(name, "ups"))
+        *records = UPT_EXPORT_UPSES;
+    else if (name && streq(name, "all"))
+        *records = UPT_EXPORT_ALL;
+    else
+        return -1;
+    return 0;
+}
+
+// JSON string with quotes, control characters escaped
+static void s_json_string(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const unsigned char* c = reinterpret_cast<const unsigned char*>(text); *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(file, "\\u%04x", *c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// CSV field, quoted when it holds a separator, a quote or a line break
+static void s_csv_field(FILE* file, const char* text)
+{
+    if (!strpbrk(text, ",\"\r\n")) {
+        fputs(text, file);
+        return;
+    }
+    fputc('"', file);
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"')
+            fputc('"', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// share of total the datacenter was not offline
+static double s_availability(uint64_t total, uint64_t offline)
+{
+    if (total == 0)
+        return 1.0;
+    return offline < total ? double(total - offline) / double(total) : 0.0;
+}
+
+// name of the datacenter, the first field of every record
+static void s_record(FILE* file, upt_export_format_t format, const char* record, const char* name)
+{
+    if (format == UPT_EXPORT_JSON) {
+        fprintf(file, "{\"record\":\"%s\",\"dc\":", record);
+        s_json_string(file, name);
+    } else
+        s_csv_field(file, name);
+}
+
+static void s_durations(FILE* file, upt_export_format_t format, const uint64_t* durations)
+{
+    if (format == UPT_EXPORT_JSON) {
+        fputs(",\"durations\":{", file);
+        for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+            fprintf(file, "%s\"%s\":%" PRIu64, state == DC_STATE_ONLINE ? "" : ",", dc_state_name(dc_state_t(state)),
+                durations[state]);
+        }
+        fputs("}}\n", file);
+    } else {
+        for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+            fprintf(file, ",%" PRIu64, durations[state]);
+        }
+        fputs("\r\n", file);
+    }
+}
+
+int upt_export_header(FILE* file, upt_export_format_t format, upt_export_records_t records)
+{
+    assert(file);
+
+    if (format != UPT_EXPORT_CSV)
+        return 0;
+    if (records == UPT_EXPORT_DCS)
+        fputs("dc,total,offline,unknown,availability,policy,threshold,upses,offline_upses", file);
+    else if (records == UPT_EXPORT_WINDOWS)
+        fputs("dc,baseline,taken,total,offline,unknown,availability", file);
+    else if (records == UPT_EXPORT_UPSES) {
+        fputs("dc,ups,state,on_battery,transitions,last_change\r\n", file);
+        return 0;
+    } else
+        return -1;
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+        fprintf(file, ",%s", dc_state_name(dc_state_t(state)));
+    }
+    fputs("\r\n", file);
+    return 0;
+}
+
+void upt_export_dc(FILE* file, upt_export_format_t format, const char* name, dc_t* dc, size_t upses)
+{
+    assert(file);
+    assert(name);
+    assert(dc);
+
+    uint64_t total, offline, durations[DC_STATE_COUNT];
+    dc_uptime(dc, &total, &offline);
+    dc_durations(dc, durations);
+    double availability = s_availability(total, offline);
+
+    s_record(file, format, "dc", name);
+    if (format == UPT_EXPORT_JSON)
+        fprintf(file,
+            ",\"total\":%" PRIu64 ",\"offline\":%" PRIu64 ",\"unknown\":%" PRIu64
+            ",\"availability\":%.6f,\"policy\":\"%s\",\"threshold\":%" PRIu64 ",\"upses\":%zu,\"offline_upses\":%zu",
+            total, offline, dc_unknown(dc), availability, dc_policy_name(dc->policy), dc->threshold, upses,
+            zlistx_size(dc->ups));
+    else
+        fprintf(file, ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.6f,%s,%" PRIu64 ",%zu,%zu", total, offline,
+            dc_unknown(dc), availability, dc_policy_name(dc->policy), dc->threshold, upses, zlistx_size(dc->ups));
+    s_durations(file, format, durations);
+}
+
+size_t upt_export_windows(FILE* file, upt_export_format_t format, const char* name, dc_t* dc, upt_baseline_t* baselines)
+{
+    assert(file);
+    assert(name);
+    assert(dc);
+    assert(baselines);
+
+    upt_baseline_counters_t now;
+    dc_uptime(dc, &now.total, &now.offline);
+    now.unknown = dc_unknown(dc);
+    dc_durations(dc, now.durations);
+
+    size_t count = 0;
+    for (const char* baseline = upt_baseline_first(baselines); baseline != nullptr;
+         baseline             = upt_baseline_next(baselines)) {
+        upt_baseline_counters_t counters = now;
+        upt_baseline_since(baselines, baseline, name, &counters);
+        double availability = s_availability(counters.total, counters.offline);
+
+        s_record(file, format, "window", name);
+        if (format == UPT_EXPORT_JSON) {
+            fputs(",\"baseline\":", file);
+            s_json_string(file, baseline);
+            fprintf(file,
+                ",\"taken\":%" PRIi64 ",\"total\":%" PRIu64 ",\"offline\":%" PRIu64 ",\"unknown\":%" PRIu64
+                ",\"availability\":%.6f",
+                upt_baseline_taken(baselines, baseline), counters.total, counters.offline, counters.unknown,
+                availability);
+        } else {
+            fputc(',', file);
+            s_csv_field(file, baseline);
+            fprintf(file, ",%" PRIi64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.6f",
+                upt_baseline_taken(baselines, baseline), counters.total, counters.offline, counters.unknown,
+                availability);
+        }
+        s_durations(file, format, counters.durations);
+        count++;
+    }
+    return count;
+}
+
+size_t upt_export_upses(FILE* file, upt_export_format_t format, const char* name, dc_t* dc)
+{
+    assert(file);
+    assert(name);
+    assert(dc);
+
+    if (!dc->counters)
+        return 0;
+    size_t count = 0;
+    for (void* it = zhashx_first(dc->counters); it != nullptr; it = zhashx_next(dc->counters)) {
+        const char*       ups = reinterpret_cast<const char*>(zhashx_cursor(dc->counters));
+        dc_ups_counters_t counters;
+        dc_ups_counters(dc, ups, &counters);
+        const char* state = dc_state_name(dc_ups_state(dc, ups));
+
+        s_record(file, format, "ups", name);
+        if (format == UPT_EXPORT_JSON) {
+            fputs(",\"ups\":", file);
+            s_json_string(file, ups);
+            fprintf(file,
+                ",\"state\":\"%s\",\"on_battery\":%" PRIu64 ",\"transitions\":%" PRIu64 ",\"last_change\":%" PRIi64
+                "}\n",
+                state, counters.on_battery, counters.transitions, counters.last_change);
+        } else {
+            fputc(',', file);
+            s_csv_field(file, ups);
+            fprintf(file, ",%s,%" PRIu64 ",%" PRIu64 ",%" PRIi64 "\r\n", state, counters.on_battery,
+                counters.transitions, counters.last_change);
+        }
+        count++;
+    }
+    return count;
+}
+
+size_t upt_export_write(FILE* file, upt_export_format_t format, upt_export_records_t records, const char* name,
+    dc_t* dc, size_t upses, upt_baseline_t* baselines)
+{
+    size_t count = 0;
+    if (records & UPT_EXPORT_DCS) {
+        upt_export_dc(file, format, name, dc, upses);
+        count++;
+    }
+    if ((records & UPT_EXPORT_WINDOWS) && baselines)
+        count += upt_export_windows(file, format, name, dc, baselines);
+    if (records & UPT_EXPORT_UPSES)
+        count += upt_export_upses(file, format, name, dc);
+    return count;
+}
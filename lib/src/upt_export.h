@@ -0,0 +1,74 @@
+/*  =========================================================================
+    upt_export - Datacenter records as JSON Lines or CSV
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "dc.h"
+#include "upt_baseline.h"
+#include <czmq.h>
+
+// Records of datacenters written as they come so that exports of any size take constant memory:
+// a JSON object per line (JSON Lines) or a CSV row after a header row. Counters are seconds,
+// availability is the share of total time the datacenter was not offline.
+//
+// Three kinds of records, JSON objects tell them apart by their "record" field
+//
+//  dc          counters of the datacenter
+//  window      counters of the datacenter since a baseline (see upt_baseline.h), one per baseline
+//  ups         outage counters of an ups which changed state while in the datacenter (see dc_top)
+//
+// A CSV export holds one kind of records only.
+
+enum upt_export_format_t
+{
+    UPT_EXPORT_JSON, // JSON Lines
+    UPT_EXPORT_CSV   // RFC 4180, header row first
+};
+
+enum upt_export_records_t
+{
+    UPT_EXPORT_DCS     = 1,
+    UPT_EXPORT_WINDOWS = 2,
+    UPT_EXPORT_UPSES   = 4,
+    UPT_EXPORT_ALL     = UPT_EXPORT_DCS | UPT_EXPORT_WINDOWS | UPT_EXPORT_UPSES
+};
+
+///  Parse name of format ("json" or "csv"), return -1 if it is not known
+int upt_export_format_parse(const char* name, upt_export_format_t* format);
+
+///  Parse kind of records ("dc", "window", "ups" or "all"), return -1 if it is not known
+int upt_export_records_parse(const char* name, upt_export_records_t* records);
+
+///  Write what comes before the first datacenter (CSV header row), return -1 if format can't hold
+///  the records
+int upt_export_header(FILE* file, upt_export_format_t format, upt_export_records_t records);
+
+///  Write datacenter name with upses members, counters are accounted up to now
+void upt_export_dc(FILE* file, upt_export_format_t format, const char* name, dc_t* dc, size_t upses);
+
+///  Write counters of datacenter name since every baseline of baselines, return number of records
+size_t upt_export_windows(FILE* file, upt_export_format_t format, const char* name, dc_t* dc, upt_baseline_t* baselines);
+
+///  Write outage counters of upses of datacenter name, return number of records
+size_t upt_export_upses(FILE* file, upt_export_format_t format, const char* name, dc_t* dc);
+
+///  Write records of datacenter name, baselines can be nullptr, return number of records
+size_t upt_export_write(FILE* file, upt_export_format_t format, upt_export_records_t records, const char* name,
+    dc_t* dc, size_t upses, upt_baseline_t* baselines);
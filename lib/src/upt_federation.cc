@@ -0,0 +1,314 @@
+/*  =========================================================================
+    upt_federation - Mergeable uptime state of several appliances
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_federation - Mergeable uptime state of several appliances
+
+#include "upt_federation.h"
+#include <fty_log.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// sorted, disjoint and non adjacent intervals [start, end)
+typedef std::vector<std::pair<int64_t, int64_t>> s_intervals_t;
+
+struct s_dc_t
+{
+    s_intervals_t         observed;
+    s_intervals_t         offline;
+    std::set<std::string> sources;
+    int64_t               last       = -1; // time of the previous observe, -1 if not watching
+    bool                  is_offline = false;
+};
+
+struct upt_federation_t
+{
+    std::string                             source;
+    std::map<std::string, s_dc_t>           dcs;
+    std::map<std::string, s_dc_t>::iterator cursor;
+};
+
+upt_federation_t* upt_federation_new(const char* source)
+{
+    upt_federation_t* self = new upt_federation_t;
+    self->source           = source ? source : "";
+    self->cursor           = self->dcs.end();
+    return self;
+}
+
+void upt_federation_destroy(upt_federation_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    delete *self_p;
+    *self_p = nullptr;
+}
+
+// append interval starting at or after the start of the last one
+static void s_append(s_intervals_t& set, int64_t start, int64_t end)
+{
+    if (end <= start)
+        return;
+    if (!set.empty() && start <= set.back().second) {
+        if (end > set.back().second)
+            set.back().second = end;
+    } else
+        set.emplace_back(start, end);
+}
+
+// union of two sets in one pass over both
+static void s_union(s_intervals_t& self, const s_intervals_t& other)
+{
+    if (other.empty())
+        return;
+
+    s_intervals_t out;
+    out.reserve(self.size() + other.size());
+    size_t i = 0, j = 0;
+    while (i != self.size() || j != other.size()) {
+        bool take_self = j == other.size() || (i != self.size() && self[i].first <= other[j].first);
+        const std::pair<int64_t, int64_t>& next = take_self ? self[i++] : other[j++];
+        s_append(out, next.first, next.second);
+    }
+    self.swap(out);
+}
+
+static void s_add(s_intervals_t& set, int64_t start, int64_t end)
+{
+    if (set.empty() || start >= set.back().first)
+        s_append(set, start, end);
+    else
+        s_union(set, s_intervals_t{{start, end}});
+}
+
+static uint64_t s_measure(const s_intervals_t& set)
+{
+    uint64_t sum = 0;
+    for (const auto& interval : set) {
+        sum += uint64_t(interval.second - interval.first);
+    }
+    return sum;
+}
+
+void upt_federation_observe(upt_federation_t* self, const char* dc_name, int64_t now, bool offline)
+{
+    assert(self);
+    assert(dc_name);
+
+    s_dc_t& dc = self->dcs[dc_name];
+    dc.sources.insert(self->source);
+
+    if (dc.last != -1 && now > dc.last) {
+        s_add(dc.observed, dc.last, now);
+        if (dc.is_offline)
+            s_add(dc.offline, dc.last, now);
+    }
+    if (dc.last == -1 || now > dc.last)
+        dc.last = now;
+    dc.is_offline = offline;
+}
+
+void upt_federation_leave(upt_federation_t* self, const char* dc_name, int64_t now)
+{
+    assert(self);
+    assert(dc_name);
+
+    auto it = self->dcs.find(dc_name);
+    if (it == self->dcs.end() || it->second.last == -1)
+        return;
+    upt_federation_observe(self, dc_name, now, it->second.is_offline);
+    it->second.last = -1;
+}
+
+void upt_federation_pause(upt_federation_t* self)
+{
+    assert(self);
+
+    for (auto& it : self->dcs) {
+        it.second.last = -1;
+    }
+}
+
+void upt_federation_merge(upt_federation_t* self, upt_federation_t* other)
+{
+    assert(self);
+    assert(other);
+
+    // both maps are sorted, walk them side by side, insertion before the hint is amortized constant
+    auto it = self->dcs.begin();
+    for (const auto& theirs : other->dcs) {
+        while (it != self->dcs.end() && it->first < theirs.first)
+            ++it;
+        if (it == self->dcs.end() || it->first != theirs.first) {
+            it = self->dcs.emplace_hint(it, theirs.first, theirs.second);
+            // what other is watching right now is not part of its snapshot
+            it->second.last = -1;
+            continue;
+        }
+        s_dc_t& ours = it->second;
+        s_union(ours.observed, theirs.second.observed);
+        s_union(ours.offline, theirs.second.offline);
+        ours.sources.insert(theirs.second.sources.begin(), theirs.second.sources.end());
+    }
+    self->cursor = self->dcs.end();
+}
+
+size_t upt_federation_size(upt_federation_t* self)
+{
+    assert(self);
+
+    return self->dcs.size();
+}
+
+int upt_federation_uptime(
+    upt_federation_t* self, const char* dc_name, uint64_t* total, uint64_t* offline, size_t* sources)
+{
+    assert(self);
+    assert(dc_name);
+    assert(total);
+    assert(offline);
+
+    auto it = self->dcs.find(dc_name);
+    if (it == self->dcs.end())
+        return -1;
+
+    *total   = s_measure(it->second.observed) / 1000;
+    *offline = s_measure(it->second.offline) / 1000;
+    if (sources)
+        *sources = it->second.sources.size();
+    return 0;
+}
+
+const char* upt_federation_first(upt_federation_t* self)
+{
+    assert(self);
+
+    self->cursor = self->dcs.begin();
+    return self->cursor == self->dcs.end() ? nullptr : self->cursor->first.c_str();
+}
+
+const char* upt_federation_next(upt_federation_t* self)
+{
+    assert(self);
+
+    if (self->cursor == self->dcs.end())
+        return nullptr;
+    ++self->cursor;
+    return self->cursor == self->dcs.end() ? nullptr : self->cursor->first.c_str();
+}
+
+int upt_federation_save(upt_federation_t* self, const char* file_path)
+{
+    assert(self);
+    assert(file_path);
+
+    FILE* file = fopen(file_path, "w");
+    if (!file) {
+        log_error("upt_federation_save: can't open %s", file_path);
+        return -1;
+    }
+
+    fprintf(file, "# fty-kpi-power-uptime federation snapshot\n");
+    for (const auto& it : self->dcs) {
+        fprintf(file, "dc\t%s\n", it.first.c_str());
+        for (const auto& source : it.second.sources) {
+            fprintf(file, "source\t%s\n", source.c_str());
+        }
+        for (const auto& interval : it.second.observed) {
+            fprintf(file, "observed\t%" PRIi64 "\t%" PRIi64 "\n", interval.first, interval.second);
+        }
+        for (const auto& interval : it.second.offline) {
+            fprintf(file, "offline\t%" PRIi64 "\t%" PRIi64 "\n", interval.first, interval.second);
+        }
+    }
+    int rv = ferror(file) ? -1 : 0;
+    if (fclose(file) != 0)
+        rv = -1;
+    if (rv != 0)
+        log_error("upt_federation_save: can't write %s", file_path);
+    return rv;
+}
+
+// parse "start\tend", return false if malformed or empty
+static bool s_parse_interval(const char* text, int64_t* start, int64_t* end)
+{
+    char* stop = nullptr;
+    *start     = strtoll(text, &stop, 10);
+    if (stop == text || *stop != '\t')
+        return false;
+    text = stop + 1;
+    *end = strtoll(text, &stop, 10);
+    return stop != text && *stop == '\0' && *end > *start;
+}
+
+upt_federation_t* upt_federation_load(const char* file_path, const char* source)
+{
+    assert(file_path);
+
+    FILE* file = fopen(file_path, "r");
+    if (!file) {
+        log_error("upt_federation_load: can't open %s", file_path);
+        return nullptr;
+    }
+
+    upt_federation_t* self   = upt_federation_new(source);
+    s_dc_t*           dc     = nullptr;
+    size_t            lineno = 0;
+    char*             line   = nullptr;
+    size_t            size   = 0;
+    ssize_t           len;
+    while (self && (len = getline(&line, &size, file)) != -1) {
+        lineno++;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        if (len == 0 || line[0] == '#')
+            continue;
+
+        char* tab = strchr(line, '\t');
+        bool  ok  = tab != nullptr && tab[1] != '\0';
+        if (ok) {
+            *tab              = '\0';
+            const char* value = tab + 1;
+            int64_t     start, end;
+            if (streq(line, "dc"))
+                dc = &self->dcs[value];
+            else if (!dc)
+                ok = false;
+            else if (streq(line, "source"))
+                dc->sources.insert(value);
+            else if (streq(line, "observed") && s_parse_interval(value, &start, &end))
+                s_add(dc->observed, start, end);
+            else if (streq(line, "offline") && s_parse_interval(value, &start, &end))
+                s_add(dc->offline, start, end);
+            else
+                ok = false;
+        }
+        if (!ok) {
+            log_error("upt_federation_load: %s:%zu: malformed record", file_path, lineno);
+            upt_federation_destroy(&self);
+        }
+    }
+    free(line);
+    fclose(file);
+    return self;
+}
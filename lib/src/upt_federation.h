@@ -0,0 +1,83 @@
+/*  =========================================================================
+    upt_federation - Mergeable uptime state of several appliances
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <czmq.h>
+
+// Availability of datacenters as seen by one or more appliances. For every datacenter it keeps
+// the set of time intervals some appliance watched it, the set of intervals some appliance saw
+// it offline and the names of those appliances. Times are msec of the wall clock.
+//
+// Sets are merged by union, which is commutative, associative and idempotent: snapshots of N
+// appliances, each watching part of the UPSes of a datacenter, merge to the same view in any
+// order, and merging a snapshot twice changes nothing. Under the `any` policy a datacenter is
+// offline while any of its UPSes is, so the union of offline intervals is what one appliance
+// watching all UPSes counts. Other policies need the status of UPSes seen by other appliances,
+// which a snapshot does not have: only datacenters under `any` are recorded.
+//
+// Snapshot file is a text file, one record per line, fields separated by tabs
+//
+//  dc          name            following records belong to this datacenter
+//  source      name            appliance which contributed to it
+//  observed    start   end     interval it was watched, [start, end)
+//  offline     start   end     interval it was offline, [start, end)
+
+struct upt_federation_t;
+
+///  Create an empty federation state recorded by appliance source
+upt_federation_t* upt_federation_new(const char* source);
+
+///  Destroy the federation state
+void upt_federation_destroy(upt_federation_t** self_p);
+
+///  Record that datacenter dc_name is offline (or not) at time now. Time since the previous record
+///  of dc_name is accounted as watched with the previous status; the first record only starts watching.
+void upt_federation_observe(upt_federation_t* self, const char* dc_name, int64_t now, bool offline);
+
+///  Stop watching datacenter dc_name at time now (its policy is no longer `any`), time since the
+///  previous record is accounted with the previous status. Next observe of it starts watching again.
+void upt_federation_leave(upt_federation_t* self, const char* dc_name, int64_t now);
+
+///  Stop watching all datacenters, next observe of each one starts watching again
+void upt_federation_pause(upt_federation_t* self);
+
+///  Add the intervals and sources of other to self, cost is linear in the size of both
+void upt_federation_merge(upt_federation_t* self, upt_federation_t* other);
+
+///  Number of datacenters
+size_t upt_federation_size(upt_federation_t* self);
+
+///  Compute watched and offline time of datacenter dc_name in seconds, sources is the number of
+///  appliances which contributed (can be nullptr). Return -1 if dc_name is unknown.
+int upt_federation_uptime(
+    upt_federation_t* self, const char* dc_name, uint64_t* total, uint64_t* offline, size_t* sources);
+
+///  Return the first datacenter name (in alphabetical order) or nullptr
+const char* upt_federation_first(upt_federation_t* self);
+
+///  Return the next datacenter name or nullptr
+const char* upt_federation_next(upt_federation_t* self);
+
+///  Save the snapshot to file, return 0 on success
+int upt_federation_save(upt_federation_t* self, const char* file_path);
+
+///  Load a snapshot from file, source of the result is the source given. Return nullptr on error.
+upt_federation_t* upt_federation_load(const char* file_path, const char* source);
@@ -0,0 +1,363 @@
+/*  =========================================================================
+    upt_replay - Offline replay of recorded UPS status and topology
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_replay - Offline replay of recorded UPS status and topology
+///
+/// Replay runs in two passes. The first one walks events in time order and resolves
+/// them against the topology valid at that moment into operations on one datacenter
+/// (create, ups offline, ups online). The second one applies those operations, each
+/// worker owning the datacenters of its shard, on its own simulated clock.
+///
+/// Unlike the live agent, time is accounted right before every change of status, so
+/// the result does not depend on how often metrics were polled. An ups may belong to several
+/// datacenters, its status counts in all of them, and it is set online in a datacenter it left.
+
+#include "upt_replay.h"
+#include "dc.h"
+#include <algorithm>
+#include <fty_log.h>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define NONE UINT32_MAX
+
+enum s_kind_t
+{
+    EVENT_STATUS_ONLINE,
+    EVENT_STATUS_OFFLINE,
+    EVENT_TOPOLOGY
+};
+
+struct s_event_t
+{
+    int64_t  time;
+    uint32_t kind;
+    uint32_t name; // ups for status, dc for topology
+    uint32_t list; // index of ups list of topology
+};
+
+struct s_op_t
+{
+    int64_t  time;
+    uint32_t kind; // EVENT_TOPOLOGY creates dc
+    uint32_t dc;
+    uint32_t ups;
+};
+
+struct upt_replay_t
+{
+    std::vector<std::string>                  names;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::vector<uint32_t>>        lists;
+    std::vector<s_event_t>                    events;
+};
+
+static uint32_t s_intern(upt_replay_t* self, const char* name, size_t len)
+{
+    std::string key(name, len);
+    auto        it = self->ids.find(key);
+    if (it != self->ids.end())
+        return it->second;
+    uint32_t id = uint32_t(self->names.size());
+    self->names.push_back(key);
+    self->ids.emplace(std::move(key), id);
+    return id;
+}
+
+upt_replay_t* upt_replay_new(void)
+{
+    return new upt_replay_t();
+}
+
+void upt_replay_destroy(upt_replay_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    delete *self_p;
+    *self_p = nullptr;
+}
+
+void upt_replay_status(upt_replay_t* self, int64_t time, const char* ups_name, bool onbattery)
+{
+    assert(self);
+    assert(ups_name);
+
+    self->events.push_back({time, onbattery ? EVENT_STATUS_OFFLINE : EVENT_STATUS_ONLINE,
+        s_intern(self, ups_name, strlen(ups_name)), NONE});
+}
+
+void upt_replay_topology(upt_replay_t* self, int64_t time, const char* dc_name, zlistx_t* ups)
+{
+    assert(self);
+    assert(dc_name);
+
+    std::vector<uint32_t> list;
+    for (char* ups_name = reinterpret_cast<char*>(zlistx_first(ups)); ups && ups_name != nullptr;
+         ups_name       = reinterpret_cast<char*>(zlistx_next(ups))) {
+        list.push_back(s_intern(self, ups_name, strlen(ups_name)));
+    }
+    self->events.push_back({time, EVENT_TOPOLOGY, s_intern(self, dc_name, strlen(dc_name)), uint32_t(self->lists.size())});
+    self->lists.push_back(std::move(list));
+}
+
+size_t upt_replay_size(upt_replay_t* self)
+{
+    assert(self);
+
+    return self->events.size();
+}
+
+// same rules as status metrics of the live agent
+static bool s_onbattery(const char* value, size_t len)
+{
+    if (len != 0 && isdigit(value[0]))
+        return (atoi(value) & 0x10) != 0;
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (value[i] == 'O' && value[i + 1] == 'B')
+            return true;
+    }
+    return false;
+}
+
+// parse one line (without the newline), return false if it is malformed
+static bool s_parse_line(upt_replay_t* self, const char* line, size_t len, int flags)
+{
+    const char* end    = line + len;
+    const char* fields[4];
+    size_t      sizes[4];
+    size_t      count = 0;
+    for (const char* start = line; count != 4; count++) {
+        const char* comma = count == 3 ? end : reinterpret_cast<const char*>(memchr(start, ',', size_t(end - start)));
+        if (!comma)
+            return false;
+        fields[count] = start;
+        sizes[count]  = size_t(comma - start);
+        start         = comma + (comma == end ? 0 : 1);
+    }
+
+    char*   time_end = nullptr;
+    int64_t time     = strtoll(fields[0], &time_end, 10);
+    if (time_end != fields[0] + sizes[0] || sizes[2] == 0)
+        return false;
+
+    if (sizes[1] == 6 && memcmp(fields[1], "status", 6) == 0) {
+        std::string value(fields[3], sizes[3]);
+        self->events.push_back({time, s_onbattery(value.c_str(), value.size()) ? EVENT_STATUS_OFFLINE : EVENT_STATUS_ONLINE,
+            s_intern(self, fields[2], sizes[2]), NONE});
+        return true;
+    }
+    if (sizes[1] == 8 && memcmp(fields[1], "topology", 8) == 0) {
+        if (flags & UPT_REPLAY_STATUS_ONLY)
+            return true;
+        std::vector<uint32_t> list;
+        const char*           ups     = fields[3];
+        const char*           ups_end = fields[3] + sizes[3];
+        while (ups < ups_end) {
+            const char* semicolon = reinterpret_cast<const char*>(memchr(ups, ';', size_t(ups_end - ups)));
+            if (!semicolon)
+                semicolon = ups_end;
+            if (semicolon != ups)
+                list.push_back(s_intern(self, ups, size_t(semicolon - ups)));
+            ups = semicolon + 1;
+        }
+        self->events.push_back({time, EVENT_TOPOLOGY, s_intern(self, fields[2], sizes[2]), uint32_t(self->lists.size())});
+        self->lists.push_back(std::move(list));
+        return true;
+    }
+    return false;
+}
+
+int64_t upt_replay_load(upt_replay_t* self, const char* path, int flags)
+{
+    assert(self);
+    assert(path);
+
+    FILE* file = streq(path, "-") ? stdin : fopen(path, "r");
+    if (!file) {
+        log_error("upt_replay_load: can't open %s", path);
+        return -1;
+    }
+
+    size_t  before = self->events.size();
+    size_t  lineno = 0;
+    size_t  errors = 0;
+    char*   line   = nullptr;
+    size_t  size   = 0;
+    ssize_t len;
+    while ((len = getline(&line, &size, file)) != -1) {
+        lineno++;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            len--;
+        if (len == 0 || line[0] == '#')
+            continue;
+        if (!s_parse_line(self, line, size_t(len), flags)) {
+            if (errors++ < 10)
+                log_warning("upt_replay_load: %s:%zu: malformed event skipped", path, lineno);
+        }
+    }
+    free(line);
+    if (file != stdin)
+        fclose(file);
+    if (errors != 0)
+        log_warning("upt_replay_load: %s: %zu malformed events skipped", path, errors);
+    return int64_t(self->events.size() - before);
+}
+
+// pass 1: resolve events up to until against the topology of their time, ops of each shard are in time order
+// ups2dc is left with the membership valid at until, an ups may belong to several datacenters
+static void s_resolve(upt_replay_t* self, int64_t until, size_t threads, std::vector<std::vector<s_op_t>>& shards,
+    std::vector<std::vector<uint32_t>>& ups2dc)
+{
+    size_t                             count = self->names.size();
+    std::vector<bool>                  offline(count, false);
+    std::vector<std::vector<uint32_t>> members(count);
+    std::vector<uint32_t>              shard_of(count, NONE);
+
+    auto shard = [&](uint32_t dc) -> std::vector<s_op_t>& {
+        if (shard_of[dc] == NONE)
+            shard_of[dc] = uint32_t(upt_shard_of(self->names[dc].c_str(), threads));
+        return shards[shard_of[dc]];
+    };
+
+    ups2dc.assign(count, {});
+    for (const s_event_t& event : self->events) {
+        if (event.time > until)
+            break;
+        if (event.kind == EVENT_TOPOLOGY) {
+            uint32_t                     dc   = event.name;
+            const std::vector<uint32_t>& list = self->lists[event.list];
+            shard(dc).push_back({event.time, EVENT_TOPOLOGY, dc, NONE});
+
+            // upses leaving dc, their other datacenters are kept
+            for (uint32_t ups : members[dc]) {
+                if (std::find(list.begin(), list.end(), ups) != list.end())
+                    continue;
+                std::vector<uint32_t>& dcs = ups2dc[ups];
+                auto                   it  = std::find(dcs.begin(), dcs.end(), dc);
+                if (it == dcs.end())
+                    continue;
+                dcs.erase(it);
+                if (offline[ups])
+                    shard(dc).push_back({event.time, EVENT_STATUS_ONLINE, dc, ups});
+            }
+            // upses joining dc bring their status along
+            for (uint32_t ups : list) {
+                std::vector<uint32_t>& dcs = ups2dc[ups];
+                if (std::find(dcs.begin(), dcs.end(), dc) != dcs.end())
+                    continue;
+                dcs.push_back(dc);
+                if (offline[ups])
+                    shard(dc).push_back({event.time, EVENT_STATUS_OFFLINE, dc, ups});
+            }
+            members[dc] = list;
+            continue;
+        }
+
+        bool onbattery = event.kind == EVENT_STATUS_OFFLINE;
+        if (offline[event.name] == onbattery)
+            continue;
+        offline[event.name] = onbattery;
+        for (uint32_t dc : ups2dc[event.name])
+            shard(dc).push_back({event.time, event.kind, dc, event.name});
+    }
+}
+
+// pass 2: apply ops of one shard on its own clock
+static void s_apply(upt_replay_t* self, const std::vector<s_op_t>& ops, int64_t until, std::vector<dc_t*>& dcs)
+{
+    upt_clock_t* clock = upt_clock_sim_new(ops.empty() ? until : ops.front().time);
+    uint64_t     total, offline;
+
+    for (const s_op_t& op : ops) {
+        upt_clock_set(clock, op.time);
+        dc_t*& dc = dcs[op.dc];
+        if (!dc) {
+            dc = dc_new_clock(clock);
+            continue;
+        }
+        if (op.kind == EVENT_TOPOLOGY)
+            continue;
+
+        // account time spent in the old status first
+        dc_uptime(dc, &total, &offline);
+        char* ups = const_cast<char*>(self->names[op.ups].c_str());
+        if (op.kind == EVENT_STATUS_OFFLINE)
+            dc_set_offline(dc, ups);
+        else
+            dc_set_online(dc, ups);
+    }
+
+    // bring every dc to until, then hand it over to the system clock
+    upt_clock_set(clock, until);
+    for (const s_op_t& op : ops) {
+        dc_t* dc = dcs[op.dc];
+        if (dc && dc->clock == clock)
+            dc_set_clock(dc, nullptr);
+    }
+    upt_clock_destroy(&clock);
+}
+
+upt_t* upt_replay_run(upt_replay_t* self, int64_t until, size_t threads)
+{
+    assert(self);
+
+    if (threads == 0)
+        threads = 1;
+
+    std::stable_sort(self->events.begin(), self->events.end(),
+        [](const s_event_t& a, const s_event_t& b) { return a.time < b.time; });
+    if (until < 0)
+        until = self->events.empty() ? 0 : self->events.back().time;
+
+    std::vector<std::vector<s_op_t>>   shards(threads);
+    std::vector<std::vector<uint32_t>> ups2dc;
+    s_resolve(self, until, threads, shards, ups2dc);
+
+    // shards own disjoint datacenters, so workers write disjoint slots
+    std::vector<dc_t*> dcs(self->names.size(), nullptr);
+    if (threads == 1)
+        s_apply(self, shards[0], until, dcs);
+    else {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i != threads; i++)
+            workers.emplace_back(s_apply, self, std::cref(shards[i]), until, std::ref(dcs));
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    upt_t* upt = upt_new();
+    for (uint32_t id = 0; id != dcs.size(); id++) {
+        if (dcs[id])
+            zhashx_insert(upt->dc, self->names[id].c_str(), dcs[id]);
+    }
+
+    for (uint32_t ups = 0; ups != ups2dc.size(); ups++) {
+        for (uint32_t dc : ups2dc[ups]) {
+            if (dcs[dc])
+                upt_add_member(upt, self->names[dc].c_str(), self->names[ups].c_str());
+        }
+    }
+    return upt;
+}
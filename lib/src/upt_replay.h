@@ -0,0 +1,55 @@
+/*  =========================================================================
+    upt_replay - Offline replay of recorded UPS status and topology
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "upt.h"
+#include <czmq.h>
+
+// Event log is CSV, one event per line, time in msec, lines starting with '#' are skipped:
+//  <time>,status,<ups>,<value>           value is a numeric ups.status (bit 0x10 is on battery) or a string with "OB"
+//  <time>,topology,<dc>,<ups>;<ups>;...  upses protecting dc from this moment on, dc starts counting on its first event
+
+// skip topology events while loading, to replay statuses against another topology
+#define UPT_REPLAY_STATUS_ONLY 1
+
+struct upt_replay_t;
+
+///  Create a new, empty replay
+upt_replay_t* upt_replay_new(void);
+
+///  Destroy the replay
+void upt_replay_destroy(upt_replay_t** self_p);
+
+///  Append events from a CSV file ("-" is stdin), return number of events read or -1 on error
+int64_t upt_replay_load(upt_replay_t* self, const char* path, int flags);
+
+///  Append a status event
+void upt_replay_status(upt_replay_t* self, int64_t time, const char* ups_name, bool onbattery);
+
+///  Append a topology event, ups is a list of ups names
+void upt_replay_topology(upt_replay_t* self, int64_t time, const char* dc_name, zlistx_t* ups);
+
+///  Return number of events
+size_t upt_replay_size(upt_replay_t* self);
+
+///  Replay all events in time order and account datacenters until msec (-1 is the time of the last event).
+///  Datacenters are split over threads workers. Return the state on the system clock, ready for upt_save.
+upt_t* upt_replay_run(upt_replay_t* self, int64_t until, size_t threads);
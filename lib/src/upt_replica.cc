@@ -0,0 +1,361 @@
+/*  =========================================================================
+    upt_replica - Streaming replication of uptime state
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_replica - Streaming replication of uptime state
+
+#include "upt_replica.h"
+#include "dc.h"
+#include <fty_log.h>
+
+upt_replica_t* upt_replica_new(void)
+{
+    upt_replica_t* self = reinterpret_cast<upt_replica_t*>(zmalloc(sizeof(upt_replica_t)));
+    if (!self)
+        return nullptr;
+    self->started    = zclock_mono();
+    self->catchup_ms = -1;
+    return self;
+}
+
+void upt_replica_destroy(upt_replica_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    free(*self_p);
+    *self_p = nullptr;
+}
+
+static zmsg_t* s_header(upt_replica_t* self, const char* topic)
+{
+    zmsg_t* msg = zmsg_new();
+    zmsg_addstr(msg, topic);
+    zmsg_addstrf(msg, "%" PRIu64, ++self->seq);
+    zmsg_addstrf(msg, "%" PRIi64, zclock_usecs());
+    return msg;
+}
+
+static void s_add_dc(zmsg_t* msg, const char* dc_name, dc_t* dc)
+{
+    uint64_t total, offline;
+    dc_uptime(dc, &total, &offline);
+    zmsg_addstr(msg, dc_name);
+    zframe_t* frame = dc_pack(dc);
+    zmsg_append(msg, &frame);
+}
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+static void s_list_destructor(void** x)
+{
+    zlistx_destroy(reinterpret_cast<zlistx_t**>(x));
+}
+
+zmsg_t* upt_replica_snapshot(upt_replica_t* self, upt_t* upt)
+{
+    assert(self);
+    assert(upt);
+
+    // members of every datacenter in one pass over ups2dc
+    zhashx_t* members = zhashx_new();
+    zhashx_set_destructor(members, s_list_destructor);
+    for (zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_first(upt->ups2dc)); dcs != nullptr;
+         dcs           = reinterpret_cast<zlistx_t*>(zhashx_next(upt->ups2dc))) {
+        for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dcs)); dc_name != nullptr;
+             dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+            zlistx_t* list = reinterpret_cast<zlistx_t*>(zhashx_lookup(members, dc_name));
+            if (!list) {
+                list = zlistx_new();
+                zhashx_insert(members, dc_name, list);
+            }
+            zlistx_add_end(list, const_cast<void*>(zhashx_cursor(upt->ups2dc)));
+        }
+    }
+
+    zmsg_t* msg = s_header(self, "UPT-SNAPSHOT");
+    zmsg_addstrf(msg, "%zu", zhashx_size(upt->dc));
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(upt->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(upt->dc))) {
+        const char* dc_name = reinterpret_cast<const char*>(zhashx_cursor(upt->dc));
+        s_add_dc(msg, dc_name, dc);
+        zlistx_t* list = reinterpret_cast<zlistx_t*>(zhashx_lookup(members, dc_name));
+        zmsg_addstrf(msg, "%zu", list ? zlistx_size(list) : 0);
+        for (char* ups = list ? reinterpret_cast<char*>(zlistx_first(list)) : nullptr; ups != nullptr;
+             ups       = reinterpret_cast<char*>(zlistx_next(list))) {
+            zmsg_addstr(msg, ups);
+        }
+    }
+    zhashx_destroy(&members);
+    return msg;
+}
+
+zmsg_t* upt_replica_delta(upt_replica_t* self, upt_t* upt, zhashx_t* dc_names)
+{
+    assert(self);
+    assert(upt);
+    assert(dc_names);
+
+    zmsg_t* msg   = s_header(self, "UPT-DELTA");
+    zmsg_t* items = zmsg_new();
+    size_t  count = 0;
+    for (void* item = zhashx_first(dc_names); item != nullptr; item = zhashx_next(dc_names)) {
+        const char* dc_name = reinterpret_cast<const char*>(zhashx_cursor(dc_names));
+        dc_t*       dc      = reinterpret_cast<dc_t*>(zhashx_lookup(upt->dc, dc_name));
+        if (!dc)
+            continue;
+        s_add_dc(items, dc_name, dc);
+        count++;
+    }
+    zmsg_addstrf(msg, "%zu", count);
+    for (zframe_t* frame = zmsg_pop(items); frame != nullptr; frame = zmsg_pop(items)) {
+        zmsg_append(msg, &frame);
+    }
+    zmsg_destroy(&items);
+    return msg;
+}
+
+zmsg_t* upt_replica_topology(upt_replica_t* self, upt_t* upt, const char* dc_name, zlistx_t* ups)
+{
+    assert(self);
+    assert(upt);
+    assert(dc_name);
+
+    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(upt->dc, dc_name));
+    if (!dc)
+        return nullptr;
+
+    zmsg_t* msg = s_header(self, "UPT-TOPOLOGY");
+    s_add_dc(msg, dc_name, dc);
+    zmsg_addstrf(msg, "%zu", ups ? zlistx_size(ups) : 0);
+    for (char* ups_name = ups ? reinterpret_cast<char*>(zlistx_first(ups)) : nullptr; ups_name != nullptr;
+         ups_name       = reinterpret_cast<char*>(zlistx_next(ups))) {
+        zmsg_addstr(msg, ups_name);
+    }
+    return msg;
+}
+
+// take counters and offline upses of a received dc, time continues on the clock of upt from now
+static void s_assign(upt_t* upt, const char* dc_name, dc_t** received_p)
+{
+    dc_t* received = *received_p;
+    received->clock       = upt->clock;
+    received->last_update = upt_clock_now(upt->clock) / 1000LL;
+    if (upt->table)
+        dc_set_slot(received, upt_table_slot(upt->table, dc_name));
+    // replaces the old dc, which is destroyed by the hash
+    zhashx_update(upt->dc, dc_name, received);
+    *received_p = nullptr;
+}
+
+// pop name/dc entry, return false if malformed
+static bool s_pop_dc(zmsg_t* msg, char** dc_name_p, dc_t** dc_p)
+{
+    *dc_name_p      = zmsg_popstr(msg);
+    zframe_t* frame = zmsg_pop(msg);
+    *dc_p           = frame ? dc_unpack(frame) : nullptr;
+    zframe_destroy(&frame);
+    if (*dc_name_p && *dc_p)
+        return true;
+    zstr_free(dc_name_p);
+    dc_destroy(dc_p);
+    return false;
+}
+
+// pop count/ups... into a new list
+static zlistx_t* s_pop_members(zmsg_t* msg)
+{
+    char* s_count = zmsg_popstr(msg);
+    if (!s_count)
+        return nullptr;
+    size_t count = size_t(atol(s_count));
+    zstr_free(&s_count);
+
+    zlistx_t* list = zlistx_new();
+    zlistx_set_destructor(list, s_str_destructor);
+    for (size_t i = 0; i != count; i++) {
+        char* ups = zmsg_popstr(msg);
+        if (!ups) {
+            zlistx_destroy(&list);
+            return nullptr;
+        }
+        zlistx_add_end(list, ups);
+    }
+    return list;
+}
+
+static int s_apply_snapshot(upt_t** upt_p, zmsg_t* msg)
+{
+    char* s_count = zmsg_popstr(msg);
+    if (!s_count)
+        return -1;
+    size_t count = size_t(atol(s_count));
+    zstr_free(&s_count);
+
+    upt_t* upt = upt_new();
+    upt_set_clock(upt, (*upt_p)->clock);
+    upt->table = (*upt_p)->table;
+    for (size_t i = 0; i != count; i++) {
+        char*     dc_name;
+        dc_t*     dc;
+        zlistx_t* members = nullptr;
+        if (!s_pop_dc(msg, &dc_name, &dc) || !(members = s_pop_members(msg))) {
+            if (dc_name) {
+                zstr_free(&dc_name);
+                dc_destroy(&dc);
+            }
+            upt_destroy(&upt);
+            return -1;
+        }
+        s_assign(upt, dc_name, &dc);
+        for (char* ups = reinterpret_cast<char*>(zlistx_first(members)); ups != nullptr;
+             ups       = reinterpret_cast<char*>(zlistx_next(members))) {
+            upt_add_member(upt, dc_name, ups);
+        }
+        zlistx_destroy(&members);
+        zstr_free(&dc_name);
+    }
+    upt_destroy(upt_p);
+    *upt_p = upt;
+    return 0;
+}
+
+static int s_apply_delta(upt_t* upt, zmsg_t* msg)
+{
+    char* s_count = zmsg_popstr(msg);
+    if (!s_count)
+        return -1;
+    size_t count = size_t(atol(s_count));
+    zstr_free(&s_count);
+
+    for (size_t i = 0; i != count; i++) {
+        char* dc_name;
+        dc_t* dc;
+        if (!s_pop_dc(msg, &dc_name, &dc))
+            return -1;
+        s_assign(upt, dc_name, &dc);
+        zstr_free(&dc_name);
+    }
+    return 0;
+}
+
+static int s_apply_topology(upt_t* upt, zmsg_t* msg)
+{
+    char* dc_name;
+    dc_t* dc;
+    if (!s_pop_dc(msg, &dc_name, &dc))
+        return -1;
+    zlistx_t* members = s_pop_members(msg);
+    if (!members) {
+        zstr_free(&dc_name);
+        dc_destroy(&dc);
+        return -1;
+    }
+    upt_add(upt, dc_name, members);
+    s_assign(upt, dc_name, &dc);
+    zlistx_destroy(&members);
+    zstr_free(&dc_name);
+    return 0;
+}
+
+int upt_replica_apply(upt_replica_t* self, upt_t** upt_p, zmsg_t** msg_p)
+{
+    assert(self);
+    assert(upt_p && *upt_p);
+    assert(msg_p);
+
+    zmsg_t* msg = *msg_p;
+    if (!msg)
+        return -1;
+    *msg_p = nullptr;
+
+    char* topic  = zmsg_popstr(msg);
+    char* s_seq  = zmsg_popstr(msg);
+    char* s_sent = zmsg_popstr(msg);
+    int   r      = -1;
+    if (topic && s_seq && s_sent) {
+        uint64_t seq  = uint64_t(atoll(s_seq));
+        int64_t  sent = atoll(s_sent);
+        self->received++;
+
+        if (streq(topic, "UPT-SNAPSHOT")) {
+            r = s_apply_snapshot(upt_p, msg);
+            if (r == 0) {
+                self->synced = true;
+                self->snapshots++;
+                if (self->catchup_ms == -1)
+                    self->catchup_ms = zclock_mono() - self->started;
+            }
+        } else if (!self->synced || seq != self->seq + 1) {
+            // lost something, deltas make sense only on top of what they follow
+            if (self->synced) {
+                log_warning("replica: expected message %" PRIu64 ", got %" PRIu64 ", waiting for snapshot",
+                    self->seq + 1, seq);
+                self->gaps++;
+            }
+            self->synced = false;
+        } else if (streq(topic, "UPT-DELTA"))
+            r = s_apply_delta(*upt_p, msg);
+        else if (streq(topic, "UPT-TOPOLOGY"))
+            r = s_apply_topology(*upt_p, msg);
+
+        if (r == 0) {
+            self->seq = seq;
+            int64_t lag = zclock_usecs() - sent;
+            upt_stats_histogram_add(&self->lag, lag > 0 ? uint64_t(lag) : 0);
+        } else if (self->synced) {
+            log_error("replica: malformed %s message %" PRIu64 ", waiting for snapshot", topic, seq);
+            self->synced = false;
+        }
+    }
+    zstr_free(&topic);
+    zstr_free(&s_seq);
+    zstr_free(&s_sent);
+    zmsg_destroy(&msg);
+    return r;
+}
+
+void upt_replica_report(upt_replica_t* self, zmsg_t* msg)
+{
+    assert(self);
+    assert(msg);
+
+    zmsg_addstr(msg, "replica.seq");
+    zmsg_addstrf(msg, "%" PRIu64, self->seq);
+    zmsg_addstr(msg, "replica.synced");
+    zmsg_addstrf(msg, "%d", self->synced ? 1 : 0);
+    zmsg_addstr(msg, "replica.received");
+    zmsg_addstrf(msg, "%" PRIu64, self->received);
+    zmsg_addstr(msg, "replica.gaps");
+    zmsg_addstrf(msg, "%" PRIu64, self->gaps);
+    zmsg_addstr(msg, "replica.snapshots");
+    zmsg_addstrf(msg, "%" PRIu64, self->snapshots);
+    zmsg_addstr(msg, "replica.catchup_ms");
+    zmsg_addstrf(msg, "%" PRIi64, self->catchup_ms);
+    zmsg_addstr(msg, "replica.lag.p50_us");
+    zmsg_addstrf(msg, "%" PRIu64, upt_stats_histogram_percentile(&self->lag, 50));
+    zmsg_addstr(msg, "replica.lag.p99_us");
+    zmsg_addstrf(msg, "%" PRIu64, upt_stats_histogram_percentile(&self->lag, 99));
+    zmsg_addstr(msg, "replica.lag.max_us");
+    zmsg_addstrf(msg, "%" PRIu64, self->lag.max_us);
+}
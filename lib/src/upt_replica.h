@@ -0,0 +1,73 @@
+/*  =========================================================================
+    upt_replica - Streaming replication of uptime state
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "upt.h"
+#include "upt_stats.h"
+#include <czmq.h>
+
+// Replication stream, every message starts with topic/seq/sent where seq grows by one with every
+// message and sent is zclock_usecs() of the leader (lag is meaningful between processes of one host).
+// Datacenter entries are name/dc_pack frame, counters folded at the time of sending.
+//
+//  UPT-SNAPSHOT/seq/sent/count/(name/dc/members/ups...)*count   whole state
+//  UPT-DELTA/seq/sent/count/(name/dc)*count                     counters of changed datacenters
+//  UPT-TOPOLOGY/seq/sent/name/dc/members/ups...                 new ups list of a datacenter
+//
+// Follower applies deltas only on top of the snapshot they follow, after a gap in seq it waits for
+// the next snapshot.
+
+#define UPT_REPLICA_TOPIC "UPT-"
+
+struct upt_replica_t
+{
+    uint64_t seq;        // leader: seq of the last message sent, follower: seq of the last message applied
+    bool     synced;     // follower: a snapshot was applied and no message was lost since
+    uint64_t received;   // follower: messages received
+    uint64_t gaps;       // follower: messages lost, each one forced to wait for a snapshot
+    uint64_t snapshots;  // follower: snapshots applied
+    int64_t  started;    // follower: zclock_mono() when following started
+    int64_t  catchup_ms; // follower: msec from start to the first snapshot, -1 before
+
+    upt_stats_histogram_t lag; // follower: usec from sending to applying a message
+};
+
+///  Create replication state, started is set to now
+upt_replica_t* upt_replica_new(void);
+
+///  Destroy replication state
+void upt_replica_destroy(upt_replica_t** self_p);
+
+///  Encode the whole state, seq of self is advanced
+zmsg_t* upt_replica_snapshot(upt_replica_t* self, upt_t* upt);
+
+///  Encode counters of datacenters named by keys of dc_names, seq of self is advanced
+zmsg_t* upt_replica_delta(upt_replica_t* self, upt_t* upt, zhashx_t* dc_names);
+
+///  Encode new list of upses of datacenter dc_name, seq of self is advanced
+zmsg_t* upt_replica_topology(upt_replica_t* self, upt_t* upt, const char* dc_name, zlistx_t* ups);
+
+///  Apply a message of the stream to *upt_p, snapshot replaces *upt_p. Message is destroyed.
+///  Return 0 if applied, -1 if dropped (out of sync or malformed)
+int upt_replica_apply(upt_replica_t* self, upt_t** upt_p, zmsg_t** msg_p);
+
+///  Append follower statistics to msg as name/value string pairs
+void upt_replica_report(upt_replica_t* self, zmsg_t* msg);
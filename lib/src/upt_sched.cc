@@ -0,0 +1,186 @@
+/*  =========================================================================
+    upt_sched - Timer scheduler of the server loop
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+/// upt_sched - Timer scheduler of the server loop
+
+#include "upt_sched.h"
+
+static void s_task_destructor(void** x)
+{
+    upt_sched_task_t** self_p = reinterpret_cast<upt_sched_task_t**>(x);
+    if (!*self_p)
+        return;
+    zstr_free(&(*self_p)->name);
+    free(*self_p);
+    *self_p = nullptr;
+}
+
+static int s_task_comparator(const void* a, const void* b)
+{
+    int64_t da = reinterpret_cast<const upt_sched_task_t*>(a)->deadline;
+    int64_t db = reinterpret_cast<const upt_sched_task_t*>(b)->deadline;
+    return da < db ? -1 : da > db ? 1 : 0;
+}
+
+upt_sched_t* upt_sched_new(upt_clock_t* clock)
+{
+    upt_sched_t* self = reinterpret_cast<upt_sched_t*>(zmalloc(sizeof(upt_sched_t)));
+    self->clock       = clock ? clock : upt_clock_system();
+    self->tasks       = zlistx_new();
+    zlistx_set_destructor(self->tasks, s_task_destructor);
+    return self;
+}
+
+void upt_sched_destroy(upt_sched_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    upt_sched_t* self = *self_p;
+    zlistx_destroy(&self->tasks);
+    free(self);
+    *self_p = nullptr;
+}
+
+upt_sched_task_t* upt_sched_add(upt_sched_t* self, const char* name, upt_sched_fn* fn, void* arg)
+{
+    assert(self);
+    assert(name);
+    assert(fn);
+
+    upt_sched_task_t* task = reinterpret_cast<upt_sched_task_t*>(zmalloc(sizeof(upt_sched_task_t)));
+    task->name             = strdup(name);
+    task->fn               = fn;
+    task->arg              = arg;
+    task->deadline         = -1;
+    task->period           = 0;
+    zlistx_add_end(self->tasks, task);
+    return task;
+}
+
+void upt_sched_arm(upt_sched_t* self, upt_sched_task_t* task, int64_t deadline)
+{
+    assert(self);
+    assert(task);
+
+    task->deadline = deadline;
+    task->period   = 0;
+}
+
+void upt_sched_arm_in(upt_sched_t* self, upt_sched_task_t* task, int64_t delay)
+{
+    assert(self);
+
+    upt_sched_arm(self, task, upt_clock_now(self->clock) + (delay > 0 ? delay : 0));
+}
+
+void upt_sched_every(upt_sched_t* self, upt_sched_task_t* task, int64_t period)
+{
+    assert(self);
+    assert(task);
+    assert(period > 0);
+
+    task->deadline = upt_clock_now(self->clock) + period;
+    task->period   = period;
+}
+
+void upt_sched_disarm(upt_sched_t* self, upt_sched_task_t* task)
+{
+    assert(self);
+    assert(task);
+
+    task->deadline = -1;
+    task->period   = 0;
+}
+
+int64_t upt_sched_timeout(upt_sched_t* self)
+{
+    assert(self);
+
+    int64_t deadline = -1;
+    for (upt_sched_task_t* task = reinterpret_cast<upt_sched_task_t*>(zlistx_first(self->tasks)); task != nullptr;
+         task                   = reinterpret_cast<upt_sched_task_t*>(zlistx_next(self->tasks))) {
+        if (task->deadline != -1 && (deadline == -1 || task->deadline < deadline))
+            deadline = task->deadline;
+    }
+    if (deadline == -1)
+        return -1;
+
+    int64_t timeout = deadline - upt_clock_now(self->clock);
+    return timeout > 0 ? timeout : 0;
+}
+
+size_t upt_sched_run(upt_sched_t* self)
+{
+    assert(self);
+
+    // tasks may arm and disarm each other, the due ones are taken first
+    int64_t   now = upt_clock_now(self->clock);
+    zlistx_t* due = zlistx_new();
+    zlistx_set_comparator(due, s_task_comparator);
+    for (void* task = zlistx_first(self->tasks); task != nullptr; task = zlistx_next(self->tasks)) {
+        int64_t deadline = reinterpret_cast<upt_sched_task_t*>(task)->deadline;
+        if (deadline != -1 && deadline <= now)
+            zlistx_add_end(due, task);
+    }
+    zlistx_sort(due);
+
+    size_t count = 0;
+    for (upt_sched_task_t* task = reinterpret_cast<upt_sched_task_t*>(zlistx_first(due)); task != nullptr;
+         task                   = reinterpret_cast<upt_sched_task_t*>(zlistx_next(due))) {
+        if (task->deadline == -1 || task->deadline > now)
+            continue;
+        upt_stats_histogram_add(&self->lag, uint64_t(now - task->deadline) * 1000);
+        if (task->period != 0) {
+            task->deadline += task->period;
+            if (task->deadline <= now)
+                task->deadline = now + task->period;
+        } else
+            task->deadline = -1;
+        task->runs++;
+        count++;
+        task->fn(task->arg);
+    }
+    zlistx_destroy(&due);
+
+    if (count != 0)
+        self->wakeups++;
+    self->runs += count;
+    return count;
+}
+
+void upt_sched_report(upt_sched_t* self, zmsg_t* msg)
+{
+    assert(self);
+    assert(msg);
+
+    zmsg_addstr(msg, "timer.wakeups");
+    zmsg_addstrf(msg, "%" PRIu64, self->wakeups);
+    zmsg_addstr(msg, "timer.runs");
+    zmsg_addstrf(msg, "%" PRIu64, self->runs);
+    for (upt_sched_task_t* task = reinterpret_cast<upt_sched_task_t*>(zlistx_first(self->tasks)); task != nullptr;
+         task                   = reinterpret_cast<upt_sched_task_t*>(zlistx_next(self->tasks))) {
+        zmsg_addstrf(msg, "timer.%s.runs", task->name);
+        zmsg_addstrf(msg, "%" PRIu64, task->runs);
+    }
+    upt_stats_histogram_report(&self->lag, "timer.lag", msg);
+}
@@ -0,0 +1,87 @@
+/*  =========================================================================
+    upt_sched - Timer scheduler of the server loop
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+#pragma once
+#include "upt_clock.h"
+#include "upt_stats.h"
+#include <czmq.h>
+
+// Deadlines of the periodic and one-shot work of the server loop (polling shm, expiring debounce
+// and stale timers, closing the bootstrap window, dumping statistics, replica snapshots). The
+// loop waits for messages at most upt_sched_timeout msec and calls upt_sched_run, so it wakes only
+// when something is due. Tasks are few, they are kept in a list and scanned.
+
+struct upt_sched_task_t;
+
+///  Work of a task, arg is the one given to upt_sched_add
+typedef void(upt_sched_fn)(void* arg);
+
+struct upt_sched_t
+{
+    upt_clock_t*          clock;   // time source, not owned
+    zlistx_t*             tasks;   // upt_sched_task_t, owned
+    uint64_t              wakeups; // upt_sched_run calls which found something due
+    uint64_t              runs;    // tasks run
+    upt_stats_histogram_t lag;     // how late tasks ran after their deadline
+};
+
+struct upt_sched_task_t
+{
+    char*         name;
+    upt_sched_fn* fn;
+    void*         arg;
+    int64_t       deadline; // msec on the clock of the scheduler, -1 when not armed
+    int64_t       period;   // msec between two runs, 0 for a one-shot task
+    uint64_t      runs;     // times the task was run
+};
+
+///  Create new scheduler on clock, nullptr is the system clock
+upt_sched_t* upt_sched_new(upt_clock_t* clock);
+
+///  Destroy the scheduler and its tasks
+void upt_sched_destroy(upt_sched_t** self_p);
+
+///  Add task name calling fn(arg), it is not armed. Task is owned by the scheduler.
+upt_sched_task_t* upt_sched_add(upt_sched_t* self, const char* name, upt_sched_fn* fn, void* arg);
+
+///  Run task once at deadline (msec on the clock), a periodic task becomes a one-shot one
+void upt_sched_arm(upt_sched_t* self, upt_sched_task_t* task, int64_t deadline);
+
+///  Run task once delay msec from now
+void upt_sched_arm_in(upt_sched_t* self, upt_sched_task_t* task, int64_t delay);
+
+///  Run task every period msec, first one period from now. Runs missed by a late loop are skipped.
+void upt_sched_every(upt_sched_t* self, upt_sched_task_t* task, int64_t period);
+
+///  Do not run task until it is armed again
+void upt_sched_disarm(upt_sched_t* self, upt_sched_task_t* task);
+
+///  Return msec until the earliest deadline, 0 if something is due, -1 if no task is armed
+int64_t upt_sched_timeout(upt_sched_t* self);
+
+///  Run the tasks which are due, earliest deadline first. Tasks armed by them in the past run at
+///  the next call. Return number of tasks run.
+size_t upt_sched_run(upt_sched_t* self);
+
+///  Append timer.wakeups, timer.runs, timer.<task>.runs and timer.lag histogram to msg as
+///  name/value pairs
+void upt_sched_report(upt_sched_t* self, zmsg_t* msg);
@@ -0,0 +1,347 @@
+/*  =========================================================================
+    upt_shard - Actor owning a slice of the uptime state
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_shard - Actor owning a slice of the uptime state
+
+#include "upt_shard.h"
+#include <fty_log.h>
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+static void s_handle_topology(upt_t* upt, zmsg_t* msg)
+{
+    char* dc_name = zmsg_popstr(msg);
+    if (!dc_name)
+        return;
+
+    zlistx_t* ups = zlistx_new();
+    zlistx_set_destructor(ups, s_str_destructor);
+    for (char* ups_name = zmsg_popstr(msg); ups_name != nullptr; ups_name = zmsg_popstr(msg)) {
+        zlistx_add_end(ups, ups_name);
+    }
+    upt_add(upt, dc_name, ups);
+
+    uint64_t total, offline;
+    upt_uptime(upt, dc_name, &total, &offline);
+
+    zlistx_destroy(&ups);
+    zstr_free(&dc_name);
+}
+
+// POLICY/dc/policy/threshold and RATING/dc/ups/rating
+static void s_handle_policy(upt_t* upt, zmsg_t* msg, bool rating)
+{
+    char* dc_name = zmsg_popstr(msg);
+    char* arg     = zmsg_popstr(msg);
+    char* value   = zmsg_popstr(msg);
+
+    dc_policy_t policy;
+    if (!dc_name || !arg || !value)
+        log_warning("upt_shard: malformed %s message", rating ? "RATING" : "POLICY");
+    else if (rating)
+        upt_set_rating(upt, dc_name, arg, strtoull(value, nullptr, 10));
+    else if (dc_policy_parse(arg, &policy) == 0)
+        upt_set_policy(upt, dc_name, policy, strtoull(value, nullptr, 10));
+
+    zstr_free(&dc_name);
+    zstr_free(&arg);
+    zstr_free(&value);
+}
+
+// return number of ups status changes
+static uint64_t s_handle_status(upt_t* upt, zmsg_t* msg)
+{
+    uint64_t transitions = 0;
+    while (zmsg_size(msg) >= 2) {
+        char* ups_name = zmsg_popstr(msg);
+        char* flag     = zmsg_popstr(msg);
+        int   state    = atoi(flag);
+
+        zlistx_t* dcs = upt_dc_names(upt, ups_name);
+        if (dcs && state >= DC_STATE_ONLINE && state < DC_STATE_COUNT) {
+            // time up to now belongs to the old state, account it before the change
+            uint64_t total, offline;
+            for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dcs)); dc_name != nullptr;
+                 dc_name       = reinterpret_cast<char*>(zlistx_next(dcs))) {
+                upt_uptime(upt, dc_name, &total, &offline);
+            }
+            if (upt_set_state(upt, ups_name, dc_state_t(state)))
+                transitions++;
+        }
+        zstr_free(&ups_name);
+        zstr_free(&flag);
+    }
+    return transitions;
+}
+
+void upt_shard(zsock_t* pipe, void* args)
+{
+    upt_t* upt = reinterpret_cast<upt_t*>(args);
+    assert(upt);
+    upt_snapshot_t* snapshot    = nullptr;
+    uint64_t        transitions = 0;
+    zsock_signal(pipe, 0);
+
+    while (!zsys_interrupted) {
+        zmsg_t* msg = zmsg_recv(pipe);
+        if (!msg)
+            break;
+
+        char* cmd = zmsg_popstr(msg);
+        if (!cmd) {
+            log_warning("upt_shard: missing command in pipe");
+            zmsg_destroy(&msg);
+            continue;
+        }
+
+        if (streq(cmd, "$TERM")) {
+            zstr_free(&cmd);
+            zmsg_destroy(&msg);
+            break;
+        } else if (streq(cmd, "STATUS")) {
+            transitions += s_handle_status(upt, msg);
+            if (snapshot)
+                upt_snapshot_publish(snapshot, upt);
+        } else if (streq(cmd, "TOPOLOGY")) {
+            s_handle_topology(upt, msg);
+            if (snapshot)
+                upt_snapshot_publish(snapshot, upt);
+        } else if (streq(cmd, "POLICY") || streq(cmd, "RATING")) {
+            s_handle_policy(upt, msg, streq(cmd, "RATING"));
+            if (snapshot)
+                upt_snapshot_publish(snapshot, upt);
+        } else if (streq(cmd, "PUBLISH")) {
+            zframe_t* frame = zmsg_pop(msg);
+            if (frame && zframe_size(frame) == sizeof(void*)) {
+                memcpy(&snapshot, zframe_data(frame), sizeof(void*));
+                upt_snapshot_publish(snapshot, upt);
+            }
+            zframe_destroy(&frame);
+        } else if (streq(cmd, "UPTIME")) {
+            char*    dc_name = zmsg_popstr(msg);
+            uint64_t total = 0, offline = 0;
+            int      r     = dc_name ? upt_uptime(upt, dc_name, &total, &offline) : -1;
+            zsock_send(pipe, "i88", r, total, offline);
+            zstr_free(&dc_name);
+        } else if (streq(cmd, "DURATIONS")) {
+            char*    dc_name                   = zmsg_popstr(msg);
+            uint64_t durations[DC_STATE_COUNT] = {};
+            int      r = dc_name ? upt_durations(upt, dc_name, durations) : -1;
+            zsock_send(pipe, "ib", r, durations, sizeof(durations));
+            zstr_free(&dc_name);
+        } else if (streq(cmd, "TOP")) {
+            // n is checked by the sender
+            char*     dc_name = zmsg_popstr(msg);
+            zframe_t* frame   = zmsg_pop(msg);
+            size_t    n       = 0;
+            if (frame && zframe_size(frame) == sizeof(n))
+                memcpy(&n, zframe_data(frame), sizeof(n));
+            zsock_send(pipe, "p", dc_name && n != 0 ? upt_top(upt, dc_name, n) : nullptr);
+            zstr_free(&dc_name);
+            zframe_destroy(&frame);
+        } else if (streq(cmd, "TRANSITIONS")) {
+            zsock_send(pipe, "8", transitions);
+        } else if (streq(cmd, "SNAPSHOT")) {
+            zsock_send(pipe, "p", upt_dup(upt));
+        } else if (streq(cmd, "COPY")) {
+            zlistx_t* dc_names = zlistx_new();
+            zlistx_set_destructor(dc_names, s_str_destructor);
+            for (char* dc_name = zmsg_popstr(msg); dc_name != nullptr; dc_name = zmsg_popstr(msg))
+                zlistx_add_end(dc_names, dc_name);
+            zsock_send(pipe, "p", upt_dup_dcs(upt, dc_names));
+            zlistx_destroy(&dc_names);
+        } else {
+            log_warning("upt_shard: unknown command %s", cmd);
+        }
+        zstr_free(&cmd);
+        zmsg_destroy(&msg);
+    }
+    upt_destroy(&upt);
+}
+
+void upt_shard_topology(zactor_t* self, const char* dc_name, zlistx_t* ups)
+{
+    assert(self);
+    assert(dc_name);
+
+    zmsg_t* msg = zmsg_new();
+    zmsg_addstr(msg, "TOPOLOGY");
+    zmsg_addstr(msg, dc_name);
+    if (ups) {
+        for (char* ups_name = reinterpret_cast<char*>(zlistx_first(ups)); ups_name != nullptr;
+             ups_name       = reinterpret_cast<char*>(zlistx_next(ups))) {
+            zmsg_addstr(msg, ups_name);
+        }
+    }
+    zmsg_send(&msg, self);
+}
+
+void upt_shard_policy(zactor_t* self, const char* dc_name, dc_policy_t policy, uint64_t threshold)
+{
+    assert(self);
+    assert(dc_name);
+
+    zmsg_t* msg = zmsg_new();
+    zmsg_addstr(msg, "POLICY");
+    zmsg_addstr(msg, dc_name);
+    zmsg_addstr(msg, dc_policy_name(policy));
+    zmsg_addstrf(msg, "%" PRIu64, threshold);
+    zmsg_send(&msg, self);
+}
+
+void upt_shard_rating(zactor_t* self, const char* dc_name, const char* ups_name, uint64_t rating)
+{
+    assert(self);
+    assert(dc_name);
+    assert(ups_name);
+
+    zmsg_t* msg = zmsg_new();
+    zmsg_addstr(msg, "RATING");
+    zmsg_addstr(msg, dc_name);
+    zmsg_addstr(msg, ups_name);
+    zmsg_addstrf(msg, "%" PRIu64, rating);
+    zmsg_send(&msg, self);
+}
+
+void upt_shard_status_add(zmsg_t** batch_p, const char* ups_name, dc_state_t state)
+{
+    assert(batch_p);
+    assert(ups_name);
+
+    if (!*batch_p) {
+        *batch_p = zmsg_new();
+        zmsg_addstr(*batch_p, "STATUS");
+    }
+    zmsg_addstr(*batch_p, ups_name);
+    zmsg_addstrf(*batch_p, "%d", int(state));
+}
+
+void upt_shard_status(zactor_t* self, zmsg_t** batch_p)
+{
+    assert(self);
+    assert(batch_p);
+
+    if (*batch_p)
+        zmsg_send(batch_p, self);
+}
+
+int upt_shard_uptime(zactor_t* self, const char* dc_name, uint64_t* total, uint64_t* offline)
+{
+    assert(self);
+    assert(dc_name);
+
+    int r    = -1;
+    *total   = 0;
+    *offline = 0;
+    zsock_send(self, "ss", "UPTIME", dc_name);
+    if (zsock_recv(self, "i88", &r, total, offline) == -1)
+        return -1;
+    return r;
+}
+
+int upt_shard_durations(zactor_t* self, const char* dc_name, uint64_t* durations)
+{
+    assert(self);
+    assert(dc_name);
+    assert(durations);
+
+    int    r    = -1;
+    byte*  data = nullptr;
+    size_t size = 0;
+    zsock_send(self, "ss", "DURATIONS", dc_name);
+    if (zsock_recv(self, "ib", &r, &data, &size) == -1)
+        return -1;
+    if (data && size == DC_STATE_COUNT * sizeof(uint64_t))
+        memcpy(durations, data, size);
+    else
+        r = -1;
+    free(data);
+    return r;
+}
+
+zmsg_t* upt_shard_top(zactor_t* self, const char* dc_name, size_t n)
+{
+    assert(self);
+    assert(dc_name);
+
+    zmsg_t* msg = zmsg_new();
+    zmsg_addstr(msg, "TOP");
+    zmsg_addstr(msg, dc_name);
+    zmsg_addmem(msg, &n, sizeof(n));
+    zmsg_send(&msg, self);
+
+    zmsg_t* top = nullptr;
+    if (zsock_recv(self, "p", &top) == -1)
+        return nullptr;
+    return top;
+}
+
+upt_t* upt_shard_snapshot(zactor_t* self)
+{
+    assert(self);
+
+    upt_t* upt = nullptr;
+    zsock_send(self, "s", "SNAPSHOT");
+    if (zsock_recv(self, "p", &upt) == -1)
+        return nullptr;
+    return upt;
+}
+
+upt_t* upt_shard_copy(zactor_t* self, zlistx_t* dc_names)
+{
+    assert(self);
+    assert(dc_names);
+
+    zmsg_t* msg = zmsg_new();
+    zmsg_addstr(msg, "COPY");
+    for (char* dc_name = reinterpret_cast<char*>(zlistx_first(dc_names)); dc_name != nullptr;
+         dc_name       = reinterpret_cast<char*>(zlistx_next(dc_names))) {
+        zmsg_addstr(msg, dc_name);
+    }
+    zmsg_send(&msg, self);
+
+    upt_t* upt = nullptr;
+    if (zsock_recv(self, "p", &upt) == -1)
+        return nullptr;
+    return upt;
+}
+
+uint64_t upt_shard_transitions(zactor_t* self)
+{
+    assert(self);
+
+    uint64_t transitions = 0;
+    zsock_send(self, "s", "TRANSITIONS");
+    if (zsock_recv(self, "8", &transitions) == -1)
+        return 0;
+    return transitions;
+}
+
+void upt_shard_publish(zactor_t* self, upt_snapshot_t* snapshot)
+{
+    assert(self);
+    assert(snapshot);
+
+    zsock_send(self, "sp", "PUBLISH", snapshot);
+}
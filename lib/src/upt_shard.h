@@ -0,0 +1,73 @@
+/*  =========================================================================
+    upt_shard - Actor owning a slice of the uptime state
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "upt.h"
+#include "upt_snapshot.h"
+#include <czmq.h>
+
+//  Create new shard, it takes ownership of upt and is the only thread touching it
+//
+//      zactor_t *shard = zactor_new (upt_shard, upt_partition (upt, index, count));
+//
+//  Destroy the shard
+//      zactor_destroy (&shard);
+//
+//  Commands are sent by helpers below, TOPOLOGY, POLICY, RATING and STATUS are asynchronous,
+//  UPTIME, DURATIONS, TOP, SNAPSHOT and COPY wait for the reply of the shard.
+//
+void upt_shard(zsock_t* pipe, void* args);
+
+/// replace the list of upses of datacenter dc_name
+void upt_shard_topology(zactor_t* self, const char* dc_name, zlistx_t* ups);
+
+/// set when datacenter dc_name is offline, see upt_set_policy
+void upt_shard_policy(zactor_t* self, const char* dc_name, dc_policy_t policy, uint64_t threshold);
+
+/// set rated capacity of ups of datacenter dc_name, see upt_set_rating
+void upt_shard_rating(zactor_t* self, const char* dc_name, const char* ups_name, uint64_t rating);
+
+/// add state of one ups to batch, batch is created if *batch_p is nullptr
+void upt_shard_status_add(zmsg_t** batch_p, const char* ups_name, dc_state_t state);
+
+/// send a batch of ups statuses to the shard, batch is destroyed
+void upt_shard_status(zactor_t* self, zmsg_t** batch_p);
+
+/// compute uptime of datacenter owned by the shard, return -1 if unknown
+int upt_shard_uptime(zactor_t* self, const char* dc_name, uint64_t* total, uint64_t* offline);
+
+/// compute time spent by datacenter owned by the shard in every state (see upt_durations), return -1 if unknown
+int upt_shard_durations(zactor_t* self, const char* dc_name, uint64_t* durations);
+
+/// get upses of datacenter owned by the shard with the most on battery seconds (see upt_top), nullptr if unknown
+zmsg_t* upt_shard_top(zactor_t* self, const char* dc_name, size_t n);
+
+/// return a copy of the state owned by the shard, caller is responsible for destroying it
+upt_t* upt_shard_snapshot(zactor_t* self);
+
+/// return a copy of datacenters dc_names owned by the shard (see upt_dup_dcs), caller is responsible for destroying it
+upt_t* upt_shard_copy(zactor_t* self, zlistx_t* dc_names);
+
+/// return number of ups status changes applied by the shard so far
+uint64_t upt_shard_transitions(zactor_t* self);
+
+/// make the shard publish its counters to snapshot after every change, snapshot must outlive the shard
+void upt_shard_publish(zactor_t* self, upt_snapshot_t* snapshot);
@@ -0,0 +1,216 @@
+/*  =========================================================================
+    upt_snapshot - Immutable snapshots of DC counters for lock-free readers
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_snapshot - Immutable snapshots of DC counters for lock-free readers
+
+#include "upt_snapshot.h"
+#include "dc.h"
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// reader is not inside of a read side critical section
+#define READER_IDLE UINT64_MAX
+
+struct s_counters_t
+{
+    int64_t  last_update;
+    uint64_t total;
+    uint64_t offline;
+    uint64_t unknown;
+    bool     is_offline;
+    uint64_t durations[DC_STATE_COUNT];
+    uint32_t accounting; // bit of every state time is accounted to until the next change
+};
+
+static s_counters_t s_counters(dc_t* dc)
+{
+    s_counters_t counters{dc->last_update, dc->total, dc->offline, dc->unknown, dc_is_offline(dc), {}, 0};
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+        counters.durations[state] = dc->durations[state];
+        if (state != DC_STATE_ONLINE && dc->in_state[state] != 0)
+            counters.accounting |= 1u << state;
+    }
+    if (counters.accounting == 0)
+        counters.accounting = 1u << DC_STATE_ONLINE;
+    return counters;
+}
+
+struct s_snapshot_t
+{
+    uint64_t                                      generation;
+    upt_clock_t*                                  clock;
+    std::unordered_map<std::string, s_counters_t> dcs;
+};
+
+struct upt_snapshot_t
+{
+    std::atomic<s_snapshot_t*>          current;
+    std::atomic<uint64_t>               generation;
+    std::vector<std::atomic<uint64_t>>  readers; // generation each reader may still use, READER_IDLE if none
+    std::vector<s_snapshot_t*>          retired; // replaced snapshots, owned by the writer
+
+    explicit upt_snapshot_t(size_t count)
+        : current(nullptr)
+        , generation(0)
+        , readers(count)
+    {
+        for (auto& reader : readers)
+            reader.store(READER_IDLE);
+    }
+};
+
+upt_snapshot_t* upt_snapshot_new(size_t readers)
+{
+    return new upt_snapshot_t(readers);
+}
+
+void upt_snapshot_destroy(upt_snapshot_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    upt_snapshot_t* self = *self_p;
+    for (s_snapshot_t* snapshot : self->retired)
+        delete snapshot;
+    delete self->current.load();
+    delete self;
+    *self_p = nullptr;
+}
+
+// free retired snapshots older than anything an active reader may hold
+static void s_reclaim(upt_snapshot_t* self)
+{
+    uint64_t oldest = READER_IDLE;
+    for (auto& reader : self->readers) {
+        uint64_t generation = reader.load();
+        if (generation < oldest)
+            oldest = generation;
+    }
+
+    size_t kept = 0;
+    for (s_snapshot_t* snapshot : self->retired) {
+        if (snapshot->generation < oldest)
+            delete snapshot;
+        else
+            self->retired[kept++] = snapshot;
+    }
+    self->retired.resize(kept);
+}
+
+void upt_snapshot_publish(upt_snapshot_t* self, upt_t* upt)
+{
+    assert(self);
+    assert(upt);
+
+    s_snapshot_t* snapshot = new s_snapshot_t();
+    snapshot->generation   = self->generation.load() + 1;
+    snapshot->clock        = upt->clock;
+    snapshot->dcs.reserve(zhashx_size(upt->dc));
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(upt->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(upt->dc))) {
+        snapshot->dcs.emplace(reinterpret_cast<const char*>(zhashx_cursor(upt->dc)), s_counters(dc));
+    }
+
+    // pointer must be visible before the generation readers announce
+    s_snapshot_t* old = self->current.exchange(snapshot);
+    self->generation.store(snapshot->generation);
+    if (old)
+        self->retired.push_back(old);
+    s_reclaim(self);
+}
+
+int upt_snapshot_uptime(upt_snapshot_t* self, size_t reader, const char* dc_name, uint64_t* total, uint64_t* offline,
+    uint64_t* unknown)
+{
+    assert(self);
+    assert(reader < self->readers.size());
+    assert(dc_name);
+
+    *total   = 0;
+    *offline = 0;
+
+    // announce the oldest generation we can see, then pick the snapshot
+    self->readers[reader].store(self->generation.load());
+    const s_snapshot_t* snapshot = self->current.load();
+
+    int r = -1;
+    if (snapshot) {
+        auto it = snapshot->dcs.find(dc_name);
+        if (it != snapshot->dcs.end()) {
+            const s_counters_t& counters = it->second;
+
+            *total   = counters.total;
+            *offline = counters.offline;
+            if (unknown)
+                *unknown = counters.unknown;
+
+            int64_t now       = (upt_clock_now(snapshot->clock) / 1000LL);
+            int64_t time_diff = (now - counters.last_update);
+            if (time_diff > 0LL) {
+                *total += uint64_t(time_diff);
+                if (counters.is_offline)
+                    *offline += uint64_t(time_diff);
+            }
+            r = 0;
+        }
+    }
+
+    self->readers[reader].store(READER_IDLE);
+    return r;
+}
+
+int upt_snapshot_durations(upt_snapshot_t* self, size_t reader, const char* dc_name, uint64_t* durations)
+{
+    assert(self);
+    assert(reader < self->readers.size());
+    assert(dc_name);
+    assert(durations);
+
+    self->readers[reader].store(self->generation.load());
+    const s_snapshot_t* snapshot = self->current.load();
+
+    int r = -1;
+    if (snapshot) {
+        auto it = snapshot->dcs.find(dc_name);
+        if (it != snapshot->dcs.end()) {
+            const s_counters_t& counters  = it->second;
+            int64_t             time_diff = (upt_clock_now(snapshot->clock) / 1000LL) - counters.last_update;
+            for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+                durations[state] = counters.durations[state];
+                if (time_diff > 0LL && (counters.accounting & (1u << state)))
+                    durations[state] += uint64_t(time_diff);
+            }
+            r = 0;
+        }
+    }
+
+    self->readers[reader].store(READER_IDLE);
+    return r;
+}
+
+uint64_t upt_snapshot_generation(upt_snapshot_t* self)
+{
+    assert(self);
+
+    return self->generation.load();
+}
@@ -0,0 +1,53 @@
+/*  =========================================================================
+    upt_snapshot - Immutable snapshots of DC counters for lock-free readers
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "upt.h"
+#include <czmq.h>
+
+//  Publication point of per-DC counters. One writer thread publishes a new immutable
+//  snapshot with upt_snapshot_publish, readers look counters up without any lock and
+//  without ever waiting for the writer. Old snapshots are reclaimed by the writer once
+//  no reader can reference them (quiescent state based RCU).
+//
+//  Each reader thread uses its own reader index in range <0, readers).
+struct upt_snapshot_t;
+
+///  Create a new publication point for readers reader threads
+upt_snapshot_t* upt_snapshot_new(size_t readers);
+
+///  Destroy the publication point, no reader may be active
+void upt_snapshot_destroy(upt_snapshot_t** self_p);
+
+///  Publish counters of all datacenters of upt, must be called from one thread only
+void upt_snapshot_publish(upt_snapshot_t* self, upt_t* upt);
+
+///  Compute uptime of datacenter from the last snapshot, return -1 if unknown
+///  Counters are extrapolated to current time exactly as dc_uptime does, unknown can be nullptr.
+int upt_snapshot_uptime(upt_snapshot_t* self, size_t reader, const char* dc_name, uint64_t* total, uint64_t* offline,
+    uint64_t* unknown);
+
+///  Compute time spent by datacenter in every state from the last snapshot (see dc_durations), durations
+///  must hold DC_STATE_COUNT values. Return -1 if unknown.
+int upt_snapshot_durations(upt_snapshot_t* self, size_t reader, const char* dc_name, uint64_t* durations);
+
+///  Return generation of the last published snapshot, 0 if nothing was published yet
+uint64_t upt_snapshot_generation(upt_snapshot_t* self);
@@ -0,0 +1,157 @@
+/*  =========================================================================
+    upt_stale - Expiry of upses which stopped reporting
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_stale - Expiry of upses which stopped reporting
+
+#include "upt_stale.h"
+
+// wheel of 1 sec ticks, 64 slots on each level
+#define WHEEL_TICK  1000
+#define WHEEL_SLOTS 64
+
+struct s_ups_t
+{
+    int64_t last_seen; // msec
+    int64_t deadline;  // of the timer of the ups on the wheel, -1 if it has none
+    bool    stale;
+};
+
+struct s_expire_t
+{
+    upt_stale_t*  self;
+    upt_stale_fn* fn;
+    void*         arg;
+    int64_t       now;
+    size_t        count;
+};
+
+static void s_ups_destructor(void** x)
+{
+    free(*x);
+    *x = nullptr;
+}
+
+upt_stale_t* upt_stale_new(upt_clock_t* clock, int64_t ttl_ms)
+{
+    upt_stale_t* self = reinterpret_cast<upt_stale_t*>(zmalloc(sizeof(upt_stale_t)));
+    self->clock       = clock ? clock : upt_clock_system();
+    self->ttl_ms      = ttl_ms;
+    self->upses       = zhashx_new();
+    zhashx_set_destructor(self->upses, s_ups_destructor);
+    self->wheel = upt_wheel_new(WHEEL_TICK, WHEEL_SLOTS, upt_clock_now(self->clock));
+    return self;
+}
+
+void upt_stale_destroy(upt_stale_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    upt_stale_t* self = *self_p;
+    zhashx_destroy(&self->upses);
+    upt_wheel_destroy(&self->wheel);
+    free(self);
+    *self_p = nullptr;
+}
+
+void upt_stale_set_ttl(upt_stale_t* self, int64_t ttl_ms)
+{
+    assert(self);
+
+    self->ttl_ms = ttl_ms;
+}
+
+bool upt_stale_seen(upt_stale_t* self, const char* ups)
+{
+    assert(self);
+    assert(ups);
+
+    s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_lookup(self->upses, ups));
+    if (!entry) {
+        entry           = reinterpret_cast<s_ups_t*>(zmalloc(sizeof(s_ups_t)));
+        entry->deadline = -1;
+        zhashx_insert(self->upses, ups, entry);
+    }
+    bool stale       = entry->stale;
+    entry->last_seen = upt_clock_now(self->clock);
+    entry->stale     = false;
+    // an armed timer is moved on expiry, reporting does not touch the wheel
+    if (entry->deadline == -1) {
+        entry->deadline = entry->last_seen + self->ttl_ms;
+        upt_wheel_add(self->wheel, ups, entry->deadline);
+    }
+    return stale;
+}
+
+void upt_stale_forget(upt_stale_t* self, const char* ups)
+{
+    assert(self);
+    assert(ups);
+
+    zhashx_delete(self->upses, ups);
+}
+
+static void s_expired(const char* ups, int64_t deadline, void* arg)
+{
+    s_expire_t* expire = reinterpret_cast<s_expire_t*>(arg);
+    s_ups_t*    entry  = reinterpret_cast<s_ups_t*>(zhashx_lookup(expire->self->upses, ups));
+    // forgotten upses leave their timer behind, it is not the one of the ups seen again
+    if (!entry || entry->deadline != deadline)
+        return;
+
+    int64_t due = entry->last_seen + expire->self->ttl_ms;
+    if (due > expire->now) {
+        entry->deadline = due;
+        upt_wheel_add(expire->self->wheel, ups, due);
+        return;
+    }
+    entry->deadline = -1;
+    entry->stale = true;
+    expire->self->expired++;
+    expire->count++;
+    if (expire->fn)
+        expire->fn(ups, expire->arg);
+}
+
+size_t upt_stale_expire(upt_stale_t* self, upt_stale_fn* fn, void* arg)
+{
+    assert(self);
+
+    s_expire_t expire{self, fn, arg, upt_clock_now(self->clock), 0};
+    upt_wheel_advance(self->wheel, expire.now, s_expired, &expire);
+    return expire.count;
+}
+
+int64_t upt_stale_next(upt_stale_t* self)
+{
+    assert(self);
+
+    return upt_wheel_next(self->wheel);
+}
+
+bool upt_stale_is_stale(upt_stale_t* self, const char* ups)
+{
+    assert(self);
+    assert(ups);
+
+    s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_lookup(self->upses, ups));
+    return entry && entry->stale;
+}
@@ -0,0 +1,66 @@
+/*  =========================================================================
+    upt_stale - Expiry of upses which stopped reporting
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "upt_clock.h"
+#include "upt_wheel.h"
+#include <czmq.h>
+
+// Last time every ups reported its status. An ups not seen for ttl is stale: its last status is
+// no longer trusted and the user moves it to DC_STATE_STALE until it reports again. Each ups has
+// at most one timer on a hierarchical timer wheel, re-armed from its last-seen time on expiry,
+// so reporting is a hash update and expiry costs O(1) per tick whatever the number of upses.
+
+struct upt_stale_t
+{
+    upt_clock_t* clock;   // time source, not owned
+    int64_t      ttl_ms;  // upses not seen for this long are stale
+    zhashx_t*    upses;   // ups name -> last seen
+    upt_wheel_t* wheel;   // expiry of upses
+    uint64_t     expired; // upses which went stale so far
+};
+
+///  Called for every ups which went stale
+typedef void(upt_stale_fn)(const char* ups, void* arg);
+
+///  Create new expiry of upses not seen for ttl_ms on clock, nullptr is the system clock
+upt_stale_t* upt_stale_new(upt_clock_t* clock, int64_t ttl_ms);
+
+///  Destroy the expiry
+void upt_stale_destroy(upt_stale_t** self_p);
+
+///  Set ttl (msec), upses seen already keep their timer and are checked against the new ttl
+void upt_stale_set_ttl(upt_stale_t* self, int64_t ttl_ms);
+
+///  Record that ups reported now, return true if it was stale
+bool upt_stale_seen(upt_stale_t* self, const char* ups);
+
+///  Stop tracking ups, e.g. when it was removed
+void upt_stale_forget(upt_stale_t* self, const char* ups);
+
+///  Call fn for every ups which was not seen for ttl since the last call. Return their number.
+size_t upt_stale_expire(upt_stale_t* self, upt_stale_fn* fn, void* arg);
+
+///  Return time (msec on the clock) of the next upt_stale_expire with something to do, -1 if none
+int64_t upt_stale_next(upt_stale_t* self);
+
+///  Return true if ups is stale
+bool upt_stale_is_stale(upt_stale_t* self, const char* ups);
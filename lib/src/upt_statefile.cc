@@ -0,0 +1,731 @@
+/*  =========================================================================
+    upt_statefile - Streaming reader and writer of state files
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_statefile - Streaming reader and writer of state files
+
+#include "upt_statefile.h"
+#include <cinttypes>
+#include <fty_log.h>
+#include <unistd.h>
+
+// groups of values of a state file, in the order the writer puts them
+enum s_group_t
+{
+    S_DC_LIST,
+    S_DC_DATA,
+    S_DC_RATINGS,
+    S_DC_DURATIONS,
+    S_DC_STATES,
+    S_DC_COUNTERS,
+    S_DC_OFFLINE,
+    S_DC_UPSES,
+    S_GROUP_COUNT
+};
+
+static const char* s_group_names[S_GROUP_COUNT] = {
+    "dc_list", "dc_data", "dc_ratings", "dc_durations", "dc_states", "dc_counters", "dc_offline", "dc_upses"};
+
+// one line of ZPL, name at level (4 spaces each), value is nullptr for a section
+struct s_line_t
+{
+    int   level;
+    char* name;
+    char* value;
+};
+
+// position of the reader in one group
+struct s_cursor_t
+{
+    FILE*    file;   // nullptr if the group is not in the file or it ended
+    size_t   lineno; // of the line in buffer
+    char*    buffer;
+    size_t   size;
+    bool     peeked; // line is the next one, not consumed yet
+    s_line_t line;
+};
+
+struct upt_statefile_t
+{
+    char*              path;
+    upt_clock_t*       clock;      // clock of the records, never advanced
+    int64_t            checkpoint; // -1 if none
+    s_cursor_t         groups[S_GROUP_COUNT];
+    zhashx_t*          values;     // name -> value of the current datacenter in one group
+    upt_statefile_dc_t record;
+    size_t             count;      // datacenters read so far
+    size_t             ignored;
+    char*              error;
+};
+
+struct upt_statefile_writer_t
+{
+    char*   path;
+    int64_t checkpoint;
+    FILE*   groups[S_GROUP_COUNT]; // temporary files
+    size_t  count;
+};
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+static void* s_str_duplicator(const void* x)
+{
+    return strdup(reinterpret_cast<const char*>(x));
+}
+
+// parse text in place, return 1 for a line, 0 for a blank line or a comment, -1 if malformed
+static int s_parse(char* text, s_line_t* line)
+{
+    size_t indent = 0;
+    while (text[indent] == ' ')
+        indent++;
+    char* p   = text + indent;
+    char* end = p + strlen(p);
+    while (end != p && (end[-1] == '\n' || end[-1] == '\r'))
+        *--end = '\0';
+    if (*p == '\0' || *p == '#')
+        return 0;
+    if (indent % 4 != 0)
+        return -1;
+
+    line->level = int(indent / 4);
+    line->name  = p;
+    line->value = nullptr;
+    while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '=')
+        p++;
+    if (p == line->name)
+        return -1;
+    end = p;
+    while (*p == ' ' || *p == '\t')
+        p++;
+    bool has_value = *p == '=';
+    if (!has_value && *p != '\0' && *p != '#')
+        return -1;
+    *end = '\0';
+    if (!has_value)
+        return 1;
+
+    p++;
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p == '"' || *p == '\'') {
+        char* close = strchr(p + 1, *p);
+        if (!close)
+            return -1;
+        *close      = '\0';
+        line->value = p + 1;
+    } else {
+        line->value = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '#')
+            p++;
+        *p = '\0';
+    }
+    return 1;
+}
+
+// keep the first error, lineno 0 if it is not about one line
+static void s_fail(upt_statefile_t* self, size_t lineno, const char* format, ...)
+{
+    if (self->error)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    char* reason = zsys_vprintf(format, args);
+    va_end(args);
+    if (lineno != 0)
+        self->error = zsys_sprintf("%s:%zu: %s", self->path, lineno, reason);
+    else
+        self->error = zsys_sprintf("%s: %s", self->path, reason);
+    zstr_free(&reason);
+}
+
+static void s_cursor_end(s_cursor_t* cursor)
+{
+    if (cursor->file)
+        fclose(cursor->file);
+    cursor->file   = nullptr;
+    cursor->peeked = false;
+}
+
+// return the next line of the group without consuming it, nullptr at its end or on error
+static s_line_t* s_peek(upt_statefile_t* self, s_cursor_t* cursor)
+{
+    while (cursor->file && !cursor->peeked) {
+        if (getline(&cursor->buffer, &cursor->size, cursor->file) == -1) {
+            s_cursor_end(cursor);
+            return nullptr;
+        }
+        cursor->lineno++;
+        int r = s_parse(cursor->buffer, &cursor->line);
+        if (r == -1) {
+            s_fail(self, cursor->lineno, "malformed line");
+            s_cursor_end(cursor);
+            return nullptr;
+        }
+        cursor->peeked = r == 1;
+    }
+    if (!cursor->file)
+        return nullptr;
+    if (cursor->line.level == 0) {
+        s_cursor_end(cursor);
+        return nullptr;
+    }
+    return &cursor->line;
+}
+
+upt_statefile_t* upt_statefile_open(const char* file_path)
+{
+    assert(file_path);
+
+    FILE* file = fopen(file_path, "r");
+    if (!file) {
+        log_error("upt_statefile_open: can't open %s", file_path);
+        return nullptr;
+    }
+
+    upt_statefile_t* self = reinterpret_cast<upt_statefile_t*>(zmalloc(sizeof(upt_statefile_t)));
+    self->path            = strdup(file_path);
+    self->clock           = upt_clock_sim_new(0);
+    self->checkpoint      = -1;
+    self->values          = zhashx_new();
+    zhashx_set_duplicator(self->values, s_str_duplicator);
+    zhashx_set_destructor(self->values, s_str_destructor);
+    self->record.upses = zlistx_new();
+    zlistx_set_duplicator(self->record.upses, s_str_duplicator);
+    zlistx_set_destructor(self->record.upses, s_str_destructor);
+
+    // one pass over the top level of the file, every group gets its own position
+    char*    buffer = nullptr;
+    size_t   size   = 0;
+    size_t   lineno = 0;
+    s_line_t line;
+    while (!self->error && getline(&buffer, &size, file) != -1) {
+        lineno++;
+        int r = s_parse(buffer, &line);
+        if (r == -1)
+            s_fail(self, lineno, "malformed line");
+        if (r != 1 || line.level != 0)
+            continue;
+
+        if (streq(line.name, "checkpoint")) {
+            char* stop = nullptr;
+            self->checkpoint = line.value ? strtoll(line.value, &stop, 10) : -1;
+            if (!line.value || stop == line.value || *stop != '\0')
+                s_fail(self, lineno, "checkpoint is not a number");
+            continue;
+        }
+        for (int group = S_DC_LIST; group != S_GROUP_COUNT; group++) {
+            s_cursor_t* cursor = &self->groups[group];
+            if (!streq(line.name, s_group_names[group]))
+                continue;
+            if (cursor->file || cursor->lineno != 0) {
+                s_fail(self, lineno, "%s is repeated", line.name);
+                break;
+            }
+            cursor->file   = fopen(file_path, "r");
+            cursor->lineno = lineno;
+            if (!cursor->file || fseek(cursor->file, ftell(file), SEEK_SET) != 0)
+                s_fail(self, lineno, "can't read %s", line.name);
+        }
+    }
+    free(buffer);
+    fclose(file);
+    return self;
+}
+
+static void s_record_clear(upt_statefile_t* self)
+{
+    zstr_free(const_cast<char**>(&self->record.name));
+    dc_destroy(&self->record.dc);
+    zlistx_purge(self->record.upses);
+}
+
+void upt_statefile_close(upt_statefile_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    upt_statefile_t* self = *self_p;
+    s_record_clear(self);
+    zlistx_destroy(&self->record.upses);
+    for (int group = S_DC_LIST; group != S_GROUP_COUNT; group++) {
+        s_cursor_end(&self->groups[group]);
+        free(self->groups[group].buffer);
+    }
+    zhashx_destroy(&self->values);
+    upt_clock_destroy(&self->clock);
+    zstr_free(&self->error);
+    zstr_free(&self->path);
+    free(self);
+    *self_p = nullptr;
+}
+
+int64_t upt_statefile_checkpoint(upt_statefile_t* self)
+{
+    assert(self);
+
+    return self->checkpoint;
+}
+
+const char* upt_statefile_error(upt_statefile_t* self)
+{
+    assert(self);
+
+    return self->error;
+}
+
+size_t upt_statefile_ignored(upt_statefile_t* self)
+{
+    assert(self);
+
+    return self->ignored;
+}
+
+// read values of datacenter name in group, nothing if the group has no values of it
+static void s_values(upt_statefile_t* self, int group, const char* name)
+{
+    zhashx_purge(self->values);
+    s_cursor_t* cursor = &self->groups[group];
+    s_line_t*   line   = s_peek(self, cursor);
+    if (!line)
+        return;
+    if (line->level != 1 || line->value) {
+        s_fail(self, cursor->lineno, "%s: expected a datacenter", s_group_names[group]);
+        return;
+    }
+    if (!streq(line->name, name))
+        return;
+
+    cursor->peeked = false;
+    while ((line = s_peek(self, cursor)) != nullptr && line->level != 1) {
+        if (line->level != 2 || !line->value) {
+            s_fail(self, cursor->lineno, "%s/%s: expected a value", s_group_names[group], name);
+            return;
+        }
+        zhashx_update(self->values, line->name, line->value);
+        cursor->peeked = false;
+    }
+}
+
+static const char* s_value(upt_statefile_t* self, const char* format, size_t k)
+{
+    char key[32];
+    snprintf(key, sizeof(key), format, k);
+    return reinterpret_cast<const char*>(zhashx_lookup(self->values, key));
+}
+
+static bool s_number(upt_statefile_t* self, int group, const char* key, const char* text, uint64_t* number)
+{
+    char* stop = nullptr;
+    *number    = strtoull(text, &stop, 10);
+    if (stop == text || *stop != '\0' || *text == '-') {
+        s_fail(self, 0, "%s/%s/%s: '%s' is not a number", s_group_names[group], self->record.name, key, text);
+        return false;
+    }
+    return true;
+}
+
+// values at indexes after a gap are not read by upt_load either
+static void s_ignored(upt_statefile_t* self, size_t used)
+{
+    self->ignored += zhashx_size(self->values) - used;
+}
+
+static void s_read_data(upt_statefile_t* self, dc_t* dc)
+{
+    dc_policy_t policy    = DC_POLICY_ANY;
+    uint64_t    threshold = 0, total = 0, offline = 0, unknown = 0;
+    const char* text      = reinterpret_cast<const char*>(zhashx_lookup(self->values, "policy"));
+    if (text && dc_policy_parse(text, &policy) == -1)
+        s_fail(self, 0, "dc_data/%s/policy: unknown policy '%s'", self->record.name, text);
+    text = reinterpret_cast<const char*>(zhashx_lookup(self->values, "threshold"));
+    if (text)
+        s_number(self, S_DC_DATA, "threshold", text, &threshold);
+    dc_set_policy(dc, policy, threshold);
+
+    text = reinterpret_cast<const char*>(zhashx_lookup(self->values, "total"));
+    if (text && s_number(self, S_DC_DATA, "total", text, &total))
+        set_dc_total(dc, total);
+    text = reinterpret_cast<const char*>(zhashx_lookup(self->values, "off_line"));
+    if (text && s_number(self, S_DC_DATA, "off_line", text, &offline))
+        set_dc_off_line(dc, offline);
+    text = reinterpret_cast<const char*>(zhashx_lookup(self->values, "unknown"));
+    if (text && s_number(self, S_DC_DATA, "unknown", text, &unknown))
+        set_dc_unknown(dc, unknown);
+}
+
+static void s_read_ratings(upt_statefile_t* self, dc_t* dc)
+{
+    size_t k = 1;
+    for (;; k++) {
+        const char* ups      = s_value(self, "ups.%zu", k);
+        const char* s_rating = s_value(self, "rating.%zu", k);
+        uint64_t    rating   = 0;
+        if (!ups || !s_rating || !s_number(self, S_DC_RATINGS, "rating", s_rating, &rating))
+            break;
+        dc_set_rating(dc, ups, rating);
+    }
+    s_ignored(self, 2 * (k - 1));
+}
+
+static void s_read_offline(upt_statefile_t* self, dc_t* dc)
+{
+    size_t k = 1;
+    for (const char* ups; (ups = s_value(self, "ups.%zu", k)) != nullptr; k++) {
+        dc_set_offline(dc, const_cast<char*>(ups));
+    }
+    s_ignored(self, k - 1);
+}
+
+static void s_read_states(upt_statefile_t* self, dc_t* dc)
+{
+    size_t k = 1;
+    for (;; k++) {
+        const char* ups     = s_value(self, "ups.%zu", k);
+        const char* s_state = s_value(self, "state.%zu", k);
+        dc_state_t  state;
+        if (!ups || !s_state)
+            break;
+        if (dc_state_parse(s_state, &state) == -1) {
+            s_fail(self, 0, "dc_states/%s/state.%zu: unknown state '%s'", self->record.name, k, s_state);
+            break;
+        }
+        dc_set_state(dc, ups, state);
+    }
+    s_ignored(self, 2 * (k - 1));
+}
+
+static void s_read_counters(upt_statefile_t* self, dc_t* dc)
+{
+    // restoring states is no change of upses, counters are the saved ones
+    if (dc->counters)
+        zhashx_purge(dc->counters);
+    size_t k = 1;
+    for (;; k++) {
+        const char* ups           = s_value(self, "ups.%zu", k);
+        const char* s_on_battery  = s_value(self, "on_battery.%zu", k);
+        const char* s_transitions = s_value(self, "transitions.%zu", k);
+        const char* s_last_change = s_value(self, "last_change.%zu", k);
+        uint64_t    on_battery, transitions, last_change;
+        if (!ups || !s_on_battery || !s_transitions || !s_last_change)
+            break;
+        if (!s_number(self, S_DC_COUNTERS, "on_battery", s_on_battery, &on_battery) ||
+            !s_number(self, S_DC_COUNTERS, "transitions", s_transitions, &transitions) ||
+            !s_number(self, S_DC_COUNTERS, "last_change", s_last_change, &last_change))
+            break;
+        dc_set_ups_counters(dc, ups, on_battery, transitions, int64_t(last_change));
+    }
+    s_ignored(self, 4 * (k - 1));
+}
+
+static void s_read_durations(upt_statefile_t* self, dc_t* dc)
+{
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+        const char* name = dc_state_name(dc_state_t(state));
+        const char* text = reinterpret_cast<const char*>(zhashx_lookup(self->values, name));
+        if (text)
+            s_number(self, S_DC_DURATIONS, name, text, &dc->durations[state]);
+    }
+}
+
+static void s_read_upses(upt_statefile_t* self, dc_t* dc)
+{
+    size_t k = 1;
+    for (const char* ups; (ups = s_value(self, "ups.%zu", k)) != nullptr; k++) {
+        zlistx_add_end(self->record.upses, const_cast<char*>(ups));
+    }
+    s_ignored(self, k - 1);
+    dc_set_members(dc, k - 1);
+}
+
+// every group still holding a datacenter at the end has one which is not in dc_list
+static void s_check_end(upt_statefile_t* self)
+{
+    for (int group = S_DC_DATA; group != S_GROUP_COUNT && !self->error; group++) {
+        s_cursor_t* cursor = &self->groups[group];
+        s_line_t*   line   = s_peek(self, cursor);
+        if (line)
+            s_fail(self, cursor->lineno, "%s/%s: datacenter is not in dc_list or out of its order",
+                s_group_names[group], line->name);
+    }
+}
+
+upt_statefile_dc_t* upt_statefile_next(upt_statefile_t* self)
+{
+    assert(self);
+
+    s_record_clear(self);
+    if (self->error)
+        return nullptr;
+
+    s_cursor_t* list = &self->groups[S_DC_LIST];
+    s_line_t*   line = s_peek(self, list);
+    if (!line) {
+        s_check_end(self);
+        return nullptr;
+    }
+    char expected[32];
+    snprintf(expected, sizeof(expected), "dc.%zu", self->count + 1);
+    if (line->level != 1 || !line->value || !streq(line->name, expected)) {
+        s_fail(self, list->lineno, "dc_list: expected %s", expected);
+        return nullptr;
+    }
+    self->record.name = strdup(line->value);
+    list->peeked      = false;
+    self->count++;
+
+    // same order of restore as upt_load
+    dc_t* dc = dc_new_clock(self->clock);
+    self->record.dc = dc;
+    s_values(self, S_DC_DATA, self->record.name);
+    s_read_data(self, dc);
+    s_values(self, S_DC_RATINGS, self->record.name);
+    s_read_ratings(self, dc);
+    s_values(self, S_DC_OFFLINE, self->record.name);
+    s_read_offline(self, dc);
+    s_values(self, S_DC_STATES, self->record.name);
+    s_read_states(self, dc);
+    s_values(self, S_DC_COUNTERS, self->record.name);
+    s_read_counters(self, dc);
+    s_values(self, S_DC_DURATIONS, self->record.name);
+    s_read_durations(self, dc);
+    s_values(self, S_DC_UPSES, self->record.name);
+    s_read_upses(self, dc);
+    dc->checkpoint = self->checkpoint;
+    zhashx_purge(self->values);
+
+    if (self->error) {
+        s_record_clear(self);
+        return nullptr;
+    }
+    return &self->record;
+}
+
+//  --------------------------------------------------------------------------
+//  Writer
+
+static void s_put(FILE* file, int level, const char* name, const char* value)
+{
+    // ZPL has no escapes, a value holding double quotes is put in single ones
+    if (strchr(value, '"'))
+        fprintf(file, "%*s%s = '%s'\n", level * 4, "", name, value);
+    else
+        fprintf(file, "%*s%s = \"%s\"\n", level * 4, "", name, value);
+}
+
+static void s_putf(FILE* file, int level, const char* name, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    char* value = zsys_vprintf(format, args);
+    va_end(args);
+    s_put(file, level, name, value);
+    zstr_free(&value);
+}
+
+static void s_section(FILE* file, int level, const char* name)
+{
+    fprintf(file, "%*s%s\n", level * 4, "", name);
+}
+
+void upt_statefile_abort(upt_statefile_writer_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    upt_statefile_writer_t* self = *self_p;
+    for (int group = S_DC_LIST; group != S_GROUP_COUNT; group++) {
+        if (self->groups[group])
+            fclose(self->groups[group]);
+    }
+    zstr_free(&self->path);
+    free(self);
+    *self_p = nullptr;
+}
+
+upt_statefile_writer_t* upt_statefile_create(const char* file_path, int64_t checkpoint)
+{
+    assert(file_path);
+
+    upt_statefile_writer_t* self =
+        reinterpret_cast<upt_statefile_writer_t*>(zmalloc(sizeof(upt_statefile_writer_t)));
+    self->path       = strdup(file_path);
+    self->checkpoint = checkpoint;
+    for (int group = S_DC_LIST; group != S_GROUP_COUNT; group++) {
+        self->groups[group] = tmpfile();
+        if (!self->groups[group]) {
+            log_error("upt_statefile_create: can't create temporary file for %s", file_path);
+            upt_statefile_abort(&self);
+            return nullptr;
+        }
+    }
+    return self;
+}
+
+int upt_statefile_write(upt_statefile_writer_t* self, const char* name, dc_t* dc, zlistx_t* upses)
+{
+    assert(self);
+    assert(name);
+    assert(dc);
+
+    char key[32];
+    snprintf(key, sizeof(key), "dc.%zu", ++self->count);
+    s_put(self->groups[S_DC_LIST], 1, key, name);
+
+    // counters are accounted up to now, as upt_save does
+    uint64_t total, offline;
+    dc_uptime(dc, &total, &offline);
+    FILE* file = self->groups[S_DC_DATA];
+    s_section(file, 1, name);
+    s_putf(file, 2, "total", "%" PRIu64, total);
+    s_putf(file, 2, "off_line", "%" PRIu64, offline);
+    s_putf(file, 2, "unknown", "%" PRIu64, dc_unknown(dc));
+    s_put(file, 2, "policy", dc_policy_name(dc->policy));
+    s_putf(file, 2, "threshold", "%" PRIu64, dc->threshold);
+
+    size_t k = 1;
+    if (dc->ratings && zhashx_size(dc->ratings) != 0) {
+        file = self->groups[S_DC_RATINGS];
+        s_section(file, 1, name);
+        for (uint64_t* rating = reinterpret_cast<uint64_t*>(zhashx_first(dc->ratings)); rating != nullptr;
+             rating           = reinterpret_cast<uint64_t*>(zhashx_next(dc->ratings)), k++) {
+            snprintf(key, sizeof(key), "ups.%zu", k);
+            s_put(file, 2, key, reinterpret_cast<const char*>(zhashx_cursor(dc->ratings)));
+            snprintf(key, sizeof(key), "rating.%zu", k);
+            s_putf(file, 2, key, "%" PRIu64, *rating);
+        }
+    }
+
+    file = self->groups[S_DC_DURATIONS];
+    s_section(file, 1, name);
+    for (int state = DC_STATE_ONLINE; state != DC_STATE_COUNT; state++) {
+        s_putf(file, 2, dc_state_name(dc_state_t(state)), "%" PRIu64, dc->durations[state]);
+    }
+
+    if (dc->states && zhashx_size(dc->states) != 0) {
+        file = self->groups[S_DC_STATES];
+        s_section(file, 1, name);
+        k = 1;
+        for (void* entry = zhashx_first(dc->states); entry != nullptr; entry = zhashx_next(dc->states), k++) {
+            const char* ups = reinterpret_cast<const char*>(zhashx_cursor(dc->states));
+            snprintf(key, sizeof(key), "ups.%zu", k);
+            s_put(file, 2, key, ups);
+            snprintf(key, sizeof(key), "state.%zu", k);
+            s_put(file, 2, key, dc_state_name(dc_ups_state(dc, ups)));
+        }
+    }
+
+    if (dc->counters && zhashx_size(dc->counters) != 0) {
+        file = self->groups[S_DC_COUNTERS];
+        s_section(file, 1, name);
+        k = 1;
+        for (void* entry = zhashx_first(dc->counters); entry != nullptr; entry = zhashx_next(dc->counters), k++) {
+            const char*       ups = reinterpret_cast<const char*>(zhashx_cursor(dc->counters));
+            dc_ups_counters_t counters;
+            dc_ups_counters(dc, ups, &counters);
+            snprintf(key, sizeof(key), "ups.%zu", k);
+            s_put(file, 2, key, ups);
+            snprintf(key, sizeof(key), "on_battery.%zu", k);
+            s_putf(file, 2, key, "%" PRIu64, counters.on_battery);
+            snprintf(key, sizeof(key), "transitions.%zu", k);
+            s_putf(file, 2, key, "%" PRIu64, counters.transitions);
+            snprintf(key, sizeof(key), "last_change.%zu", k);
+            s_putf(file, 2, key, "%" PRIi64, counters.last_change);
+        }
+    }
+
+    if (zlistx_size(dc->ups) != 0) {
+        file = self->groups[S_DC_OFFLINE];
+        s_section(file, 1, name);
+        k = 1;
+        for (char* ups = reinterpret_cast<char*>(zlistx_first(dc->ups)); ups != nullptr;
+             ups       = reinterpret_cast<char*>(zlistx_next(dc->ups)), k++) {
+            snprintf(key, sizeof(key), "ups.%zu", k);
+            s_put(file, 2, key, ups);
+        }
+    }
+
+    if (upses && zlistx_size(upses) != 0) {
+        file = self->groups[S_DC_UPSES];
+        s_section(file, 1, name);
+        k = 1;
+        for (char* ups = reinterpret_cast<char*>(zlistx_first(upses)); ups != nullptr;
+             ups       = reinterpret_cast<char*>(zlistx_next(upses)), k++) {
+            snprintf(key, sizeof(key), "ups.%zu", k);
+            s_put(file, 2, key, ups);
+        }
+    }
+
+    for (int group = S_DC_LIST; group != S_GROUP_COUNT; group++) {
+        if (ferror(self->groups[group]))
+            return -1;
+    }
+    return 0;
+}
+
+int upt_statefile_commit(upt_statefile_writer_t** self_p)
+{
+    assert(self_p);
+    assert(*self_p);
+
+    upt_statefile_writer_t* self = *self_p;
+    // written next to the file and renamed, a reader never sees half of it
+    char* tmp_path = zsys_sprintf("%s.tmp", self->path);
+    FILE* file     = fopen(tmp_path, "w");
+    int   rv       = file ? 0 : -1;
+    if (file) {
+        if (self->checkpoint != -1)
+            s_putf(file, 0, "checkpoint", "%" PRIi64, self->checkpoint);
+        char buffer[65536];
+        for (int group = S_DC_LIST; group != S_GROUP_COUNT && rv == 0; group++) {
+            FILE* group_file = self->groups[group];
+            if (ftell(group_file) == 0)
+                continue;
+            s_section(file, 0, s_group_names[group]);
+            rewind(group_file);
+            size_t size;
+            while ((size = fread(buffer, 1, sizeof(buffer), group_file)) != 0) {
+                if (fwrite(buffer, 1, size, file) != size) {
+                    rv = -1;
+                    break;
+                }
+            }
+            if (ferror(group_file))
+                rv = -1;
+        }
+        if (ferror(file))
+            rv = -1;
+        if (fclose(file) != 0)
+            rv = -1;
+        if (rv == 0 && rename(tmp_path, self->path) != 0)
+            rv = -1;
+    }
+    if (rv != 0) {
+        log_error("upt_statefile_commit: can't write %s", self->path);
+        unlink(tmp_path);
+    }
+    zstr_free(&tmp_path);
+    upt_statefile_abort(self_p);
+    return rv;
+}
@@ -0,0 +1,77 @@
+/*  =========================================================================
+    upt_statefile - Streaming reader and writer of state files
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+#pragma once
+#include "dc.h"
+#include <czmq.h>
+
+// State files (see upt_save) one datacenter at a time, without building the whole tree of the
+// file: memory used is the one of the biggest datacenter, not of the file.
+//
+// The file groups values by kind (dc_list, dc_data, dc_durations, ...) and every group lists
+// datacenters in the order of dc_list, which is how upt_save writes them. The reader keeps a file
+// position in every group and advances them together; a group holding a datacenter which is not
+// in dc_list, or out of its order, is reported as an error. Groups not known to the reader are
+// skipped. The writer keeps every group in a temporary file until commit, which concatenates them
+// into a file upt_load reads.
+
+struct upt_statefile_t;
+struct upt_statefile_writer_t;
+
+///  One datacenter of a state file, owned by the reader and valid until the next record
+struct upt_statefile_dc_t
+{
+    const char* name;
+    dc_t*       dc;    // counters, policy, ratings and states of upses, time stands still on its clock
+    zlistx_t*   upses; // names of member upses
+};
+
+///  Open state file for reading, nullptr if it can't be read
+upt_statefile_t* upt_statefile_open(const char* file_path);
+
+///  Close the state file
+void upt_statefile_close(upt_statefile_t** self_p);
+
+///  Return wall clock time (s) counters of the file are accounted up to, -1 if the file has none
+int64_t upt_statefile_checkpoint(upt_statefile_t* self);
+
+///  Return the next datacenter, nullptr at the end of the file or on error
+upt_statefile_dc_t* upt_statefile_next(upt_statefile_t* self);
+
+///  Return description of the error which stopped the reader ("file:line: reason"), nullptr if none
+const char* upt_statefile_error(upt_statefile_t* self);
+
+///  Return number of values the agent ignores too (entries after a gap in their numbering)
+size_t upt_statefile_ignored(upt_statefile_t* self);
+
+///  Create a state file with wall clock checkpoint (s), -1 for none. Nothing is visible at
+///  file_path until commit.
+upt_statefile_writer_t* upt_statefile_create(const char* file_path, int64_t checkpoint);
+
+///  Append datacenter name with its members upses, return 0 on success
+int upt_statefile_write(upt_statefile_writer_t* self, const char* name, dc_t* dc, zlistx_t* upses);
+
+///  Write the file and destroy the writer, return 0 on success. On error the file is not touched.
+int upt_statefile_commit(upt_statefile_writer_t** self_p);
+
+///  Destroy the writer without writing the file
+void upt_statefile_abort(upt_statefile_writer_t** self_p);
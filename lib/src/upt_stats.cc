@@ -0,0 +1,157 @@
+/*  =========================================================================
+    upt_stats - Runtime statistics of the uptime agent
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_stats - Runtime statistics of the uptime agent
+
+#include "upt_stats.h"
+#include <fty_log.h>
+
+upt_stats_t* upt_stats_new(void)
+{
+    upt_stats_t* self = reinterpret_cast<upt_stats_t*>(zmalloc(sizeof(upt_stats_t)));
+    return self;
+}
+
+void upt_stats_destroy(upt_stats_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    free(*self_p);
+    *self_p = nullptr;
+}
+
+void upt_stats_histogram_add(upt_stats_histogram_t* self, uint64_t usecs)
+{
+    assert(self);
+
+    size_t bucket = usecs == 0 ? 0 : size_t(64 - __builtin_clzll(usecs));
+    if (bucket >= UPT_STATS_BUCKETS)
+        bucket = UPT_STATS_BUCKETS - 1;
+
+    self->count++;
+    self->sum_us += usecs;
+    if (usecs > self->max_us)
+        self->max_us = usecs;
+    self->buckets[bucket]++;
+}
+
+uint64_t upt_stats_histogram_percentile(upt_stats_histogram_t* self, double percentile)
+{
+    assert(self);
+
+    if (self->count == 0)
+        return 0;
+
+    uint64_t rank = uint64_t(double(self->count) * percentile / 100.0);
+    if (rank >= self->count)
+        rank = self->count - 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i != UPT_STATS_BUCKETS; i++) {
+        seen += self->buckets[i];
+        if (seen > rank)
+            return i == UPT_STATS_BUCKETS - 1 ? self->max_us : (1ULL << i);
+    }
+    return self->max_us;
+}
+
+static void s_add(zmsg_t* msg, const char* name, uint64_t value)
+{
+    zmsg_addstr(msg, name);
+    zmsg_addstrf(msg, "%" PRIu64, value);
+}
+
+void upt_stats_histogram_report(upt_stats_histogram_t* self, const char* name, zmsg_t* msg)
+{
+    assert(self);
+    assert(name);
+    assert(msg);
+
+    zmsg_addstrf(msg, "%s.count", name);
+    zmsg_addstrf(msg, "%" PRIu64, self->count);
+    zmsg_addstrf(msg, "%s.avg_us", name);
+    zmsg_addstrf(msg, "%" PRIu64, self->count ? self->sum_us / self->count : 0);
+    zmsg_addstrf(msg, "%s.p50_us", name);
+    zmsg_addstrf(msg, "%" PRIu64, upt_stats_histogram_percentile(self, 50));
+    zmsg_addstrf(msg, "%s.p99_us", name);
+    zmsg_addstrf(msg, "%" PRIu64, upt_stats_histogram_percentile(self, 99));
+    zmsg_addstrf(msg, "%s.max_us", name);
+    zmsg_addstrf(msg, "%" PRIu64, self->max_us);
+}
+
+void upt_stats_report(upt_stats_t* self, zmsg_t* msg)
+{
+    assert(self);
+    assert(msg);
+
+    s_add(msg, "polls", self->polls);
+    s_add(msg, "metrics.read", self->metrics_read);
+    s_add(msg, "metrics.matched", self->metrics_matched);
+    s_add(msg, "transitions", self->transitions);
+    s_add(msg, "flaps", self->flaps);
+    s_add(msg, "debounced", self->debounced);
+    s_add(msg, "stale", self->stale);
+    s_add(msg, "wakeups", self->wakeups);
+    s_add(msg, "saves", self->saves);
+    s_add(msg, "saves.errors", self->save_errors);
+    s_add(msg, "saves.bytes", self->save_bytes);
+    s_add(msg, "messages.mailbox", self->msg_mailbox);
+    s_add(msg, "messages.metric", self->msg_metric);
+    s_add(msg, "messages.asset", self->msg_asset);
+    s_add(msg, "messages.invalid", self->msg_invalid);
+    upt_stats_histogram_report(&self->poll, "poll", msg);
+    upt_stats_histogram_report(&self->save, "save", msg);
+    upt_stats_histogram_report(&self->query, "query", msg);
+}
+
+int upt_stats_dump(zmsg_t* report, const char* file_path)
+{
+    assert(report);
+    assert(file_path);
+
+    char* tmp  = zsys_sprintf("%s.tmp", file_path);
+    FILE* file = fopen(tmp, "w");
+    if (!file) {
+        log_error("upt_stats_dump: can't open %s", tmp);
+        zstr_free(&tmp);
+        return -1;
+    }
+
+    for (zframe_t* name = zmsg_first(report); name != nullptr; name = zmsg_next(report)) {
+        zframe_t* value = zmsg_next(report);
+        if (!value)
+            break;
+        char* s_name  = zframe_strdup(name);
+        char* s_value = zframe_strdup(value);
+        fprintf(file, "%s %s\n", s_name, s_value);
+        zstr_free(&s_name);
+        zstr_free(&s_value);
+    }
+
+    int rv = fclose(file);
+    if (rv == 0)
+        rv = rename(tmp, file_path);
+    if (rv != 0)
+        log_error("upt_stats_dump: can't write %s", file_path);
+    zstr_free(&tmp);
+    return rv == 0 ? 0 : -1;
+}
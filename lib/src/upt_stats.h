@@ -0,0 +1,78 @@
+/*  =========================================================================
+    upt_stats - Runtime statistics of the uptime agent
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <czmq.h>
+
+// histogram bucket i counts durations in <2^(i-1), 2^i) usec, last bucket takes everything longer
+#define UPT_STATS_BUCKETS 28
+
+struct upt_stats_histogram_t
+{
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[UPT_STATS_BUCKETS];
+};
+
+struct upt_stats_t
+{
+    uint64_t polls;              // shm polls
+    uint64_t metrics_read;       // status metrics read from shm or stream
+    uint64_t metrics_matched;    // metrics of upses protecting some datacenter
+    uint64_t transitions;        // ups status changes applied to datacenters
+    uint64_t flaps;              // ups status changes given up before their debounce dwell
+    uint64_t debounced;          // ups status changes applied after their debounce dwell
+    uint64_t stale;              // upses which stopped reporting and went stale
+    uint64_t wakeups;            // returns from the wait of the server loop, for a message or a timer
+    uint64_t saves;              // state saves
+    uint64_t save_errors;        // failed state saves
+    uint64_t save_bytes;         // size of the last saved state file
+    uint64_t msg_mailbox;        // MAILBOX DELIVER messages
+    uint64_t msg_metric;         // STREAM DELIVER metrics
+    uint64_t msg_asset;          // STREAM DELIVER assets
+    uint64_t msg_invalid;        // messages we don't understand
+
+    upt_stats_histogram_t poll;  // duration of shm poll
+    upt_stats_histogram_t save;  // duration of state save
+    upt_stats_histogram_t query; // UPTIME request from arrival to reply
+};
+
+///  Create new statistics, all zeroed
+upt_stats_t* upt_stats_new(void);
+
+///  Destroy statistics
+void upt_stats_destroy(upt_stats_t** self_p);
+
+///  Record one duration in usec
+void upt_stats_histogram_add(upt_stats_histogram_t* self, uint64_t usecs);
+
+///  Return upper bound (usec) of the bucket holding given percentile (0-100), 0 if empty
+uint64_t upt_stats_histogram_percentile(upt_stats_histogram_t* self, double percentile);
+
+///  Append histogram to msg as name.count, name.avg_us, name.p50_us, name.p99_us and name.max_us pairs
+void upt_stats_histogram_report(upt_stats_histogram_t* self, const char* name, zmsg_t* msg);
+
+///  Append statistics to msg as name/value string pairs
+void upt_stats_report(upt_stats_t* self, zmsg_t* msg);
+
+///  Write name/value pairs of msg to file_path as "name value" lines, file is replaced atomically
+int upt_stats_dump(zmsg_t* report, const char* file_path);
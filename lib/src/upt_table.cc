@@ -0,0 +1,328 @@
+/*  =========================================================================
+    upt_table - Memory mapped table of datacenter counters
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_table - Memory mapped table of datacenter counters
+
+#include "upt_table.h"
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <fty_log.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define UPT_TABLE_MAGIC "UPTTBL01"
+
+struct s_header_t
+{
+    char                  magic[8];
+    uint32_t              slot_size;
+    uint32_t              unused;
+    uint64_t              capacity;
+    std::atomic<uint64_t> count;
+    std::atomic<int64_t>  offset;
+    char                  padding[128 - 40];
+};
+
+struct upt_table_slot_t
+{
+    std::atomic<uint64_t> seq;
+    std::atomic<int64_t>  last_update;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> offline;
+    std::atomic<uint64_t> offline_upses;
+    char                  name[UPT_TABLE_NAME_SIZE];
+};
+
+static_assert(sizeof(s_header_t) == 128, "table header layout");
+static_assert(sizeof(upt_table_slot_t) == 128, "table slot layout");
+
+struct upt_table_t
+{
+    int               fd;
+    bool              readonly;
+    size_t            size;    // mapped bytes
+    s_header_t*       header;
+    upt_table_slot_t* slots;
+    zhashx_t*         index;   // dc name -> slot
+    size_t            indexed; // slots in index
+    std::mutex        lock;    // of index and appends, shards of one agent share the table
+};
+
+// add slots appended since the last call to the index
+static void s_index(upt_table_t* self)
+{
+    size_t count = size_t(self->header->count.load(std::memory_order_acquire));
+    if (count > self->header->capacity)
+        count = size_t(self->header->capacity);
+    for (; self->indexed < count; self->indexed++) {
+        upt_table_slot_t* slot = &self->slots[self->indexed];
+        zhashx_update(self->index, slot->name, slot);
+    }
+}
+
+static upt_table_t* s_open(const char* file_path, size_t capacity, bool readonly)
+{
+    assert(file_path);
+
+    int fd = open(file_path, readonly ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        log_error("upt_table: can't open %s: %s", file_path, strerror(errno));
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        log_error("upt_table: can't stat %s: %s", file_path, strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+
+    bool   create = st.st_size == 0;
+    size_t size   = size_t(st.st_size);
+    if (create) {
+        if (readonly || capacity == 0) {
+            log_error("upt_table: %s is empty", file_path);
+            close(fd);
+            return nullptr;
+        }
+        size = sizeof(s_header_t) + capacity * sizeof(upt_table_slot_t);
+        if (ftruncate(fd, off_t(size)) == -1) {
+            log_error("upt_table: can't resize %s: %s", file_path, strerror(errno));
+            close(fd);
+            return nullptr;
+        }
+    }
+    if (size < sizeof(s_header_t)) {
+        log_error("upt_table: %s is not a counter table", file_path);
+        close(fd);
+        return nullptr;
+    }
+
+    void* base = mmap(nullptr, size, readonly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        log_error("upt_table: can't map %s: %s", file_path, strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+
+    s_header_t* header = reinterpret_cast<s_header_t*>(base);
+    if (create) {
+        // new file reads as zeros, count and offset are already 0
+        memcpy(header->magic, UPT_TABLE_MAGIC, sizeof(header->magic));
+        header->slot_size = sizeof(upt_table_slot_t);
+        header->capacity  = capacity;
+    } else if (memcmp(header->magic, UPT_TABLE_MAGIC, sizeof(header->magic)) != 0
+               || header->slot_size != sizeof(upt_table_slot_t)
+               || size != sizeof(s_header_t) + header->capacity * sizeof(upt_table_slot_t)) {
+        log_error("upt_table: %s is not a counter table", file_path);
+        munmap(base, size);
+        close(fd);
+        return nullptr;
+    }
+
+    upt_table_t* self = new upt_table_t();
+    self->fd          = fd;
+    self->readonly    = readonly;
+    self->size        = size;
+    self->header      = header;
+    self->slots       = reinterpret_cast<upt_table_slot_t*>(reinterpret_cast<char*>(base) + sizeof(s_header_t));
+    self->index       = zhashx_new();
+    s_index(self);
+    return self;
+}
+
+upt_table_t* upt_table_open(const char* file_path, size_t capacity)
+{
+    return s_open(file_path, capacity, false);
+}
+
+upt_table_t* upt_table_open_readonly(const char* file_path)
+{
+    return s_open(file_path, 0, true);
+}
+
+void upt_table_destroy(upt_table_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    upt_table_t* self = *self_p;
+    zhashx_destroy(&self->index);
+    munmap(self->header, self->size);
+    close(self->fd);
+    delete self;
+    *self_p = nullptr;
+}
+
+// caller holds the lock
+static upt_table_slot_t* s_lookup(upt_table_t* self, const char* dc_name)
+{
+    upt_table_slot_t* slot = reinterpret_cast<upt_table_slot_t*>(zhashx_lookup(self->index, dc_name));
+    if (!slot && self->readonly) {
+        // the writer may have appended it since
+        s_index(self);
+        slot = reinterpret_cast<upt_table_slot_t*>(zhashx_lookup(self->index, dc_name));
+    }
+    return slot;
+}
+
+upt_table_slot_t* upt_table_lookup(upt_table_t* self, const char* dc_name)
+{
+    assert(self);
+    assert(dc_name);
+
+    std::lock_guard<std::mutex> guard(self->lock);
+    return s_lookup(self, dc_name);
+}
+
+upt_table_slot_t* upt_table_slot(upt_table_t* self, const char* dc_name)
+{
+    assert(self);
+    assert(dc_name);
+
+    std::lock_guard<std::mutex> guard(self->lock);
+    upt_table_slot_t*           slot = s_lookup(self, dc_name);
+    if (slot || self->readonly)
+        return slot;
+
+    uint64_t count = self->header->count.load(std::memory_order_relaxed);
+    if (count == self->header->capacity) {
+        log_warning("upt_table: table is full, counters of %s are not mapped", dc_name);
+        return nullptr;
+    }
+    if (strlen(dc_name) >= UPT_TABLE_NAME_SIZE) {
+        log_warning("upt_table: name %s is too long, counters are not mapped", dc_name);
+        return nullptr;
+    }
+
+    // name is written before the slot is published by count
+    slot = &self->slots[count];
+    strncpy(slot->name, dc_name, UPT_TABLE_NAME_SIZE);
+    self->header->count.store(count + 1, std::memory_order_release);
+    s_index(self);
+    return slot;
+}
+
+void upt_table_write(
+    upt_table_slot_t* slot, int64_t last_update, uint64_t total, uint64_t offline, uint64_t offline_upses)
+{
+    assert(slot);
+
+    uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+    slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->last_update.store(last_update, std::memory_order_relaxed);
+    slot->total.store(total, std::memory_order_relaxed);
+    slot->offline.store(offline, std::memory_order_relaxed);
+    slot->offline_upses.store(offline_upses, std::memory_order_relaxed);
+    slot->seq.store(seq + 2, std::memory_order_release);
+}
+
+void upt_table_read(upt_table_t* self, upt_table_slot_t* slot, upt_table_entry_t* entry)
+{
+    assert(self);
+    assert(slot);
+    assert(entry);
+
+    uint64_t before, after;
+    do {
+        before = slot->seq.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+        entry->last_update   = slot->last_update.load(std::memory_order_relaxed);
+        entry->total         = slot->total.load(std::memory_order_relaxed);
+        entry->offline       = slot->offline.load(std::memory_order_relaxed);
+        entry->offline_upses = slot->offline_upses.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = slot->seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    entry->last_update += self->header->offset.load(std::memory_order_relaxed);
+}
+
+int upt_table_get(upt_table_t* self, const char* dc_name, upt_table_entry_t* entry)
+{
+    upt_table_slot_t* slot = upt_table_lookup(self, dc_name);
+    if (!slot)
+        return -1;
+    upt_table_read(self, slot, entry);
+    return 0;
+}
+
+void upt_table_set_offset(upt_table_t* self, int64_t offset)
+{
+    assert(self);
+    assert(!self->readonly);
+
+    // slots written by a previous writer are on its clock, rebase them so they keep their wall time
+    int64_t delta = self->header->offset.exchange(offset, std::memory_order_relaxed) - offset;
+    if (delta == 0)
+        return;
+    size_t count = size_t(self->header->count.load(std::memory_order_relaxed));
+    for (size_t i = 0; i != count && i != self->header->capacity; i++) {
+        upt_table_slot_t* slot = &self->slots[i];
+        uint64_t          seq  = slot->seq.load(std::memory_order_relaxed);
+        if (seq == 0)
+            continue; // never written
+        slot->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->last_update.fetch_add(delta, std::memory_order_relaxed);
+        slot->seq.store(seq + 2, std::memory_order_release);
+    }
+}
+
+size_t upt_table_size(upt_table_t* self)
+{
+    assert(self);
+
+    std::lock_guard<std::mutex> guard(self->lock);
+    if (self->readonly)
+        s_index(self);
+    return self->indexed;
+}
+
+size_t upt_table_capacity(upt_table_t* self)
+{
+    assert(self);
+
+    return size_t(self->header->capacity);
+}
+
+const char* upt_table_name(upt_table_t* self, size_t index)
+{
+    assert(self);
+    assert(index < self->indexed);
+
+    return self->slots[index].name;
+}
+
+int upt_table_sync(upt_table_t* self, bool sync)
+{
+    assert(self);
+
+    if (msync(self->header, self->size, sync ? MS_SYNC : MS_ASYNC) == -1) {
+        log_error("upt_table: msync failed: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*  =========================================================================
+    upt_table - Memory mapped table of datacenter counters
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <czmq.h>
+
+// Counters of datacenters in a file mapped to memory and updated in place, so they survive a
+// crash of the agent without any save, and other processes can read them without asking.
+//
+// Layout, native byte order, all fields 8 bytes aligned:
+//
+//  header (128 bytes)  magic "UPTTBL01", uint32 slot size, uint32 unused, uint64 capacity,
+//                      uint64 count of used slots, int64 offset from last_update to wall clock (s)
+//  slot (128 bytes)    uint64 seq, int64 last_update, uint64 total, uint64 offline,
+//                      uint64 offline upses, char name[88] (NUL terminated)
+//
+// Slots are only appended, a datacenter keeps its slot forever. A writer makes seq odd while it
+// updates a slot; readers retry until they see the same even seq before and after reading.
+// Threads of the writer (shards) may share the table as long as each slot has one of them
+// writing it, looking up and appending slots is serialized.
+
+#define UPT_TABLE_NAME_SIZE 88
+
+struct upt_table_t;
+struct upt_table_slot_t;
+
+///  Counters of one datacenter as read from the table
+struct upt_table_entry_t
+{
+    int64_t  last_update;   // wall clock (s) counters were accounted up to
+    uint64_t total;         // seconds
+    uint64_t offline;       // seconds
+    uint64_t offline_upses; // datacenter is offline if not 0
+};
+
+///  Open the table for writing, it is created with room for capacity datacenters if it does not
+///  exist (capacity of an existing file is kept). Return nullptr on error.
+upt_table_t* upt_table_open(const char* file_path, size_t capacity);
+
+///  Open an existing table for reading only. Return nullptr on error.
+upt_table_t* upt_table_open_readonly(const char* file_path);
+
+///  Unmap and close the table
+void upt_table_destroy(upt_table_t** self_p);
+
+///  Return slot of datacenter dc_name, a new one is allocated if needed. Return nullptr if the
+///  table is full, read only or the name is too long.
+upt_table_slot_t* upt_table_slot(upt_table_t* self, const char* dc_name);
+
+///  Return slot of datacenter dc_name if it already has one, nullptr otherwise
+upt_table_slot_t* upt_table_lookup(upt_table_t* self, const char* dc_name);
+
+///  Update counters of a slot, last_update is on the clock of the writer
+void upt_table_write(
+    upt_table_slot_t* slot, int64_t last_update, uint64_t total, uint64_t offline, uint64_t offline_upses);
+
+///  Read consistent counters of a slot
+void upt_table_read(upt_table_t* self, upt_table_slot_t* slot, upt_table_entry_t* entry);
+
+///  Read counters of datacenter dc_name, return -1 if it has no slot
+int upt_table_get(upt_table_t* self, const char* dc_name, upt_table_entry_t* entry);
+
+///  Set seconds from the clock of the writer to the wall clock, last_update of slots already written
+///  (by a previous writer, before a reboot) is moved so their wall clock time does not change. No
+///  other thread may write slots meanwhile.
+void upt_table_set_offset(upt_table_t* self, int64_t offset);
+
+///  Number of used slots
+size_t upt_table_size(upt_table_t* self);
+
+///  Number of slots
+size_t upt_table_capacity(upt_table_t* self);
+
+///  Name of datacenter in slot index (less than size)
+const char* upt_table_name(upt_table_t* self, size_t index);
+
+///  Flush the table to disk, wait for the write if sync is true. Return 0 on success.
+int upt_table_sync(upt_table_t* self, bool sync);
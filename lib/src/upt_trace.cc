@@ -0,0 +1,77 @@
+/*  =========================================================================
+    upt_trace - Trace points of the hot path
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_trace - Trace points of the hot path
+
+#include "upt_trace.h"
+
+static std::atomic<int>      s_mode(UPT_TRACE_OFF);
+static std::atomic<uint32_t> s_rate(10);
+
+void upt_trace_set_mode(upt_trace_mode_t mode, uint32_t rate)
+{
+    s_rate.store(rate, std::memory_order_relaxed);
+    s_mode.store(mode, std::memory_order_relaxed);
+#ifndef UPT_TRACE
+    if (mode != UPT_TRACE_OFF)
+        log_warning("trace points are not compiled in, rebuild with ENABLE_TRACE");
+#endif
+}
+
+upt_trace_mode_t upt_trace_mode(void)
+{
+    return upt_trace_mode_t(s_mode.load(std::memory_order_relaxed));
+}
+
+int upt_trace_parse(const char* name)
+{
+    if (!name)
+        return -1;
+    if (streq(name, "off"))
+        return UPT_TRACE_OFF;
+    if (streq(name, "sample"))
+        return UPT_TRACE_SAMPLE;
+    if (streq(name, "full"))
+        return UPT_TRACE_FULL;
+    return -1;
+}
+
+bool upt_trace_admit(upt_trace_point_t* point)
+{
+    assert(point);
+
+    upt_trace_mode_t mode = upt_trace_mode();
+    if (mode == UPT_TRACE_FULL)
+        return true;
+    if (mode == UPT_TRACE_OFF)
+        return false;
+
+    // fixed one second windows, a racing thread may let a record or two more through
+    int64_t window = zclock_mono() / 1000;
+    if (point->window.load(std::memory_order_relaxed) != window) {
+        point->window.store(window, std::memory_order_relaxed);
+        point->count.store(0, std::memory_order_relaxed);
+    }
+    if (point->count.fetch_add(1, std::memory_order_relaxed) < s_rate.load(std::memory_order_relaxed))
+        return true;
+    point->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
@@ -0,0 +1,74 @@
+/*  =========================================================================
+    upt_trace - Trace points of the hot path
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <atomic>
+#include <czmq.h>
+#include <fty_log.h>
+
+// Trace points are compiled in only with UPT_TRACE defined (cmake -DENABLE_TRACE=ON).
+// Otherwise upt_trace() is dead code: arguments are type checked, never evaluated.
+//
+// Compiled in trace points are still silent until enabled at runtime:
+//  off    - nothing is emitted, one relaxed load per trace point
+//  sample - at most rate records per second and trace point
+//  full   - every record
+
+enum upt_trace_mode_t
+{
+    UPT_TRACE_OFF    = 0,
+    UPT_TRACE_SAMPLE = 1,
+    UPT_TRACE_FULL   = 2
+};
+
+struct upt_trace_point_t
+{
+    std::atomic<int64_t>  window;  // second the count belongs to
+    std::atomic<uint32_t> count;   // records seen in window
+    std::atomic<uint64_t> dropped; // records not emitted by sampling
+};
+
+///  Set trace mode, rate is used by sample mode (records per second and trace point)
+void upt_trace_set_mode(upt_trace_mode_t mode, uint32_t rate);
+
+///  Return current trace mode
+upt_trace_mode_t upt_trace_mode(void);
+
+///  Parse mode name (off, sample, full), return -1 if unknown
+int upt_trace_parse(const char* name);
+
+///  Return true if the record of trace point should be emitted now
+bool upt_trace_admit(upt_trace_point_t* point);
+
+#ifdef UPT_TRACE
+#define upt_trace(point, format, ...)                                                                                 \
+    do {                                                                                                               \
+        static upt_trace_point_t s_trace_point;                                                                        \
+        if (upt_trace_mode() != UPT_TRACE_OFF && upt_trace_admit(&s_trace_point))                                      \
+            log_info("trace " point ": " format, ##__VA_ARGS__);                                                       \
+    } while (0)
+#else
+#define upt_trace(point, format, ...)                                                                                 \
+    do {                                                                                                               \
+        if (false)                                                                                                     \
+            log_info("trace " point ": " format, ##__VA_ARGS__);                                                       \
+    } while (0)
+#endif
@@ -0,0 +1,302 @@
+/*  =========================================================================
+    upt_tree - Uptime rollups over the asset tree
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_tree - Uptime rollups over the asset tree
+
+#include "upt_tree.h"
+
+// placement and status of an ups
+struct s_ups_t
+{
+    upt_tree_node_t* parent; // nullptr until placed
+    bool             offline;
+};
+
+static void s_node_destructor(void** x)
+{
+    upt_tree_node_t** self_p = reinterpret_cast<upt_tree_node_t**>(x);
+    if (!*self_p)
+        return;
+    zstr_free(&(*self_p)->name);
+    zstr_free(&(*self_p)->type);
+    free(*self_p);
+    *self_p = nullptr;
+}
+
+static void s_ups_destructor(void** x)
+{
+    free(*x);
+    *x = nullptr;
+}
+
+// account time elapsed since the last accounting of node
+static void s_fold(upt_tree_t* self, upt_tree_node_t* node)
+{
+    int64_t now = upt_clock_now(self->clock);
+    if (now <= node->last)
+        return;
+    node->total_ms += uint64_t(now - node->last);
+    if (node->offline_children != 0)
+        node->offline_ms += uint64_t(now - node->last);
+    node->last = now;
+}
+
+// a child of node went offline or online, walk up as long as statuses of ancestors flip
+static void s_propagate(upt_tree_t* self, upt_tree_node_t* node, bool offline)
+{
+    for (; node != nullptr; node = node->parent) {
+        bool flips = offline ? node->offline_children == 0 : node->offline_children == 1;
+        if (flips)
+            s_fold(self, node);
+        if (offline)
+            node->offline_children++;
+        else
+            node->offline_children--;
+        if (!flips)
+            return;
+        if (offline)
+            node->outages++;
+    }
+}
+
+static void s_attach(upt_tree_t* self, upt_tree_node_t* parent, bool offline)
+{
+    parent->children++;
+    if (offline)
+        s_propagate(self, parent, true);
+}
+
+static void s_detach(upt_tree_t* self, upt_tree_node_t* parent, bool offline)
+{
+    parent->children--;
+    if (offline)
+        s_propagate(self, parent, false);
+}
+
+static upt_tree_node_t* s_node_new(upt_tree_t* self, const char* name, const char* type, upt_tree_node_t* parent)
+{
+    upt_tree_node_t* node = reinterpret_cast<upt_tree_node_t*>(zmalloc(sizeof(upt_tree_node_t)));
+    node->name            = strdup(name);
+    node->type            = strdup(type);
+    node->parent          = parent;
+    node->last            = upt_clock_now(self->clock);
+    zhashx_insert(self->nodes, name, node);
+    if (parent)
+        s_attach(self, parent, false);
+    return node;
+}
+
+// node name, created under the root until it is seen itself
+static upt_tree_node_t* s_node_get(upt_tree_t* self, const char* name)
+{
+    upt_tree_node_t* node = reinterpret_cast<upt_tree_node_t*>(zhashx_lookup(self->nodes, name));
+    if (!node)
+        node = s_node_new(self, name, "unknown", self->root);
+    return node;
+}
+
+upt_tree_t* upt_tree_new(upt_clock_t* clock)
+{
+    upt_tree_t* self = reinterpret_cast<upt_tree_t*>(zmalloc(sizeof(upt_tree_t)));
+    self->clock      = clock ? clock : upt_clock_system();
+    self->nodes      = zhashx_new();
+    zhashx_set_destructor(self->nodes, s_node_destructor);
+    self->upses = zhashx_new();
+    zhashx_set_destructor(self->upses, s_ups_destructor);
+    self->root = s_node_new(self, UPT_TREE_ROOT, "estate", nullptr);
+    return self;
+}
+
+void upt_tree_destroy(upt_tree_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    upt_tree_t* self = *self_p;
+    zhashx_destroy(&self->nodes);
+    zhashx_destroy(&self->upses);
+    free(self);
+    *self_p = nullptr;
+}
+
+void upt_tree_set_clock(upt_tree_t* self, upt_clock_t* clock)
+{
+    assert(self);
+
+    for (upt_tree_node_t* node = reinterpret_cast<upt_tree_node_t*>(zhashx_first(self->nodes)); node != nullptr;
+         node                  = reinterpret_cast<upt_tree_node_t*>(zhashx_next(self->nodes))) {
+        s_fold(self, node);
+    }
+    self->clock = clock ? clock : upt_clock_system();
+    int64_t now = upt_clock_now(self->clock);
+    for (upt_tree_node_t* node = reinterpret_cast<upt_tree_node_t*>(zhashx_first(self->nodes)); node != nullptr;
+         node                  = reinterpret_cast<upt_tree_node_t*>(zhashx_next(self->nodes))) {
+        node->last = now;
+    }
+}
+
+int upt_tree_set_node(upt_tree_t* self, const char* name, const char* type, const char* parent_name)
+{
+    assert(self);
+    assert(name);
+    assert(type);
+
+    if (streq(name, UPT_TREE_ROOT) || (parent_name && streq(parent_name, name)))
+        return -1;
+    upt_tree_node_t* parent = parent_name && *parent_name ? s_node_get(self, parent_name) : self->root;
+    upt_tree_node_t* node   = reinterpret_cast<upt_tree_node_t*>(zhashx_lookup(self->nodes, name));
+    if (!node) {
+        s_node_new(self, name, type, parent);
+        return 0;
+    }
+
+    if (!streq(node->type, type)) {
+        zstr_free(&node->type);
+        node->type = strdup(type);
+    }
+    if (node->parent == parent)
+        return 0;
+    for (upt_tree_node_t* up = parent; up != nullptr; up = up->parent) {
+        if (up == node)
+            return -1;
+    }
+    bool offline = node->offline_children != 0;
+    s_detach(self, node->parent, offline);
+    node->parent = parent;
+    s_attach(self, parent, offline);
+    return 0;
+}
+
+void upt_tree_set_ups(upt_tree_t* self, const char* ups, const char* parent_name)
+{
+    assert(self);
+    assert(ups);
+
+    s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_lookup(self->upses, ups));
+    if (!entry) {
+        entry = reinterpret_cast<s_ups_t*>(zmalloc(sizeof(s_ups_t)));
+        zhashx_insert(self->upses, ups, entry);
+    }
+    upt_tree_node_t* parent = parent_name && *parent_name ? s_node_get(self, parent_name) : nullptr;
+    if (entry->parent == parent)
+        return;
+    if (entry->parent)
+        s_detach(self, entry->parent, entry->offline);
+    entry->parent = parent;
+    if (parent)
+        s_attach(self, parent, entry->offline);
+}
+
+void upt_tree_remove(upt_tree_t* self, const char* name)
+{
+    assert(self);
+    assert(name);
+
+    s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_lookup(self->upses, name));
+    if (entry) {
+        if (entry->parent)
+            s_detach(self, entry->parent, entry->offline);
+        zhashx_delete(self->upses, name);
+        return;
+    }
+
+    upt_tree_node_t* node = reinterpret_cast<upt_tree_node_t*>(zhashx_lookup(self->nodes, name));
+    if (!node || node == self->root)
+        return;
+    upt_tree_node_t* parent = node->parent;
+    s_detach(self, parent, node->offline_children != 0);
+
+    // children move to the parent of the removed node
+    for (upt_tree_node_t* child = reinterpret_cast<upt_tree_node_t*>(zhashx_first(self->nodes)); child != nullptr;
+         child                  = reinterpret_cast<upt_tree_node_t*>(zhashx_next(self->nodes))) {
+        if (child->parent == node) {
+            child->parent = parent;
+            s_attach(self, parent, child->offline_children != 0);
+        }
+    }
+    for (s_ups_t* ups = reinterpret_cast<s_ups_t*>(zhashx_first(self->upses)); ups != nullptr;
+         ups          = reinterpret_cast<s_ups_t*>(zhashx_next(self->upses))) {
+        if (ups->parent == node) {
+            ups->parent = parent;
+            s_attach(self, parent, ups->offline);
+        }
+    }
+    zhashx_delete(self->nodes, name);
+}
+
+bool upt_tree_is_placed(upt_tree_t* self, const char* ups)
+{
+    assert(self);
+    assert(ups);
+
+    s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_lookup(self->upses, ups));
+    return entry && entry->parent;
+}
+
+bool upt_tree_set_offline(upt_tree_t* self, const char* ups, bool offline)
+{
+    assert(self);
+    assert(ups);
+
+    s_ups_t* entry = reinterpret_cast<s_ups_t*>(zhashx_lookup(self->upses, ups));
+    if (!entry) {
+        if (!offline)
+            return false;
+        entry = reinterpret_cast<s_ups_t*>(zmalloc(sizeof(s_ups_t)));
+        zhashx_insert(self->upses, ups, entry);
+    }
+    if (entry->offline == offline)
+        return false;
+    entry->offline = offline;
+    if (entry->parent)
+        s_propagate(self, entry->parent, offline);
+    return true;
+}
+
+bool upt_tree_is_offline(upt_tree_t* self, const char* name)
+{
+    assert(self);
+    assert(name);
+
+    upt_tree_node_t* node = reinterpret_cast<upt_tree_node_t*>(zhashx_lookup(self->nodes, name));
+    return node && node->offline_children != 0;
+}
+
+int upt_tree_rollup(upt_tree_t* self, const char* name, upt_tree_rollup_t* rollup)
+{
+    assert(self);
+    assert(name);
+    assert(rollup);
+
+    upt_tree_node_t* node = reinterpret_cast<upt_tree_node_t*>(zhashx_lookup(self->nodes, name));
+    if (!node)
+        return -1;
+
+    s_fold(self, node);
+    rollup->type             = node->type;
+    rollup->parent           = node->parent ? node->parent->name : nullptr;
+    rollup->total            = node->total_ms / 1000;
+    rollup->offline          = node->offline_ms / 1000;
+    rollup->children         = node->children;
+    rollup->offline_children = node->offline_children;
+    rollup->outages          = node->outages;
+    return 0;
+}
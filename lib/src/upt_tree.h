@@ -0,0 +1,97 @@
+/*  =========================================================================
+    upt_tree - Uptime rollups over the asset tree
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "upt_clock.h"
+#include <czmq.h>
+
+// Tree of locations (estate, datacenters, rooms, rows, racks) built from parents of assets, with
+// upses as leaves. A node is offline while any of its children is, every node keeps the number of
+// its offline children and the time it spent offline. A change of ups status walks up only as
+// long as the status of ancestors flips, so it costs O(depth) at most, and time is accounted
+// lazily at flips and queries, so reading any node is O(1).
+
+// name of the root node, parent of datacenters and of nodes without a known parent
+#define UPT_TREE_ROOT "estate"
+
+struct upt_tree_node_t
+{
+    char*            name;
+    char*            type;             // asset type (datacenter, room, row, rack), "unknown" until seen
+    upt_tree_node_t* parent;           // nullptr for the root
+    size_t           children;         // nodes and upses placed directly under this one
+    size_t           offline_children; // children currently offline
+    uint64_t         outages;          // times the node went offline
+    uint64_t         total_ms;         // time accounted so far
+    uint64_t         offline_ms;       // of which offline
+    int64_t          last;             // msec on the clock of the last accounting
+};
+
+struct upt_tree_t
+{
+    upt_clock_t*     clock; // time source, not owned
+    zhashx_t*        nodes; // node name -> upt_tree_node_t
+    zhashx_t*        upses; // ups name -> placement and status of the ups
+    upt_tree_node_t* root;
+};
+
+struct upt_tree_rollup_t
+{
+    const char* type;
+    const char* parent; // nullptr for the root
+    uint64_t    total;  // seconds
+    uint64_t    offline;
+    size_t      children;
+    size_t      offline_children;
+    uint64_t    outages;
+};
+
+///  Create new tree holding the root only, time runs on clock, nullptr is the system clock
+upt_tree_t* upt_tree_new(upt_clock_t* clock);
+
+///  Destroy the tree
+void upt_tree_destroy(upt_tree_t** self_p);
+
+///  Move the tree to another clock, time accounted so far is kept
+void upt_tree_set_clock(upt_tree_t* self, upt_clock_t* clock);
+
+///  Create or update node name of type under parent (nullptr or empty is the root). An unknown
+///  parent is created under the root until it is seen itself. Return -1 if the node is the root
+///  or parent is below the node.
+int upt_tree_set_node(upt_tree_t* self, const char* name, const char* type, const char* parent);
+
+///  Place ups under node parent (nullptr detaches it), an unknown parent is created like above
+void upt_tree_set_ups(upt_tree_t* self, const char* ups, const char* parent);
+
+///  Remove node or ups name, children of a removed node move to its parent. O(size of the tree).
+void upt_tree_remove(upt_tree_t* self, const char* name);
+
+///  Return true if ups is placed under some node
+bool upt_tree_is_placed(upt_tree_t* self, const char* ups);
+
+///  Set status of ups, upses not placed yet keep it for their placement. Return true if it changed.
+bool upt_tree_set_offline(upt_tree_t* self, const char* ups, bool offline);
+
+///  Return true if node name is offline, false if it is online or not known
+bool upt_tree_is_offline(upt_tree_t* self, const char* name);
+
+///  Fill rollup of node name, strings are owned by the tree. Return -1 if the node is not known.
+int upt_tree_rollup(upt_tree_t* self, const char* name, upt_tree_rollup_t* rollup);
@@ -0,0 +1,238 @@
+/*  =========================================================================
+    upt_wheel - Timer wheel
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/// upt_wheel - Timer wheel
+
+#include "upt_wheel.h"
+
+struct s_timer_t
+{
+    char*   key;
+    int64_t deadline; // msec
+};
+
+struct upt_wheel_t
+{
+    int64_t    tick;    // msec per slot of level 0
+    size_t     slots;   // number of slots of every level
+    int64_t    span[UPT_WHEEL_LEVELS + 1]; // ticks per slot of every level, span[UPT_WHEEL_LEVELS] is the range
+    int64_t    current; // last tick the wheel was advanced to
+    size_t     size;    // number of pending timers
+    int64_t    next;    // no timer expires or cascades before this tick, -1 when it must be looked up
+    zlistx_t** slot;    // timers of slot i of level l at l * slots + i
+};
+
+static void s_timer_destructor(void** x)
+{
+    s_timer_t** self_p = reinterpret_cast<s_timer_t**>(x);
+    if (!*self_p)
+        return;
+    zstr_free(&(*self_p)->key);
+    free(*self_p);
+    *self_p = nullptr;
+}
+
+// put timer to the slot of its deadline relative to the current tick, earliest is the first tick
+// still to be visited, return the tick of the slot
+static int64_t s_insert(upt_wheel_t* self, s_timer_t* timer, int64_t earliest)
+{
+    // round up, a timer never expires before its deadline
+    int64_t tick = (timer->deadline + self->tick - 1) / self->tick;
+    if (tick < earliest)
+        tick = earliest;
+    if (tick - self->current >= self->span[UPT_WHEEL_LEVELS])
+        tick = self->current + self->span[UPT_WHEEL_LEVELS] - 1;
+
+    size_t level = 0;
+    while (tick - self->current >= self->span[level + 1])
+        level++;
+    size_t index = size_t(tick / self->span[level]) % self->slots;
+    zlistx_add_end(self->slot[level * self->slots + index], timer);
+    return tick;
+}
+
+// move timers of slot index of level down to the levels below, before the current tick is visited
+static void s_cascade(upt_wheel_t* self, size_t level, size_t index)
+{
+    zlistx_t* slot = self->slot[level * self->slots + index];
+    if (zlistx_size(slot) == 0)
+        return;
+    zlistx_t* moved = zlistx_new();
+    for (void* timer = zlistx_first(slot); timer != nullptr; timer = zlistx_next(slot))
+        zlistx_add_end(moved, timer);
+    zlistx_purge(slot); // slots do not own their timers
+    for (void* timer = zlistx_first(moved); timer != nullptr; timer = zlistx_next(moved))
+        s_insert(self, reinterpret_cast<s_timer_t*>(timer), self->current);
+    zlistx_destroy(&moved);
+}
+
+upt_wheel_t* upt_wheel_new(int64_t tick, size_t slots, int64_t now)
+{
+    assert(tick > 0);
+    assert(slots > 1);
+
+    upt_wheel_t* self = reinterpret_cast<upt_wheel_t*>(zmalloc(sizeof(upt_wheel_t)));
+    self->tick        = tick;
+    self->slots       = slots;
+    self->span[0]     = 1;
+    for (size_t level = 1; level <= UPT_WHEEL_LEVELS; level++)
+        self->span[level] = self->span[level - 1] * int64_t(slots);
+    self->current = now / tick;
+    self->size    = 0;
+    self->next    = -1;
+    self->slot    = reinterpret_cast<zlistx_t**>(zmalloc(UPT_WHEEL_LEVELS * slots * sizeof(zlistx_t*)));
+    for (size_t i = 0; i != UPT_WHEEL_LEVELS * slots; i++)
+        self->slot[i] = zlistx_new();
+    return self;
+}
+
+static void s_slot_destroy(zlistx_t** slot_p)
+{
+    s_timer_t* timer = reinterpret_cast<s_timer_t*>(zlistx_first(*slot_p));
+    while (timer) {
+        s_timer_destructor(reinterpret_cast<void**>(&timer));
+        timer = reinterpret_cast<s_timer_t*>(zlistx_next(*slot_p));
+    }
+    zlistx_destroy(slot_p);
+}
+
+void upt_wheel_destroy(upt_wheel_t** self_p)
+{
+    if (!self_p || !*self_p)
+        return;
+
+    upt_wheel_t* self = *self_p;
+    for (size_t i = 0; i != UPT_WHEEL_LEVELS * self->slots; i++)
+        s_slot_destroy(&self->slot[i]);
+    free(self->slot);
+    free(self);
+    *self_p = nullptr;
+}
+
+void upt_wheel_add(upt_wheel_t* self, const char* key, int64_t deadline)
+{
+    assert(self);
+    assert(key);
+
+    s_timer_t* timer = reinterpret_cast<s_timer_t*>(zmalloc(sizeof(s_timer_t)));
+    timer->key       = strdup(key);
+    timer->deadline  = deadline;
+    int64_t tick     = s_insert(self, timer, self->current + 1);
+    self->size++;
+    if (self->next != -1 && tick < self->next)
+        self->next = tick;
+}
+
+size_t upt_wheel_advance(upt_wheel_t* self, int64_t now, upt_wheel_fn* fn, void* arg)
+{
+    assert(self);
+
+    int64_t target = now / self->tick;
+    if (target <= self->current)
+        return 0;
+
+    // expired timers are taken out first, fn may add new ones
+    zlistx_t* expired = zlistx_new();
+    if (target - self->current >= self->span[2]) {
+        // long jump (e.g. after a suspend), every timer is due or goes to its new place
+        zlistx_t* all = zlistx_new();
+        for (size_t i = 0; i != UPT_WHEEL_LEVELS * self->slots; i++) {
+            for (void* timer = zlistx_first(self->slot[i]); timer != nullptr; timer = zlistx_next(self->slot[i]))
+                zlistx_add_end(all, timer);
+            zlistx_purge(self->slot[i]);
+        }
+        self->current = target;
+        for (void* timer = zlistx_first(all); timer != nullptr; timer = zlistx_next(all)) {
+            if (reinterpret_cast<s_timer_t*>(timer)->deadline <= now)
+                zlistx_add_end(expired, timer);
+            else
+                s_insert(self, reinterpret_cast<s_timer_t*>(timer), self->current + 1);
+        }
+        zlistx_destroy(&all);
+    } else {
+        while (self->current < target) {
+            self->current++;
+            for (size_t level = UPT_WHEEL_LEVELS - 1; level != 0; level--) {
+                if (self->current % self->span[level] == 0)
+                    s_cascade(self, level, size_t(self->current / self->span[level]) % self->slots);
+            }
+            zlistx_t* slot = self->slot[size_t(self->current) % self->slots];
+            zlistx_t* later = nullptr;
+            for (void* timer = zlistx_first(slot); timer != nullptr; timer = zlistx_next(slot)) {
+                // timers beyond the range of the wheel were parked at its end
+                if (reinterpret_cast<s_timer_t*>(timer)->deadline > self->current * self->tick) {
+                    if (!later)
+                        later = zlistx_new();
+                    zlistx_add_end(later, timer);
+                } else
+                    zlistx_add_end(expired, timer);
+            }
+            zlistx_purge(slot);
+            for (void* timer = later ? zlistx_first(later) : nullptr; timer != nullptr; timer = zlistx_next(later))
+                s_insert(self, reinterpret_cast<s_timer_t*>(timer), self->current + 1);
+            zlistx_destroy(&later);
+        }
+    }
+    self->next = -1;
+
+    size_t count = zlistx_size(expired);
+    self->size -= count;
+    for (s_timer_t* timer = reinterpret_cast<s_timer_t*>(zlistx_first(expired)); timer != nullptr;
+         timer            = reinterpret_cast<s_timer_t*>(zlistx_next(expired))) {
+        if (fn)
+            fn(timer->key, timer->deadline, arg);
+        s_timer_destructor(reinterpret_cast<void**>(&timer));
+    }
+    zlistx_destroy(&expired);
+    return count;
+}
+
+size_t upt_wheel_size(upt_wheel_t* self)
+{
+    assert(self);
+
+    return self->size;
+}
+
+int64_t upt_wheel_next(upt_wheel_t* self)
+{
+    assert(self);
+
+    if (self->size == 0)
+        return -1;
+    if (self->next != -1)
+        return self->next * self->tick;
+
+    // first non empty slot of every level, an upper level slot is due when it cascades
+    int64_t next = self->current + self->span[UPT_WHEEL_LEVELS];
+    for (size_t level = 0; level != UPT_WHEEL_LEVELS; level++) {
+        int64_t turn = self->current / self->span[level];
+        for (int64_t k = 1; k <= int64_t(self->slots); k++) {
+            if (zlistx_size(self->slot[level * self->slots + size_t(turn + k) % self->slots]) != 0) {
+                if ((turn + k) * self->span[level] < next)
+                    next = (turn + k) * self->span[level];
+                break;
+            }
+        }
+    }
+    self->next = next;
+    return next * self->tick;
+}
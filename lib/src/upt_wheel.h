@@ -0,0 +1,58 @@
+/*  =========================================================================
+    upt_wheel - Timer wheel
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <czmq.h>
+
+// Hierarchical timer wheel: level 0 has slots of tick msec each, every upper level has as many
+// slots covering a whole turn of the level below. Adding a timer is O(1), a tick visits one slot
+// and moves the timers of an upper slot down when the level below completes a turn, whatever the
+// number of timers. Timers beyond the top level wait there until their deadline is in range.
+// Advancing by more than a turn of level 1 at once redistributes all timers instead of ticking.
+// Timers can't be cancelled, users check on expiry whether the timer is still wanted.
+
+#define UPT_WHEEL_LEVELS 4
+
+struct upt_wheel_t;
+
+///  Called for every expired timer with its key, deadline (msec) and arg of upt_wheel_advance
+typedef void(upt_wheel_fn)(const char* key, int64_t deadline, void* arg);
+
+///  Create a wheel of UPT_WHEEL_LEVELS levels of slots slots, level 0 ticks every tick msec,
+///  starting at now (msec)
+upt_wheel_t* upt_wheel_new(int64_t tick, size_t slots, int64_t now);
+
+///  Destroy the wheel and all its timers
+void upt_wheel_destroy(upt_wheel_t** self_p);
+
+///  Add timer key (copied) expiring at deadline (msec), past deadlines expire at the next tick
+void upt_wheel_add(upt_wheel_t* self, const char* key, int64_t deadline);
+
+///  Move the wheel to now (msec) and call fn for every timer expired meanwhile, tick by tick.
+///  Return number of expired timers.
+size_t upt_wheel_advance(upt_wheel_t* self, int64_t now, upt_wheel_fn* fn, void* arg);
+
+///  Return the earliest time (msec) upt_wheel_advance may expire a timer, -1 if there is none.
+///  It is exact for timers due within a turn of level 0, a bound for the later ones.
+int64_t upt_wheel_next(upt_wheel_t* self);
+
+///  Return number of pending timers
+size_t upt_wheel_size(upt_wheel_t* self);
@@ -4,7 +4,8 @@
 
 TEST_CASE("dc test")
 {
-    dc_t* dc = dc_new();
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    dc_t*        dc    = dc_new_clock(clock);
 
     CHECK(!dc_is_offline(dc));
 
@@ -16,23 +17,29 @@ TEST_CASE("dc test")
 
     uint64_t total, offline;
 
-    zclock_sleep(3000);
+    upt_clock_advance(clock, 3000);
     dc_uptime(dc, &total, &offline);
-    printf("total:  %" PRIi64, total);
-    printf("offline:  %" PRIi64, offline);
-
-    CHECK(total > 1);
-    CHECK(offline > 1);
+    CHECK(total == 3);
+    CHECK(offline == 3);
 
     dc_set_online(dc, const_cast<char*>("UPS001"));
     CHECK(!dc_is_offline(dc));
 
-    zclock_sleep(3000);
+    upt_clock_advance(clock, 3000);
+    dc_uptime(dc, &total, &offline);
+    CHECK(total == 6);
+    CHECK(offline == 3);
+
+    // clocks don't move backwards, time is kept when the dc moves to another clock
+    upt_clock_t* other = upt_clock_sim_new(1000000);
+    dc_set_clock(dc, other);
+    upt_clock_advance(other, 1000);
     dc_uptime(dc, &total, &offline);
-    CHECK(total > 2);
-    CHECK(offline > 1);
+    CHECK(total == 7);
+    CHECK(offline == 3);
 
     dc_destroy(&dc);
+    upt_clock_destroy(&other);
 
     // pack/unpack
     dc = dc_new();
@@ -40,6 +47,7 @@ TEST_CASE("dc test")
     dc->last_update = 42;
     dc->total       = 1042;
     dc->offline     = 17;
+    dc->unknown     = 5;
     dc_set_offline(dc, const_cast<char*>("UPS001"));
     dc_set_offline(dc, const_cast<char*>("UPS002"));
     dc_set_offline(dc, const_cast<char*>("UPS003"));
@@ -52,6 +60,7 @@ TEST_CASE("dc test")
     CHECK(dc->last_update == dc2->last_update);
     CHECK(dc->total == dc2->total);
     CHECK(dc->offline == dc2->offline);
+    CHECK(dc->unknown == dc2->unknown);
     CHECK(dc_is_offline(dc2));
     CHECK(zlistx_size(dc2->ups) == 3);
     CHECK(streq(reinterpret_cast<char*>(zlistx_first(dc2->ups)), "UPS001"));
@@ -73,4 +82,289 @@ TEST_CASE("dc test")
     zframe_destroy(&frame);
     dc_destroy(&dc2);
     dc_destroy(&dc);
+    upt_clock_destroy(&clock);
+}
+
+TEST_CASE("dc reconcile")
+{
+    // wall clock is the simulated one, checkpoint 100 s ago
+    upt_clock_t* clock = upt_clock_sim_new(1000000);
+    int64_t      now   = upt_clock_wall(clock) / 1000LL;
+
+    uint64_t total, offline;
+    dc_t*    dc = dc_new_clock(clock);
+    dc_set_offline(dc, const_cast<char*>("UPS001"));
+
+    // no checkpoint, nothing to reconcile
+    dc_reconcile(dc, now, DC_GAP_ASSUME, 0);
+    dc_uptime(dc, &total, &offline);
+    CHECK(total == 0);
+    CHECK(dc_unknown(dc) == 0);
+
+    dc->checkpoint = now - 100;
+    dc_reconcile(dc, now, DC_GAP_UNKNOWN, 0);
+    dc_uptime(dc, &total, &offline);
+    CHECK(total == 0);
+    CHECK(offline == 0);
+    CHECK(dc_unknown(dc) == 100);
+
+    // checkpoint is reconciled once
+    dc_reconcile(dc, now, DC_GAP_UNKNOWN, 0);
+    CHECK(dc_unknown(dc) == 100);
+
+    dc->checkpoint = now - 100;
+    dc_reconcile(dc, now, DC_GAP_ASSUME, 0);
+    dc_uptime(dc, &total, &offline);
+    CHECK(total == 100);
+    CHECK(offline == 100);
+    CHECK(dc_unknown(dc) == 100);
+
+    // online datacenter, 30 s assumed and the rest unknown
+    dc_set_online(dc, const_cast<char*>("UPS001"));
+    dc->checkpoint = now - 100;
+    dc_reconcile(dc, now, DC_GAP_CLAMP, 30);
+    dc_uptime(dc, &total, &offline);
+    CHECK(total == 130);
+    CHECK(offline == 100);
+    CHECK(dc_unknown(dc) == 170);
+
+    // clock moved backwards, nothing to account
+    dc->checkpoint = now + 100;
+    dc_reconcile(dc, now, DC_GAP_ASSUME, 0);
+    dc_uptime(dc, &total, &offline);
+    CHECK(total == 130);
+    CHECK(dc_unknown(dc) == 170);
+
+    dc_destroy(&dc);
+    upt_clock_destroy(&clock);
+}
+
+TEST_CASE("dc policy")
+{
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    dc_t*        dc    = dc_new_clock(clock);
+    dc_set_members(dc, 3);
+
+    dc_set_offline(dc, const_cast<char*>("UPS001"));
+    CHECK(dc_is_offline(dc));
+
+    // time is accounted under the old policy
+    uint64_t total, offline;
+    upt_clock_advance(clock, 2000);
+    dc_set_policy(dc, DC_POLICY_ALL, 0);
+    CHECK(!dc_is_offline(dc));
+    upt_clock_advance(clock, 2000);
+    dc_uptime(dc, &total, &offline);
+    CHECK(total == 4);
+    CHECK(offline == 2);
+
+    dc_set_offline(dc, const_cast<char*>("UPS002"));
+    CHECK(!dc_is_offline(dc));
+    dc_set_offline(dc, const_cast<char*>("UPS003"));
+    CHECK(dc_is_offline(dc));
+
+    // at least 2 of 3 upses must be online
+    dc_set_policy(dc, DC_POLICY_K_OF_N, 2);
+    dc_set_online(dc, const_cast<char*>("UPS003"));
+    CHECK(dc_is_offline(dc));
+    dc_set_online(dc, const_cast<char*>("UPS002"));
+    CHECK(!dc_is_offline(dc));
+
+    // half of rated capacity must be online, offline capacity follows status and rating changes
+    dc_set_policy(dc, DC_POLICY_CAPACITY, 50);
+    dc_set_rating(dc, "UPS001", 3000);
+    dc_set_rating(dc, "UPS002", 1000);
+    dc_set_rating(dc, "UPS003", 1000);
+    CHECK(dc->capacity == 5000);
+    CHECK(dc->offline_capacity == 3000);
+    CHECK(dc_is_offline(dc));
+    dc_set_rating(dc, "UPS001", 2000);
+    CHECK(dc->offline_capacity == 2000);
+    CHECK(!dc_is_offline(dc));
+    dc_set_offline(dc, const_cast<char*>("UPS002"));
+    CHECK(dc->offline_capacity == 3000);
+    CHECK(dc_is_offline(dc));
+    dc_set_online(dc, const_cast<char*>("UPS001"));
+    CHECK(dc->offline_capacity == 1000);
+    CHECK(!dc_is_offline(dc));
+    CHECK(dc_rating(dc, "UPS042") == 0);
+
+    // policy and ratings are packed
+    dc_set_offline(dc, const_cast<char*>("UPS001"));
+    zframe_t* frame = dc_pack(dc);
+    REQUIRE(frame);
+    dc_t* dc2 = dc_unpack(frame);
+    REQUIRE(dc2);
+    CHECK(dc2->policy == DC_POLICY_CAPACITY);
+    CHECK(dc2->threshold == 50);
+    CHECK(dc2->members == 3);
+    CHECK(dc2->capacity == 4000);
+    CHECK(dc2->offline_capacity == 3000);
+    CHECK(dc_rating(dc2, "UPS001") == 2000);
+    CHECK(zlistx_size(dc2->ups) == 2);
+    CHECK(dc_is_offline(dc2));
+    zframe_destroy(&frame);
+    dc_destroy(&dc2);
+
+    dc_policy_t policy;
+    CHECK(dc_policy_parse("k-of-n", &policy) == 0);
+    CHECK(policy == DC_POLICY_K_OF_N);
+    CHECK(dc_policy_parse("most", &policy) == -1);
+    CHECK(streq(dc_policy_name(DC_POLICY_CAPACITY), "capacity"));
+
+    dc_destroy(&dc);
+    upt_clock_destroy(&clock);
+}
+
+TEST_CASE("dc states")
+{
+    CHECK(dc_state_of_status("8") == DC_STATE_ONLINE);
+    CHECK(dc_state_of_status("16") == DC_STATE_ON_BATTERY);
+    CHECK(dc_state_of_status("80") == DC_STATE_LOW_BATTERY);
+    CHECK(dc_state_of_status("264") == DC_STATE_BYPASS);
+    CHECK(dc_state_of_status("40") == DC_STATE_OVERLOAD);
+    CHECK(dc_state_of_status("0") == DC_STATE_UNKNOWN);
+    CHECK(dc_state_of_status("OB LB") == DC_STATE_LOW_BATTERY);
+    CHECK(dc_state_of_status("OL BYPASS") == DC_STATE_BYPASS);
+    CHECK(dc_state_of_status("OL OVER") == DC_STATE_OVERLOAD);
+    CHECK(dc_state_of_status("OL") == DC_STATE_ONLINE);
+    CHECK(dc_state_of_status("") == DC_STATE_UNKNOWN);
+
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    dc_t*        dc    = dc_new_clock(clock);
+    uint64_t     durations[DC_STATE_COUNT];
+    uint64_t     total, offline;
+
+    // time is accounted before every change, as callers do
+    upt_clock_advance(clock, 2000);
+    dc_durations(dc, durations);
+    CHECK(dc_set_state(dc, "UPS001", DC_STATE_BYPASS));
+    CHECK(!dc_set_state(dc, "UPS001", DC_STATE_BYPASS));
+    CHECK(!dc_is_offline(dc));
+
+    upt_clock_advance(clock, 3000);
+    dc_durations(dc, durations);
+    CHECK(dc_set_state(dc, "UPS002", DC_STATE_LOW_BATTERY));
+    CHECK(dc_is_offline(dc));
+    CHECK(zlistx_size(dc->ups) == 1);
+
+    upt_clock_advance(clock, 4000);
+    dc_durations(dc, durations);
+    CHECK(dc_set_state(dc, "UPS002", DC_STATE_ON_BATTERY));
+    CHECK(zlistx_size(dc->ups) == 1);
+    CHECK(!dc_set_offline(dc, const_cast<char*>("UPS002")));
+    // on bypass is not offline
+    CHECK(!dc_set_online(dc, const_cast<char*>("UPS001")));
+    CHECK(dc_ups_state(dc, "UPS001") == DC_STATE_BYPASS);
+    CHECK(dc->in_state[DC_STATE_BYPASS] == 1);
+
+    CHECK(dc_set_online(dc, const_cast<char*>("UPS002")));
+    CHECK(dc_set_state(dc, "UPS001", DC_STATE_ONLINE));
+    CHECK(!dc_is_offline(dc));
+    CHECK(dc->in_state[DC_STATE_BYPASS] == 0);
+    upt_clock_advance(clock, 1000);
+
+    dc_durations(dc, durations);
+    CHECK(durations[DC_STATE_ONLINE] == 3);
+    CHECK(durations[DC_STATE_BYPASS] == 7);
+    CHECK(durations[DC_STATE_LOW_BATTERY] == 4);
+    CHECK(durations[DC_STATE_ON_BATTERY] == 0);
+    dc_uptime(dc, &total, &offline);
+    CHECK(total == 10);
+    CHECK(offline == 4);
+
+    // states and durations are packed and copied
+    dc_set_state(dc, "UPS003", DC_STATE_OVERLOAD);
+    dc_set_state(dc, "UPS004", DC_STATE_ON_BATTERY);
+    zframe_t* frame = dc_pack(dc);
+    REQUIRE(frame);
+    dc_t* dc2 = dc_unpack(frame);
+    REQUIRE(dc2);
+    dc_t* dc3 = dc_dup(dc);
+    REQUIRE(dc3);
+    for (dc_t* copy : {dc2, dc3}) {
+        CHECK(dc_ups_state(copy, "UPS003") == DC_STATE_OVERLOAD);
+        CHECK(dc_ups_state(copy, "UPS004") == DC_STATE_ON_BATTERY);
+        CHECK(copy->in_state[DC_STATE_OVERLOAD] == 1);
+        CHECK(zlistx_size(copy->ups) == 1);
+        CHECK(copy->durations[DC_STATE_BYPASS] == 7);
+    }
+    zframe_destroy(&frame);
+    dc_destroy(&dc2);
+    dc_destroy(&dc3);
+
+    dc_state_t state;
+    CHECK(dc_state_parse("low-battery", &state) == 0);
+    CHECK(state == DC_STATE_LOW_BATTERY);
+    CHECK(dc_state_parse("sleeping", &state) == -1);
+    CHECK(streq(dc_state_name(DC_STATE_STALE), "stale"));
+
+    dc_destroy(&dc);
+    upt_clock_destroy(&clock);
+}
+
+TEST_CASE("dc ups counters")
+{
+    upt_clock_t*      clock = upt_clock_sim_new(0);
+    dc_t*             dc    = dc_new_clock(clock);
+    dc_ups_counters_t counters;
+
+    CHECK(dc_ups_counters(dc, "UPS001", &counters) == -1);
+
+    // UPS001 on battery for 5 s twice, UPS002 for 7 s once, UPS003 never
+    dc_set_offline(dc, const_cast<char*>("UPS001"));
+    dc_set_state(dc, "UPS003", DC_STATE_BYPASS);
+    upt_clock_advance(clock, 5000);
+    dc_set_online(dc, const_cast<char*>("UPS001"));
+    dc_set_state(dc, "UPS002", DC_STATE_LOW_BATTERY);
+    upt_clock_advance(clock, 7000);
+    dc_set_state(dc, "UPS002", DC_STATE_ONLINE);
+    dc_set_offline(dc, const_cast<char*>("UPS001"));
+    upt_clock_advance(clock, 3000);
+
+    REQUIRE(dc_ups_counters(dc, "UPS001", &counters) == 0);
+    CHECK(counters.on_battery == 8);
+    CHECK(counters.transitions == 3);
+    CHECK(counters.last_change == 12);
+    REQUIRE(dc_ups_counters(dc, "UPS002", &counters) == 0);
+    CHECK(counters.on_battery == 7);
+    CHECK(counters.transitions == 2);
+
+    const char*       upses[3];
+    dc_ups_counters_t top[3];
+    REQUIRE(dc_top(dc, 2, upses, top) == 2);
+    CHECK(streq(upses[0], "UPS001"));
+    CHECK(top[0].on_battery == 8);
+    CHECK(streq(upses[1], "UPS002"));
+    REQUIRE(dc_top(dc, 3, upses, top) == 3);
+    CHECK(streq(upses[2], "UPS003"));
+    CHECK(top[2].on_battery == 0);
+    CHECK(top[2].transitions == 1);
+
+    // counters are packed, restoring states does not count changes
+    zframe_t* frame = dc_pack(dc);
+    REQUIRE(frame);
+    dc_t* dc2 = dc_unpack(frame);
+    REQUIRE(dc2);
+    REQUIRE(dc_ups_counters(dc2, "UPS001", &counters) == 0);
+    CHECK(counters.on_battery == 8);
+    CHECK(counters.transitions == 3);
+    zframe_destroy(&frame);
+    dc_destroy(&dc2);
+
+    // ups leaving the datacenter takes its counters away, time up to it was offline
+    uint64_t total, offline, total2, offline2;
+    dc_uptime(dc, &total, &offline);
+    upt_clock_advance(clock, 5000);
+    dc_remove_ups(dc, "UPS001");
+    CHECK(dc_ups_counters(dc, "UPS001", &counters) == -1);
+    CHECK(!dc_is_offline(dc));
+    dc_uptime(dc, &total2, &offline2);
+    CHECK(total2 == total + 5);
+    CHECK(offline2 == offline + 5);
+    REQUIRE(dc_top(dc, 3, upses, top) == 2);
+    CHECK(streq(upses[0], "UPS002"));
+
+    dc_destroy(&dc);
+    upt_clock_destroy(&clock);
 }
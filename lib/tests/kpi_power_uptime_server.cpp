@@ -3,6 +3,35 @@
 #include <fty_shm.h>
 #include <malamute.h>
 
+// counter name reported by STATS, 0 if not reported
+static uint64_t s_stat(zactor_t* server, const char* name)
+{
+    zstr_sendx(server, "STATS", nullptr);
+    zmsg_t*  reply   = zmsg_recv(server);
+    uint64_t current = 0;
+    for (char* key = zmsg_popstr(reply); key != nullptr; key = zmsg_popstr(reply)) {
+        char* s_value = zmsg_popstr(reply);
+        if (s_value && streq(key, name))
+            current = uint64_t(atoll(s_value));
+        zstr_free(&key);
+        zstr_free(&s_value);
+    }
+    zmsg_destroy(&reply);
+    return current;
+}
+
+// wait until counter name reported by STATS reaches value, return false after 5 seconds
+static bool s_wait_stat(zactor_t* server, const char* name, uint64_t value)
+{
+    int64_t deadline = zclock_mono() + 5000;
+    while (zclock_mono() < deadline) {
+        if (s_stat(server, name) >= value)
+            return true;
+        zclock_sleep(1);
+    }
+    return false;
+}
+
 TEST_CASE("kpi power uptime server test")
 {
     fty_shm_set_test_dir(".");
@@ -25,8 +54,12 @@ TEST_CASE("kpi power uptime server test")
 
     fty_kpi_power_uptime_server_t* kpi = fty_kpi_power_uptime_server_new();
 
+    upt_clock_t* clock = upt_clock_sim_new(0);
+
     zactor_t* server = zactor_new(fty_kpi_power_uptime_server, const_cast<char*>("uptime"));
 
+    zsock_send(server, "sp", "CLOCK", clock);
+    zsock_wait(server);
     zstr_sendx(server, "CONFIG", ".", nullptr);
     zsock_wait(server);
     zstr_sendx(server, "CONNECT", endpoint, nullptr);
@@ -35,7 +68,10 @@ TEST_CASE("kpi power uptime server test")
     //    zsock_wait (server);
     zstr_sendx(server, "CONSUMER", "ASSETS", "datacenter.unknown@.*", nullptr);
     zsock_wait(server);
-    zclock_sleep(500); // THIS IS A HACK TO SETTLE DOWN THINGS
+    zstr_sendx(server, "CONSUMER", "ASSETS", "rack\\..*@.*", nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONSUMER", "ASSETS", "device\\.ups@.*", nullptr);
+    zsock_wait(server);
 
     // ---------- test of the new fn ------------------------
     zhash_t* aux = zhash_new();
@@ -51,7 +87,6 @@ TEST_CASE("kpi power uptime server test")
     REQUIRE(fmsg);
 
     s_set_dc_upses(kpi, fmsg);
-    zclock_sleep(500);
 
     zhash_destroy(&aux);
     fty_proto_destroy(&fmsg);
@@ -72,9 +107,25 @@ TEST_CASE("kpi power uptime server test")
 
     int rv = mlm_client_send(ups_dc, subject, &msg2);
     REQUIRE(rv == 0);
-    zclock_sleep(500);
+    REQUIRE(s_wait_stat(server, "upses", 3));
     zhash_destroy(&aux2);
 
+    // roz.ups33 sits in a rack of my-dc
+    aux2 = zhash_new();
+    zhash_insert(aux2, "type", const_cast<char*>("rack"));
+    zhash_insert(aux2, "parent_name.1", const_cast<char*>("my-dc"));
+    msg2 = fty_proto_encode_asset(aux2, "my-rack", "inventory", nullptr);
+    REQUIRE(mlm_client_send(ups_dc, "rack.unknown@my-rack", &msg2) == 0);
+    zhash_destroy(&aux2);
+    aux2 = zhash_new();
+    zhash_insert(aux2, "type", const_cast<char*>("device"));
+    zhash_insert(aux2, "subtype", const_cast<char*>("ups"));
+    zhash_insert(aux2, "parent_name.1", const_cast<char*>("my-rack"));
+    msg2 = fty_proto_encode_asset(aux2, "roz.ups33", "inventory", nullptr);
+    REQUIRE(mlm_client_send(ups_dc, "device.ups@roz.ups33", &msg2) == 0);
+    zhash_destroy(&aux2);
+    REQUIRE(s_wait_stat(server, "messages.asset", 3));
+
     // set ups to on battery
     //    zmsg_t *metric = fty_proto_encode_metric (nullptr,
     //                                              time (nullptr),
@@ -88,32 +139,181 @@ TEST_CASE("kpi power uptime server test")
     //    mlm_client_send (ups, "status.ups@roz.ups33", &metric);
     fty::shm::write_metric("roz.ups33", "status.ups", "16", "", 100);
 
-    char *subject2, *command, *total, *offline;
-    zclock_sleep(10000);
+    // read shm now and let ten seconds pass on the simulated clock
+    zstr_sendx(server, "POLL", nullptr);
+    zsock_wait(server);
+    upt_clock_advance(clock, 10000);
+
+    char *  subject2, *command, *total, *offline, *unknown;
     zmsg_t* req = zmsg_new();
     zmsg_addstrf(req, "%s", "UPTIME");
     zmsg_addstrf(req, "%s", "my-dc");
     mlm_client_sendto(ui_metr, "uptime", "UPTIME", nullptr, 5000, &req);
 
-    zclock_sleep(3000);
-    int r = mlm_client_recvx(ui_metr, &subject2, &command, &total, &offline, nullptr);
+    int r = mlm_client_recvx(ui_metr, &subject2, &command, &total, &offline, &unknown, nullptr);
     REQUIRE(r != -1);
     CHECK(streq(subject2, "UPTIME"));
     CHECK(streq(command, "UPTIME"));
-    CHECK(atoi(total) > 0);
-    CHECK(atoi(offline) > 0);
+    CHECK(atoi(total) == 10);
+    CHECK(atoi(offline) == 10);
+    CHECK(atoi(unknown) == 0);
 
     // zmsg_destroy (&metric);
     zstr_free(&subject2);
     zstr_free(&command);
     zstr_free(&total);
     zstr_free(&offline);
+    zstr_free(&unknown);
+
+    // the rack of the ups was offline as well
+    char *type, *parent, *rack_total, *rack_offline;
+    req = zmsg_new();
+    zmsg_addstr(req, "ROLLUP");
+    zmsg_addstr(req, "my-rack");
+    mlm_client_sendto(ui_metr, "uptime", "ROLLUP", nullptr, 5000, &req);
+
+    r = mlm_client_recvx(ui_metr, &subject2, &command, &type, &parent, &rack_total, &rack_offline, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(command, "ROLLUP"));
+    CHECK(streq(type, "rack"));
+    CHECK(streq(parent, "my-dc"));
+    CHECK(atoi(rack_total) == 10);
+    CHECK(atoi(rack_offline) == 10);
+    zstr_free(&subject2);
+    zstr_free(&command);
+    zstr_free(&type);
+    zstr_free(&parent);
+    zstr_free(&rack_total);
+    zstr_free(&rack_offline);
+
+    // the ups which was on battery is the worst one
+    char *ups_name, *on_battery, *transitions;
+    req = zmsg_new();
+    zmsg_addstr(req, "TOP");
+    zmsg_addstr(req, "my-dc");
+    zmsg_addstr(req, "3");
+    mlm_client_sendto(ui_metr, "uptime", "TOP", nullptr, 5000, &req);
+
+    r = mlm_client_recvx(ui_metr, &subject2, &command, &ups_name, &on_battery, &transitions, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(subject2, "TOP"));
+    CHECK(streq(command, "TOP"));
+    CHECK(streq(ups_name, "roz.ups33"));
+    CHECK(atoi(on_battery) == 10);
+    CHECK(atoi(transitions) == 1);
+    zstr_free(&subject2);
+    zstr_free(&command);
+    zstr_free(&ups_name);
+    zstr_free(&on_battery);
+    zstr_free(&transitions);
+
+    // n must be a positive number
+    for (const char* bad : {"-1", "0", "ten"}) {
+        char *kind, *reason;
+        req = zmsg_new();
+        zmsg_addstr(req, "TOP");
+        zmsg_addstr(req, "my-dc");
+        zmsg_addstr(req, bad);
+        mlm_client_sendto(ui_metr, "uptime", "TOP", nullptr, 5000, &req);
+        r = mlm_client_recvx(ui_metr, &subject2, &command, &kind, &reason, nullptr);
+        REQUIRE(r != -1);
+        CHECK(streq(command, "TOP"));
+        CHECK(streq(kind, "ERROR"));
+        zstr_free(&subject2);
+        zstr_free(&command);
+        zstr_free(&kind);
+        zstr_free(&reason);
+    }
+
+    // counters since a baseline start from zero
+    char* taken;
+    req = zmsg_new();
+    zmsg_addstr(req, "BASELINE");
+    zmsg_addstr(req, "TAKE");
+    zmsg_addstr(req, "q1");
+    mlm_client_sendto(ui_metr, "uptime", "BASELINE", nullptr, 5000, &req);
+    r = mlm_client_recvx(ui_metr, &subject2, &command, &taken, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(command, "BASELINE"));
+    CHECK(streq(taken, "OK"));
+    zstr_free(&subject2);
+    zstr_free(&command);
+    zstr_free(&taken);
+    upt_clock_advance(clock, 5000);
+
+    req = zmsg_new();
+    zmsg_addstr(req, "UPTIME");
+    zmsg_addstr(req, "my-dc");
+    zmsg_addstr(req, "q1");
+    mlm_client_sendto(ui_metr, "uptime", "UPTIME", nullptr, 5000, &req);
+    r = mlm_client_recvx(ui_metr, &subject2, &command, &total, &offline, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(command, "UPTIME"));
+    CHECK(atoi(total) == 5);
+    CHECK(atoi(offline) == 5);
+    zstr_free(&subject2);
+    zstr_free(&command);
+    zstr_free(&total);
+    zstr_free(&offline);
+
+    req = zmsg_new();
+    zmsg_addstr(req, "UPTIME");
+    zmsg_addstr(req, "my-dc");
+    zmsg_addstr(req, "q2");
+    mlm_client_sendto(ui_metr, "uptime", "UPTIME", nullptr, 5000, &req);
+    r = mlm_client_recvx(ui_metr, &subject2, &command, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(command, "ERROR"));
+    zstr_free(&subject2);
+    zstr_free(&command);
+
+    // all datacenters streamed as JSON Lines, then the number of records
+    char *kind, *seq, *data, *count;
+    req = zmsg_new();
+    zmsg_addstr(req, "EXPORT");
+    zmsg_addstr(req, "json");
+    zmsg_addstr(req, "all");
+    mlm_client_sendto(ui_metr, "uptime", "EXPORT", nullptr, 5000, &req);
+    r = mlm_client_recvx(ui_metr, &subject2, &command, &kind, &seq, &data, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(command, "EXPORT"));
+    CHECK(streq(kind, "DATA"));
+    CHECK(streq(seq, "0"));
+    CHECK(strstr(data, "{\"record\":\"dc\",\"dc\":\"my-dc\",\"total\":15,\"offline\":15,"));
+    CHECK(strstr(data, "{\"record\":\"window\",\"dc\":\"my-dc\",\"baseline\":\"q1\","));
+    CHECK(strstr(data, "{\"record\":\"ups\",\"dc\":\"my-dc\",\"ups\":\"roz.ups33\",\"state\":\"on-battery\""));
+    zstr_free(&subject2);
+    zstr_free(&command);
+    zstr_free(&kind);
+    zstr_free(&seq);
+    zstr_free(&data);
+    r = mlm_client_recvx(ui_metr, &subject2, &command, &kind, &count, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(kind, "END"));
+    CHECK(atoi(count) >= 3);
+    zstr_free(&subject2);
+    zstr_free(&command);
+    zstr_free(&kind);
+    zstr_free(&count);
+
+    req = zmsg_new();
+    zmsg_addstr(req, "EXPORT");
+    zmsg_addstr(req, "csv");
+    zmsg_addstr(req, "all");
+    mlm_client_sendto(ui_metr, "uptime", "EXPORT", nullptr, 5000, &req);
+    r = mlm_client_recvx(ui_metr, &subject2, &command, &kind, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(kind, "ERROR"));
+    zstr_free(&subject2);
+    zstr_free(&command);
+    zstr_free(&kind);
 
     mlm_client_destroy(&ups_dc);
     //    mlm_client_destroy (&ups);
     mlm_client_destroy(&ui_metr);
     zactor_destroy(&server);
     zactor_destroy(&broker);
+    upt_clock_destroy(&clock);
 
     // test for private function only!! UGLY REDONE DO NOT READ!!
     fty_kpi_power_uptime_server_t* s = fty_kpi_power_uptime_server_new();
@@ -127,7 +327,6 @@ TEST_CASE("kpi power uptime server test")
     REQUIRE(r == 0);
 
     fty_kpi_power_uptime_server_set_dir(s, ".");
-    zclock_sleep(1000);
     r = fty_kpi_power_uptime_server_save_state(s);
     REQUIRE(r == 0);
     r = fty_kpi_power_uptime_server_load_state(s);
@@ -138,3 +337,334 @@ TEST_CASE("kpi power uptime server test")
     fty_kpi_power_uptime_server_destroy(&s);
     fty_shm_delete_test_dir();
 }
+
+TEST_CASE("kpi power uptime server bootstrap")
+{
+    fty_shm_set_test_dir(".");
+    fty_shm_set_default_polling_interval(10);
+
+    static const char* endpoint = "inproc://upt-server-bootstrap-test";
+    zactor_t*          broker   = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    zstr_sendx(broker, "BIND", endpoint, nullptr);
+
+    mlm_client_t* ui = mlm_client_new();
+    mlm_client_connect(ui, endpoint, 1000, "UI");
+
+    // mock of the asset agent, republishes one datacenter on request
+    mlm_client_t* asset = mlm_client_new();
+    mlm_client_connect(asset, endpoint, 1000, "asset-agent-mock");
+    mlm_client_set_producer(asset, "ASSETS");
+
+    // UPS status is already in shm before the server starts
+    fty::shm::write_metric("boot.ups1", "status.ups", "16", "", 100);
+
+    upt_clock_t* clock  = upt_clock_sim_new(0);
+    zactor_t*    server = zactor_new(fty_kpi_power_uptime_server, const_cast<char*>("uptime-boot"));
+    zsock_send(server, "sp", "CLOCK", clock);
+    zsock_wait(server);
+    zstr_sendx(server, "CONFIG", ".", nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONNECT", endpoint, nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONSUMER", "ASSETS", "datacenter.unknown@.*", nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "BOOTSTRAP", "asset-agent-mock", "5000", nullptr);
+    zsock_wait(server);
+
+    zmsg_t* request = mlm_client_recv(asset);
+    REQUIRE(request);
+    CHECK(streq(mlm_client_subject(asset), "REPUBLISH"));
+    char* what = zmsg_popstr(request);
+    CHECK(streq(what, "$all"));
+    zstr_free(&what);
+    zmsg_destroy(&request);
+
+    zhash_t* aux = zhash_new();
+    zhash_autofree(aux);
+    zhash_insert(aux, "ups1", const_cast<char*>("boot.ups1"));
+    zhash_insert(aux, "ups2", const_cast<char*>("boot.ups2"));
+    zhash_insert(aux, "type", const_cast<char*>("datacenter"));
+    zmsg_t* msg = fty_proto_encode_asset(aux, "boot-dc", "inventory", nullptr);
+    int     rv  = mlm_client_send(asset, "datacenter.unknown@boot-dc", &msg);
+    REQUIRE(rv == 0);
+    zhash_destroy(&aux);
+
+    // bootstrap window closes after the stream goes quiet, well before the polling interval
+    int64_t deadline = zclock_mono() + 5000;
+    while (int64_t(s_stat(server, "bootstrap_ms")) == -1 && zclock_mono() < deadline)
+        zclock_sleep(1);
+    int64_t bootstrap_ms = int64_t(s_stat(server, "bootstrap_ms"));
+    CHECK(bootstrap_ms >= 0);
+    CHECK(bootstrap_ms < 5000);
+    CHECK(s_stat(server, "upses") == 2);
+    CHECK(s_stat(server, "timer.bootstrap.runs") >= 1);
+
+    // status seeded from shm when the window closed makes the datacenter offline at once (a state
+    // left by an earlier run only adds to both counters)
+    upt_clock_advance(clock, 10000);
+    zmsg_t* req = zmsg_new();
+    zmsg_addstr(req, "UPTIME");
+    zmsg_addstr(req, "boot-dc");
+    mlm_client_sendto(ui, "uptime-boot", "UPTIME", nullptr, 5000, &req);
+
+    char *subject, *command, *total, *offline;
+    int   r = mlm_client_recvx(ui, &subject, &command, &total, &offline, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(command, "UPTIME"));
+    CHECK(atoi(offline) >= 10);
+    CHECK(streq(offline, total));
+
+    zstr_free(&subject);
+    zstr_free(&command);
+    zstr_free(&total);
+    zstr_free(&offline);
+
+    mlm_client_destroy(&asset);
+    mlm_client_destroy(&ui);
+    zactor_destroy(&server);
+    zactor_destroy(&broker);
+    upt_clock_destroy(&clock);
+    fty_shm_delete_test_dir();
+}
+
+TEST_CASE("kpi power uptime server reader")
+{
+    static const char* endpoint = "inproc://upt-server-reader-test";
+    zactor_t*          broker   = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    zstr_sendx(broker, "BIND", endpoint, nullptr);
+
+    mlm_client_t* ui = mlm_client_new();
+    mlm_client_connect(ui, endpoint, 1000, "UI");
+
+    mlm_client_t* asset = mlm_client_new();
+    mlm_client_connect(asset, endpoint, 1000, "ASSET");
+    mlm_client_set_producer(asset, "ASSETS");
+
+    zactor_t* server = zactor_new(fty_kpi_power_uptime_server, const_cast<char*>("uptime-reader"));
+    zstr_sendx(server, "CONFIG", ".", nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "READER", nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONNECT", endpoint, nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONSUMER", "ASSETS", "datacenter.unknown@.*", nullptr);
+    zsock_wait(server);
+
+    zhash_t* aux = zhash_new();
+    zhash_autofree(aux);
+    zhash_insert(aux, "ups1", const_cast<char*>("reader.ups1"));
+    zhash_insert(aux, "type", const_cast<char*>("datacenter"));
+    zmsg_t* msg = fty_proto_encode_asset(aux, "reader-dc", "inventory", nullptr);
+    REQUIRE(mlm_client_send(asset, "datacenter.unknown@reader-dc", &msg) == 0);
+    zhash_destroy(&aux);
+    REQUIRE(s_wait_stat(server, "upses", 1));
+
+    // answered by the reader thread from the published snapshot
+    zmsg_t* req = zmsg_new();
+    zmsg_addstr(req, "UPTIME");
+    zmsg_addstr(req, "reader-dc");
+    mlm_client_sendto(ui, "uptime-reader", "UPTIME", nullptr, 5000, &req);
+
+    char *subject, *command, *total, *offline;
+    int   r = mlm_client_recvx(ui, &subject, &command, &total, &offline, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(command, "UPTIME"));
+    zstr_free(&subject);
+    zstr_free(&command);
+    zstr_free(&total);
+    zstr_free(&offline);
+
+    // forwarded to the server, which answers on its own
+    req = zmsg_new();
+    zmsg_addstr(req, "FOO");
+    mlm_client_sendto(ui, "uptime-reader", "UPTIME", nullptr, 5000, &req);
+
+    char *reason;
+    r = mlm_client_recvx(ui, &subject, &command, &reason, nullptr);
+    REQUIRE(r != -1);
+    CHECK(streq(command, "ERROR"));
+    zstr_free(&subject);
+    zstr_free(&command);
+    zstr_free(&reason);
+
+    mlm_client_destroy(&asset);
+    mlm_client_destroy(&ui);
+    zactor_destroy(&server);
+    zactor_destroy(&broker);
+}
+
+TEST_CASE("kpi power uptime server priority")
+{
+    static const char* endpoint = "inproc://upt-server-priority-test";
+    zactor_t*          broker   = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    zstr_sendx(broker, "BIND", endpoint, nullptr);
+
+    mlm_client_t* ui = mlm_client_new();
+    mlm_client_connect(ui, endpoint, 1000, "UI");
+
+    mlm_client_t* asset = mlm_client_new();
+    mlm_client_connect(asset, endpoint, 1000, "ASSET");
+    mlm_client_set_producer(asset, "ASSETS");
+
+    zactor_t* server = zactor_new(fty_kpi_power_uptime_server, const_cast<char*>("uptime-priority"));
+    zstr_sendx(server, "CONFIG", ".", nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONNECT", endpoint, nullptr);
+    zsock_wait(server);
+    zstr_sendx(server, "CONSUMER", "ASSETS", "datacenter.unknown@.*", nullptr);
+    zsock_wait(server);
+
+    // storm of datacenter assets followed by one query
+    const int storm = 2000;
+    for (int i = 0; i != storm; i++) {
+        zhash_t* aux = zhash_new();
+        zhash_autofree(aux);
+        char* ups = zsys_sprintf("storm.ups%d", i);
+        zhash_insert(aux, "ups1", ups);
+        zhash_insert(aux, "type", const_cast<char*>("datacenter"));
+        char*   dc      = zsys_sprintf("storm-dc%d", i % 10);
+        char*   subject = zsys_sprintf("datacenter.unknown@%s", dc);
+        zmsg_t* msg     = fty_proto_encode_asset(aux, dc, "inventory", nullptr);
+        mlm_client_send(asset, subject, &msg);
+        zstr_free(&subject);
+        zstr_free(&dc);
+        zstr_free(&ups);
+        zhash_destroy(&aux);
+    }
+
+    zmsg_t* req = zmsg_new();
+    zmsg_addstr(req, "UPTIME");
+    zmsg_addstr(req, "storm-dc0");
+    mlm_client_sendto(ui, "uptime-priority", "UPTIME", nullptr, 5000, &req);
+
+    char *subject, *command, *total, *offline;
+    int   r = mlm_client_recvx(ui, &subject, &command, &total, &offline, nullptr);
+    REQUIRE(r != -1);
+    zstr_free(&subject);
+    zstr_free(&command);
+    zstr_free(&total);
+    zstr_free(&offline);
+
+    zstr_sendx(server, "QUEUES", nullptr);
+    zmsg_t* reply = zmsg_recv(server);
+    REQUIRE(reply);
+    bool served        = false;
+    int  stream_served = -1;
+    int  stream_depth  = -1;
+    for (char* key = zmsg_popstr(reply); key != nullptr; key = zmsg_popstr(reply)) {
+        char* value = zmsg_popstr(reply);
+        if (streq(key, "queries.served"))
+            served = value && atoi(value) == 1;
+        else if (streq(key, "stream.served") && value)
+            stream_served = atoi(value);
+        else if (streq(key, "stream.depth") && value)
+            stream_depth = atoi(value);
+        zstr_free(&key);
+        zstr_free(&value);
+    }
+    CHECK(served);
+    // the query overtook the storm: part of it was still waiting when the reply came
+    REQUIRE(stream_served != -1);
+    REQUIRE(stream_depth != -1);
+    CHECK((stream_depth > 0 || stream_served < storm));
+    zmsg_destroy(&reply);
+
+    req = zmsg_new();
+    zmsg_addstr(req, "STATS");
+    mlm_client_sendto(ui, "uptime-priority", "STATS", nullptr, 5000, &req);
+    reply = mlm_client_recv(ui);
+    REQUIRE(reply);
+    CHECK(streq(mlm_client_subject(ui), "STATS"));
+    char* header = zmsg_popstr(reply);
+    CHECK(streq(header, "STATS"));
+    CHECK(zmsg_size(reply) % 2 == 0);
+    zstr_free(&header);
+    zmsg_destroy(&reply);
+
+    mlm_client_destroy(&asset);
+    mlm_client_destroy(&ui);
+    zactor_destroy(&server);
+    zactor_destroy(&broker);
+}
+
+TEST_CASE("kpi power uptime server replica")
+{
+    fty_shm_set_test_dir(".");
+    fty_shm_set_default_polling_interval(3600);
+
+    static const char* endpoint = "inproc://upt-server-replica-test";
+    static const char* stream   = "inproc://upt-server-replica-stream";
+    zactor_t*          broker   = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    zstr_sendx(broker, "BIND", endpoint, nullptr);
+
+    mlm_client_t* asset = mlm_client_new();
+    mlm_client_connect(asset, endpoint, 1000, "ASSET");
+    mlm_client_set_producer(asset, "ASSETS");
+
+    upt_clock_t* clock = upt_clock_sim_new(0);
+
+    zactor_t* leader = zactor_new(fty_kpi_power_uptime_server, const_cast<char*>("uptime-leader"));
+    zsock_send(leader, "sp", "CLOCK", clock);
+    zsock_wait(leader);
+    zstr_sendx(leader, "CONNECT", endpoint, nullptr);
+    zsock_wait(leader);
+    zstr_sendx(leader, "CONSUMER", "ASSETS", "datacenter.unknown@.*", nullptr);
+    zsock_wait(leader);
+    zstr_sendx(leader, "REPLICATE", stream, "60000", nullptr);
+    zsock_wait(leader);
+
+    zactor_t* follower = zactor_new(fty_kpi_power_uptime_server, const_cast<char*>("uptime-follower"));
+    zsock_send(follower, "sp", "CLOCK", clock);
+    zsock_wait(follower);
+    zstr_sendx(follower, "FOLLOW", stream, nullptr);
+    zsock_wait(follower);
+
+    // subscription alone brings the first snapshot
+    REQUIRE(s_wait_stat(follower, "replica.snapshots", 1));
+
+    zhash_t* aux = zhash_new();
+    zhash_autofree(aux);
+    zhash_insert(aux, "ups1", const_cast<char*>("rep.ups1"));
+    zhash_insert(aux, "type", const_cast<char*>("datacenter"));
+    zmsg_t* msg = fty_proto_encode_asset(aux, "rep-dc", "inventory", nullptr);
+    REQUIRE(mlm_client_send(asset, "datacenter.unknown@rep-dc", &msg) == 0);
+    zhash_destroy(&aux);
+    REQUIRE(s_wait_stat(leader, "upses", 1));
+
+    fty::shm::write_metric("rep.ups1", "status.ups", "16", "", 100);
+    zstr_sendx(leader, "POLL", nullptr);
+    zsock_wait(leader);
+
+    // snapshot, topology and delta of the outage
+    uint64_t seq = s_stat(leader, "replica.seq");
+    CHECK(seq >= 3);
+    REQUIRE(s_wait_stat(follower, "replica.seq", seq));
+    CHECK(s_stat(follower, "replica.synced") == 1);
+    CHECK(s_stat(follower, "replica.gaps") == 0);
+
+    int      r;
+    uint64_t total, offline;
+    upt_clock_advance(clock, 5000);
+    zstr_sendx(follower, "UPTIME", "rep-dc", nullptr);
+    zsock_recv(follower, "i88", &r, &total, &offline);
+    CHECK(r == 0);
+    CHECK(total == 5);
+    CHECK(offline == 5);
+
+    // leader is gone, follower takes over with what it has
+    zactor_destroy(&leader);
+    zstr_sendx(follower, "PROMOTE", nullptr);
+    zsock_wait(follower);
+    upt_clock_advance(clock, 5000);
+    zstr_sendx(follower, "UPTIME", "rep-dc", nullptr);
+    zsock_recv(follower, "i88", &r, &total, &offline);
+    CHECK(r == 0);
+    CHECK(total == 10);
+    CHECK(offline == 10);
+
+    zactor_destroy(&follower);
+    mlm_client_destroy(&asset);
+    zactor_destroy(&broker);
+    upt_clock_destroy(&clock);
+    fty_shm_delete_test_dir();
+}
@@ -13,7 +13,11 @@ TEST_CASE("upt test")
     upt_destroy(&uptime);
     CHECK(!uptime);
 
+    // simulated clock, time moves only when the test says so
+    upt_clock_t* clock = upt_clock_sim_new(0);
+
     uptime = upt_new();
+    upt_set_clock(uptime, clock);
     uint64_t total, offline;
     int      r;
 
@@ -59,22 +63,22 @@ TEST_CASE("upt test")
     upt_set_online(uptime, "DC042");
     CHECK(upt_is_offline(uptime, "DC007"));
 
-    // uptime works with 1sec precision, so let sleep
-    zclock_sleep(2000);
+    // uptime works with 1sec precision
+    upt_clock_advance(clock, 2000);
 
     r = upt_uptime(uptime, "DC007", &total, &offline);
     REQUIRE(r == 0);
-    CHECK(total > 1);
-    CHECK(offline > 1);
+    CHECK(total == 2);
+    CHECK(offline == 2);
 
     upt_set_online(uptime, "UPS007");
     CHECK(!upt_is_offline(uptime, "DC007"));
 
-    zclock_sleep(1000);
+    upt_clock_advance(clock, 1000);
     r = upt_uptime(uptime, "DC007", &total, &offline);
     REQUIRE(r == 0);
-    CHECK(total > 2);
-    CHECK(offline > 1);
+    CHECK(total == 3);
+    CHECK(offline == 2);
 
     // test UPS removal
     ups = zlistx_new();
@@ -88,6 +92,7 @@ TEST_CASE("upt test")
     CHECK(!dc_name);
 
     upt_t* uptime2 = upt_new();
+    upt_set_clock(uptime2, clock);
     //    upt_t *uptime3 = upt_new ();
     zlistx_t* ups2 = zlistx_new();
     ups            = zlistx_new();
@@ -111,15 +116,14 @@ TEST_CASE("upt test")
     upt_set_offline(uptime2, "UPS007");
     CHECK(upt_is_offline(uptime2, "DC007"));
 
-    // uptime works with 1sec precision, so let sleep
-    zclock_sleep(2000);
+    upt_clock_advance(clock, 2000);
 
     total   = 0;
     offline = 0;
     r       = upt_uptime(uptime, "DC007", &total, &offline);
     REQUIRE(r == 0);
-    CHECK(total > 1);
-    CHECK(offline > 1);
+    CHECK(total == 5);
+    CHECK(offline == 2);
 
     r = upt_save(uptime2, state_file);
     REQUIRE(r == 0);
@@ -132,8 +136,8 @@ TEST_CASE("upt test")
     offline = 0;
     r       = upt_uptime(uptime, "DC007", &total, &offline);
     REQUIRE(r == 0);
-    CHECK(total > 1);
-    CHECK(offline > 1);
+    CHECK(total == 5);
+    CHECK(offline == 2);
 
     zstr_free(&state_file);
 
@@ -142,4 +146,374 @@ TEST_CASE("upt test")
     upt_destroy(&uptime);
     upt_destroy(&uptime2);
     upt_destroy(&uptime3);
+    upt_clock_destroy(&clock);
+}
+
+TEST_CASE("upt bulk add")
+{
+    upt_t* uptime = upt_new();
+
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(uptime, "DC001", ups) == 0);
+    zlistx_destroy(&ups);
+
+    upt_set_offline(uptime, "UPS002");
+    CHECK(upt_is_offline(uptime, "DC001"));
+
+    zhashx_t* topology = zhashx_new();
+    zlistx_t* dc1      = zlistx_new();
+    zlistx_t* dc2      = zlistx_new();
+    zlistx_add_end(dc1, const_cast<char*>("UPS001"));
+    zlistx_add_end(dc2, const_cast<char*>("UPS003"));
+    zlistx_add_end(dc2, const_cast<char*>("UPS004"));
+    zhashx_insert(topology, "DC001", dc1);
+    zhashx_insert(topology, "DC002", dc2);
+
+    REQUIRE(upt_add_bulk(uptime, topology) == 0);
+
+    // UPS002 left DC001, so it does not keep it offline
+    CHECK(!upt_dc_name(uptime, "UPS002"));
+    CHECK(!upt_is_offline(uptime, "DC001"));
+    CHECK(streq(upt_dc_name(uptime, "UPS001"), "DC001"));
+    CHECK(streq(upt_dc_name(uptime, "UPS003"), "DC002"));
+    CHECK(streq(upt_dc_name(uptime, "UPS004"), "DC002"));
+    CHECK(zhashx_size(uptime->dc) == 2);
+
+    zlistx_destroy(&dc1);
+    zlistx_destroy(&dc2);
+    zhashx_destroy(&topology);
+    upt_destroy(&uptime);
+}
+
+TEST_CASE("upt downtime")
+{
+    char* state_file = zsys_sprintf("%s/state-upt-downtime", ".");
+
+    upt_clock_t* clock  = upt_clock_sim_new(1000000);
+    upt_t*       uptime = upt_new();
+    upt_set_clock(uptime, clock);
+
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(uptime, "DC001", ups) == 0);
+    upt_set_offline(uptime, "UPS002");
+
+    upt_clock_advance(clock, 10000);
+    REQUIRE(upt_save(uptime, state_file) == 0);
+
+    // agent was not running for 100 s
+    upt_clock_advance(clock, 100000);
+
+    struct
+    {
+        dc_gap_policy_t policy;
+        int64_t         clamp;
+        uint64_t        total;
+        uint64_t        unknown;
+    } cases[] = {{DC_GAP_UNKNOWN, 0, 10, 100}, {DC_GAP_ASSUME, 0, 110, 0}, {DC_GAP_CLAMP, 30, 40, 70}};
+
+    for (const auto& c : cases) {
+        upt_t* loaded = upt_load(state_file);
+        REQUIRE(loaded);
+        upt_set_clock(loaded, clock);
+        // offline upses are kept over the restart
+        CHECK(upt_is_offline(loaded, "DC001"));
+
+        upt_reconcile(loaded, c.policy, c.clamp);
+
+        uint64_t total, offline, unknown;
+        REQUIRE(upt_uptime(loaded, "DC001", &total, &offline) == 0);
+        REQUIRE(upt_unknown(loaded, "DC001", &unknown) == 0);
+        // loading runs on the system clock, a second can pass before the clock is set
+        CHECK(total >= c.total);
+        CHECK(total <= c.total + 1);
+        CHECK(offline == total);
+        CHECK(unknown == c.unknown);
+        upt_destroy(&loaded);
+    }
+    uint64_t unknown;
+    CHECK(upt_unknown(uptime, "DC042", &unknown) == -1);
+
+    zlistx_destroy(&ups);
+    upt_destroy(&uptime);
+    upt_clock_destroy(&clock);
+    zsys_file_delete(state_file);
+    zstr_free(&state_file);
+}
+
+TEST_CASE("upt policy")
+{
+    char* state_file = zsys_sprintf("%s/state-upt-policy", ".");
+
+    upt_t*    uptime = upt_new();
+    zlistx_t* ups    = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(uptime, "DC001", ups) == 0);
+    REQUIRE(upt_set_policy(uptime, "DC001", DC_POLICY_ALL, 0) == 0);
+    REQUIRE(upt_set_rating(uptime, "DC001", "UPS001", 800) == 0);
+
+    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(uptime->dc, "DC001"));
+    CHECK(dc->members == 2);
+
+    upt_set_offline(uptime, "UPS001");
+    CHECK(!upt_is_offline(uptime, "DC001"));
+
+    // ups claimed by another datacenter is shared, it leaves DC001 only when DC001 drops it
+    zlistx_t* ups2 = zlistx_new();
+    zlistx_add_end(ups2, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(uptime, "DC002", ups2) == 0);
+    CHECK(dc->members == 2);
+    CHECK(!upt_is_offline(uptime, "DC001"));
+    zlistx_purge(ups);
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    REQUIRE(upt_add(uptime, "DC001", ups) == 0);
+    CHECK(dc->members == 1);
+    CHECK(upt_is_offline(uptime, "DC001"));
+    CHECK(streq(upt_dc_name(uptime, "UPS002"), "DC002"));
+
+    REQUIRE(upt_save(uptime, state_file) == 0);
+    upt_t* loaded = upt_load(state_file);
+    REQUIRE(loaded);
+    dc = reinterpret_cast<dc_t*>(zhashx_lookup(loaded->dc, "DC001"));
+    REQUIRE(dc);
+    CHECK(dc->policy == DC_POLICY_ALL);
+    CHECK(dc->members == 1);
+    CHECK(dc_rating(dc, "UPS001") == 800);
+    CHECK(dc->offline_capacity == 800);
+    CHECK(upt_is_offline(loaded, "DC001"));
+
+    // policy of a datacenter not known yet creates it
+    REQUIRE(upt_set_policy(loaded, "DC003", DC_POLICY_K_OF_N, 2) == 0);
+    CHECK(zhashx_size(loaded->dc) == 3);
+
+    zlistx_destroy(&ups);
+    zlistx_destroy(&ups2);
+    upt_destroy(&loaded);
+    upt_destroy(&uptime);
+    zsys_file_delete(state_file);
+    zstr_free(&state_file);
+}
+
+TEST_CASE("upt states")
+{
+    char* state_file = zsys_sprintf("%s/state-upt-states", ".");
+
+    upt_clock_t* clock  = upt_clock_sim_new(0);
+    upt_t*       uptime = upt_new();
+    upt_set_clock(uptime, clock);
+
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(uptime, "DC001", ups) == 0);
+
+    CHECK(upt_set_state(uptime, "UPS001", DC_STATE_OVERLOAD));
+    CHECK(upt_set_state(uptime, "UPS002", DC_STATE_LOW_BATTERY));
+    CHECK(!upt_set_state(uptime, "UPS042", DC_STATE_BYPASS));
+    upt_clock_advance(clock, 5000);
+
+    uint64_t durations[DC_STATE_COUNT];
+    REQUIRE(upt_durations(uptime, "DC001", durations) == 0);
+    CHECK(durations[DC_STATE_OVERLOAD] == 5);
+    CHECK(durations[DC_STATE_LOW_BATTERY] == 5);
+    CHECK(durations[DC_STATE_ONLINE] == 0);
+    CHECK(upt_durations(uptime, "DC042", durations) == -1);
+
+    REQUIRE(upt_save(uptime, state_file) == 0);
+    upt_t* loaded = upt_load(state_file);
+    REQUIRE(loaded);
+    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(loaded->dc, "DC001"));
+    REQUIRE(dc);
+    CHECK(dc_ups_state(dc, "UPS001") == DC_STATE_OVERLOAD);
+    CHECK(dc_ups_state(dc, "UPS002") == DC_STATE_LOW_BATTERY);
+    CHECK(dc->durations[DC_STATE_OVERLOAD] == 5);
+    CHECK(upt_is_offline(loaded, "DC001"));
+
+    // per ups counters survive the save, restored states are no changes
+    dc_ups_counters_t counters;
+    REQUIRE(dc_ups_counters(dc, "UPS002", &counters) == 0);
+    // loaded state counts on the system clock, the ups is still on battery
+    CHECK(counters.on_battery >= 5);
+    CHECK(counters.transitions == 1);
+    zmsg_t* top = upt_top(loaded, "DC001", 1);
+    REQUIRE(top);
+    CHECK(zmsg_size(top) == 4);
+    char* name = zmsg_popstr(top);
+    CHECK(streq(name, "UPS002"));
+    zstr_free(&name);
+    zmsg_destroy(&top);
+    CHECK(!upt_top(loaded, "DC042", 1));
+
+    zlistx_destroy(&ups);
+    upt_destroy(&loaded);
+    upt_destroy(&uptime);
+    upt_clock_destroy(&clock);
+    zsys_file_delete(state_file);
+    zstr_free(&state_file);
+}
+
+TEST_CASE("upt shared upses")
+{
+    char* state_file = zsys_sprintf("%s/state-upt-shared", ".");
+
+    upt_t*    uptime = upt_new();
+    zlistx_t* ups    = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(uptime, "DC001", ups) == 0);
+    zlistx_purge(ups);
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    zlistx_add_end(ups, const_cast<char*>("UPS003"));
+    REQUIRE(upt_add(uptime, "DC002", ups) == 0);
+
+    // one transition of a shared ups counts in each of its datacenters
+    CHECK(zlistx_size(upt_dc_names(uptime, "UPS002")) == 2);
+    CHECK(upt_set_offline(uptime, "UPS002"));
+    CHECK(!upt_set_offline(uptime, "UPS002"));
+    CHECK(upt_is_offline(uptime, "DC001"));
+    CHECK(upt_is_offline(uptime, "DC002"));
+    dc_ups_counters_t counters;
+    REQUIRE(dc_ups_counters(reinterpret_cast<dc_t*>(zhashx_lookup(uptime->dc, "DC001")), "UPS002", &counters) == 0);
+    CHECK(counters.transitions == 1);
+    REQUIRE(dc_ups_counters(reinterpret_cast<dc_t*>(zhashx_lookup(uptime->dc, "DC002")), "UPS002", &counters) == 0);
+    CHECK(counters.transitions == 1);
+
+    // membership survives save, partition and merge
+    REQUIRE(upt_save(uptime, state_file) == 0);
+    upt_t* loaded = upt_load(state_file);
+    REQUIRE(loaded);
+    CHECK(zlistx_size(upt_dc_names(loaded, "UPS002")) == 2);
+    CHECK(upt_is_offline(loaded, "DC002"));
+    upt_t* part0 = upt_partition(loaded, 0, 2);
+    upt_t* part1 = upt_partition(loaded, 1, 2);
+    CHECK(zhashx_size(part0->dc) + zhashx_size(part1->dc) == 2);
+    upt_merge(part0, &part1);
+    CHECK(zlistx_size(upt_dc_names(part0, "UPS002")) == 2);
+    upt_destroy(&part0);
+    upt_destroy(&loaded);
+
+    // copy of some datacenters carries their counters, not the membership
+    zlistx_t* names = zlistx_new();
+    zlistx_add_end(names, const_cast<char*>("DC002"));
+    zlistx_add_end(names, const_cast<char*>("DC042"));
+    upt_t* copy = upt_dup_dcs(uptime, names);
+    REQUIRE(copy);
+    CHECK(zhashx_size(copy->dc) == 1);
+    CHECK(upt_is_offline(copy, "DC002"));
+    CHECK(!upt_dc_names(copy, "UPS002"));
+    upt_destroy(&copy);
+    zlistx_destroy(&names);
+
+    // refresh of one datacenter removes only its membership
+    zhashx_t* topology = zhashx_new();
+    zlistx_purge(ups);
+    zlistx_add_end(ups, const_cast<char*>("UPS003"));
+    zhashx_insert(topology, "DC002", ups);
+    REQUIRE(upt_add_bulk(uptime, topology) == 0);
+    zhashx_destroy(&topology);
+    CHECK(streq(upt_dc_name(uptime, "UPS002"), "DC001"));
+    CHECK(zlistx_size(upt_dc_names(uptime, "UPS002")) == 1);
+    CHECK(upt_is_offline(uptime, "DC001"));
+    CHECK(!upt_is_offline(uptime, "DC002"));
+    upt_destroy(&uptime);
+
+    // every ups shared by three datacenters out of many
+    const int datacenters = 1000;
+    const int upses       = 10000;
+    uptime                = upt_new();
+    zlistx_purge(ups);
+    zlistx_set_duplicator(ups, [](const void* x) -> void* { return strdup(reinterpret_cast<const char*>(x)); });
+    zlistx_set_destructor(ups, [](void** x) { zstr_free(reinterpret_cast<char**>(x)); });
+    for (int d = 0; d != datacenters; d++) {
+        zlistx_purge(ups);
+        for (int u = 0; u != upses; u++) {
+            if (u % datacenters == d || (u + 1) % datacenters == d || (u + 2) % datacenters == d) {
+                char* name = zsys_sprintf("UPS%05d", u);
+                zlistx_add_end(ups, name);
+                zstr_free(&name);
+            }
+        }
+        char* dc_name = zsys_sprintf("DC%04d", d);
+        REQUIRE(upt_add(uptime, dc_name, ups) == 0);
+        zstr_free(&dc_name);
+    }
+    CHECK(zhashx_size(uptime->ups2dc) == size_t(upses));
+    size_t memberships = 0;
+    for (int u = 0; u != upses; u++) {
+        char* name = zsys_sprintf("UPS%05d", u);
+        CHECK(upt_set_offline(uptime, name));
+        memberships += zlistx_size(upt_dc_names(uptime, name));
+        zstr_free(&name);
+    }
+    CHECK(memberships == size_t(3 * upses));
+    size_t offline = 0;
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(uptime->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(uptime->dc))) {
+        if (dc_is_offline(dc))
+            offline++;
+    }
+    CHECK(offline == size_t(datacenters));
+    upt_destroy(&uptime);
+
+    zlistx_destroy(&ups);
+    zsys_file_delete(state_file);
+    zstr_free(&state_file);
+}
+
+TEST_CASE("upt frozen copy")
+{
+    upt_clock_t* clock  = upt_clock_sim_new(0);
+    upt_t*       uptime = upt_new();
+    upt_set_clock(uptime, clock);
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    REQUIRE(upt_add(uptime, "DC001", ups) == 0);
+    zlistx_purge(ups);
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(uptime, "DC002", ups) == 0);
+    zlistx_destroy(&ups);
+    upt_set_offline(uptime, "UPS001");
+    upt_clock_advance(clock, 10000);
+
+    // copies taken later count up to the stopped clock only
+    upt_clock_t* stopped = upt_clock_sim_new(upt_clock_now(clock));
+    upt_clock_advance(clock, 5000);
+    zlistx_t* names = zlistx_new();
+    zlistx_add_end(names, const_cast<char*>("DC001"));
+    zlistx_add_end(names, const_cast<char*>("DC002"));
+    upt_t* copy = upt_dup_dcs(uptime, names);
+    REQUIRE(copy);
+    upt_freeze(copy, stopped);
+    upt_clock_advance(clock, 5000);
+
+    uint64_t total, offline;
+    REQUIRE(upt_uptime(copy, "DC001", &total, &offline) == 0);
+    CHECK(total == 10);
+    CHECK(offline == 10);
+    REQUIRE(upt_uptime(copy, "DC002", &total, &offline) == 0);
+    CHECK(total == 10);
+    CHECK(offline == 0);
+    zmsg_t* top = upt_top(copy, "DC001", 1);
+    REQUIRE(top);
+    char* name       = zmsg_popstr(top);
+    char* on_battery = zmsg_popstr(top);
+    CHECK(streq(name, "UPS001"));
+    CHECK(streq(on_battery, "10"));
+    zstr_free(&name);
+    zstr_free(&on_battery);
+    zmsg_destroy(&top);
+
+    // the live state goes on
+    REQUIRE(upt_uptime(uptime, "DC001", &total, &offline) == 0);
+    CHECK(total == 20);
+
+    upt_destroy(&copy);
+    zlistx_destroy(&names);
+    upt_destroy(&uptime);
+    upt_clock_destroy(&stopped);
+    upt_clock_destroy(&clock);
 }
@@ -0,0 +1,173 @@
+#include "src/upt_baseline.h"
+#include <catch2/catch.hpp>
+#include <unistd.h>
+
+static upt_baseline_counters_t s_counters(upt_t* upt, const char* dc_name)
+{
+    upt_baseline_counters_t counters = {};
+    CHECK(upt_uptime(upt, dc_name, &counters.total, &counters.offline) == 0);
+    CHECK(upt_unknown(upt, dc_name, &counters.unknown) == 0);
+    CHECK(upt_durations(upt, dc_name, counters.durations) == 0);
+    return counters;
+}
+
+static void s_add(upt_t* upt, const char* dc_name, const char* ups_name)
+{
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>(ups_name));
+    REQUIRE(upt_add(upt, dc_name, ups) == 0);
+    zlistx_destroy(&ups);
+}
+
+TEST_CASE("upt baseline test")
+{
+    upt_clock_t*    clock     = upt_clock_sim_new(0);
+    upt_t*          upt       = upt_new();
+    upt_baseline_t* baselines = upt_baseline_new();
+    upt_set_clock(upt, clock);
+    s_add(upt, "DC1", "UPS1");
+    s_add(upt, "DC2", "UPS2");
+
+    upt_baseline_counters_t counters = {};
+    CHECK(upt_baseline_since(baselines, "q1", "DC1", &counters) == -1);
+    CHECK(upt_baseline_taken(baselines, "q1") == -1);
+
+    // q1 after 10s online, DC1 goes offline for 5s after it
+    upt_clock_advance(clock, 10000);
+    upt_baseline_take(baselines, "q1", 1000, upt);
+    CHECK(upt_baseline_taken(baselines, "q1") == 1000);
+    upt_set_offline(upt, "UPS1");
+    upt_clock_advance(clock, 5000);
+    counters = s_counters(upt, "DC1");
+    CHECK(counters.total == 15);
+    REQUIRE(upt_baseline_since(baselines, "q1", "DC1", &counters) == 0);
+    CHECK(counters.total == 5);
+    CHECK(counters.offline == 5);
+    CHECK(counters.durations[DC_STATE_ONLINE] == 0);
+    CHECK(counters.durations[DC_STATE_ON_BATTERY] == 5);
+
+    // q2, audit is taken at the same time and has no counters of its own, DC3 comes after all
+    upt_baseline_take(baselines, "q2", 1005, upt);
+    upt_baseline_take(baselines, "audit", 1005, upt);
+    s_add(upt, "DC3", "UPS3");
+    upt_clock_advance(clock, 2000);
+    counters = s_counters(upt, "DC3");
+    REQUIRE(upt_baseline_since(baselines, "q1", "DC3", &counters) == 0);
+    CHECK(counters.total == 2);
+    counters = s_counters(upt, "DC2");
+    REQUIRE(upt_baseline_since(baselines, "q2", "DC2", &counters) == 0);
+    CHECK(counters.total == 2);
+    CHECK(counters.offline == 0);
+
+    // baselines are listed by name
+    CHECK(upt_baseline_size(baselines) == 3);
+    CHECK(streq(upt_baseline_first(baselines), "audit"));
+    CHECK(streq(upt_baseline_next(baselines), "q1"));
+    CHECK(streq(upt_baseline_next(baselines), "q2"));
+    CHECK(!upt_baseline_next(baselines));
+
+    // saved as deltas, counters are the same once loaded
+    char path[] = "/tmp/upt-baseline-XXXXXX";
+    int  fd     = mkstemp(path);
+    REQUIRE(fd != -1);
+    close(fd);
+    REQUIRE(upt_baseline_save(baselines, path) == 0);
+    size_t records = 0;
+    FILE*  file    = fopen(path, "r");
+    REQUIRE(file);
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        records++;
+    }
+    fclose(file);
+    CHECK(records == 1 + 3 + 3 + 1); // header, q1 and q2 with DC1 and DC2, audit alone
+
+    upt_baseline_t* loaded = upt_baseline_load(path);
+    REQUIRE(loaded);
+    CHECK(upt_baseline_size(loaded) == 3);
+    CHECK(upt_baseline_taken(loaded, "q2") == 1005);
+    for (const char* dc_name : {"DC1", "DC2", "DC3"}) {
+        for (const char* name : {"q1", "q2", "audit"}) {
+            upt_baseline_counters_t expected = s_counters(upt, dc_name);
+            upt_baseline_counters_t actual   = expected;
+            REQUIRE(upt_baseline_since(baselines, name, dc_name, &expected) == 0);
+            REQUIRE(upt_baseline_since(loaded, name, dc_name, &actual) == 0);
+            CHECK(memcmp(&expected, &actual, sizeof(expected)) == 0);
+        }
+    }
+    upt_baseline_destroy(&loaded);
+
+    // retaking replaces a baseline, dropping forgets it
+    upt_baseline_take(baselines, "q1", 1007, upt);
+    counters = s_counters(upt, "DC1");
+    REQUIRE(upt_baseline_since(baselines, "q1", "DC1", &counters) == 0);
+    CHECK(counters.total == 0);
+    CHECK(upt_baseline_drop(baselines, "q1") == 0);
+    CHECK(upt_baseline_drop(baselines, "q1") == -1);
+    CHECK(upt_baseline_size(baselines) == 2);
+
+    // malformed file is refused
+    file = fopen(path, "w");
+    REQUIRE(file);
+    fprintf(file, "dc\tDC1\t1\t2\t3\n");
+    fclose(file);
+    CHECK(!upt_baseline_load(path));
+    unlink(path);
+
+    upt_baseline_destroy(&baselines);
+    CHECK(!baselines);
+    upt_destroy(&upt);
+    upt_clock_destroy(&clock);
+}
+
+TEST_CASE("upt baseline removed datacenter and names with separators")
+{
+    upt_clock_t*    clock     = upt_clock_sim_new(0);
+    upt_t*          before    = upt_new();
+    upt_t*          after     = upt_new();
+    upt_baseline_t* baselines = upt_baseline_new();
+    upt_set_clock(before, clock);
+    upt_set_clock(after, clock);
+    s_add(before, "DC1", "UPS1");
+    s_add(before, "DC\t2\n", "UPS2");
+    s_add(after, "DC1", "UPS1");
+
+    // DC\t2\n is gone in the second baseline, the third one has a name with separators
+    upt_clock_advance(clock, 10000);
+    upt_baseline_take(baselines, "q1", 1000, before);
+    upt_clock_advance(clock, 5000);
+    upt_baseline_take(baselines, "q2", 1005, after);
+    upt_baseline_take(baselines, "q\t3\r\n\\", 1005, after);
+
+    char path[] = "/tmp/upt-baseline-XXXXXX";
+    int  fd     = mkstemp(path);
+    REQUIRE(fd != -1);
+    close(fd);
+    REQUIRE(upt_baseline_save(baselines, path) == 0);
+    upt_baseline_t* loaded = upt_baseline_load(path);
+    unlink(path);
+    REQUIRE(loaded);
+    CHECK(upt_baseline_size(loaded) == 3);
+    CHECK(upt_baseline_taken(loaded, "q\t3\r\n\\") == 1005);
+
+    upt_clock_advance(clock, 2000);
+    for (const char* dc_name : {"DC1", "DC\t2\n"}) {
+        for (const char* name : {"q1", "q2", "q\t3\r\n\\"}) {
+            upt_baseline_counters_t expected = s_counters(before, dc_name);
+            upt_baseline_counters_t actual   = expected;
+            REQUIRE(upt_baseline_since(baselines, name, dc_name, &expected) == 0);
+            REQUIRE(upt_baseline_since(loaded, name, dc_name, &actual) == 0);
+            CHECK(memcmp(&expected, &actual, sizeof(expected)) == 0);
+        }
+    }
+    // the removed datacenter reports all its time since the baselines it is not in
+    upt_baseline_counters_t counters = s_counters(before, "DC\t2\n");
+    REQUIRE(upt_baseline_since(loaded, "q2", "DC\t2\n", &counters) == 0);
+    CHECK(counters.total == 17);
+
+    upt_baseline_destroy(&loaded);
+    upt_baseline_destroy(&baselines);
+    upt_destroy(&after);
+    upt_destroy(&before);
+    upt_clock_destroy(&clock);
+}
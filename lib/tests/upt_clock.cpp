@@ -0,0 +1,94 @@
+#include "src/upt.h"
+#include "src/upt_clock.h"
+#include <catch2/catch.hpp>
+
+static int64_t s_fixed_now(upt_clock_t* self)
+{
+    return *reinterpret_cast<int64_t*>(self->arg);
+}
+
+TEST_CASE("upt clock test")
+{
+    // system clock
+    upt_clock_t* system = upt_clock_system();
+    REQUIRE(system);
+    CHECK(upt_clock_now(system) <= zclock_mono());
+    CHECK(upt_clock_now(nullptr) >= upt_clock_now(system));
+    upt_clock_destroy(&system);
+    CHECK(!system);
+    CHECK(upt_clock_system());
+
+    // simulated clock
+    upt_clock_t* clock = upt_clock_sim_new(42);
+    CHECK(upt_clock_now(clock) == 42);
+    upt_clock_advance(clock, 1000);
+    CHECK(upt_clock_now(clock) == 1042);
+    upt_clock_set(clock, 5000);
+    CHECK(upt_clock_now(clock) == 5000);
+    upt_clock_set(clock, 10);
+    CHECK(upt_clock_now(clock) == 5000);
+    upt_clock_destroy(&clock);
+    CHECK(!clock);
+
+    // custom time source
+    int64_t      now    = 7000;
+    upt_clock_t* custom = upt_clock_new(s_fixed_now, &now);
+    CHECK(upt_clock_now(custom) == 7000);
+    now = 8000;
+    CHECK(upt_clock_now(custom) == 8000);
+    upt_clock_destroy(&custom);
+}
+
+TEST_CASE("upt clock year of accounting")
+{
+    upt_clock_t* clock  = upt_clock_sim_new(0);
+    upt_t*       uptime = upt_new();
+    upt_set_clock(uptime, clock);
+
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(uptime, "DC001", ups) == 0);
+    zlistx_destroy(&ups);
+
+    // one hour long outage every day, second ups fails during the second half of it; time is
+    // accounted before every change as the server does
+    uint64_t total, offline;
+    for (int day = 0; day != 365; day++) {
+        upt_uptime(uptime, "DC001", &total, &offline);
+        upt_set_offline(uptime, "UPS001");
+        upt_clock_advance(clock, 1800 * 1000LL);
+        upt_uptime(uptime, "DC001", &total, &offline);
+        upt_set_offline(uptime, "UPS002");
+        upt_set_online(uptime, "UPS001");
+        upt_clock_advance(clock, 1800 * 1000LL);
+        upt_uptime(uptime, "DC001", &total, &offline);
+        upt_set_online(uptime, "UPS002");
+        upt_clock_advance(clock, 23 * 3600 * 1000LL);
+    }
+
+    REQUIRE(upt_uptime(uptime, "DC001", &total, &offline) == 0);
+    CHECK(total == 365 * 24 * 3600ULL);
+    CHECK(offline == 365 * 3600ULL);
+
+    // counters keep their value when state moves to another clock
+    upt_clock_t* other = upt_clock_sim_new(0);
+    upt_set_clock(uptime, other);
+    upt_clock_advance(other, 60 * 1000LL);
+    REQUIRE(upt_uptime(uptime, "DC001", &total, &offline) == 0);
+    CHECK(total == 365 * 24 * 3600ULL + 60);
+    CHECK(offline == 365 * 3600ULL);
+
+    // and new datacenters count on the new clock
+    ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS003"));
+    REQUIRE(upt_add(uptime, "DC002", ups) == 0);
+    zlistx_destroy(&ups);
+    upt_clock_advance(other, 5000);
+    REQUIRE(upt_uptime(uptime, "DC002", &total, &offline) == 0);
+    CHECK(total == 5);
+
+    upt_destroy(&uptime);
+    upt_clock_destroy(&other);
+    upt_clock_destroy(&clock);
+}
@@ -0,0 +1,74 @@
+#include "src/upt_debounce.h"
+#include <catch2/catch.hpp>
+
+static void s_accepted(const char* ups, dc_state_t state, void* arg)
+{
+    zhashx_t* accepted = reinterpret_cast<zhashx_t*>(arg);
+    zhashx_update(accepted, ups, reinterpret_cast<void*>(intptr_t(state) + 1));
+}
+
+TEST_CASE("upt debounce test")
+{
+    upt_clock_t*    clock    = upt_clock_sim_new(0);
+    upt_debounce_t* debounce = upt_debounce_new(clock);
+    zhashx_t*       accepted = zhashx_new();
+    upt_debounce_set_dwell(debounce, 5000, 30000);
+
+    // first state is taken at once, repeating it changes nothing
+    CHECK(upt_debounce_observe(debounce, "UPS001", DC_STATE_ONLINE));
+    CHECK(!upt_debounce_observe(debounce, "UPS001", DC_STATE_ONLINE));
+
+    // chattering OL/OB shorter than the dwell never reaches the datacenter
+    for (int i = 0; i != 3; i++) {
+        CHECK(!upt_debounce_observe(debounce, "UPS001", DC_STATE_ON_BATTERY));
+        upt_clock_advance(clock, 2000);
+        CHECK(!upt_debounce_observe(debounce, "UPS001", DC_STATE_ONLINE));
+        upt_clock_advance(clock, 2000);
+        CHECK(upt_debounce_expire(debounce, s_accepted, accepted) == 0);
+    }
+    CHECK(debounce->flaps == 3);
+    CHECK(upt_debounce_pending(debounce) == 0);
+
+    // timers of states given up are dropped on expiry, not moved along with the new pending state
+    CHECK(upt_debounce_observe(debounce, "UPS002", DC_STATE_ONLINE));
+    for (int i = 0; i != 3; i++) {
+        CHECK(!upt_debounce_observe(debounce, "UPS002", DC_STATE_ON_BATTERY));
+        upt_clock_advance(clock, 1000);
+        CHECK(!upt_debounce_observe(debounce, "UPS002", DC_STATE_ONLINE));
+        CHECK(!upt_debounce_observe(debounce, "UPS002", DC_STATE_ON_BATTERY));
+        upt_clock_advance(clock, 4500);
+        CHECK(upt_debounce_expire(debounce, s_accepted, accepted) == 0);
+        CHECK(upt_wheel_size(debounce->wheel) == 1);
+    }
+    upt_debounce_forget(debounce, "UPS002");
+    upt_clock_advance(clock, 5000);
+    CHECK(upt_debounce_expire(debounce, s_accepted, accepted) == 0);
+    CHECK(upt_wheel_size(debounce->wheel) == 0);
+
+    // on battery for longer than the dwell is accepted at the first expiry after it
+    CHECK(!upt_debounce_observe(debounce, "UPS001", DC_STATE_ON_BATTERY));
+    CHECK(upt_debounce_pending(debounce) == 1);
+    upt_clock_advance(clock, 4900);
+    CHECK(upt_debounce_expire(debounce, s_accepted, accepted) == 0);
+    upt_clock_advance(clock, 100);
+    CHECK(upt_debounce_expire(debounce, s_accepted, accepted) == 1);
+    CHECK(zhashx_lookup(accepted, "UPS001") == reinterpret_cast<void*>(intptr_t(DC_STATE_ON_BATTERY) + 1));
+    CHECK(debounce->delayed == 1);
+
+    // hysteresis, coming back takes the longer online dwell
+    CHECK(!upt_debounce_observe(debounce, "UPS001", DC_STATE_ONLINE));
+    upt_clock_advance(clock, 10000);
+    CHECK(upt_debounce_expire(debounce, s_accepted, accepted) == 0);
+    upt_clock_advance(clock, 20000);
+    CHECK(upt_debounce_expire(debounce, s_accepted, accepted) == 1);
+    CHECK(zhashx_lookup(accepted, "UPS001") == reinterpret_cast<void*>(intptr_t(DC_STATE_ONLINE) + 1));
+
+    // no dwell accepts at once
+    upt_debounce_set_dwell(debounce, 0, 30000);
+    CHECK(upt_debounce_observe(debounce, "UPS001", DC_STATE_LOW_BATTERY));
+
+    zhashx_destroy(&accepted);
+    upt_debounce_destroy(&debounce);
+    CHECK(!debounce);
+    upt_clock_destroy(&clock);
+}
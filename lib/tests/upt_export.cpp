@@ -0,0 +1,100 @@
+#include "src/upt_export.h"
+#include <catch2/catch.hpp>
+
+static char* s_export(upt_export_format_t format, upt_export_records_t records, const char* name, dc_t* dc,
+    upt_baseline_t* baselines = nullptr)
+{
+    char*  text = nullptr;
+    size_t size = 0;
+    FILE*  file = open_memstream(&text, &size);
+    CHECK(upt_export_header(file, format, records) == 0);
+    upt_export_write(file, format, records, name, dc, 2, baselines);
+    fclose(file);
+    return text;
+}
+
+TEST_CASE("upt export test")
+{
+    upt_export_format_t format;
+    CHECK(upt_export_format_parse("json", &format) == 0);
+    CHECK(format == UPT_EXPORT_JSON);
+    CHECK(upt_export_format_parse("csv", &format) == 0);
+    CHECK(format == UPT_EXPORT_CSV);
+    CHECK(upt_export_format_parse("xml", &format) == -1);
+    CHECK(upt_export_format_parse(nullptr, &format) == -1);
+    upt_export_records_t records;
+    CHECK(upt_export_records_parse("window", &records) == 0);
+    CHECK(records == UPT_EXPORT_WINDOWS);
+    CHECK(upt_export_records_parse("all", &records) == 0);
+    CHECK(records == UPT_EXPORT_ALL);
+    CHECK(upt_export_records_parse("outage", &records) == -1);
+
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    dc_t*        dc    = dc_new_clock(clock);
+    uint64_t     total, offline;
+    upt_clock_advance(clock, 30000);
+    dc_uptime(dc, &total, &offline);
+    dc_set_offline(dc, const_cast<char*>("UPS1"));
+    upt_clock_advance(clock, 10000);
+
+    // names are escaped, counters accounted up to now
+    char* text = s_export(UPT_EXPORT_JSON, UPT_EXPORT_DCS, "DC \"1\"", dc);
+    CHECK(streq(text,
+        "{\"record\":\"dc\",\"dc\":\"DC \\\"1\\\"\",\"total\":40,\"offline\":10,\"unknown\":0,\"availability\":0.750000,"
+        "\"policy\":\"any\",\"threshold\":0,\"upses\":2,\"offline_upses\":1,\"durations\":{\"online\":30,"
+        "\"on-battery\":10,\"low-battery\":0,\"bypass\":0,\"overload\":0,\"unknown\":0,\"stale\":0}}\n"));
+    zstr_free(&text);
+
+    text = s_export(UPT_EXPORT_CSV, UPT_EXPORT_DCS, "DC,1", dc);
+    CHECK(streq(text,
+        "dc,total,offline,unknown,availability,policy,threshold,upses,offline_upses,online,on-battery,"
+        "low-battery,bypass,overload,unknown,stale\r\n"
+        "\"DC,1\",40,10,0,0.750000,any,0,2,1,30,10,0,0,0,0,0\r\n"));
+    zstr_free(&text);
+
+    // outage counters of upses which changed state, bypass is not an outage
+    dc_set_online(dc, const_cast<char*>("UPS1"));
+    dc_set_state(dc, "UPS2", DC_STATE_BYPASS);
+    upt_clock_advance(clock, 5000);
+    text = s_export(UPT_EXPORT_CSV, UPT_EXPORT_UPSES, "DC1", dc);
+    CHECK(strstr(text, "dc,ups,state,on_battery,transitions,last_change\r\n"));
+    CHECK(strstr(text, "\r\nDC1,UPS1,online,10,2,"));
+    CHECK(strstr(text, "\r\nDC1,UPS2,bypass,0,1,"));
+    zstr_free(&text);
+
+    // windows since baselines, CSV holds one kind of records
+    upt_t* upt = upt_new();
+    upt_set_clock(upt, clock);
+    zlistx_t* upses = zlistx_new();
+    zlistx_add_end(upses, const_cast<char*>("UPS3"));
+    upt_add(upt, "DC1", upses);
+    zlistx_destroy(&upses);
+    upt_clock_advance(clock, 10000);
+    upt_baseline_t* baselines = upt_baseline_new();
+    upt_baseline_take(baselines, "q1", 1600000000, upt);
+    upt_clock_advance(clock, 20000);
+    dc_t* dc1 = reinterpret_cast<dc_t*>(zhashx_lookup(upt->dc, "DC1"));
+    dc_uptime(dc1, &total, &offline);
+    upt_set_offline(upt, "UPS3");
+    upt_clock_advance(clock, 5000);
+    text = s_export(UPT_EXPORT_JSON, UPT_EXPORT_WINDOWS, "DC1", dc1, baselines);
+    CHECK(streq(text,
+        "{\"record\":\"window\",\"dc\":\"DC1\",\"baseline\":\"q1\",\"taken\":1600000000,\"total\":25,"
+        "\"offline\":5,\"unknown\":0,\"availability\":0.800000,\"durations\":{\"online\":20,\"on-battery\":5,"
+        "\"low-battery\":0,\"bypass\":0,\"overload\":0,\"unknown\":0,\"stale\":0}}\n"));
+    zstr_free(&text);
+    text = s_export(UPT_EXPORT_JSON, UPT_EXPORT_ALL, "DC1", dc1, baselines);
+    CHECK(strstr(text, "{\"record\":\"dc\",\"dc\":\"DC1\",\"total\":35,"));
+    CHECK(strstr(text, "\n{\"record\":\"window\","));
+    CHECK(strstr(text, "\n{\"record\":\"ups\",\"dc\":\"DC1\",\"ups\":\"UPS3\",\"state\":\"on-battery\""));
+    zstr_free(&text);
+    FILE* file = fopen("/dev/null", "w");
+    CHECK(upt_export_header(file, UPT_EXPORT_CSV, UPT_EXPORT_ALL) == -1);
+    CHECK(upt_export_header(file, UPT_EXPORT_JSON, UPT_EXPORT_ALL) == 0);
+    fclose(file);
+
+    upt_baseline_destroy(&baselines);
+    upt_destroy(&upt);
+    dc_destroy(&dc);
+    upt_clock_destroy(&clock);
+}
@@ -0,0 +1,118 @@
+#include "src/upt_federation.h"
+#include <catch2/catch.hpp>
+
+// watched since start until end, offline in [down, up)
+static upt_federation_t* s_node(const char* source, int64_t start, int64_t down, int64_t up, int64_t end)
+{
+    upt_federation_t* self = upt_federation_new(source);
+    upt_federation_observe(self, "DC001", start, false);
+    upt_federation_observe(self, "DC001", down, true);
+    upt_federation_observe(self, "DC001", up, false);
+    upt_federation_observe(self, "DC001", end, false);
+    return self;
+}
+
+static void s_check(upt_federation_t* self, uint64_t total, uint64_t offline, size_t sources)
+{
+    uint64_t t, o;
+    size_t   s;
+    REQUIRE(upt_federation_uptime(self, "DC001", &t, &o, &s) == 0);
+    CHECK(t == total);
+    CHECK(o == offline);
+    CHECK(s == sources);
+}
+
+TEST_CASE("upt federation test")
+{
+    upt_federation_t* a = s_node("node-a", 0, 10000, 20000, 60000);
+    upt_federation_t* b = s_node("node-b", 30000, 40000, 50000, 90000);
+    s_check(a, 60, 10, 1);
+    s_check(b, 60, 10, 1);
+
+    uint64_t total, offline;
+    CHECK(upt_federation_uptime(a, "DC042", &total, &offline, nullptr) == -1);
+
+    // snapshots go through files, as they come from the appliances
+    REQUIRE(upt_federation_save(a, "./federation-a") == 0);
+    REQUIRE(upt_federation_save(b, "./federation-b") == 0);
+    upt_federation_destroy(&a);
+    upt_federation_destroy(&b);
+    CHECK(!a);
+
+    upt_federation_t* ab = upt_federation_load("./federation-a", "merge");
+    upt_federation_t* ba = upt_federation_load("./federation-b", "merge");
+    upt_federation_t* snapshot_a = upt_federation_load("./federation-a", "merge");
+    upt_federation_t* snapshot_b = upt_federation_load("./federation-b", "merge");
+    REQUIRE(ab);
+    REQUIRE(ba);
+    REQUIRE(snapshot_a);
+    REQUIRE(snapshot_b);
+    s_check(snapshot_a, 60, 10, 1);
+
+    // union of watched time and of offline time, in any order
+    upt_federation_merge(ab, snapshot_b);
+    upt_federation_merge(ba, snapshot_a);
+    s_check(ab, 90, 20, 2);
+    s_check(ba, 90, 20, 2);
+
+    // merging again changes nothing
+    upt_federation_merge(ab, snapshot_a);
+    upt_federation_merge(ab, snapshot_b);
+    upt_federation_merge(ab, ba);
+    s_check(ab, 90, 20, 2);
+
+    // outages seen by two appliances at once are counted once
+    upt_federation_t* c = s_node("node-c", 0, 15000, 45000, 60000);
+    upt_federation_merge(ab, c);
+    s_check(ab, 90, 40, 3);
+    upt_federation_destroy(&c);
+
+    REQUIRE(upt_federation_save(ab, "./federation-merged") == 0);
+    upt_federation_t* merged = upt_federation_load("./federation-merged", "merge");
+    REQUIRE(merged);
+    s_check(merged, 90, 40, 3);
+    CHECK(upt_federation_size(merged) == 1);
+    CHECK(streq(upt_federation_first(merged), "DC001"));
+    CHECK(!upt_federation_next(merged));
+    upt_federation_destroy(&merged);
+
+    upt_federation_destroy(&snapshot_a);
+    upt_federation_destroy(&snapshot_b);
+    upt_federation_destroy(&ab);
+    upt_federation_destroy(&ba);
+    zsys_file_delete("./federation-a");
+    zsys_file_delete("./federation-b");
+    zsys_file_delete("./federation-merged");
+}
+
+TEST_CASE("upt federation pause")
+{
+    upt_federation_t* self = upt_federation_new("node-a");
+    upt_federation_observe(self, "DC001", 0, true);
+    upt_federation_observe(self, "DC002", 0, false);
+    upt_federation_observe(self, "DC001", 10000, true);
+
+    // time while the appliance was down is not watched, first record after it only starts again
+    upt_federation_pause(self);
+    upt_federation_observe(self, "DC001", 50000, false);
+    upt_federation_observe(self, "DC001", 60000, false);
+    s_check(self, 20, 10, 1);
+    CHECK(upt_federation_size(self) == 2);
+
+    // policy of DC001 is no longer any: time up to the change is kept, it is not watched after it
+    upt_federation_observe(self, "DC001", 70000, true);
+    upt_federation_leave(self, "DC001", 80000);
+    upt_federation_observe(self, "DC001", 90000, true);
+    s_check(self, 40, 20, 1);
+    upt_federation_leave(self, "DC042", 90000);
+    CHECK(upt_federation_size(self) == 2);
+    upt_federation_destroy(&self);
+
+    FILE* file = fopen("./federation-bad", "w");
+    REQUIRE(file);
+    fprintf(file, "observed\t0\t1000\n");
+    fclose(file);
+    CHECK(!upt_federation_load("./federation-bad", "merge"));
+    CHECK(!upt_federation_load("./federation-missing", "merge"));
+    zsys_file_delete("./federation-bad");
+}
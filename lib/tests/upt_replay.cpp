@@ -0,0 +1,114 @@
+#include "src/dc.h"
+#include "src/upt_replay.h"
+#include <catch2/catch.hpp>
+
+static void s_check(upt_t* upt, const char* dc_name, uint64_t total, uint64_t offline)
+{
+    dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(upt->dc, dc_name));
+    REQUIRE(dc);
+    CHECK(dc->total == total);
+    CHECK(dc->offline == offline);
+}
+
+TEST_CASE("upt replay test")
+{
+    const char* events_file   = "./replay-events.csv";
+    const char* topology_file = "./replay-topology.csv";
+    const char* state_file    = "./replay-state";
+
+    FILE* file = fopen(events_file, "w");
+    REQUIRE(file);
+    fputs("# time,kind,name,value\n", file);
+    fputs("1000000,topology,DC1,UPS1;UPS2\n", file);
+    fputs("1000000,topology,DC2,UPS3\n", file);
+    fputs("1010000,status,UPS1,16\n", file);
+    fputs("1015000,status,UPS1,16\n", file);
+    fputs("1020000,status,UPS1,8\n", file);
+    fputs("1030000,status,UPS3,OB DISCHRG\n", file);
+    fputs("this is not an event\n", file);
+    fputs("1035000,topology,DC2,\n", file);
+    fputs("1060000,status,UPS2,8\n", file);
+    fclose(file);
+
+    file = fopen(topology_file, "w");
+    REQUIRE(file);
+    fputs("1000000,topology,DC1,UPS1;UPS2;UPS3\n", file);
+    fclose(file);
+
+    // sequential and parallel replay agree
+    for (size_t threads = 1; threads <= 4; threads += 3) {
+        upt_replay_t* replay = upt_replay_new();
+        REQUIRE(upt_replay_load(replay, events_file, 0) == 8);
+        CHECK(upt_replay_size(replay) == 8);
+
+        upt_t* upt = upt_replay_run(replay, -1, threads);
+        REQUIRE(upt);
+        CHECK(zhashx_size(upt->dc) == 2);
+        s_check(upt, "DC1", 60, 10);
+        // UPS3 left DC2 while on battery
+        s_check(upt, "DC2", 60, 5);
+        CHECK(streq(upt_dc_name(upt, "UPS1"), "DC1"));
+        CHECK(!upt_dc_name(upt, "UPS3"));
+        CHECK(!upt_is_offline(upt, "DC2"));
+
+        upt_destroy(&upt);
+        upt_replay_destroy(&replay);
+    }
+
+    // what-if: UPS3 belonged to DC1 from the beginning
+    upt_replay_t* replay = upt_replay_new();
+    REQUIRE(upt_replay_load(replay, topology_file, 0) == 1);
+    REQUIRE(upt_replay_load(replay, events_file, UPT_REPLAY_STATUS_ONLY) == 5);
+    upt_t* upt = upt_replay_run(replay, 1090000, 2);
+    CHECK(zhashx_size(upt->dc) == 1);
+    s_check(upt, "DC1", 90, 70);
+    CHECK(upt_is_offline(upt, "DC1"));
+
+    // daemon loads the result
+    REQUIRE(upt_save(upt, state_file) == 0);
+    upt_t* loaded = upt_load(state_file);
+    REQUIRE(loaded);
+    s_check(loaded, "DC1", 90, 70);
+    CHECK(streq(upt_dc_name(loaded, "UPS3"), "DC1"));
+    upt_destroy(&loaded);
+    upt_destroy(&upt);
+    upt_replay_destroy(&replay);
+
+    // events added in code, out of order
+    replay        = upt_replay_new();
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS9"));
+    upt_replay_status(replay, 5000, "UPS9", false);
+    upt_replay_status(replay, 2000, "UPS9", true);
+    upt_replay_topology(replay, 1000, "DC9", ups);
+    zlistx_destroy(&ups);
+    upt = upt_replay_run(replay, 11000, 1);
+    s_check(upt, "DC9", 10, 3);
+    upt_destroy(&upt);
+    upt_replay_destroy(&replay);
+
+    // shared ups counts in both datacenters until one of them drops it
+    replay = upt_replay_new();
+    ups    = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS7"));
+    upt_replay_topology(replay, 1000, "DC7", ups);
+    upt_replay_topology(replay, 1000, "DC8", ups);
+    zlistx_purge(ups);
+    upt_replay_status(replay, 2000, "UPS7", true);
+    upt_replay_topology(replay, 4000, "DC8", ups);
+    zlistx_destroy(&ups);
+    upt = upt_replay_run(replay, 6000, 2);
+    s_check(upt, "DC7", 5, 4);
+    s_check(upt, "DC8", 5, 2);
+    CHECK(zlistx_size(upt_dc_names(upt, "UPS7")) == 1);
+    upt_destroy(&upt);
+    upt_replay_destroy(&replay);
+
+    replay = upt_replay_new();
+    CHECK(upt_replay_load(replay, "./no-such-file.csv", 0) == -1);
+    upt_replay_destroy(&replay);
+
+    zsys_file_delete(events_file);
+    zsys_file_delete(topology_file);
+    zsys_file_delete(state_file);
+}
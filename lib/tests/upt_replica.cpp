@@ -0,0 +1,108 @@
+#include "src/upt_replica.h"
+#include <catch2/catch.hpp>
+
+static void s_add(upt_t* upt, const char* dc_name, const char* ups_name)
+{
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>(ups_name));
+    REQUIRE(upt_add(upt, dc_name, ups) == 0);
+    zlistx_destroy(&ups);
+}
+
+TEST_CASE("upt replica test")
+{
+    upt_clock_t* clock  = upt_clock_sim_new(0);
+    upt_t*       leader = upt_new();
+    upt_set_clock(leader, clock);
+    upt_t* follower = upt_new();
+    upt_set_clock(follower, clock);
+
+    upt_replica_t* out = upt_replica_new();
+    upt_replica_t* in  = upt_replica_new();
+    REQUIRE(out);
+    REQUIRE(in);
+
+    s_add(leader, "DC001", "UPS001");
+    s_add(leader, "DC002", "UPS002");
+    upt_set_offline(leader, "UPS001");
+    upt_clock_advance(clock, 1000);
+
+    // deltas before the first snapshot are dropped
+    zhashx_t* dirty = zhashx_new();
+    zhashx_insert(dirty, "DC001", leader);
+    zmsg_t* msg = upt_replica_delta(out, leader, dirty);
+    CHECK(upt_replica_apply(in, &follower, &msg) == -1);
+    CHECK(!msg);
+    CHECK(!in->synced);
+
+    msg = upt_replica_snapshot(out, leader);
+    CHECK(upt_replica_apply(in, &follower, &msg) == 0);
+    CHECK(in->synced);
+    CHECK(in->seq == 2);
+    CHECK(in->snapshots == 1);
+    CHECK(in->catchup_ms >= 0);
+
+    // replicated counters continue on the clock of the follower
+    uint64_t total, offline;
+    upt_clock_advance(clock, 1000);
+    CHECK(upt_uptime(follower, "DC001", &total, &offline) == 0);
+    CHECK(total == 2);
+    CHECK(offline == 2);
+    CHECK(upt_uptime(follower, "DC002", &total, &offline) == 0);
+    CHECK(offline == 0);
+    CHECK(streq(upt_dc_name(follower, "UPS002"), "DC002"));
+
+    // fold the offline time before the change, as the server does
+    upt_uptime(leader, "DC001", &total, &offline);
+    upt_set_online(leader, "UPS001");
+    msg = upt_replica_delta(out, leader, dirty);
+    CHECK(upt_replica_apply(in, &follower, &msg) == 0);
+    upt_clock_advance(clock, 1000);
+    CHECK(upt_uptime(follower, "DC001", &total, &offline) == 0);
+    CHECK(total == 3);
+    CHECK(offline == 2);
+
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    zlistx_add_end(ups, const_cast<char*>("UPS003"));
+    upt_add(leader, "DC002", ups);
+    msg = upt_replica_topology(out, leader, "DC002", ups);
+    zlistx_destroy(&ups);
+    CHECK(upt_replica_apply(in, &follower, &msg) == 0);
+    CHECK(streq(upt_dc_name(follower, "UPS003"), "DC002"));
+    CHECK(in->seq == out->seq);
+
+    // a lost message stops the follower until the next snapshot
+    msg = upt_replica_delta(out, leader, dirty);
+    zmsg_destroy(&msg);
+    msg = upt_replica_delta(out, leader, dirty);
+    CHECK(upt_replica_apply(in, &follower, &msg) == -1);
+    CHECK(in->gaps == 1);
+    CHECK(!in->synced);
+    msg = upt_replica_snapshot(out, leader);
+    CHECK(upt_replica_apply(in, &follower, &msg) == 0);
+    CHECK(in->synced);
+    CHECK(in->snapshots == 2);
+
+    msg = upt_replica_delta(out, leader, dirty);
+    zframe_t* topic = zmsg_pop(msg);
+    zframe_destroy(&topic);
+    zframe_t* garbage = zframe_new("x", 1); // unknown topic
+    zmsg_prepend(msg, &garbage);
+    CHECK(upt_replica_apply(in, &follower, &msg) == -1);
+
+    zmsg_t* report = zmsg_new();
+    upt_replica_report(in, report);
+    char* name = zmsg_popstr(report);
+    CHECK(streq(name, "replica.seq"));
+    zstr_free(&name);
+    zmsg_destroy(&report);
+
+    zhashx_destroy(&dirty);
+    upt_replica_destroy(&in);
+    upt_replica_destroy(&out);
+    CHECK(!in);
+    upt_destroy(&follower);
+    upt_destroy(&leader);
+    upt_clock_destroy(&clock);
+}
@@ -0,0 +1,80 @@
+#include "src/upt_sched.h"
+#include <catch2/catch.hpp>
+
+struct s_probe_t
+{
+    upt_sched_t*      sched;
+    upt_sched_task_t* other; // task armed by the probe, nullptr if none
+    int               count;
+};
+
+static void s_count(void* arg)
+{
+    s_probe_t* probe = reinterpret_cast<s_probe_t*>(arg);
+    probe->count++;
+    if (probe->other)
+        upt_sched_arm_in(probe->sched, probe->other, 0);
+}
+
+TEST_CASE("upt sched test")
+{
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    upt_sched_t* sched = upt_sched_new(clock);
+    s_probe_t    poll  = {sched, nullptr, 0};
+    s_probe_t    once  = {sched, nullptr, 0};
+
+    upt_sched_task_t* poll_task = upt_sched_add(sched, "poll", s_count, &poll);
+    upt_sched_task_t* once_task = upt_sched_add(sched, "once", s_count, &once);
+    CHECK(upt_sched_timeout(sched) == -1);
+
+    // the loop sleeps until the earliest deadline
+    upt_sched_every(sched, poll_task, 1000);
+    upt_sched_arm_in(sched, once_task, 300);
+    CHECK(upt_sched_timeout(sched) == 300);
+    CHECK(upt_sched_run(sched) == 0);
+    upt_clock_advance(clock, 300);
+    CHECK(upt_sched_timeout(sched) == 0);
+    CHECK(upt_sched_run(sched) == 1);
+    CHECK(once.count == 1);
+    CHECK(upt_sched_timeout(sched) == 700);
+
+    // periodic task keeps its pace, runs missed by a late loop are skipped
+    upt_clock_advance(clock, 750);
+    CHECK(upt_sched_run(sched) == 1);
+    CHECK(upt_sched_timeout(sched) == 950);
+    upt_clock_advance(clock, 3500);
+    CHECK(upt_sched_run(sched) == 1);
+    CHECK(poll.count == 2);
+    CHECK(upt_sched_timeout(sched) == 1000);
+
+    // a task armed by another one in the past runs at the next call
+    poll.other = once_task;
+    upt_clock_advance(clock, 1000);
+    CHECK(upt_sched_run(sched) == 1);
+    CHECK(upt_sched_timeout(sched) == 0);
+    CHECK(upt_sched_run(sched) == 1);
+    CHECK(once.count == 2);
+
+    upt_sched_disarm(sched, poll_task);
+    CHECK(upt_sched_timeout(sched) == -1);
+
+    // lag and wakeups are reported
+    CHECK(sched->wakeups == 5);
+    CHECK(sched->runs == 5);
+    CHECK(sched->lag.count == 5);
+    CHECK(sched->lag.max_us == 2550000);
+    zmsg_t* report = zmsg_new();
+    upt_sched_report(sched, report);
+    bool found = false;
+    for (zframe_t* name = zmsg_first(report); name != nullptr; name = zmsg_next(report)) {
+        zframe_t* value = zmsg_next(report);
+        if (zframe_streq(name, "timer.once.runs"))
+            found = zframe_streq(value, "2");
+    }
+    CHECK(found);
+    zmsg_destroy(&report);
+
+    upt_sched_destroy(&sched);
+    CHECK(!sched);
+    upt_clock_destroy(&clock);
+}
@@ -0,0 +1,91 @@
+#include "src/upt_shard.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("upt shard test")
+{
+    upt_t*    upt = upt_new();
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(upt, "DC001", ups) == 0);
+    zlistx_destroy(&ups);
+
+    ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS003"));
+    REQUIRE(upt_add(upt, "DC002", ups) == 0);
+    zlistx_destroy(&ups);
+
+    // every datacenter lands in exactly one partition
+    size_t dcs = 0;
+    for (size_t i = 0; i != 3; i++) {
+        upt_t* part = upt_partition(upt, i, 3);
+        dcs += zhashx_size(part->dc);
+        upt_destroy(&part);
+    }
+    CHECK(dcs == 2);
+
+    zactor_t* shard = zactor_new(upt_shard, upt_dup(upt));
+
+    zmsg_t* batch = nullptr;
+    upt_shard_status_add(&batch, "UPS002", DC_STATE_ON_BATTERY);
+    upt_shard_status_add(&batch, "UPS042", DC_STATE_ON_BATTERY);
+    upt_shard_status(shard, &batch);
+    CHECK(!batch);
+
+    uint64_t total, offline;
+    CHECK(upt_shard_uptime(shard, "DC001", &total, &offline) == 0);
+    CHECK(upt_shard_uptime(shard, "DC042", &total, &offline) == -1);
+
+    ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS004"));
+    upt_shard_topology(shard, "DC003", ups);
+    zlistx_destroy(&ups);
+
+    upt_t* snapshot = upt_shard_snapshot(shard);
+    REQUIRE(snapshot);
+    CHECK(zhashx_size(snapshot->dc) == 3);
+    CHECK(upt_is_offline(snapshot, "DC001"));
+    CHECK(!upt_is_offline(snapshot, "DC002"));
+    CHECK(streq(upt_dc_name(snapshot, "UPS004"), "DC003"));
+
+    // merge moves datacenters into the target
+    upt_t* merged = upt_new();
+    upt_merge(merged, &snapshot);
+    CHECK(!snapshot);
+    CHECK(zhashx_size(merged->dc) == 3);
+    CHECK(upt_is_offline(merged, "DC001"));
+
+    upt_destroy(&merged);
+
+    // copy of some datacenters only, unknown ones are skipped
+    zlistx_t* names = zlistx_new();
+    zlistx_add_end(names, const_cast<char*>("DC001"));
+    zlistx_add_end(names, const_cast<char*>("DC042"));
+    upt_t* copy = upt_shard_copy(shard, names);
+    REQUIRE(copy);
+    CHECK(zhashx_size(copy->dc) == 1);
+    CHECK(upt_is_offline(copy, "DC001"));
+    upt_destroy(&copy);
+    zlistx_destroy(&names);
+
+    // DC001 stays online while one of its two upses is
+    upt_shard_policy(shard, "DC001", DC_POLICY_K_OF_N, 1);
+    upt_shard_rating(shard, "DC001", "UPS002", 1500);
+    snapshot = upt_shard_snapshot(shard);
+    REQUIRE(snapshot);
+    CHECK(!upt_is_offline(snapshot, "DC001"));
+    CHECK(dc_rating(reinterpret_cast<dc_t*>(zhashx_lookup(snapshot->dc, "DC001")), "UPS002") == 1500);
+    upt_destroy(&snapshot);
+
+    zmsg_t* top = upt_shard_top(shard, "DC001", 5);
+    REQUIRE(top);
+    CHECK(zmsg_size(top) == 4);
+    char* name = zmsg_popstr(top);
+    CHECK(streq(name, "UPS002"));
+    zstr_free(&name);
+    zmsg_destroy(&top);
+    CHECK(!upt_shard_top(shard, "DC042", 5));
+
+    zactor_destroy(&shard);
+    upt_destroy(&upt);
+}
@@ -0,0 +1,51 @@
+#include "src/upt_snapshot.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("upt snapshot test")
+{
+    upt_snapshot_t* snapshot = upt_snapshot_new(2);
+    REQUIRE(snapshot);
+    CHECK(upt_snapshot_generation(snapshot) == 0);
+
+    uint64_t total, offline;
+    CHECK(upt_snapshot_uptime(snapshot, 0, "DC001", &total, &offline, nullptr) == -1);
+
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    upt_t*       upt   = upt_new();
+    upt_set_clock(upt, clock);
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    REQUIRE(upt_add(upt, "DC001", ups) == 0);
+    zlistx_destroy(&ups);
+
+    upt_snapshot_publish(snapshot, upt);
+    CHECK(upt_snapshot_generation(snapshot) == 1);
+    CHECK(upt_snapshot_uptime(snapshot, 0, "DC001", &total, &offline, nullptr) == 0);
+    CHECK(offline == 0);
+    CHECK(upt_snapshot_uptime(snapshot, 1, "DC042", &total, &offline, nullptr) == -1);
+
+    // snapshot is immutable, changes are visible only after the next publication
+    upt_set_offline(upt, "UPS001");
+    upt_clock_advance(clock, 2000);
+    CHECK(upt_snapshot_uptime(snapshot, 1, "DC001", &total, &offline, nullptr) == 0);
+    CHECK(offline == 0);
+
+    upt_snapshot_publish(snapshot, upt);
+    CHECK(upt_snapshot_generation(snapshot) == 2);
+    upt_clock_advance(clock, 2000);
+    CHECK(upt_snapshot_uptime(snapshot, 1, "DC001", &total, &offline, nullptr) == 0);
+    CHECK(total == 4);
+    CHECK(offline == 2);
+
+    // state durations are extrapolated from the last accounting like the uptime
+    uint64_t durations[DC_STATE_COUNT];
+    CHECK(upt_snapshot_durations(snapshot, 0, "DC001", durations) == 0);
+    CHECK(durations[DC_STATE_ONLINE] == 0);
+    CHECK(durations[DC_STATE_ON_BATTERY] == 4);
+    CHECK(upt_snapshot_durations(snapshot, 0, "DC042", durations) == -1);
+
+    upt_destroy(&upt);
+    upt_clock_destroy(&clock);
+    upt_snapshot_destroy(&snapshot);
+    CHECK(!snapshot);
+}
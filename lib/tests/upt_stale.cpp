@@ -0,0 +1,68 @@
+#include "src/upt.h"
+#include "src/upt_stale.h"
+#include <catch2/catch.hpp>
+
+static void s_apply_stale(const char* ups, void* arg)
+{
+    upt_set_state(reinterpret_cast<upt_t*>(arg), ups, DC_STATE_STALE);
+}
+
+TEST_CASE("upt stale test")
+{
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    upt_stale_t* stale = upt_stale_new(clock, 10000);
+
+    upt_t* upt = upt_new();
+    upt_set_clock(upt, clock);
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    zlistx_add_end(ups, const_cast<char*>("UPS002"));
+    REQUIRE(upt_add(upt, "DC001", ups) == 0);
+    zlistx_destroy(&ups);
+
+    // UPS001 goes on battery and stops reporting, UPS002 keeps reporting
+    uint64_t durations[DC_STATE_COUNT];
+    CHECK(!upt_stale_seen(stale, "UPS001"));
+    upt_set_state(upt, "UPS001", DC_STATE_ON_BATTERY);
+    for (int i = 0; i != 2; i++) {
+        CHECK(!upt_stale_seen(stale, "UPS002"));
+        upt_clock_advance(clock, 4000);
+        CHECK(upt_stale_expire(stale, s_apply_stale, upt) == 0);
+    }
+    upt_clock_advance(clock, 1000);
+    CHECK(upt_stale_expire(stale, s_apply_stale, upt) == 0);
+    CHECK(!upt_stale_seen(stale, "UPS002"));
+    CHECK(upt_is_offline(upt, "DC001"));
+
+    // UPS001 was last seen at 0 with ttl 10 s, UPS002 at 9 s
+    upt_clock_advance(clock, 1000);
+    REQUIRE(upt_durations(upt, "DC001", durations) == 0);
+    CHECK(upt_stale_expire(stale, s_apply_stale, upt) == 1);
+    CHECK(upt_stale_is_stale(stale, "UPS001"));
+    CHECK(!upt_stale_is_stale(stale, "UPS002"));
+    CHECK(stale->expired == 1);
+
+    // old data no longer makes the datacenter offline, stale time is accounted separately
+    CHECK(!upt_is_offline(upt, "DC001"));
+    upt_clock_advance(clock, 5000);
+    REQUIRE(upt_durations(upt, "DC001", durations) == 0);
+    CHECK(durations[DC_STATE_ON_BATTERY] == 10);
+    CHECK(durations[DC_STATE_STALE] == 5);
+
+    // reporting again clears it
+    CHECK(upt_stale_seen(stale, "UPS001"));
+    CHECK(!upt_stale_is_stale(stale, "UPS001"));
+    upt_set_state(upt, "UPS001", DC_STATE_ONLINE);
+    CHECK(upt_stale_expire(stale, s_apply_stale, upt) == 0);
+
+    // forgotten upses never expire
+    upt_stale_forget(stale, "UPS001");
+    upt_stale_forget(stale, "UPS002");
+    upt_clock_advance(clock, 60000);
+    CHECK(upt_stale_expire(stale, s_apply_stale, upt) == 0);
+
+    upt_destroy(&upt);
+    upt_stale_destroy(&stale);
+    CHECK(!stale);
+    upt_clock_destroy(&clock);
+}
@@ -0,0 +1,238 @@
+#include "src/upt_statefile.h"
+#include "src/upt.h"
+#include <catch2/catch.hpp>
+#include <unistd.h>
+
+static void s_str_destructor(void** x)
+{
+    zstr_free(reinterpret_cast<char**>(x));
+}
+
+static void s_add(upt_t* upt, const char* dc_name, const char* ups1, const char* ups2)
+{
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>(ups1));
+    if (ups2)
+        zlistx_add_end(ups, const_cast<char*>(ups2));
+    REQUIRE(upt_add(upt, dc_name, ups) == 0);
+    zlistx_destroy(&ups);
+}
+
+// names of member upses of dc_name
+static zlistx_t* s_members(upt_t* upt, const char* dc_name)
+{
+    zlistx_t* members = zlistx_new();
+    zlistx_set_destructor(members, s_str_destructor);
+    for (zlistx_t* dcs = reinterpret_cast<zlistx_t*>(zhashx_first(upt->ups2dc)); dcs != nullptr;
+         dcs           = reinterpret_cast<zlistx_t*>(zhashx_next(upt->ups2dc))) {
+        if (zlistx_find(dcs, const_cast<char*>(dc_name)))
+            zlistx_add_end(members, strdup(reinterpret_cast<const char*>(zhashx_cursor(upt->ups2dc))));
+    }
+    return members;
+}
+
+static void s_write(upt_t* upt, const char* path)
+{
+    upt_statefile_writer_t* writer = upt_statefile_create(path, 1000);
+    REQUIRE(writer);
+    for (dc_t* dc = reinterpret_cast<dc_t*>(zhashx_first(upt->dc)); dc != nullptr;
+         dc       = reinterpret_cast<dc_t*>(zhashx_next(upt->dc))) {
+        const char* dc_name = reinterpret_cast<const char*>(zhashx_cursor(upt->dc));
+        zlistx_t*   members = s_members(upt, dc_name);
+        CHECK(upt_statefile_write(writer, dc_name, dc, members) == 0);
+        zlistx_destroy(&members);
+    }
+    REQUIRE(upt_statefile_commit(&writer) == 0);
+    CHECK(!writer);
+}
+
+// every datacenter of upt is in the file with the same counters, states and members
+static void s_check(upt_t* upt, const char* path)
+{
+    upt_statefile_t* file = upt_statefile_open(path);
+    REQUIRE(file);
+    size_t count = 0;
+    for (upt_statefile_dc_t* record = upt_statefile_next(file); record != nullptr;
+         record                     = upt_statefile_next(file), count++) {
+        dc_t* dc = reinterpret_cast<dc_t*>(zhashx_lookup(upt->dc, record->name));
+        REQUIRE(dc);
+        uint64_t total, offline;
+        REQUIRE(upt_uptime(upt, record->name, &total, &offline) == 0);
+        CHECK(dc_total(record->dc) == total);
+        CHECK(dc_off_line(record->dc) == offline);
+        CHECK(record->dc->policy == dc->policy);
+        CHECK(record->dc->threshold == dc->threshold);
+        CHECK(memcmp(record->dc->durations, dc->durations, sizeof(dc->durations)) == 0);
+        CHECK(dc_is_offline(record->dc) == dc_is_offline(dc));
+        CHECK(dc_ups_state(record->dc, "UPS3") == dc_ups_state(dc, "UPS3"));
+        CHECK(dc_rating(record->dc, "UPS1") == dc_rating(dc, "UPS1"));
+        zlistx_t* members = s_members(upt, record->name);
+        CHECK(zlistx_size(record->upses) == zlistx_size(members));
+        CHECK(record->dc->members == zlistx_size(members));
+        zlistx_destroy(&members);
+        dc_ups_counters_t expected, actual;
+        if (dc_ups_counters(dc, "UPS1", &expected) == 0) {
+            REQUIRE(dc_ups_counters(record->dc, "UPS1", &actual) == 0);
+            CHECK(actual.transitions == expected.transitions);
+            CHECK(actual.last_change == expected.last_change);
+        }
+    }
+    CHECK(!upt_statefile_error(file));
+    CHECK(upt_statefile_ignored(file) == 0);
+    CHECK(count == zhashx_size(upt->dc));
+    upt_statefile_close(&file);
+    CHECK(!file);
+}
+
+static upt_t* s_upt(upt_clock_t* clock)
+{
+    upt_t* upt = upt_new();
+    upt_set_clock(upt, clock);
+    s_add(upt, "DC1", "UPS1", "UPS2");
+    s_add(upt, "DC2", "UPS2", "UPS3");
+    s_add(upt, "DC3", "UPS4", nullptr);
+    upt_set_policy(upt, "DC2", DC_POLICY_CAPACITY, 50);
+    upt_set_rating(upt, "DC1", "UPS1", 3000);
+    upt_clock_advance(clock, 10000);
+    upt_set_offline(upt, "UPS1");
+    upt_set_state(upt, "UPS3", DC_STATE_BYPASS);
+    upt_clock_advance(clock, 5000);
+    upt_set_online(upt, "UPS1");
+    upt_set_offline(upt, "UPS2");
+    upt_clock_advance(clock, 1000);
+    return upt;
+}
+
+static void s_text(const char* path, const char* text)
+{
+    FILE* file = fopen(path, "w");
+    REQUIRE(file);
+    fputs(text, file);
+    fclose(file);
+}
+
+TEST_CASE("upt statefile test")
+{
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    upt_t*       upt   = s_upt(clock);
+    char         path[] = "/tmp/upt-statefile-XXXXXX";
+    int          fd     = mkstemp(path);
+    REQUIRE(fd != -1);
+    close(fd);
+
+    // what the writer writes, the reader reads
+    s_write(upt, path);
+    s_check(upt, path);
+    upt_statefile_t* file = upt_statefile_open(path);
+    REQUIRE(file);
+    CHECK(upt_statefile_checkpoint(file) == 1000);
+    upt_statefile_close(&file);
+
+    // ZPL as zconfig writes it, groups in any order, comments and both quotes
+    s_text(path,
+        "#   state of the agent\n"
+        "checkpoint = \"42\"\n"
+        "dc_list\n"
+        "    dc.1 = \"DC1\"\n"
+        "    dc.2 = 'DC \"2\"'\n"
+        "dc_upses\n"
+        "    DC1\n"
+        "        ups.1 = \"UPS1\"\n"
+        "        ups.2 = \"UPS2\"\n"
+        "        ups.4 = \"UPS4\"\n"
+        "dc_data\n"
+        "    DC1\n"
+        "        total = \"100\"   # seconds\n"
+        "        off_line = 10\n"
+        "        policy = \"all\"\n"
+        "dc_offline\n"
+        "    DC1\n"
+        "        ups.1 = \"UPS1\"\n");
+    file = upt_statefile_open(path);
+    REQUIRE(file);
+    CHECK(upt_statefile_checkpoint(file) == 42);
+    upt_statefile_dc_t* record = upt_statefile_next(file);
+    REQUIRE(record);
+    CHECK(streq(record->name, "DC1"));
+    CHECK(dc_total(record->dc) == 100);
+    CHECK(dc_off_line(record->dc) == 10);
+    CHECK(record->dc->policy == DC_POLICY_ALL);
+    CHECK(zlistx_size(record->upses) == 2);
+    CHECK(dc_ups_state(record->dc, "UPS1") == DC_STATE_ON_BATTERY);
+    CHECK(!dc_is_offline(record->dc));
+    record = upt_statefile_next(file);
+    REQUIRE(record);
+    CHECK(streq(record->name, "DC \"2\""));
+    CHECK(dc_total(record->dc) == 0);
+    CHECK(!upt_statefile_next(file));
+    CHECK(!upt_statefile_error(file));
+    // ups.4 comes after a gap, the agent does not read it either
+    CHECK(upt_statefile_ignored(file) == 1);
+    upt_statefile_close(&file);
+
+    // errors name the line or the value
+    const char* broken[] = {
+        "dc_list\n   dc.1 = \"DC1\"\n",
+        "dc_list\n    dc.2 = \"DC1\"\n",
+        "dc_list\n    dc.1 = \"DC1\"\ndc_data\n    DC1\n        total = \"many\"\n",
+        "dc_list\n    dc.1 = \"DC1\"\ndc_states\n    DC1\n        ups.1 = \"UPS1\"\n        state.1 = \"DOWN\"\n",
+        "dc_list\n    dc.1 = \"DC1\"\n    dc.2 = \"DC2\"\ndc_data\n    DC2\n        total = 1\n    DC1\n        total = 1\n",
+        "dc_list\n    dc.1 = \"DC1\"\ndc_durations\n    DC9\n        online = 1\n",
+        "checkpoint = \"now\"\n",
+    };
+    for (const char* text : broken) {
+        s_text(path, text);
+        file = upt_statefile_open(path);
+        REQUIRE(file);
+        while (upt_statefile_next(file))
+            ;
+        CHECK(upt_statefile_error(file));
+        upt_statefile_close(&file);
+    }
+    CHECK(!upt_statefile_open("/nonexistent/state"));
+
+    // nothing is written without commit
+    unlink(path);
+    upt_statefile_writer_t* writer = upt_statefile_create(path, -1);
+    REQUIRE(writer);
+    upt_statefile_abort(&writer);
+    CHECK(!writer);
+    CHECK(access(path, F_OK) != 0);
+
+    upt_destroy(&upt);
+    upt_clock_destroy(&clock);
+}
+
+TEST_CASE("upt statefile zconfig")
+{
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    upt_t*       upt   = s_upt(clock);
+    char         path[] = "/tmp/upt-statefile-XXXXXX";
+    int          fd     = mkstemp(path);
+    REQUIRE(fd != -1);
+    close(fd);
+
+    // the reader reads what upt_save writes
+    REQUIRE(upt_save(upt, path) == 0);
+    s_check(upt, path);
+
+    // upt_load reads what the writer writes
+    s_write(upt, path);
+    upt_t* loaded = upt_load(path);
+    REQUIRE(loaded);
+    upt_set_clock(loaded, clock);
+    for (const char* dc_name : {"DC1", "DC2", "DC3"}) {
+        uint64_t total, offline, loaded_total, loaded_offline;
+        REQUIRE(upt_uptime(upt, dc_name, &total, &offline) == 0);
+        REQUIRE(upt_uptime(loaded, dc_name, &loaded_total, &loaded_offline) == 0);
+        CHECK(loaded_total == total);
+        CHECK(loaded_offline == offline);
+        CHECK(upt_is_offline(loaded, dc_name) == upt_is_offline(upt, dc_name));
+    }
+    CHECK(zlistx_size(upt_dc_names(loaded, "UPS2")) == 2);
+
+    unlink(path);
+    upt_destroy(&loaded);
+    upt_destroy(&upt);
+    upt_clock_destroy(&clock);
+}
@@ -0,0 +1,46 @@
+#include "src/upt_stats.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("upt stats test")
+{
+    upt_stats_t* stats = upt_stats_new();
+    REQUIRE(stats);
+
+    CHECK(upt_stats_histogram_percentile(&stats->poll, 99) == 0);
+
+    for (uint64_t i = 0; i != 99; i++) {
+        upt_stats_histogram_add(&stats->poll, 3);
+    }
+    upt_stats_histogram_add(&stats->poll, 1000);
+    CHECK(stats->poll.count == 100);
+    CHECK(stats->poll.max_us == 1000);
+    CHECK(upt_stats_histogram_percentile(&stats->poll, 50) == 4);
+    CHECK(upt_stats_histogram_percentile(&stats->poll, 100) == 1024);
+
+    // durations beyond the last bucket are reported as the maximum
+    upt_stats_histogram_add(&stats->save, UINT64_MAX / 2);
+    CHECK(upt_stats_histogram_percentile(&stats->save, 50) == UINT64_MAX / 2);
+
+    stats->transitions = 42;
+    zmsg_t* report     = zmsg_new();
+    upt_stats_report(stats, report);
+    CHECK(zmsg_size(report) % 2 == 0);
+
+    bool found = false;
+    for (zframe_t* name = zmsg_first(report); name != nullptr; name = zmsg_next(report)) {
+        zframe_t* value = zmsg_next(report);
+        if (zframe_streq(name, "transitions"))
+            found = zframe_streq(value, "42");
+    }
+    CHECK(found);
+
+    REQUIRE(upt_stats_dump(report, "./stats-test") == 0);
+    zconfig_t* dump = zconfig_load("./stats-test");
+    CHECK(zsys_file_exists("./stats-test"));
+    zconfig_destroy(&dump);
+    zsys_file_delete("./stats-test");
+
+    zmsg_destroy(&report);
+    upt_stats_destroy(&stats);
+    CHECK(!stats);
+}
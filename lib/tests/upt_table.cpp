@@ -0,0 +1,200 @@
+#include "src/dc.h"
+#include "src/upt.h"
+#include <catch2/catch.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("upt table test")
+{
+    zsys_file_delete("./table-test");
+    upt_table_t* table = upt_table_open("./table-test", 2);
+    REQUIRE(table);
+    CHECK(upt_table_size(table) == 0);
+    CHECK(upt_table_capacity(table) == 2);
+    CHECK(!upt_table_lookup(table, "DC001"));
+
+    upt_table_slot_t* slot = upt_table_slot(table, "DC001");
+    REQUIRE(slot);
+    CHECK(upt_table_slot(table, "DC001") == slot);
+    CHECK(upt_table_lookup(table, "DC001") == slot);
+    upt_table_set_offset(table, 1000);
+    upt_table_write(slot, 42, 10, 4, 1);
+
+    // other processes map the file read only
+    upt_table_t* reader = upt_table_open_readonly("./table-test");
+    REQUIRE(reader);
+    upt_table_entry_t entry;
+    REQUIRE(upt_table_get(reader, "DC001", &entry) == 0);
+    CHECK(entry.last_update == 1042);
+    CHECK(entry.total == 10);
+    CHECK(entry.offline == 4);
+    CHECK(entry.offline_upses == 1);
+    CHECK(upt_table_get(reader, "DC002", &entry) == -1);
+    CHECK(!upt_table_slot(reader, "DC002"));
+
+    // slots appended later are found by readers too
+    REQUIRE(upt_table_slot(table, "DC002"));
+    CHECK(!upt_table_slot(table, "DC003"));
+    CHECK(upt_table_get(reader, "DC002", &entry) == 0);
+    CHECK(upt_table_size(reader) == 2);
+    CHECK(streq(upt_table_name(reader, 1), "DC002"));
+    CHECK(upt_table_sync(table, true) == 0);
+
+    upt_table_destroy(&reader);
+    upt_table_destroy(&table);
+    CHECK(!table);
+
+    // capacity of an existing table is kept, values too
+    table = upt_table_open("./table-test", 100);
+    REQUIRE(table);
+    CHECK(upt_table_capacity(table) == 2);
+    REQUIRE(upt_table_get(table, "DC001", &entry) == 0);
+    CHECK(entry.total == 10);
+    upt_table_destroy(&table);
+
+    FILE* file = fopen("./table-test", "w");
+    REQUIRE(file);
+    fprintf(file, "not a table");
+    fclose(file);
+    CHECK(!upt_table_open("./table-test", 2));
+    CHECK(!upt_table_open_readonly("./table-missing"));
+    zsys_file_delete("./table-test");
+}
+
+TEST_CASE("upt table crash")
+{
+    zsys_file_delete("./table-crash");
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    upt_table_t* table = upt_table_open("./table-crash", 16);
+    REQUIRE(table);
+
+    upt_t* upt = upt_new();
+    upt_set_clock(upt, clock);
+    zlistx_t* ups = zlistx_new();
+    zlistx_add_end(ups, const_cast<char*>("UPS001"));
+    upt_add(upt, "DC001", ups);
+    REQUIRE(upt_save(upt, "./table-crash-state") == 0);
+
+    // counters are written through on every change, no save needed
+    upt_set_table(upt, table);
+    upt_set_offline(upt, "UPS001");
+    upt_clock_advance(clock, 10000);
+    uint64_t total, offline;
+    upt_uptime(upt, "DC001", &total, &offline);
+    upt_table_entry_t entry;
+    REQUIRE(upt_table_get(table, "DC001", &entry) == 0);
+    CHECK(entry.total == 10);
+    CHECK(entry.offline == 10);
+    CHECK(entry.offline_upses == 1);
+
+    // datacenters added later are mapped too
+    upt_add(upt, "DC002", nullptr);
+    CHECK(upt_table_get(table, "DC002", &entry) == 0);
+
+    // crash: the state file is older than the table
+    upt_destroy(&upt);
+    upt_table_destroy(&table);
+
+    table = upt_table_open("./table-crash", 16);
+    REQUIRE(table);
+    upt = upt_load("./table-crash-state");
+    upt_set_clock(upt, clock);
+    upt_set_table(upt, table);
+    REQUIRE(upt_uptime(upt, "DC001", &total, &offline) == 0);
+    CHECK(total == 10);
+    CHECK(offline == 10);
+
+    // copies (shards) are not mapped
+    dc_t* dc   = reinterpret_cast<dc_t*>(zhashx_lookup(upt->dc, "DC001"));
+    dc_t* copy = dc_dup(dc);
+    CHECK(!copy->slot);
+    dc_destroy(&copy);
+
+    upt_set_table(upt, nullptr);
+    CHECK(!dc->slot);
+
+    zlistx_destroy(&ups);
+    upt_destroy(&upt);
+    upt_table_destroy(&table);
+    upt_clock_destroy(&clock);
+    zsys_file_delete("./table-crash");
+    zsys_file_delete("./table-crash-state");
+}
+
+TEST_CASE("upt table offset")
+{
+    // previous writer ran on a clock 1000s ahead of the wall clock (before a reboot)
+    zsys_file_delete("./table-offset");
+    upt_table_t* table = upt_table_open("./table-offset", 4);
+    REQUIRE(table);
+    upt_table_set_offset(table, -1000);
+    upt_table_write(upt_table_slot(table, "DC001"), 102050, 20, 0, 0);
+    REQUIRE(upt_table_slot(table, "DC002")); // never written
+    upt_table_destroy(&table);
+
+    table = upt_table_open("./table-offset", 4);
+    REQUIRE(table);
+    upt_table_entry_t entry;
+    REQUIRE(upt_table_get(table, "DC001", &entry) == 0);
+    CHECK(entry.last_update == 101050);
+
+    // new writer has its own offset, wall clock time of slots is kept
+    upt_clock_t* clock = upt_clock_sim_new(101060 * 1000LL);
+    upt_t*       upt   = upt_new();
+    upt_set_clock(upt, clock);
+    upt_add(upt, "DC001", nullptr);
+    upt_set_table(upt, table);
+    REQUIRE(upt_table_get(table, "DC002", &entry) == 0);
+    CHECK(entry.last_update == 0);
+
+    // gap since the checkpoint adopted from the table is reconciled
+    upt_reconcile(upt, DC_GAP_ASSUME, 0);
+    uint64_t total, offline;
+    REQUIRE(upt_uptime(upt, "DC001", &total, &offline) == 0);
+    CHECK(total == 30);
+    CHECK(offline == 0);
+    REQUIRE(upt_table_get(table, "DC001", &entry) == 0);
+    CHECK(entry.last_update == 101060);
+    CHECK(entry.total == 30);
+
+    upt_destroy(&upt);
+    upt_table_destroy(&table);
+    upt_clock_destroy(&clock);
+    zsys_file_delete("./table-offset");
+}
+
+TEST_CASE("upt table shared by shards")
+{
+    zsys_file_delete("./table-shards");
+    upt_table_t* table = upt_table_open("./table-shards", 512);
+    REQUIRE(table);
+
+    // every shard maps its own datacenters, new ones are appended concurrently
+    upt_t* parts[2];
+    for (size_t i = 0; i != 2; i++) {
+        parts[i] = upt_new();
+        upt_set_table(parts[i], table);
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i != 2; i++) {
+        threads.emplace_back([&parts, i]() {
+            for (int d = 0; d != 200; d++) {
+                char* dc_name = zsys_sprintf("DC%zu-%03d", i, d);
+                upt_add(parts[i], dc_name, nullptr);
+                zstr_free(&dc_name);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    CHECK(upt_table_size(table) == 400);
+    upt_table_entry_t entry;
+    CHECK(upt_table_get(table, "DC0-199", &entry) == 0);
+    CHECK(upt_table_get(table, "DC1-000", &entry) == 0);
+
+    for (size_t i = 0; i != 2; i++)
+        upt_destroy(&parts[i]);
+    upt_table_destroy(&table);
+    zsys_file_delete("./table-shards");
+}
@@ -0,0 +1,40 @@
+#include "src/upt_trace.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("upt trace test")
+{
+    CHECK(upt_trace_parse("off") == UPT_TRACE_OFF);
+    CHECK(upt_trace_parse("sample") == UPT_TRACE_SAMPLE);
+    CHECK(upt_trace_parse("full") == UPT_TRACE_FULL);
+    CHECK(upt_trace_parse("verbose") == -1);
+    CHECK(upt_trace_parse(nullptr) == -1);
+
+    CHECK(upt_trace_mode() == UPT_TRACE_OFF);
+    upt_trace_point_t point;
+    point.window.store(0);
+    point.count.store(0);
+    point.dropped.store(0);
+    CHECK(!upt_trace_admit(&point));
+
+    upt_trace_set_mode(UPT_TRACE_FULL, 0);
+    CHECK(upt_trace_mode() == UPT_TRACE_FULL);
+    for (int i = 0; i != 100; i++)
+        CHECK(upt_trace_admit(&point));
+
+    // sample mode lets rate records per second through, the rest is counted as dropped
+    upt_trace_set_mode(UPT_TRACE_SAMPLE, 5);
+    int64_t window   = zclock_mono() / 1000;
+    int     admitted = 0;
+    for (int i = 0; i != 100; i++)
+        admitted += upt_trace_admit(&point) ? 1 : 0;
+    if (zclock_mono() / 1000 == window) {
+        CHECK(admitted == 5);
+        CHECK(point.dropped.load() == 95);
+    }
+
+    // trace statements compile in both builds and are silent when off
+    upt_trace_set_mode(UPT_TRACE_OFF, 0);
+    int evaluated = 0;
+    upt_trace("test.point", "value=%d", ++evaluated);
+    CHECK(evaluated == 0);
+}
@@ -0,0 +1,142 @@
+#include "src/upt_tree.h"
+#include <catch2/catch.hpp>
+
+static void s_check(upt_tree_t* tree, const char* name, uint64_t total, uint64_t offline, size_t offline_children)
+{
+    upt_tree_rollup_t rollup;
+    REQUIRE(upt_tree_rollup(tree, name, &rollup) == 0);
+    CHECK(rollup.total == total);
+    CHECK(rollup.offline == offline);
+    CHECK(rollup.offline_children == offline_children);
+}
+
+TEST_CASE("upt tree test")
+{
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    upt_tree_t*  tree  = upt_tree_new(clock);
+
+    // estate / DC1 / ROOM1 / ROW1 / RACK1, RACK2 arrives before its row
+    REQUIRE(upt_tree_set_node(tree, "DC1", "datacenter", nullptr) == 0);
+    REQUIRE(upt_tree_set_node(tree, "ROOM1", "room", "DC1") == 0);
+    REQUIRE(upt_tree_set_node(tree, "RACK2", "rack", "ROW1") == 0);
+    REQUIRE(upt_tree_set_node(tree, "ROW1", "row", "ROOM1") == 0);
+    REQUIRE(upt_tree_set_node(tree, "RACK1", "rack", "ROW1") == 0);
+    upt_tree_set_ups(tree, "UPS1", "RACK1");
+    upt_tree_set_ups(tree, "UPS2", "RACK2");
+    upt_tree_set_ups(tree, "UPS3", "ROOM1");
+
+    upt_tree_rollup_t rollup;
+    REQUIRE(upt_tree_rollup(tree, "RACK2", &rollup) == 0);
+    CHECK(streq(rollup.type, "rack"));
+    CHECK(streq(rollup.parent, "ROW1"));
+    REQUIRE(upt_tree_rollup(tree, "ROOM1", &rollup) == 0);
+    CHECK(rollup.children == 2);
+    REQUIRE(upt_tree_rollup(tree, UPT_TREE_ROOT, &rollup) == 0);
+    CHECK(!rollup.parent);
+    CHECK(rollup.children == 1);
+    CHECK(upt_tree_rollup(tree, "RACK42", &rollup) == -1);
+
+    // offline ups makes all its ancestors offline, a second one only counts in its rack and row
+    upt_clock_advance(clock, 10000);
+    CHECK(upt_tree_set_offline(tree, "UPS1", true));
+    CHECK(!upt_tree_set_offline(tree, "UPS1", true));
+    CHECK(upt_tree_is_offline(tree, UPT_TREE_ROOT));
+    CHECK(!upt_tree_is_offline(tree, "RACK2"));
+    upt_clock_advance(clock, 5000);
+    CHECK(upt_tree_set_offline(tree, "UPS2", true));
+    s_check(tree, "ROW1", 15, 5, 2);
+    s_check(tree, "ROOM1", 15, 5, 1);
+    upt_clock_advance(clock, 5000);
+    CHECK(upt_tree_set_offline(tree, "UPS1", false));
+    CHECK(upt_tree_set_offline(tree, "UPS2", false));
+    s_check(tree, "RACK1", 20, 10, 0);
+    s_check(tree, "RACK2", 20, 5, 0);
+    s_check(tree, "DC1", 20, 10, 0);
+    s_check(tree, UPT_TREE_ROOT, 20, 10, 0);
+    REQUIRE(upt_tree_rollup(tree, "DC1", &rollup) == 0);
+    CHECK(rollup.outages == 1);
+
+    // moving an offline ups or rack takes its status along
+    CHECK(upt_tree_set_offline(tree, "UPS3", true));
+    REQUIRE(upt_tree_set_node(tree, "DC2", "datacenter", "") == 0);
+    REQUIRE(upt_tree_set_node(tree, "ROOM2", "room", "DC2") == 0);
+    upt_tree_set_ups(tree, "UPS3", "ROOM2");
+    CHECK(!upt_tree_is_offline(tree, "DC1"));
+    CHECK(upt_tree_is_offline(tree, "DC2"));
+    CHECK(upt_tree_set_offline(tree, "UPS2", true));
+    REQUIRE(upt_tree_set_node(tree, "RACK2", "rack", "ROOM2") == 0);
+    CHECK(!upt_tree_is_offline(tree, "ROW1"));
+    s_check(tree, "ROOM2", 0, 0, 2);
+    s_check(tree, UPT_TREE_ROOT, 20, 10, 1);
+
+    // cycles and the root are refused
+    CHECK(upt_tree_set_node(tree, "DC2", "datacenter", "RACK2") == -1);
+    CHECK(upt_tree_set_node(tree, "DC2", "datacenter", "DC2") == -1);
+    CHECK(upt_tree_set_node(tree, UPT_TREE_ROOT, "room", "DC1") == -1);
+
+    // status of an ups comes before its placement
+    CHECK(upt_tree_set_offline(tree, "UPS4", true));
+    upt_tree_set_ups(tree, "UPS4", "RACK1");
+    CHECK(upt_tree_is_offline(tree, "DC1"));
+
+    // removed node hands its children over to its parent
+    upt_tree_remove(tree, "ROW1");
+    REQUIRE(upt_tree_rollup(tree, "RACK1", &rollup) == 0);
+    CHECK(streq(rollup.parent, "ROOM1"));
+    s_check(tree, "ROOM1", 20, 10, 1);
+    upt_tree_remove(tree, "UPS4");
+    CHECK(!upt_tree_is_offline(tree, "DC1"));
+    upt_tree_remove(tree, UPT_TREE_ROOT);
+    CHECK(upt_tree_rollup(tree, UPT_TREE_ROOT, &rollup) == 0);
+
+    // time accounted so far survives a change of the clock
+    upt_clock_t* other = upt_clock_sim_new(1000000);
+    upt_tree_set_clock(tree, other);
+    upt_clock_advance(other, 5000);
+    s_check(tree, "DC2", 5, 5, 1);
+
+    upt_tree_destroy(&tree);
+    CHECK(!tree);
+    upt_clock_destroy(&other);
+    upt_clock_destroy(&clock);
+}
+
+TEST_CASE("upt tree scale")
+{
+    upt_clock_t* clock = upt_clock_sim_new(0);
+    upt_tree_t*  tree  = upt_tree_new(clock);
+
+    // 10 datacenters of 10 rooms of 10 rows of 10 racks, one ups per rack
+    for (int i = 0; i != 10000; i++) {
+        char* dc   = zsys_sprintf("DC%d", i / 1000);
+        char* room = zsys_sprintf("ROOM%d", i / 100);
+        char* row  = zsys_sprintf("ROW%d", i / 10);
+        char* rack = zsys_sprintf("RACK%d", i);
+        char* ups  = zsys_sprintf("UPS%d", i);
+        upt_tree_set_node(tree, dc, "datacenter", nullptr);
+        upt_tree_set_node(tree, room, "room", dc);
+        upt_tree_set_node(tree, row, "row", room);
+        upt_tree_set_node(tree, rack, "rack", row);
+        upt_tree_set_ups(tree, ups, rack);
+        zstr_free(&dc);
+        zstr_free(&room);
+        zstr_free(&row);
+        zstr_free(&rack);
+        zstr_free(&ups);
+    }
+
+    upt_clock_advance(clock, 1000);
+    for (int i = 0; i != 10000; i++) {
+        char* ups = zsys_sprintf("UPS%d", i);
+        CHECK(upt_tree_set_offline(tree, ups, true));
+        zstr_free(&ups);
+    }
+    upt_clock_advance(clock, 1000);
+    s_check(tree, UPT_TREE_ROOT, 2, 1, 10);
+    s_check(tree, "DC3", 2, 1, 10);
+    s_check(tree, "ROW42", 2, 1, 10);
+    REQUIRE(zhashx_size(tree->nodes) == 1 + 10 + 100 + 1000 + 10000);
+
+    upt_tree_destroy(&tree);
+    upt_clock_destroy(&clock);
+}
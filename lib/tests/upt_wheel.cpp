@@ -0,0 +1,82 @@
+#include "src/upt_wheel.h"
+#include <catch2/catch.hpp>
+
+static void s_collect(const char* key, int64_t /*deadline*/, void* arg)
+{
+    zlistx_add_end(reinterpret_cast<zlistx_t*>(arg), const_cast<char*>(key));
+}
+
+TEST_CASE("upt wheel test")
+{
+    // 10 msec ticks, 8 slots, a turn of level 0 is 80 msec, of level 1 640 msec
+    upt_wheel_t* wheel   = upt_wheel_new(10, 8, 0);
+    zlistx_t*    expired = zlistx_new();
+    zlistx_set_duplicator(expired, [](const void* x) -> void* { return strdup(reinterpret_cast<const char*>(x)); });
+    zlistx_set_destructor(expired, [](void** x) { zstr_free(reinterpret_cast<char**>(x)); });
+
+    upt_wheel_add(wheel, "a", 25);
+    upt_wheel_add(wheel, "b", 30);
+    upt_wheel_add(wheel, "c", 2000); // beyond level 1
+    upt_wheel_add(wheel, "d", 40);
+    CHECK(upt_wheel_size(wheel) == 4);
+    CHECK(upt_wheel_next(wheel) == 30);
+
+    // timers never expire early
+    CHECK(upt_wheel_advance(wheel, 20, s_collect, expired) == 0);
+    CHECK(upt_wheel_advance(wheel, 29, s_collect, expired) == 0);
+    CHECK(upt_wheel_advance(wheel, 30, s_collect, expired) == 2);
+    CHECK(zlistx_size(expired) == 2);
+    CHECK(streq(reinterpret_cast<char*>(zlistx_first(expired)), "a"));
+    CHECK(streq(reinterpret_cast<char*>(zlistx_next(expired)), "b"));
+    zlistx_purge(expired);
+    CHECK(upt_wheel_next(wheel) == 40);
+
+    // later timers wait on upper levels
+    CHECK(upt_wheel_advance(wheel, 45, s_collect, expired) == 1);
+    CHECK(streq(reinterpret_cast<char*>(zlistx_first(expired)), "d"));
+    CHECK(upt_wheel_size(wheel) == 1);
+    zlistx_purge(expired);
+
+    // upper levels give the time they cascade, before the deadline of their timers
+    CHECK(upt_wheel_next(wheel) > 45);
+    CHECK(upt_wheel_next(wheel) <= 2000);
+
+    // past deadlines expire at the next tick
+    upt_wheel_add(wheel, "e", 10);
+    CHECK(upt_wheel_advance(wheel, 49, s_collect, expired) == 0);
+    CHECK(upt_wheel_advance(wheel, 50, s_collect, expired) == 1);
+    zlistx_purge(expired);
+
+    // timers of level 1 move down when level 0 completes its turn, and expire on time
+    upt_wheel_add(wheel, "f", 130);
+    upt_wheel_add(wheel, "g", 555);
+    CHECK(upt_wheel_advance(wheel, 129, s_collect, expired) == 0);
+    CHECK(upt_wheel_advance(wheel, 130, s_collect, expired) == 1);
+    CHECK(streq(reinterpret_cast<char*>(zlistx_first(expired)), "f"));
+    zlistx_purge(expired);
+    CHECK(upt_wheel_advance(wheel, 559, s_collect, expired) == 0);
+    CHECK(upt_wheel_advance(wheel, 560, s_collect, expired) == 1);
+    zlistx_purge(expired);
+
+    // a jump over a turn of level 1 redistributes all timers
+    upt_wheel_add(wheel, "h", 5000);
+    CHECK(upt_wheel_advance(wheel, 2500, s_collect, expired) == 1);
+    CHECK(streq(reinterpret_cast<char*>(zlistx_first(expired)), "c"));
+    CHECK(upt_wheel_size(wheel) == 1);
+    zlistx_purge(expired);
+    CHECK(upt_wheel_advance(wheel, 4999, s_collect, expired) == 0);
+    CHECK(upt_wheel_advance(wheel, 5000, s_collect, expired) == 1);
+    CHECK(upt_wheel_size(wheel) == 0);
+    CHECK(upt_wheel_next(wheel) == -1);
+    zlistx_purge(expired);
+
+    // a timer beyond the range of the wheel (40960 msec) is not expired before its deadline
+    upt_wheel_add(wheel, "i", 100000);
+    for (int64_t now = 5500; now < 100000; now += 500)
+        CHECK(upt_wheel_advance(wheel, now, s_collect, expired) == 0);
+    CHECK(upt_wheel_advance(wheel, 100000, s_collect, expired) == 1);
+
+    zlistx_destroy(&expired);
+    upt_wheel_destroy(&wheel);
+    CHECK(!wheel);
+}